@@ -17,11 +17,14 @@
  */
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-inline_ BOOL AABBTreeCollider::BoxBoxOverlap(const Point& ea, const Point& ca, const Point& eb, const Point& cb)
+inline_ BOOL AABBTreeCollider::BoxBoxOverlap(const Point& box_ea, const Point& ca, const Point& eb, const Point& cb)
 {
 	// Stats
 	mNbBVBVTests++;
 
+	// Margin queries grow box A
+	const Point ea(box_ea.x + mMargin, box_ea.y + mMargin, box_ea.z + mMargin);
+
 	float t,t2;
 
 	// Class I : A's basis vectors
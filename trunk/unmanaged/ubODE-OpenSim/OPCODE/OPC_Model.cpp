@@ -178,6 +178,43 @@ bool Model::Build(const OPCODECREATE& create)
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Loads a collision model from a tree saved with AABBNoLeafTree::Serialize(), instead of building it.
+ *	\param		create		[in] model creation structure, only the mesh interface is used
+ *	\param		nodes		[in] serialized nodes
+ *	\param		nb_nodes	[in] number of nodes
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Model::Load(const OPCODECREATE& create, const AABBNoLeafSerializedNode* nodes, udword nb_nodes)
+{
+	// Checkings
+	if(!create.mIMesh || !create.mIMesh->IsValid())	return false;
+
+	Release();
+
+	SetMeshInterface(create.mIMesh);
+
+	// Single triangle meshes have no tree
+	udword NbTris = create.mIMesh->GetNbTriangles();
+	if(NbTris==1)
+	{
+		mModelCode |= OPC_SINGLE_NODE;
+		return nb_nodes==0;
+	}
+
+	if(!CreateTree())	return false;
+
+	// CreateTree() always makes no-leaf trees
+	if(!static_cast<AABBNoLeafTree*>(mTree)->Deserialize(nodes, nb_nodes, NbTris))
+	{
+		DELETESINGLE(mTree);
+		return false;
+	}
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Gets the number of bytes used by the tree.
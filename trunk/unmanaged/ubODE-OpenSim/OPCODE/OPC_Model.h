@@ -36,6 +36,17 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	bool				Build(const OPCODECREATE& create);
 
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Loads a collision model from a tree saved with AABBNoLeafTree::Serialize(), instead of building it.
+		 *	\param		create		[in] model creation structure, only the mesh interface is used
+		 *	\param		nodes		[in] serialized nodes
+		 *	\param		nb_nodes	[in] number of nodes
+		 *	\return		true if success
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							bool				Load(const OPCODECREATE& create, const AABBNoLeafSerializedNode* nodes, udword nb_nodes);
+
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/**
 		 *	Gets the number of bytes used by the tree.
@@ -425,3 +425,69 @@ bool AABBNoLeafTree::Walk(GenericWalkingCallback callback, void* user_data) cons
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Saves the tree with child links as node indices, so it can be loaded at another address.
+ *	\param		nodes			[out] GetNbNodes() serialized nodes
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void AABBNoLeafTree::Serialize(AABBNoLeafSerializedNode* nodes) const
+{
+	for(udword i=0;i<mNbNodes;i++)
+	{
+		const AABBNoLeafNode& Current = mNodes[i];
+		nodes[i].mAABB = Current.mAABB;
+		nodes[i].mPosData = Current.HasPosLeaf() ? udword(Current.mPosData) : udword(Current.GetPos() - mNodes)<<1;
+		nodes[i].mNegData = Current.HasNegLeaf() ? udword(Current.mNegData) : udword(Current.GetNeg() - mNodes)<<1;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Loads a tree saved by Serialize().
+ *	\param		nodes			[in] serialized nodes
+ *	\param		nb_nodes		[in] number of nodes
+ *	\param		nb_prims		[in] number of primitives of the mesh the tree is used with
+ *	\return		true if success, false if the nodes don't make a valid tree for the mesh
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AABBNoLeafTree::Deserialize(const AABBNoLeafSerializedNode* nodes, udword nb_nodes, udword nb_prims)
+{
+	if(!nodes || nb_nodes!=nb_prims-1)	return false;
+
+	if(mNbNodes!=nb_nodes)
+	{
+		mNbNodes = nb_nodes;
+		DELETEARRAY(mNodes);
+		mNodes = new AABBNoLeafNode[mNbNodes];
+		CHECKALLOC(mNodes);
+	}
+
+	for(udword i=0;i<nb_nodes;i++)
+	{
+		const AABBNoLeafSerializedNode& Current = nodes[i];
+		mNodes[i].mAABB = Current.mAABB;
+
+		// Children always come after their parent, so the walk can't loop
+		const udword Links[2] = { Current.mPosData, Current.mNegData };
+		size_t Data[2];
+		for(udword j=0;j<2;j++)
+		{
+			const udword Index = Links[j]>>1;
+			if(Links[j]&1)
+			{
+				if(Index>=nb_prims)	return false;
+				Data[j] = Links[j];
+			}
+			else
+			{
+				if(Index<=i || Index>=nb_nodes)	return false;
+				Data[j] = (size_t)&mNodes[Index];
+			}
+		}
+		mNodes[i].mPosData = Data[0];
+		mNodes[i].mNegData = Data[1];
+	}
+	return true;
+}
+
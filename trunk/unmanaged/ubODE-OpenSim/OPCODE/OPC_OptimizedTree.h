@@ -159,9 +159,23 @@
 		IMPLEMENT_COLLISION_TREE(AABBCollisionTree, AABBCollisionNode)
 	};
 
+	//! Fixed size node layout used to save and load no-leaf trees
+	struct OPCODE_API AABBNoLeafSerializedNode
+	{
+						CollisionAABB		mAABB;
+						udword				mPosData;	//!< (primitive<<1)|1 for leaves, else (node index<<1)
+						udword				mNegData;	//!< same for the negative child
+	};
+
 	class OPCODE_API AABBNoLeafTree : public AABBOptimizedTree
 	{
 		IMPLEMENT_COLLISION_TREE(AABBNoLeafTree, AABBNoLeafNode)
+
+		public:
+		// Serialization
+		inline_						udword			GetSerializedSize()	const	{ return mNbNodes*sizeof(AABBNoLeafSerializedNode);	}
+									void			Serialize(AABBNoLeafSerializedNode* nodes)	const;
+									bool			Deserialize(const AABBNoLeafSerializedNode* nodes, udword nb_nodes, udword nb_prims);
 	};
 
 #endif // __OPC_OPTIMIZEDTREE_H__
@@ -49,7 +49,8 @@ AABBTreeCollider::AABBTreeCollider() :
 	mNbPrimPrimTests	(0),
 	mNbBVPrimTests		(0),
 	mFullBoxBoxTest		(true),
-	mFullPrimBoxTest	(true)
+	mFullPrimBoxTest	(true),
+	mMargin				(0.0f)
 {
 }
 
@@ -112,6 +113,34 @@ bool AABBTreeCollider::Collide(BVTCache& cache, const Matrix4x4* world0, const M
 	return Status;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Collision query restricted to a list of primitive pairs, see Collide(). The pairs are tested in order, with
+ *	the triangle-triangle overlap test whatever the margin.
+ *
+ *	\param		cache			[in] collision cache for model pointers
+ *	\param		pairs			[in] primitive indices, 2 entries per pair
+ *	\param		nb_pairs		[in] number of pairs
+ *	\param		world0			[in] world matrix for first object
+ *	\param		world1			[in] world matrix for second object
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AABBTreeCollider::CollidePairs(BVTCache& cache, const udword* pairs, udword nb_pairs, const Matrix4x4* world0, const Matrix4x4* world1)
+{
+	// Checkings
+	if(!cache.Model0 || !cache.Model1)								return false;
+	if(!Setup(cache.Model0->GetMeshInterface(), cache.Model1->GetMeshInterface()))	return false;
+
+	InitQuery(world0, world1);
+
+	const float Margin = mMargin;
+	mMargin = 0.0f;
+	for(udword i=0;i<nb_pairs;i++)	PrimTest(pairs[i*2], pairs[i*2+1]);
+	mMargin = Margin;
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Initializes a collision query :
@@ -355,7 +384,8 @@ void AABBTreeCollider::PrimTest(udword id0, udword id1)
 	TransformPoint(u2, *VP1.Vertex[2], mR1to0, mT1to0);
 
 	// Perform triangle-triangle overlap test
-	if(TriTriOverlap(*VP0.Vertex[0], *VP0.Vertex[1], *VP0.Vertex[2], u0, u1, u2))
+	if(mMargin != 0.0f ? TriTriNear(*VP0.Vertex[0], *VP0.Vertex[1], *VP0.Vertex[2], u0, u1, u2)
+		: TriTriOverlap(*VP0.Vertex[0], *VP0.Vertex[1], *VP0.Vertex[2], u0, u1, u2))
 	{
 		// Keep track of colliding pairs
 		mPairs.Add(id0).Add(id1);
@@ -377,7 +407,8 @@ inline_ void AABBTreeCollider::PrimTestTriIndex(udword id1)
 	mIMesh1->GetTriangle(VP, id1);
 
 	// Perform triangle-triangle overlap test
-	if(TriTriOverlap(mLeafVerts[0], mLeafVerts[1], mLeafVerts[2], *VP.Vertex[0], *VP.Vertex[1], *VP.Vertex[2]))
+	if(mMargin != 0.0f ? TriTriNear(mLeafVerts[0], mLeafVerts[1], mLeafVerts[2], *VP.Vertex[0], *VP.Vertex[1], *VP.Vertex[2])
+		: TriTriOverlap(mLeafVerts[0], mLeafVerts[1], mLeafVerts[2], *VP.Vertex[0], *VP.Vertex[1], *VP.Vertex[2]))
 	{
 		// Keep track of colliding pairs
 		mPairs.Add(mLeafIndex).Add(id1);
@@ -399,7 +430,8 @@ inline_ void AABBTreeCollider::PrimTestIndexTri(udword id0)
 	mIMesh0->GetTriangle(VP, id0);
 
 	// Perform triangle-triangle overlap test
-	if(TriTriOverlap(mLeafVerts[0], mLeafVerts[1], mLeafVerts[2], *VP.Vertex[0], *VP.Vertex[1], *VP.Vertex[2]))
+	if(mMargin != 0.0f ? TriTriNear(mLeafVerts[0], mLeafVerts[1], mLeafVerts[2], *VP.Vertex[0], *VP.Vertex[1], *VP.Vertex[2])
+		: TriTriOverlap(mLeafVerts[0], mLeafVerts[1], mLeafVerts[2], *VP.Vertex[0], *VP.Vertex[1], *VP.Vertex[2]))
 	{
 		// Keep track of colliding pairs
 		mPairs.Add(id0).Add(mLeafIndex);
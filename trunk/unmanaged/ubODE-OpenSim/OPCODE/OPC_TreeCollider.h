@@ -73,6 +73,21 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 							bool			Collide(BVTCache& cache, const Matrix4x4* world0=null, const Matrix4x4* world1=null);
 
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Collision query restricted to a list of primitive pairs, typically the pairs found by a previous
+		 *	margin query. Results are accessed as with Collide(), in the order of the list.
+		 *
+		 *	\param		cache			[in] collision cache for model pointers
+		 *	\param		pairs			[in] primitive indices, 2 entries per pair
+		 *	\param		nb_pairs		[in] number of pairs
+		 *	\param		world0			[in] world matrix for first object, or null
+		 *	\param		world1			[in] world matrix for second object, or null
+		 *	\return		true if success
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							bool			CollidePairs(BVTCache& cache, const udword* pairs, udword nb_pairs, const Matrix4x4* world0=null, const Matrix4x4* world1=null);
+
 		// Collision queries
 							bool			Collide(const AABBCollisionTree* tree0, const AABBCollisionTree* tree1,				const Matrix4x4* world0=null, const Matrix4x4* world1=null, Pair* cache=null);
 							bool			Collide(const AABBNoLeafTree* tree0, const AABBNoLeafTree* tree1,					const Matrix4x4* world0=null, const Matrix4x4* world1=null, Pair* cache=null);
@@ -96,6 +111,16 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		inline_				void			SetFullPrimBoxTest(bool flag)			{ mFullPrimBoxTest		= flag;					}
 
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Settings: with a non zero margin, Collide() reports the pairs of primitives whose bounds are closer than
+		 *	the margin instead of the overlapping ones. Boxes are inflated and primitives only compare their bounds,
+		 *	so near coplanar pairs TriTriOverlap accepts at a larger distance are left out.
+		 *	\param		margin		[in] distance, 0 for overlap queries
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		inline_				void			SetMargin(float margin)					{ mMargin				= margin;					}
+
 		// Stats
 
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -185,6 +210,7 @@
 		// Settings
 							bool			mFullBoxBoxTest;	//!< Perform full BV-BV tests (true) or SAT-lite tests (false)
 							bool			mFullPrimBoxTest;	//!< Perform full Primitive-BV tests (true) or SAT-lite tests (false)
+							float			mMargin;			//!< Distance for margin queries, 0 for overlap queries
 		// Internal methods
 
 			// Standard AABB trees
@@ -201,6 +227,7 @@
 			inline_			BOOL			BoxBoxOverlap(const Point& ea, const Point& ca, const Point& eb, const Point& cb);
 			inline_			BOOL			TriBoxOverlap(const Point& center, const Point& extents);
 			inline_			BOOL			TriTriOverlap(const Point& V0, const Point& V1, const Point& V2, const Point& U0, const Point& U1, const Point& U2);
+			inline_			BOOL			TriTriNear(const Point& V0, const Point& V1, const Point& V2, const Point& U0, const Point& U1, const Point& U2);
 			// Init methods
 							void			InitQuery(const Matrix4x4* world0=null, const Matrix4x4* world1=null);
 							bool			CheckTemporalCoherence(Pair* cache);
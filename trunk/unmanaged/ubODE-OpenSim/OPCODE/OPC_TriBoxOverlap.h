@@ -124,11 +124,14 @@ inline_ BOOL planeBoxOverlap(const Point& normal, const float d, const Point& ma
  *	\return		true if triangle & box overlap
  */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-inline_ BOOL AABBTreeCollider::TriBoxOverlap(const Point& center, const Point& extents)
+inline_ BOOL AABBTreeCollider::TriBoxOverlap(const Point& center, const Point& box_extents)
 {
     // Stats
     mNbBVPrimTests++;
 
+    // Margin queries grow the box
+    const Point extents(box_extents.x + mMargin, box_extents.y + mMargin, box_extents.z + mMargin);
+
     // use separating axis theorem to test overlap between triangle and box 
     // need to test for overlap in these directions: 
     // 1) the {x,y,z}-directions (actually, since we use the AABB of the triangle 
@@ -281,3 +281,25 @@ inline_ BOOL AABBTreeCollider::TriTriOverlap(const Point& V0, const Point& V1, c
     if (isect1[1] < isect2[0] || isect2[1] < isect1[0]) return FALSE;
     return TRUE;
 }
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Proximity test for margin queries: compares the triangle bounds grown by the margin.
+ *	\return		true if the triangles may be closer than the margin
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+inline_ BOOL AABBTreeCollider::TriTriNear(const Point& V0, const Point& V1, const Point& V2, const Point& U0, const Point& U1, const Point& U2)
+{
+    // Stats
+    mNbPrimPrimTests++;
+
+    for (udword i = 0; i < 3; i++)
+    {
+        const float vmin = FCMin3(V0[i], V1[i], V2[i]);
+        const float vmax = FCMax3(V0[i], V1[i], V2[i]);
+        const float umin = FCMin3(U0[i], U1[i], U2[i]);
+        const float umax = FCMax3(U0[i], U1[i], U2[i]);
+        if (umin > vmax + mMargin || vmin > umax + mMargin) return FALSE;
+    }
+    return TRUE;
+}
@@ -863,6 +863,85 @@ ODE_API void dSpaceCollide (dSpaceID space, void *data, dNearCallback *callback)
 ODE_API void dSpaceCollide2 (dGeomID space1, dGeomID space2, void *data, dNearCallback *callback);
 
 
+/**
+ * @brief Pair record produced by dSpaceCollideParallel.
+ *
+ * The contacts generated for the pair g1/g2 are stored in the packed
+ * contact array at indices first .. first + count - 1. As with dCollide,
+ * the contact normals point from g1 to g2.
+ *
+ * @ingroup collide
+ */
+typedef struct dCollidePair {
+  dGeomID g1;
+  dGeomID g2;
+  int first;
+  int count;
+} dCollidePair;
+
+/**
+ * @brief User callback selecting the candidate pairs collided by
+ * dSpaceCollideParallel.
+ *
+ * @param data The user data object, as passed to dSpaceCollideParallel.
+ * @param o1   The first geom of the candidate pair.
+ * @param o2   The second geom of the candidate pair.
+ *
+ * @returns The maximum number of contacts to generate for the pair, or 0
+ * if the pair must not be collided.
+ *
+ * @remarks The callback is always invoked from the thread that called
+ * dSpaceCollideParallel, never from the worker threads.
+ *
+ * @ingroup collide
+ */
+typedef int dPairFilterCallback (void *data, dGeomID o1, dGeomID o2);
+
+/**
+ * @brief Collides all candidate pairs of a space, distributing the dCollide
+ * calls over the threading implementation assigned to a world.
+ *
+ * Candidate pairs are gathered on the calling thread the same way
+ * dSpaceCollide does, with pairs involving nested spaces expanded by
+ * dSpaceCollide2. The pairs are then split among the world threads, each
+ * one running dCollide into its own contact buffer. Finally the buffers
+ * are merged into the packed contact array in candidate pair order, so the
+ * output does not depend on the number of threads.
+ *
+ * @param world The world whose threading implementation and island thread
+ * count limit are used (see dWorldSetStepThreadingImplementation and
+ * dWorldSetStepIslandsProcessingMaxThreadCount).
+ * @param space The space to collide.
+ * @param data Passed to the filter callback. Its meaning is user defined.
+ * @param filter Called for every candidate pair; may be NULL to collide
+ * all pairs with maxContactsPerPair contacts.
+ * @param maxContactsPerPair Upper bound for the contacts of a single pair.
+ * @param contacts Packed output contact array.
+ * @param maxContacts Capacity of the contact array.
+ * @param pairs Output pair records, one for each pair that produced
+ * contacts. May be NULL if maxPairs is 0.
+ * @param maxPairs Capacity of the pair record array.
+ * @param pairCount If not NULL receives the number of pair records written.
+ *
+ * @returns The number of contacts written to the contact array. Once the
+ * contact or pair array is full, the remaining pairs are dropped.
+ *
+ * @remarks Pairs involving triangle meshes, heightfields or terrains use
+ * per geom and per library scratch data, so they are processed one at a
+ * time by a single thread while the other pairs proceed in parallel.
+ * Without a multithreaded implementation assigned to the world (always the
+ * case when ODE is built with the threading interface disabled), all pairs
+ * are collided on the calling thread.
+ *
+ * @sa dSpaceCollide
+ * @ingroup collide
+ */
+ODE_API int dSpaceCollideParallel (dWorldID world, dSpaceID space,
+    void *data, dPairFilterCallback *filter, int maxContactsPerPair,
+    dContactGeom *contacts, int maxContacts,
+    dCollidePair *pairs, int maxPairs, int *pairCount);
+
+
 /* ************************************************************************ */
 /* standard classes */
 
@@ -961,7 +1040,6 @@ ODE_API dReal dGeomSpherePointDepth (dGeomID sphere, dReal x, dReal y, dReal z);
 
 
 /*--> Convex Functions*/
-/*
 ODE_API dGeomID dCreateConvex (dSpaceID space,
 			       dReal *_planes,
 			       unsigned int _planecount,
@@ -973,7 +1051,9 @@ ODE_API void dGeomSetConvex (dGeomID g,
 			     unsigned int _count,
 			     dReal *_points,
 			     unsigned int _pointcount,unsigned int *_polygons);
-*/
+
+/* The depth of a point in a convex, positive inside */
+ODE_API dReal dGeomConvexPointDepth (dGeomID g, dReal x, dReal y, dReal z);
 /*<-- Convex Functions*/
 
 
@@ -1062,6 +1142,7 @@ ODE_API dReal dGeomCapsulePointDepth (dGeomID ccylinder, dReal x, dReal y, dReal
 ODE_API dGeomID dCreateCylinder (dSpaceID space, dReal radius, dReal length);
 ODE_API void dGeomCylinderSetParams (dGeomID cylinder, dReal radius, dReal length);
 ODE_API void dGeomCylinderGetParams (dGeomID cylinder, dReal *radius, dReal *length);
+ODE_API dReal dGeomCylinderPointDepth (dGeomID cylinder, dReal x, dReal y, dReal z);
 
 ODE_API dGeomID dCreateRay (dSpaceID space, dReal length);
 ODE_API void dGeomRaySetLength (dGeomID ray, dReal length);
@@ -1488,6 +1569,26 @@ ODE_API void dGeomOSTerrainDataBuild( dOSTerrainDataID d,
 ODE_API void dGeomOSTerrainDataSetBounds( dOSTerrainDataID d,
 				dReal minHeight, dReal maxHeight );
 
+/* Recomputes the height bounds and the min/max pyramid after referenced
+   height data was changed in place. */
+ODE_API void dGeomOSTerrainDataUpdate( dOSTerrainDataID d );
+
+/* Enables a table of precomputed triangle planes. It costs two dReals
+   per sample and saves a square root per triangle in the colliders. */
+ODE_API void dGeomOSTerrainDataSetBuildPlanes( dOSTerrainDataID d,
+				int bBuildPlanes );
+
+/* Stores the heights as 16 bit steps between the min and max sample, in
+   tiles of 16x16 samples. Halves the sample memory for a precision of
+   (max - min) / 65535. Quantized heights are always copied; data already
+   built is converted. */
+ODE_API void dGeomOSTerrainDataSetQuantized( dOSTerrainDataID d,
+				int bQuantized );
+
+/* Bytes owned by the data: copied or quantized samples, the min/max
+   pyramid and the plane table. Referenced samples are not counted. */
+ODE_API size_t dGeomOSTerrainDataGetMemoryUsage( dOSTerrainDataID d );
+
 
 ODE_API void dGeomOSTerrainSetData( dGeomID g, dOSTerrainDataID d );
 
@@ -108,6 +108,38 @@ ODE_API void dGeomTriMeshDataPreprocess(dTriMeshDataID g);
 ODE_API void dGeomTriMeshDataGetBuffer(dTriMeshDataID g, unsigned char** buf, int* bufLen);
 ODE_API void dGeomTriMeshDataSetBuffer(dTriMeshDataID g, unsigned char* buf);
 
+/*
+ * Save the built collision tree, and the edge flags if the data was
+ * preprocessed, so the data can be rebuilt later without building the
+ * tree. The vertex and index arrays are not saved, only a hash of them.
+ * dGeomTriMeshDataSerialize returns the bytes written, or 0 if bufLen is
+ * smaller than dGeomTriMeshDataGetSerializedSize.
+ */
+ODE_API int dGeomTriMeshDataGetSerializedSize(dTriMeshDataID g);
+ODE_API int dGeomTriMeshDataSerialize(dTriMeshDataID g, void* buf, int bufLen);
+
+/*
+ * Build a TriMesh data object from arrays and a buffer saved by
+ * dGeomTriMeshDataSerialize. The arrays are referenced like in
+ * dGeomTriMeshDataBuildSimple. Returns 0 and leaves the data unbuilt if the
+ * buffer is invalid or was saved from different arrays.
+ */
+ODE_API int dGeomTriMeshDataBuildFromSerialized(dTriMeshDataID g,
+                                 const dReal* Vertices, int VertexCount,
+                                 const dTriIndex* Indices, int IndexCount,
+                                 const void* buf, int bufLen);
+
+/*
+ * Get a preprocessed TriMesh data object for the arrays, shared with every
+ * other caller passing identical arrays. The arrays are copied, so they can
+ * be released on return. If Serialized is not NULL and was saved from the
+ * same arrays it is used instead of building the tree. Release the data with
+ * dGeomTriMeshDataDestroy, it is freed with its last reference.
+ */
+ODE_API dTriMeshDataID dGeomTriMeshDataCreateShared(const dReal* Vertices, int VertexCount,
+                                 const dTriIndex* Indices, int IndexCount,
+                                 const void* Serialized, int SerializedLen);
+
 
 /*
  * Per triangle callback. Allows the user to say if he wants a collision with
@@ -156,7 +188,12 @@ ODE_API void dGeomTriMeshSetData(dGeomID g, dTriMeshDataID Data);
 ODE_API dTriMeshDataID dGeomTriMeshGetData(dGeomID g);
 
 
-/* enable/disable/check temporal coherence*/
+/* enable/disable/check temporal coherence
+ * geomClass is dSphereClass, dBoxClass, dCapsuleClass, dTriMeshClass or
+ * dOSTerrainClass. For trimeshes and terrains a few recent partners keep the
+ * triangles or vertices that can touch while the pair rests, enabling it
+ * on either trimesh of a pair is enough.
+ */
 ODE_API void dGeomTriMeshEnableTC(dGeomID g, int geomClass, int enable);
 ODE_API int dGeomTriMeshIsTCEnabled(dGeomID g, int geomClass);
 
@@ -52,6 +52,40 @@ ODE_API void * dAlloc (size_t size);
 ODE_API void * dRealloc (void *ptr, size_t oldsize, size_t newsize);
 ODE_API void dFree (void *ptr, size_t size);
 
+/* bodies, joints, geoms, their position records and the joint group arenas
+ * are allocated from size class slab pools, with a small per thread cache
+ * for threads that have collision data allocated (see dAllocateODEDataForThread).
+ * the slabs themselves come from dAlloc. */
+
+/* statistics of one size class of the pools, or of all of them */
+typedef struct dMemoryPoolStats {
+  size_t block_size;		/* bytes per block, 0 for the totals */
+  size_t slab_count;		/* slabs currently held */
+  size_t reserved_bytes;	/* bytes of the blocks in those slabs */
+  size_t used_bytes;		/* bytes in live objects or in thread caches */
+  size_t free_bytes;		/* bytes on the shared free lists */
+  duint64 slab_allocs;		/* slabs allocated since ODE was initialized */
+  duint64 slab_frees;		/* slabs released by dMemoryPoolTrim */
+} dMemoryPoolStats;
+
+/* enable or disable the pools. the setting takes effect the next time ODE
+ * is initialized; disabled, every object goes to dAlloc as before. the
+ * pools are enabled by default. dMemoryPoolIsEnabled tells whether they
+ * serve allocations now. */
+ODE_API void dMemoryPoolSetEnabled (int enabled);
+ODE_API int dMemoryPoolIsEnabled (void);
+
+/* fill in the statistics of size class class_index, 0 to
+ * dMemoryPoolGetClassCount()-1, or the totals for -1. returns 0 for an
+ * index out of range. */
+ODE_API int dMemoryPoolGetClassCount (void);
+ODE_API int dMemoryPoolGetStats (int class_index, dMemoryPoolStats *stats);
+
+/* return the blocks cached by the calling thread to the shared free lists
+ * and release every slab that has no block in use. returns the number of
+ * bytes released. blocks cached by other threads keep their slabs. */
+ODE_API size_t dMemoryPoolTrim (void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -171,6 +171,27 @@ ODE_API void dWorldSetStepIslandsProcessingMaxThreadCount(dWorldID w, unsigned c
  */
 ODE_API unsigned dWorldGetStepIslandsProcessingMaxThreadCount(dWorldID w);
 
+/**
+ * @brief Step and collide the world on a single thread.
+ *
+ * While set, island stepping, the stepper and dSpaceCollideParallel use one
+ * thread of the world's threading implementation, whatever the thread count
+ * limits are. The results then only depend on the world state and the order
+ * of the calls, so a snapshot (see dWorldSnapshotSave) replays the same way
+ * every time. Off by default.
+ *
+ * @param w The world affected
+ * @param deterministic 1 to step on a single thread, 0 for the thread limits
+ * @ingroup world
+ */
+ODE_API void dWorldSetDeterministic(dWorldID w, int deterministic);
+/**
+ * @brief Get whether the world steps on a single thread.
+ * @ingroup world
+ * @see dWorldSetDeterministic
+ */
+ODE_API int dWorldGetDeterministic(dWorldID w);
+
 /**
  * @brief Set the world to use shared working memory along with another world.
  *
@@ -482,6 +503,53 @@ ODE_API void dWorldSetQuickStepW (dWorldID, dReal over_relaxation);
  */
 ODE_API dReal dWorldGetQuickStepW (dWorldID);
 
+/**
+ * @brief Set the convergence tolerance of the QuickStep iterations.
+ * @ingroup world
+ * @param tolerance relative change of the constraint forces below which
+ * an island stops iterating.
+ * @remarks With a tolerance above zero an island stops once the largest
+ * change of its constraint forces in one iteration is below tolerance
+ * times its largest constraint force, so quiet islands take few
+ * iterations and busy ones take up to the dWorldSetQuickStepNumIterations
+ * count. The default, zero, only stops when the forces stop changing.
+ * Values around 0.001 to 0.01 are typical.
+ */
+ODE_API void dWorldSetQuickStepTolerance (dWorldID, dReal tolerance);
+
+/**
+ * @brief Get the convergence tolerance of the QuickStep iterations.
+ * @ingroup world
+ */
+ODE_API dReal dWorldGetQuickStepTolerance (dWorldID);
+
+/* QuickStep solver modes, see dWorldSetQuickStepSolverMode */
+enum {
+  dQuickStepSolverSequential = 0,
+  dQuickStepSolverColored = 1
+};
+
+/**
+ * @brief Set how the QuickStep iterations sweep the constraint rows.
+ * @ingroup world
+ * @param mode dQuickStepSolverSequential (the default) solves the rows of
+ * an island one after another on one thread. dQuickStepSolverColored
+ * colors the joints of large islands so that no two joints of a color
+ * share a body, then solves the joints of each color in parallel on the
+ * threads of the world threading implementation.
+ * @remarks The colored sweep visits the rows in a different order, so it
+ * converges somewhat differently from the sequential one, but its results
+ * do not depend on the number of threads. Islands with few rows keep the
+ * sequential sweep.
+ */
+ODE_API void dWorldSetQuickStepSolverMode (dWorldID, int mode);
+
+/**
+ * @brief Get the QuickStep solver mode.
+ * @ingroup world
+ */
+ODE_API int dWorldGetQuickStepSolverMode (dWorldID);
+
 /* World contact parameter functions */
 
 /**
@@ -522,6 +590,129 @@ ODE_API void dWorldSetContactSurfaceLayer (dWorldID, dReal depth);
 ODE_API dReal dWorldGetContactSurfaceLayer (dWorldID);
 
 
+/**
+ * @brief State of a body returned by dWorldGetMovedBodies.
+ * @ingroup world
+ */
+typedef struct dMovedBodyState {
+  dBodyID body;
+  void *data;            /**< body user data, see dBodySetData */
+  dVector3 pos;
+  dQuaternion q;
+  dVector3 lvel;
+  dVector3 avel;
+  int enabled;
+} dMovedBodyState;
+
+/**
+ * @brief Set how much a body must change before dWorldGetMovedBodies
+ * reports it again.
+ * @ingroup world
+ * @param position distance from the reported position.
+ * @param angle rotation from the reported orientation, in radians.
+ * @param linear_vel change of the linear velocity.
+ * @param angular_vel change of the angular velocity.
+ * @remarks The default for all thresholds is zero, i.e. any change.
+ */
+ODE_API void dWorldSetMovedBodiesThresholds (dWorldID, dReal position, dReal angle,
+                                             dReal linear_vel, dReal angular_vel);
+
+/**
+ * @brief Get the dWorldGetMovedBodies thresholds.
+ * @ingroup world
+ * @remarks Any of the pointers may be NULL.
+ */
+ODE_API void dWorldGetMovedBodiesThresholds (dWorldID, dReal *position, dReal *angle,
+                                             dReal *linear_vel, dReal *angular_vel);
+
+/**
+ * @brief Get the state of the bodies that changed since they were last
+ * reported.
+ * @ingroup world
+ *
+ * The world remembers the state last returned for each body. A body is
+ * returned when it was never returned before, when it was enabled or
+ * disabled since, or when its position, orientation or velocities differ
+ * from the remembered ones by more than the thresholds set with
+ * dWorldSetMovedBodiesThresholds. Bodies moved by the user (e.g. with
+ * dBodySetPosition) are reported the same way.
+ *
+ * @param buffer receives the states.
+ * @param capacity the number of states the buffer can hold. Bodies that do
+ * not fit are returned by the next call.
+ * @returns the number of states written.
+ */
+ODE_API int dWorldGetMovedBodies (dWorldID, dMovedBodyState *buffer, int capacity);
+
+
+/**
+ * @brief Profiling counters of the last step, see dWorldGetStepStats.
+ * @ingroup world
+ *
+ * Times are in seconds. Islands stepped in parallel add their times
+ * together, so the stage times may sum to more than total_time.
+ */
+typedef struct dWorldStepStats {
+  double total_time;          /**< whole dWorldStep/dWorldQuickStep call */
+  double islands_time;        /**< auto-disabling and island building */
+  double stage_time[7];       /**< QuickStep stages 0 to 6 */
+  double lcp_time;            /**< LCP iterations, included in stage_time[4] */
+  double integration_time;    /**< body integration, included in stage_time[6] */
+  int islands;
+  int bodies;                 /**< bodies in the stepped islands */
+  int joints;                 /**< joints in the stepped islands */
+  int rows;                   /**< constraint rows */
+  int lcp_iterations;         /**< LCP iterations summed over all islands */
+  size_t arena_high_water;    /**< most stepper memory arena bytes used by an island job */
+} dWorldStepStats;
+
+/**
+ * @brief Enable or disable collection of step profiling counters.
+ * @ingroup world
+ * @remarks Collection is off by default. While it is off, stepping only
+ * pays for a flag test.
+ */
+ODE_API void dWorldSetStepStatsEnabled (dWorldID, int enabled);
+
+/**
+ * @brief Get whether step profiling counters are collected.
+ * @ingroup world
+ */
+ODE_API int dWorldGetStepStatsEnabled (dWorldID);
+
+/**
+ * @brief Get the profiling counters of the last step.
+ * @ingroup world
+ * @remarks The stage times are only collected by dWorldQuickStep.
+ * @returns 1 on success, 0 (with @a stats zeroed) if collection is
+ * disabled or no step was taken since it was enabled.
+ */
+ODE_API int dWorldGetStepStats (dWorldID, dWorldStepStats *stats);
+
+/**
+ * @brief Profiling counters of one island of the last step, see
+ * dWorldGetIslandStepStats.
+ * @ingroup world
+ */
+typedef struct dWorldIslandStepStats {
+  int bodies;
+  int joints;
+  int rows;                   /**< constraint rows */
+  int lcp_iterations;         /**< LCP iterations taken by the island */
+  int colors;                 /**< joint colors of the colored solver, 0 if not used */
+} dWorldIslandStepStats;
+
+/**
+ * @brief Get the per island profiling counters of the last step.
+ * @ingroup world
+ * @param buffer receives up to @a capacity entries.
+ * @remarks Only dWorldQuickStep records islands, in no particular order.
+ * @returns the number of entries written, 0 if collection is disabled
+ * or no step was taken since it was enabled.
+ */
+ODE_API int dWorldGetIslandStepStats (dWorldID, dWorldIslandStepStats *buffer, int capacity);
+
+
 /**
  * @defgroup disable Automatic Enabling and Disabling
  * @ingroup world bodies
@@ -639,6 +830,49 @@ ODE_API int dWorldGetAutoDisableFlag (dWorldID);
  */
 ODE_API void dWorldSetAutoDisableFlag (dWorldID, int do_auto_disable);
 
+/**
+ * @brief Get whether bodies are auto-disabled per island.
+ * @ingroup disable
+ */
+ODE_API int dWorldGetAutoDisableIslands (dWorldID);
+
+/**
+ * @brief Auto-disable whole islands instead of single bodies.
+ *
+ * An island then falls asleep only when all its bodies have been idle
+ * for their auto-disable steps and time, and a body that is not
+ * auto-disabled keeps its island awake. A contact or joint from an awake
+ * body to any body of a sleeping island wakes the whole island, as does
+ * dBodyEnable() or dBodyDestroy() on one of its bodies.
+ *
+ * The space collide functions skip pairs where both geoms belong to
+ * sleeping bodies or to a sleeping body and a static geom, so an idle
+ * pile costs no broadphase callbacks until something awake touches it.
+ *
+ * @param do_islands default is false.
+ * @ingroup disable
+ * @sa dWorldGetSleepCounts()
+ */
+ODE_API void dWorldSetAutoDisableIslands (dWorldID, int do_islands);
+
+/**
+ * @brief Island and body counts of the last step, see dWorldGetSleepCounts.
+ * @ingroup disable
+ */
+typedef struct dWorldSleepCounts {
+  int awake_islands;          /**< islands stepped by the last step */
+  int awake_bodies;           /**< bodies in those islands */
+  int sleeping_islands;       /**< islands that fell asleep together and are not woken yet */
+  int sleeping_bodies;        /**< bodies in those islands */
+} dWorldSleepCounts;
+
+/**
+ * @brief Get how much of the world the last step processed.
+ * @ingroup disable
+ * @remarks Bodies disabled on their own are in neither count.
+ */
+ODE_API void dWorldGetSleepCounts (dWorldID, dWorldSleepCounts *counts);
+
 
 /**
  * @defgroup damping Damping
@@ -1480,6 +1714,46 @@ ODE_API dReal dBodyGetMaxAngularSpeed (dBodyID b);
 ODE_API void dBodySetMaxAngularSpeed(dBodyID b, dReal max_speed);
 
 
+/**
+ * @brief Get the body's continuous collision radius.
+ * @ingroup bodies
+ * @sa dBodySetCCDRadius()
+ */
+ODE_API dReal dBodyGetCCDRadius (dBodyID b);
+
+/**
+ * @brief Enable continuous collision for a small fast body.
+ *
+ * At the end of dWorldStep() and dWorldQuickStep() the motion of the body
+ * centre is swept with a ray against the top space of the body's geoms.
+ * If it passed through another geom the body is moved back so its centre
+ * stays @a radius short of the hit, and the velocity into the surface is
+ * removed. This keeps bullets and thrown objects from tunnelling through
+ * thin walls at large step sizes. The radius should be about the body's
+ * smallest half extent.
+ *
+ * @param radius 0 (the default) disables the sweep.
+ * @ingroup bodies
+ * @sa dBodySetCCDThreshold()
+ */
+ODE_API void dBodySetCCDRadius (dBodyID b, dReal radius);
+
+/**
+ * @brief Get the body's continuous collision motion threshold.
+ * @ingroup bodies
+ * @sa dBodySetCCDThreshold()
+ */
+ODE_API dReal dBodyGetCCDThreshold (dBodyID b);
+
+/**
+ * @brief Set how far the body must move in a step before it is swept.
+ * @param threshold 0 (the default) uses the CCD radius.
+ * @ingroup bodies
+ * @sa dBodySetCCDRadius()
+ */
+ODE_API void dBodySetCCDThreshold (dBodyID b, dReal threshold);
+
+
 
 /**
  * @brief Get the body's gyroscopic state.
@@ -1608,6 +1882,60 @@ ODE_API dJointID dJointCreateSlider (dWorldID, dJointGroupID);
  */
 ODE_API dJointID dJointCreateContact (dWorldID, dJointGroupID, const dContact *);
 
+/**
+ * @brief Bodies a contact joint created by dJointCreateContactsBatch is
+ * attached to. A zero body refers to the static environment.
+ * @ingroup joints
+ */
+typedef struct dBodyPairs {
+  dBodyID b1;
+  dBodyID b2;
+} dBodyPairs;
+
+/**
+ * @brief Create and attach contact joints for an array of contacts.
+ * @ingroup joints
+ *
+ * This is equivalent to calling dJointCreateContact and dJointAttach for
+ * each contact, in a single call.
+ *
+ * @param dJointGroupID set to 0 to allocate the joints normally.
+ * If it is nonzero the joints are allocated in the given joint group.
+ * @param contacts the contacts, one joint is created for each.
+ * @param bodies the bodies to attach the joint of the matching contact to.
+ * If NULL, the bodies of the contact geoms g1 and g2 are used.
+ * @param n the number of contacts.
+ * @returns the number of joints created. Contacts whose two bodies are
+ * the same (including two static geoms) are skipped.
+ */
+ODE_API int dJointCreateContactsBatch (dWorldID, dJointGroupID,
+                                       const dContact *contacts, const dBodyPairs *bodies, int n);
+
+/**
+ * @brief Collide geom pairs and create contact joints for the contacts found.
+ * @ingroup joints
+ *
+ * For each pair, dCollide is called and a contact joint using the pair
+ * surface parameters is created for every contact and attached to the
+ * bodies of the two geoms.
+ *
+ * @param dJointGroupID set to 0 to allocate the joints normally.
+ * If it is nonzero the joints are allocated in the given joint group.
+ * @param geomPairs the geoms to collide, two consecutive entries per pair.
+ * @param surfaces the surface parameters of each pair.
+ * @param pairCount the number of pairs.
+ * @param maxContactsPerPair the maximum number of contacts for one pair.
+ * @param contacts array receiving all the contacts generated, in pair order.
+ * @param maxContacts the capacity of the contacts array. Once it is full
+ * the remaining pairs are not collided.
+ * @returns the number of joints created, which is also the number of
+ * contacts stored in the contacts array. Pairs whose two geoms have the
+ * same body (including two static geoms) are skipped.
+ */
+ODE_API int dCollideAndCreateContacts (dWorldID, dJointGroupID,
+                                       const dGeomID *geomPairs, const dSurfaceParameters *surfaces, int pairCount,
+                                       int maxContactsPerPair, dContactGeom *contacts, int maxContacts);
+
 /**
  * @brief Create a new joint of the hinge2 type.
  * @ingroup joints
@@ -43,6 +43,7 @@
 #include <ode/collision.h>
 #include <ode/threading.h>
 #include <ode/threading_impl.h>
+#include <ode/snapshot.h>
 #include <ode/version.h>
 
 #ifdef __cplusplus
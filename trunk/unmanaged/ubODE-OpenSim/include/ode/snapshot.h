@@ -0,0 +1,150 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+ *  World snapshots: save the bodies, geoms, spaces, joints and parameters of
+ *  a world to a buffer, and rebuild them in a new world, e.g. to replay a
+ *  step that went wrong or to start a region from a saved state.
+ */
+
+#ifndef _ODE_SNAPSHOT_H_
+#define _ODE_SNAPSHOT_H_
+
+#include <ode/common.h>
+#include <ode/contact.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup snapshot World Snapshots
+ *
+ * A snapshot keeps the full state of the bodies, including the auto-disable
+ * and sleeping island state, of the geoms and spaces reachable from the
+ * saved space or attached to the bodies, of the joints, and of the world
+ * parameters. Loading it into a new world and stepping on a single thread
+ * (see dWorldSetDeterministic) gives the same results every time.
+ *
+ * Not saved: contact joints, which are rebuilt by the next collision, the
+ * joint groups and joint feedback, body moved callbacks, trimesh callbacks,
+ * geom transforms and user geom classes. Take the snapshot between steps,
+ * after the contact group was emptied.
+ *
+ * User data pointers and the data objects shared by geoms are saved as ids
+ * returned by the save_ref callback and turned back into pointers by the
+ * load_ref callback. With dSnapshotEmbedData the trimesh and terrain data
+ * are saved in the snapshot instead. Convex geoms always save their arrays.
+ *
+ * The format depends on the precision and on the build; dWorldSnapshotLoad
+ * refuses snapshots from another one.
+ */
+
+/* kinds of the objects passed to the snapshot callbacks */
+enum {
+  dSnapshotRefBodyData = 0,     /* user data of a body */
+  dSnapshotRefJointData,        /* user data of a joint */
+  dSnapshotRefGeomData,         /* user data of a geom or space */
+  dSnapshotRefTriMeshData,      /* dTriMeshDataID of a trimesh */
+  dSnapshotRefOSTerrainData,    /* dOSTerrainDataID of a terrain */
+  dSnapshotRefHeightfieldData,  /* dHeightfieldDataID of a heightfield */
+  dSnapshotRefConvexData        /* arrays of a convex, always embedded */
+};
+
+/* dWorldSnapshotSave flags */
+enum {
+  dSnapshotEmbedData = 1        /* save trimesh and terrain data, not ids */
+};
+
+/**
+ * @brief Callbacks mapping the objects a snapshot refers to.
+ * @ingroup snapshot
+ *
+ * Each may be NULL. A geom whose data object can not be found on load is
+ * left out of the loaded world.
+ */
+typedef struct dSnapshotCallbacks {
+  void *context;                /* passed to every callback */
+  /* save: an id for the object, 0 to save none */
+  duint64 (*save_ref) (void *context, int kind, void *object);
+  /* load: the object for an id saved by save_ref, NULL for none */
+  void *(*load_ref) (void *context, int kind, duint64 id);
+  /* load: a data object rebuilt from the snapshot. the caller owns it and
+   * releases it with dSnapshotDataDestroy once its geoms are destroyed */
+  void (*data_loaded) (void *context, int kind, void *data);
+} dSnapshotCallbacks;
+
+/**
+ * @brief How to replay a snapshot, saved along with it.
+ * @ingroup snapshot
+ */
+typedef struct dSnapshotReplayInfo {
+  dReal step_size;              /* step size of the world */
+  int quickstep;                /* 1 for dWorldQuickStep, 0 for dWorldStep */
+  int max_contacts;             /* contacts per colliding pair */
+  dSurfaceParameters surface;   /* surface of the contacts */
+  unsigned long rand_seed;      /* dRandGetSeed when saved, ignored by the save */
+} dSnapshotReplayInfo;
+
+/**
+ * @brief Save the state of a world to a buffer.
+ * @ingroup snapshot
+ * @param w the world.
+ * @param space the top space of the geoms to save, may be 0. geoms attached
+ * to the bodies of @a w are saved even if they are in no space.
+ * @param replay saved for the replay, may be NULL.
+ * @param callbacks may be NULL, see dSnapshotCallbacks.
+ * @param flags dSnapshotEmbedData or 0.
+ * @param buffer receives the snapshot if @a capacity is large enough.
+ * @returns the size of the snapshot. if it is larger than @a capacity the
+ * buffer holds an incomplete snapshot; save again with a larger one.
+ */
+ODE_API size_t dWorldSnapshotSave (dWorldID w, dSpaceID space,
+                                   const dSnapshotReplayInfo *replay,
+                                   const dSnapshotCallbacks *callbacks, int flags,
+                                   void *buffer, size_t capacity);
+
+/**
+ * @brief Rebuild a world saved by dWorldSnapshotSave.
+ * @ingroup snapshot
+ * @param world receives the new world.
+ * @param space receives the new top space, 0 if none was saved.
+ * @param replay receives the replay information, may be NULL.
+ * @returns 1 on success, 0 if the buffer is not a snapshot of this build or
+ * is truncated, in which case nothing is created.
+ */
+ODE_API int dWorldSnapshotLoad (const void *buffer, size_t size,
+                                const dSnapshotCallbacks *callbacks,
+                                dWorldID *world, dSpaceID *space,
+                                dSnapshotReplayInfo *replay);
+
+/**
+ * @brief Release a data object passed to the data_loaded callback.
+ * @ingroup snapshot
+ */
+ODE_API void dSnapshotDataDestroy (int kind, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
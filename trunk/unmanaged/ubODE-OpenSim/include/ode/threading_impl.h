@@ -45,6 +45,16 @@ extern "C" {
 struct dxThreadingThreadPool;
 typedef struct dxThreadingThreadPool *dThreadingThreadPoolID;
 
+struct dxThreadingScheduler;
+typedef struct dxThreadingScheduler *dThreadingSchedulerID;
+
+typedef struct dThreadingSchedulerUsage
+{
+  duint64         cpu_nsec;       /* CPU time the scheduler spent in the implementation's calls */
+  duint64         call_count;     /* Number of the implementation's calls executed */
+
+} dThreadingSchedulerUsage;
+
 
 /**
  * @brief Allocates built-in multi-threaded threading implementation object.
@@ -257,6 +267,96 @@ ODE_API void dThreadingThreadPoolWaitIdleState(dThreadingThreadPoolID pool);
 ODE_API void dThreadingFreeThreadPool(dThreadingThreadPoolID pool);
 
 
+/**
+ * @brief Creates a work-stealing scheduler that serves several threading 
+ * implementations at once with a single set of threads.
+ *
+ * The scheduler is intended for processes that run many worlds side by side:
+ * rather than a pool per world, every world gets an implementation from
+ * @c dThreadingSchedulerAllocateImplementation and all of them share the 
+ * scheduler's threads. Each thread keeps its own queue of ready calls and
+ * steals the oldest calls of the others when it runs out. Idle threads spin 
+ * for a short while and then block until new calls are posted. A thread that
+ * waits for a call of a scheduler's implementation executes ready calls 
+ * itself while the call is not complete.
+ *
+ * The threads are started as those of @c dThreadingAllocateThreadPool are.
+ * If @p cpu_list is given, the thread number @c i is bound to the CPU
+ * @c cpu_list[i % cpu_count]. The binding is only supported on Linux and 
+ * is ignored elsewhere.
+ *
+ * The scheduler is only available with the built-in threading implementation 
+ * on POSIX platforms; elsewhere the function returns NULL.
+ * 
+ * @param thread_count Number of threads to start
+ * @param stack_size Size of stack to be used for every thread or 0 for system default value
+ * @param ode_data_allocate_flags Flags to be passed to @c dAllocateODEDataForThread on behalf of each thread
+ * @param cpu_list Optional list of CPU numbers to bind the threads to
+ * @param cpu_count Number of entries in @p cpu_list
+ * @returns ID of object allocated or NULL on failure
+ *
+ * @ingroup threading
+ * @see dThreadingSchedulerAllocateImplementation
+ * @see dThreadingFreeScheduler
+ */
+ODE_API dThreadingSchedulerID dThreadingAllocateScheduler(unsigned thread_count, 
+  size_t stack_size, unsigned int ode_data_allocate_flags, 
+  const unsigned *cpu_list/*=NULL*/, unsigned cpu_count/*=0*/);
+
+/**
+ * @brief Allocates a threading implementation served by a scheduler.
+ *
+ * The implementation is used like the one from 
+ * @c dThreadingAllocateMultiThreadedImplementation, with functions retrieved
+ * by @c dThreadingImplementationGetFunctions, except that it needs no pool:
+ * it is served by the scheduler's threads from the start. 
+ * @c dThreadingImplementationShutdownProcessing and 
+ * @c dThreadingImplementationCleanupForRestart have no effect on it and it must
+ * not be served by a thread pool or external threads.
+ *
+ * Free the implementation with @c dThreadingFreeImplementation once nothing 
+ * uses it any longer, before the scheduler itself is freed.
+ *
+ * @param scheduler Scheduler ID
+ * @returns ID of object allocated or NULL on failure
+ *
+ * @ingroup threading
+ * @see dThreadingAllocateScheduler
+ * @see dThreadingSchedulerGetUsage
+ */
+ODE_API dThreadingImplementationID dThreadingSchedulerAllocateImplementation(dThreadingSchedulerID scheduler);
+
+/**
+ * @brief Retrieves the CPU time a scheduler has spent on an implementation.
+ *
+ * The time is the thread CPU time of the calls posted to @p impl, whichever
+ * thread executed them. The work a world does on the thread stepping it 
+ * outside of posted calls is not included.
+ *
+ * @param scheduler Scheduler ID
+ * @param impl Implementation ID allocated from @p scheduler
+ * @param out_usage Receives the usage accumulated so far
+ * @param reset_usage If not zero, the usage is reset to zero after being retrieved
+ *
+ * @ingroup threading
+ * @see dThreadingSchedulerAllocateImplementation
+ */
+ODE_API void dThreadingSchedulerGetUsage(dThreadingSchedulerID scheduler, dThreadingImplementationID impl, 
+  dThreadingSchedulerUsage *out_usage, int reset_usage);
+
+/**
+ * @brief Deletes a scheduler and stops its threads.
+ *
+ * All the implementations allocated from the scheduler must be freed before.
+ * 
+ * @param scheduler Scheduler ID to delete
+ *
+ * @ingroup threading
+ * @see dThreadingAllocateScheduler
+ */
+ODE_API void dThreadingFreeScheduler(dThreadingSchedulerID scheduler);
+
+
 #ifdef __cplusplus
 }
 #endif
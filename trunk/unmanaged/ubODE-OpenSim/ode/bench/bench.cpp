@@ -0,0 +1,1690 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+headless benchmark of OpenSim-like scenes. every scene is stepped for a
+number of frames (collide, quickstep, empty contact group) and the
+distribution of the frame times is written as one JSON object per scene,
+so the output of two builds can be compared by a script.
+
+usage: ode_bench [-l] [-s scene]... [-n steps] [-w warmup] [-t threads]
+                 [-r regions] [-p] [-v] [-m] [-e tolerance] [-g]
+                 [-d prefix] [-o file]
+
+  -l          list the scenes and exit
+  -s scene    run only the named scene (may be repeated)
+  -n steps    measured steps per scene (default 300)
+  -w warmup   unmeasured steps before measuring (default 30)
+  -t threads  step with a thread pool of this many threads
+  -r regions  step this many copies of every scene at once, each from its
+              own thread, all served by one work-stealing scheduler of
+              -t threads. one line is written per region, with the CPU
+              time the scheduler spent on it (POSIX only)
+  -p          collide with dSpaceCollideParallel
+  -v          with -p, collide every pair again on the calling thread and
+              report the pairs whose contacts differ; the exit status is 1
+              if any do. the extra collisions are included in the timings
+  -m          allocate the ODE objects with dAlloc instead of the slab
+              pools, to compare the churn scenes against malloc
+  -e tolerance
+              stop the QuickStep iterations of an island early with this
+              convergence tolerance (see dWorldSetQuickStepTolerance).
+              the iteration counts are reported either way
+  -g          solve large islands with the colored QuickStep solver (see
+              dWorldSetQuickStepSolverMode), in parallel with -t
+  -d prefix   after the warmup, save a snapshot of every scene to
+              <prefix><scene>.snap (<prefix><scene>_<region>.snap with -r)
+              for ode_replay. the trimesh and terrain data are embedded
+  -o file     write the results to file instead of stdout
+
+*/
+
+#include <ode/ode.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <pthread.h>
+#endif
+
+
+#define STEP_SIZE           REAL(0.02)
+#define MAX_CONTACTS        8
+#define PARALLEL_CONTACTS   65536
+#define PARALLEL_PAIRS      16384
+#define BENCH_ISLAND_STATS  4096
+
+#define AVATAR_RADIUS       REAL(0.35)
+#define AVATAR_LENGTH       REAL(1.1)
+#define AVATAR_MASS         REAL(80.0)
+#define AVATAR_WALK_SPEED   REAL(1.4)
+
+#define SCULPT_SIZE         32
+#define SCULPT_VERTICES     ((SCULPT_SIZE + 1) * (SCULPT_SIZE + 1))
+#define SCULPT_INDICES      (SCULPT_SIZE * SCULPT_SIZE * 6)
+
+#define PROJECTILE_SIZE     REAL(0.1)
+#define PROJECTILE_WALL_X   REAL(128.0)
+
+#define CHURN_PRIMS         400
+#define CHURN_PER_STEP      40
+
+
+//****************************************************************************
+// clock and random numbers
+
+static double benchNow()
+{
+#ifdef WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+//****************************************************************************
+// scene state
+
+struct Avatar
+{
+    dBodyID body;
+    dReal heading;
+    int turnCountdown;
+};
+
+struct BenchContext
+{
+    dWorldID world;
+    dSpaceID topSpace;          // terrain, active and static spaces
+    dSpaceID activeSpace;       // everything with a body
+    dSpaceID staticSpace;       // prims without a body
+    dJointGroupID contactGroup;
+
+    int regionSize;
+    dOSTerrainDataID terrainData;
+    dGeomID terrain;
+
+    dTriMeshDataID meshData;
+    float *meshVertices;
+    int *meshIndices;
+
+    // icosahedron hull, also built as meshData for the trimesh variant
+    dReal *hullPlanes;
+    dReal *hullPoints;
+    unsigned int *hullPolygons;
+
+    // one entry per sculpt prim, shared entries repeat. the arrays are
+    // only kept for data that does not own a copy
+    dTriMeshDataID *sculptData;
+    float **sculptVertices;
+    int **sculptIndices;
+    int sculptCount;
+
+    Avatar *avatars;
+    int avatarCount;
+
+    // small fast spheres fired at a thin wall, see fireProjectiles
+    dBodyID *projectiles;
+    int projectileCount;
+    int tunnelled;
+
+    // prims derezzed and rezzed again every step, see churnPrims. a prim
+    // may be linked to the one rezzed before it
+    dBodyID *churnBodies;
+    dJointID *churnJoints;
+    int churnCount;
+    int churnNext;
+    double churnTime;
+
+    unsigned long seed;
+    int bodyCount;
+    int contactsThisStep;
+
+    // dSpaceCollideParallel buffers
+    bool parallelCollide;
+    dContactGeom *parallelContacts;
+    dCollidePair *parallelPairs;
+
+    // -v checking of the parallel results
+    bool verifyParallel;
+    int serialContacts;
+    int mismatches;
+};
+
+// the scenes must not depend on the C library generator. the seed is kept
+// in the context so that regions stepped at once (-r) do not share it
+static dReal benchRandom(BenchContext &ctx, dReal lo, dReal hi)
+{
+    ctx.seed = (1664525UL * ctx.seed + 1013904223UL) & 0xffffffffUL;
+    return lo + (hi - lo) * (dReal)(ctx.seed >> 8) / (dReal)0x1000000;
+}
+
+// geom data: linkset the prim belongs to, prims of a linkset do not collide
+static int linksetIds[64];
+
+
+//****************************************************************************
+// terrain
+
+static dReal terrainHeightAt(dReal x, dReal y)
+{
+    return REAL(21.0)
+        + REAL(6.0) * dSin(x * REAL(0.021)) * dCos(y * REAL(0.017))
+        + REAL(1.5) * dSin(x * REAL(0.13) + y * REAL(0.07))
+        + REAL(0.4) * dCos(x * REAL(0.61) - y * REAL(0.47));
+}
+
+// the data keeps its own copy of the heights, so its memory usage
+// covers the whole terrain
+static void createTerrain(BenchContext &ctx, int regionSize, bool quantized = false)
+{
+    int samples = regionSize + 1;
+    ctx.regionSize = regionSize;
+    float *heights = (float *)malloc(sizeof(float) * (size_t)samples * (size_t)samples);
+
+    for (int y = 0; y < samples; y++) {
+        for (int x = 0; x < samples; x++) {
+            heights[x + y * samples] = (float)terrainHeightAt((dReal)x, (dReal)y);
+        }
+    }
+
+    ctx.terrainData = dGeomOSTerrainDataCreate();
+    dGeomOSTerrainDataSetQuantized(ctx.terrainData, quantized ? 1 : 0);
+    dGeomOSTerrainDataBuild(ctx.terrainData, heights, 1, REAL(1.0), samples, samples, REAL(1.0), 0);
+    free(heights);
+    ctx.terrain = dCreateOSTerrain(ctx.topSpace, ctx.terrainData, 1);
+    dGeomSetPosition(ctx.terrain, (dReal)regionSize * REAL(0.5), (dReal)regionSize * REAL(0.5), 0);
+
+    dGeomSetCategoryBits(ctx.terrain, 1);
+    dGeomSetCollideBits(ctx.terrain, 4);
+}
+
+
+//****************************************************************************
+// prims
+
+// subdivided icosahedron, 42 vertices and 80 triangles
+static void createMeshData(BenchContext &ctx, dReal radius)
+{
+    static const float t = 1.6180339887f;
+    static const float ico[12][3] = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+    };
+    static const int icoFaces[20][3] = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+        {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+    };
+
+    ctx.meshVertices = (float *)malloc(sizeof(float) * 42 * 3);
+    ctx.meshIndices = (int *)malloc(sizeof(int) * 80 * 3);
+
+    int vertexCount = 12;
+    memcpy(ctx.meshVertices, ico, sizeof(ico));
+
+    int edgeA[30], edgeB[30], edgeMid[30], edgeCount = 0;
+    int triangle = 0;
+    for (int f = 0; f < 20; f++) {
+        int mid[3];
+        for (int e = 0; e < 3; e++) {
+            int a = icoFaces[f][e], b = icoFaces[f][(e + 1) % 3];
+            if (a > b) { int s = a; a = b; b = s; }
+            int found = -1;
+            for (int k = 0; k < edgeCount; k++) {
+                if (edgeA[k] == a && edgeB[k] == b) { found = edgeMid[k]; break; }
+            }
+            if (found < 0) {
+                float *v = ctx.meshVertices + vertexCount * 3;
+                for (int c = 0; c < 3; c++) v[c] = 0.5f * (ico[a][c] + ico[b][c]);
+                edgeA[edgeCount] = a; edgeB[edgeCount] = b; edgeMid[edgeCount] = vertexCount;
+                found = vertexCount++;
+                edgeCount++;
+            }
+            mid[e] = found;
+        }
+        const int tris[4][3] = {
+            {icoFaces[f][0], mid[0], mid[2]},
+            {icoFaces[f][1], mid[1], mid[0]},
+            {icoFaces[f][2], mid[2], mid[1]},
+            {mid[0], mid[1], mid[2]}
+        };
+        for (int k = 0; k < 4; k++, triangle++) {
+            for (int c = 0; c < 3; c++) ctx.meshIndices[triangle * 3 + c] = tris[k][c];
+        }
+    }
+
+    for (int i = 0; i < vertexCount; i++) {
+        float *v = ctx.meshVertices + i * 3;
+        float scale = (float)radius / sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        v[0] *= scale; v[1] *= scale; v[2] *= scale;
+    }
+
+    ctx.meshData = dGeomTriMeshDataCreate();
+    dGeomTriMeshDataBuildSingle(ctx.meshData, ctx.meshVertices, 3 * sizeof(float), vertexCount,
+        ctx.meshIndices, triangle * 3, 3 * sizeof(int));
+}
+
+static dBodyID createMeshPrim(BenchContext &ctx, dReal x, dReal y, dReal z)
+{
+    dBodyID body = dBodyCreate(ctx.world);
+    dMass mass;
+    dMassSetSphere(&mass, REAL(500.0), REAL(0.5));
+    dBodySetMass(body, &mass);
+    dBodySetPosition(body, x, y, z);
+    ctx.bodyCount++;
+
+    dGeomID geom = dCreateTriMesh(ctx.activeSpace, ctx.meshData, NULL, NULL, NULL);
+    dGeomSetBody(geom, body);
+    return body;
+}
+
+// icosahedron as a convex hull and as a trimesh of the same 20 faces
+static void createHullData(BenchContext &ctx, dReal radius)
+{
+    static const float t = 1.6180339887f;
+    static const float ico[12][3] = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+        {0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+        {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+    };
+    static const int icoFaces[20][3] = {
+        {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+        {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+        {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+        {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+    };
+
+    // the convex arrays are read 4 values at a time, pad the points
+    ctx.hullPoints = (dReal *)malloc(sizeof(dReal) * (12 * 3 + 1));
+    ctx.hullPlanes = (dReal *)malloc(sizeof(dReal) * 20 * 4);
+    ctx.hullPolygons = (unsigned int *)malloc(sizeof(unsigned int) * 20 * 4);
+    ctx.meshVertices = (float *)malloc(sizeof(float) * 12 * 3);
+    ctx.meshIndices = (int *)malloc(sizeof(int) * 20 * 3);
+
+    float scale = (float)radius / sqrtf(1.0f + t * t);
+    for (int i = 0; i < 12 * 3; i++) {
+        ctx.meshVertices[i] = ico[i / 3][i % 3] * scale;
+        ctx.hullPoints[i] = ctx.meshVertices[i];
+    }
+    ctx.hullPoints[12 * 3] = 0;
+
+    for (int f = 0; f < 20; f++) {
+        const dReal *a = ctx.hullPoints + icoFaces[f][0] * 3;
+        const dReal *b = ctx.hullPoints + icoFaces[f][1] * 3;
+        const dReal *c = ctx.hullPoints + icoFaces[f][2] * 3;
+        dReal *plane = ctx.hullPlanes + f * 4;
+        dVector3 ab = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        dVector3 ac = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        plane[0] = ab[1] * ac[2] - ab[2] * ac[1];
+        plane[1] = ab[2] * ac[0] - ab[0] * ac[2];
+        plane[2] = ab[0] * ac[1] - ab[1] * ac[0];
+        dReal length = dSqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        plane[0] /= length; plane[1] /= length; plane[2] /= length;
+        plane[3] = plane[0] * a[0] + plane[1] * a[1] + plane[2] * a[2];
+
+        unsigned int *polygon = ctx.hullPolygons + f * 4;
+        polygon[0] = 3;
+        for (int k = 0; k < 3; k++) {
+            polygon[1 + k] = (unsigned int)icoFaces[f][k];
+            ctx.meshIndices[f * 3 + k] = icoFaces[f][k];
+        }
+    }
+
+    ctx.meshData = dGeomTriMeshDataCreate();
+    dGeomTriMeshDataBuildSingle(ctx.meshData, ctx.meshVertices, 3 * sizeof(float), 12,
+        ctx.meshIndices, 20 * 3, 3 * sizeof(int));
+}
+
+static dBodyID createHullPrim(BenchContext &ctx, dReal x, dReal y, dReal z, bool mesh)
+{
+    dBodyID body = dBodyCreate(ctx.world);
+    dMass mass;
+    dMassSetSphere(&mass, REAL(500.0), REAL(0.5));
+    dBodySetMass(body, &mass);
+    dBodySetPosition(body, x, y, z);
+    ctx.bodyCount++;
+
+    dGeomID geom = mesh
+        ? dCreateTriMesh(ctx.activeSpace, ctx.meshData, NULL, NULL, NULL)
+        : dCreateConvex(ctx.activeSpace, ctx.hullPlanes, 20, ctx.hullPoints, 12, ctx.hullPolygons);
+    dGeomSetBody(geom, body);
+    return body;
+}
+
+// a sculpt like sphere, distorted differently for every asset
+static void createSculptMesh(int asset, float *vertices, int *indices)
+{
+    for (int v = 0; v <= SCULPT_SIZE; v++) {
+        for (int u = 0; u <= SCULPT_SIZE; u++) {
+            float theta = 3.14159265f * (float)v / SCULPT_SIZE;
+            float phi = 6.2831853f * (float)u / SCULPT_SIZE;
+            float r = 0.5f * (1.0f + 0.2f * sinf((float)asset + 3.0f * phi) * sinf(2.0f * theta));
+            float *vertex = vertices + (v * (SCULPT_SIZE + 1) + u) * 3;
+            vertex[0] = r * sinf(theta) * cosf(phi);
+            vertex[1] = r * sinf(theta) * sinf(phi);
+            vertex[2] = r * cosf(theta);
+        }
+    }
+
+    for (int v = 0; v < SCULPT_SIZE; v++) {
+        for (int u = 0; u < SCULPT_SIZE; u++) {
+            int a = v * (SCULPT_SIZE + 1) + u;
+            int *tri = indices + (v * SCULPT_SIZE + u) * 6;
+            tri[0] = a; tri[1] = a + SCULPT_SIZE + 1; tri[2] = a + 1;
+            tri[3] = a + 1; tri[4] = a + SCULPT_SIZE + 1; tri[5] = a + SCULPT_SIZE + 2;
+        }
+    }
+}
+
+static dBodyID createBoxPrim(BenchContext &ctx, dReal x, dReal y, dReal z, dReal size)
+{
+    dBodyID body = dBodyCreate(ctx.world);
+    dMass mass;
+    dMassSetBox(&mass, REAL(500.0), size, size, size);
+    dBodySetMass(body, &mass);
+    dBodySetPosition(body, x, y, z);
+    ctx.bodyCount++;
+
+    dGeomID geom = dCreateBox(ctx.activeSpace, size, size, size);
+    dGeomSetBody(geom, body);
+    return body;
+}
+
+static dBodyID createSpherePrim(BenchContext &ctx, dReal x, dReal y, dReal z, dReal size)
+{
+    dBodyID body = dBodyCreate(ctx.world);
+    dMass mass;
+    dMassSetSphere(&mass, REAL(500.0), size * REAL(0.5));
+    dBodySetMass(body, &mass);
+    dBodySetPosition(body, x, y, z);
+    ctx.bodyCount++;
+
+    dGeomID geom = dCreateSphere(ctx.activeSpace, size * REAL(0.5));
+    dGeomSetBody(geom, body);
+    return body;
+}
+
+static dBodyID createCapsulePrim(BenchContext &ctx, dReal x, dReal y, dReal z, dReal size)
+{
+    dBodyID body = dBodyCreate(ctx.world);
+    dMass mass;
+    dMassSetCapsule(&mass, REAL(500.0), 3, size * REAL(0.25), size);
+    dBodySetMass(body, &mass);
+    dBodySetPosition(body, x, y, z);
+    ctx.bodyCount++;
+
+    dGeomID geom = dCreateCapsule(ctx.activeSpace, size * REAL(0.25), size);
+    dGeomSetBody(geom, body);
+    return body;
+}
+
+static dBodyID createCylinderPrim(BenchContext &ctx, dReal x, dReal y, dReal z, dReal size)
+{
+    dBodyID body = dBodyCreate(ctx.world);
+    dMass mass;
+    dMassSetCylinder(&mass, REAL(500.0), 3, size * REAL(0.5), size);
+    dBodySetMass(body, &mass);
+    dBodySetPosition(body, x, y, z);
+    ctx.bodyCount++;
+
+    dGeomID geom = dCreateCylinder(ctx.activeSpace, size * REAL(0.5), size);
+    dGeomSetBody(geom, body);
+    return body;
+}
+
+
+//****************************************************************************
+// avatars
+
+static void createAvatars(BenchContext &ctx, int count, dReal minXY, dReal maxXY)
+{
+    ctx.avatars = (Avatar *)malloc(sizeof(Avatar) * (size_t)count);
+    ctx.avatarCount = count;
+
+    for (int i = 0; i < count; i++) {
+        dReal x = benchRandom(ctx, minXY, maxXY);
+        dReal y = benchRandom(ctx, minXY, maxXY);
+        dReal z = terrainHeightAt(x, y) + AVATAR_RADIUS + AVATAR_LENGTH * REAL(0.5) + REAL(0.1);
+
+        dBodyID body = dBodyCreate(ctx.world);
+        dMass mass;
+        dMassSetCapsuleTotal(&mass, AVATAR_MASS, 3, AVATAR_RADIUS, AVATAR_LENGTH);
+        dBodySetMass(body, &mass);
+        dBodySetPosition(body, x, y, z);
+        dBodySetAutoDisableFlag(body, 0);
+        dBodySetMaxAngularSpeed(body, 0);  // stay upright
+        ctx.bodyCount++;
+
+        dGeomID geom = dCreateCapsule(ctx.activeSpace, AVATAR_RADIUS, AVATAR_LENGTH);
+        dGeomSetBody(geom, body);
+
+        ctx.avatars[i].body = body;
+        ctx.avatars[i].heading = benchRandom(ctx, 0, REAL(6.2831853));
+        ctx.avatars[i].turnCountdown = (int)benchRandom(ctx, 20, 200);
+    }
+}
+
+// steer the avatars the way a viewer would: random walks that stay away
+// from the region edges, driven by a force towards the walking velocity
+static void walkAvatars(BenchContext &ctx)
+{
+    const dReal margin = REAL(8.0);
+    const dReal center = (dReal)ctx.regionSize * REAL(0.5);
+
+    for (int i = 0; i < ctx.avatarCount; i++) {
+        Avatar &avatar = ctx.avatars[i];
+        const dReal *pos = dBodyGetPosition(avatar.body);
+
+        if (pos[0] < margin || pos[1] < margin
+            || pos[0] > (dReal)ctx.regionSize - margin || pos[1] > (dReal)ctx.regionSize - margin) {
+            avatar.heading = dAtan2(center - pos[1], center - pos[0]);
+        }
+        else if (--avatar.turnCountdown <= 0) {
+            avatar.heading += benchRandom(ctx, REAL(-1.5), REAL(1.5));
+            avatar.turnCountdown = (int)benchRandom(ctx, 20, 200);
+        }
+
+        const dReal *vel = dBodyGetLinearVel(avatar.body);
+        dReal targetX = AVATAR_WALK_SPEED * dCos(avatar.heading);
+        dReal targetY = AVATAR_WALK_SPEED * dSin(avatar.heading);
+        dReal gain = AVATAR_MASS / (REAL(4.0) * STEP_SIZE);
+        dBodyAddForce(avatar.body, (targetX - vel[0]) * gain, (targetY - vel[1]) * gain, 0);
+    }
+}
+
+
+// projectiles are fired along +x at a 5cm wall at PROJECTILE_WALL_X. one
+// found past the wall was tunnelled, one that stopped is fired again
+static void fireProjectile(BenchContext &ctx, dBodyID body)
+{
+    dReal x = PROJECTILE_WALL_X - REAL(10.0);
+    dReal y = benchRandom(ctx, REAL(118.0), REAL(138.0));
+    dReal ground = terrainHeightAt(x, y);
+    dReal wallGround = terrainHeightAt(PROJECTILE_WALL_X, y);
+    if (wallGround > ground)
+        ground = wallGround;
+
+    dBodySetPosition(body, x, y, ground + benchRandom(ctx, REAL(2.0), REAL(6.0)));
+    dBodySetLinearVel(body, benchRandom(ctx, REAL(40.0), REAL(80.0)), 0, 0);
+    dBodySetAngularVel(body, 0, 0, 0);
+    dBodyEnable(body);
+}
+
+static void fireProjectiles(BenchContext &ctx)
+{
+    for (int i = 0; i < ctx.projectileCount; i++) {
+        dBodyID body = ctx.projectiles[i];
+        const dReal *pos = dBodyGetPosition(body);
+        const dReal *vel = dBodyGetLinearVel(body);
+
+        if (pos[0] > PROJECTILE_WALL_X + REAL(0.5)) {
+            ctx.tunnelled++;
+            fireProjectile(ctx, body);
+        }
+        else if (dCalcVectorLengthSquare3(vel) < REAL(1.0) || !dBodyIsEnabled(body)) {
+            fireProjectile(ctx, body);
+        }
+    }
+}
+
+
+// rez a prim dropped over the middle of the region, every fourth one starts
+// a new linkset and the others are linked to the prim rezzed before them
+static void rezChurnPrim(BenchContext &ctx, int index)
+{
+    dReal x = benchRandom(ctx, REAL(100.0), REAL(156.0));
+    dReal y = benchRandom(ctx, REAL(100.0), REAL(156.0));
+    dReal z = terrainHeightAt(x, y) + benchRandom(ctx, REAL(1.0), REAL(6.0));
+    dReal size = benchRandom(ctx, REAL(0.3), REAL(1.0));
+
+    dBodyID body;
+    switch (index & 3) {
+        case 0: body = createBoxPrim(ctx, x, y, z, size); break;
+        case 1: body = createSpherePrim(ctx, x, y, z, size); break;
+        case 2: body = createCapsulePrim(ctx, x, y, z, size); break;
+        default: body = createCylinderPrim(ctx, x, y, z, size); break;
+    }
+    ctx.churnBodies[index] = body;
+
+    int previous = (index + ctx.churnCount - 1) % ctx.churnCount;
+    if ((index & 3) != 0 && ctx.churnBodies[previous] != NULL) {
+        dJointID joint = dJointCreateFixed(ctx.world, 0);
+        dJointAttach(joint, ctx.churnBodies[previous], body);
+        dJointSetFixed(joint);
+        ctx.churnJoints[index] = joint;
+    }
+}
+
+static void derezChurnPrim(BenchContext &ctx, int index)
+{
+    // unlink from the prims before and after it
+    int next = (index + 1) % ctx.churnCount;
+    if (ctx.churnJoints[index] != NULL) {
+        dJointDestroy(ctx.churnJoints[index]);
+        ctx.churnJoints[index] = NULL;
+    }
+    if (ctx.churnJoints[next] != NULL) {
+        dJointDestroy(ctx.churnJoints[next]);
+        ctx.churnJoints[next] = NULL;
+    }
+
+    dBodyID body = ctx.churnBodies[index];
+    dGeomID geom;
+    while ((geom = dBodyGetFirstGeom(body)) != NULL) {
+        dGeomDestroy(geom);
+    }
+    dBodyDestroy(body);
+    ctx.churnBodies[index] = NULL;
+    ctx.bodyCount--;
+}
+
+// the oldest CHURN_PER_STEP prims are replaced every step, like a busy
+// sandbox rezzing and deleting objects and changing links
+static void churnPrims(BenchContext &ctx)
+{
+    if (ctx.churnCount == 0) {
+        return;
+    }
+
+    double start = benchNow();
+    for (int i = 0; i < CHURN_PER_STEP; i++) {
+        derezChurnPrim(ctx, ctx.churnNext);
+        rezChurnPrim(ctx, ctx.churnNext);
+        ctx.churnNext = (ctx.churnNext + 1) % ctx.churnCount;
+    }
+    ctx.churnTime += benchNow() - start;
+}
+
+
+//****************************************************************************
+// collision
+
+static int pairContactLimit(BenchContext &ctx, dGeomID o1, dGeomID o2)
+{
+    (void)ctx;
+    dBodyID b1 = dGeomGetBody(o1);
+    dBodyID b2 = dGeomGetBody(o2);
+    if (b1 == b2) {
+        return 0;
+    }
+
+    int *linkset1 = (int *)dGeomGetData(o1);
+    int *linkset2 = (int *)dGeomGetData(o2);
+    if (linkset1 != NULL && linkset1 == linkset2) {
+        return 0;
+    }
+
+    return MAX_CONTACTS;
+}
+
+static void setContactSurface(dSurfaceParameters &surface)
+{
+    surface.mode = dContactSoftERP | dContactSoftCFM | dContactApprox1;
+    surface.mu = REAL(0.8);
+    surface.soft_erp = REAL(0.6);
+    surface.soft_cfm = REAL(0.0001);
+}
+
+static void nearCallback(void *data, dGeomID o1, dGeomID o2)
+{
+    BenchContext &ctx = *(BenchContext *)data;
+
+    if (dGeomIsSpace(o1) || dGeomIsSpace(o2)) {
+        dSpaceCollide2(o1, o2, data, &nearCallback);
+        return;
+    }
+
+    int limit = pairContactLimit(ctx, o1, o2);
+    if (limit == 0) {
+        return;
+    }
+
+    dContact contacts[MAX_CONTACTS];
+    int count = dCollide(o1, o2, limit, &contacts[0].geom, sizeof(dContact));
+
+    dBodyID b1 = dGeomGetBody(o1);
+    dBodyID b2 = dGeomGetBody(o2);
+    for (int i = 0; i < count; i++) {
+        setContactSurface(contacts[i].surface);
+        dJointID joint = dJointCreateContact(ctx.world, ctx.contactGroup, contacts + i);
+        dJointAttach(joint, b1, b2);
+    }
+    ctx.contactsThisStep += count;
+}
+
+static int parallelFilter(void *data, dGeomID o1, dGeomID o2)
+{
+    return pairContactLimit(*(BenchContext *)data, o1, o2);
+}
+
+static void countCallback(void *data, dGeomID o1, dGeomID o2)
+{
+    BenchContext &ctx = *(BenchContext *)data;
+
+    if (dGeomIsSpace(o1) || dGeomIsSpace(o2)) {
+        dSpaceCollide2(o1, o2, data, &countCallback);
+        return;
+    }
+
+    int limit = pairContactLimit(ctx, o1, o2);
+    if (limit == 0) {
+        return;
+    }
+
+    dContactGeom contacts[MAX_CONTACTS];
+    ctx.serialContacts += dCollide(o1, o2, limit, contacts, sizeof(dContactGeom));
+}
+
+static bool sameContact(const dContactGeom &a, const dContactGeom &b)
+{
+    return a.pos[0] == b.pos[0] && a.pos[1] == b.pos[1] && a.pos[2] == b.pos[2]
+        && a.normal[0] == b.normal[0] && a.normal[1] == b.normal[1] && a.normal[2] == b.normal[2]
+        && a.depth == b.depth && a.g1 == b.g1 && a.g2 == b.g2
+        && a.side1 == b.side1 && a.side2 == b.side2;
+}
+
+// the parallel pass must give exactly what dCollide gives on this thread.
+// pairs with trimesh or terrain temporal coherence answer the second query
+// from the state the first one left, so the _tc scenes can report mismatches
+static void verifyParallel(BenchContext &ctx, dSpaceID space, int contactCount, int pairCount)
+{
+    for (int p = 0; p < pairCount; p++) {
+        const dCollidePair &pair = ctx.parallelPairs[p];
+        dContactGeom contacts[MAX_CONTACTS];
+        int count = dCollide(pair.g1, pair.g2, pairContactLimit(ctx, pair.g1, pair.g2), contacts, sizeof(dContactGeom));
+
+        bool same = count == pair.count;
+        for (int i = 0; same && i < count; i++) {
+            same = sameContact(contacts[i], ctx.parallelContacts[pair.first + i]);
+        }
+        if (!same) {
+            ctx.mismatches++;
+        }
+    }
+
+    // pairs missing from the parallel results
+    ctx.serialContacts = 0;
+    dSpaceCollide(space, &ctx, &countCallback);
+    if (ctx.serialContacts != contactCount) {
+        ctx.mismatches++;
+    }
+}
+
+static void collideParallel(BenchContext &ctx, dSpaceID space)
+{
+    int pairCount = 0;
+    int contactCount = dSpaceCollideParallel(ctx.world, space, &ctx, &parallelFilter, MAX_CONTACTS,
+        ctx.parallelContacts, PARALLEL_CONTACTS, ctx.parallelPairs, PARALLEL_PAIRS, &pairCount);
+
+    for (int p = 0; p < pairCount; p++) {
+        const dCollidePair &pair = ctx.parallelPairs[p];
+        dBodyID b1 = dGeomGetBody(pair.g1);
+        dBodyID b2 = dGeomGetBody(pair.g2);
+        for (int i = pair.first; i < pair.first + pair.count; i++) {
+            dContact contact;
+            contact.geom = ctx.parallelContacts[i];
+            setContactSurface(contact.surface);
+            dJointID joint = dJointCreateContact(ctx.world, ctx.contactGroup, &contact);
+            dJointAttach(joint, b1, b2);
+        }
+    }
+    ctx.contactsThisStep += contactCount;
+
+    if (ctx.verifyParallel) {
+        verifyParallel(ctx, space, contactCount, pairCount);
+    }
+}
+
+static void collide(BenchContext &ctx)
+{
+    ctx.contactsThisStep = 0;
+    if (ctx.parallelCollide) {
+        collideParallel(ctx, ctx.topSpace);
+        collideParallel(ctx, ctx.activeSpace);
+    }
+    else {
+        dSpaceCollide(ctx.topSpace, &ctx, &nearCallback);
+        dSpaceCollide(ctx.activeSpace, &ctx, &nearCallback);
+    }
+}
+
+
+//****************************************************************************
+// scenes
+
+static void setupProjectiles(BenchContext &ctx, bool ccd)
+{
+    createTerrain(ctx, 256);
+
+    dGeomID wall = dCreateBox(ctx.staticSpace, REAL(0.05), REAL(120.0), REAL(30.0));
+    dGeomSetPosition(wall, PROJECTILE_WALL_X, REAL(128.0), REAL(25.0));
+
+    ctx.projectileCount = 200;
+    ctx.projectiles = (dBodyID *)malloc(sizeof(dBodyID) * (size_t)ctx.projectileCount);
+    for (int i = 0; i < ctx.projectileCount; i++) {
+        dBodyID body = createSpherePrim(ctx, 0, 0, 0, PROJECTILE_SIZE);
+        if (ccd)
+            dBodySetCCDRadius(body, PROJECTILE_SIZE * REAL(0.5));
+        ctx.projectiles[i] = body;
+        fireProjectile(ctx, body);
+    }
+}
+
+static void setupProjectilesPlain(BenchContext &ctx)
+{
+    setupProjectiles(ctx, false);
+}
+
+static void setupProjectilesCCD(BenchContext &ctx)
+{
+    setupProjectiles(ctx, true);
+}
+
+static void setupRezChurn(BenchContext &ctx)
+{
+    createTerrain(ctx, 256);
+    createAvatars(ctx, 100, REAL(16.0), REAL(240.0));
+
+    ctx.churnCount = CHURN_PRIMS;
+    ctx.churnBodies = (dBodyID *)calloc((size_t)ctx.churnCount, sizeof(dBodyID));
+    ctx.churnJoints = (dJointID *)calloc((size_t)ctx.churnCount, sizeof(dJointID));
+    for (int i = 0; i < ctx.churnCount; i++) {
+        rezChurnPrim(ctx, i);
+    }
+}
+
+static void setupAvatars256(BenchContext &ctx)
+{
+    createTerrain(ctx, 256);
+    createAvatars(ctx, 100, REAL(16.0), REAL(240.0));
+}
+
+static void setupAvatars2048(BenchContext &ctx)
+{
+    createTerrain(ctx, 2048);
+    createAvatars(ctx, 100, REAL(16.0), REAL(2032.0));
+}
+
+static void setupAvatars2048Quantized(BenchContext &ctx)
+{
+    createTerrain(ctx, 2048, true);
+    createAvatars(ctx, 100, REAL(16.0), REAL(2032.0));
+}
+
+// mesh_piles, optionally with temporal coherence against other meshes and
+// the terrain
+static void setupMeshPiles(BenchContext &ctx, bool tc)
+{
+    createTerrain(ctx, 256);
+    createMeshData(ctx, REAL(0.5));
+
+    // four piles of 10 x 10 x 2 meshes
+    for (int pile = 0; pile < 4; pile++) {
+        dReal baseX = REAL(80.0) + REAL(60.0) * (dReal)(pile & 1);
+        dReal baseY = REAL(80.0) + REAL(60.0) * (dReal)(pile >> 1);
+        for (int layer = 0; layer < 2; layer++) {
+            for (int i = 0; i < 100; i++) {
+                dReal x = baseX + REAL(1.05) * (dReal)(i % 10) + benchRandom(ctx, REAL(-0.1), REAL(0.1));
+                dReal y = baseY + REAL(1.05) * (dReal)(i / 10) + benchRandom(ctx, REAL(-0.1), REAL(0.1));
+                dReal z = terrainHeightAt(x, y) + REAL(0.6) + REAL(1.1) * (dReal)layer;
+                dBodyID body = createMeshPrim(ctx, x, y, z);
+                if (tc) {
+                    dGeomTriMeshEnableTC(dBodyGetFirstGeom(body), dTriMeshClass, 1);
+                    dGeomTriMeshEnableTC(dBodyGetFirstGeom(body), dOSTerrainClass, 1);
+                }
+            }
+        }
+    }
+}
+
+static void setupMeshPilesPlain(BenchContext &ctx)
+{
+    setupMeshPiles(ctx, false);
+}
+
+// damped so the piles settle, run with a longer -w
+static void setupMeshRest(BenchContext &ctx, bool tc)
+{
+    dWorldSetLinearDamping(ctx.world, REAL(0.05));
+    dWorldSetAngularDamping(ctx.world, REAL(0.2));
+    setupMeshPiles(ctx, tc);
+}
+
+static void setupMeshRestPlain(BenchContext &ctx)
+{
+    setupMeshRest(ctx, false);
+}
+
+static void setupMeshRestTC(BenchContext &ctx)
+{
+    setupMeshRest(ctx, true);
+}
+
+// four piles of 200 boxes on a flat floor that auto-disable, per body or
+// per island. run with a longer -w so that they settle
+static void setupSleepingPiles(BenchContext &ctx, bool islands)
+{
+    dWorldSetAutoDisableFlag(ctx.world, 1);
+    dWorldSetAutoDisableLinearThreshold(ctx.world, REAL(0.1));
+    dWorldSetAutoDisableAngularThreshold(ctx.world, REAL(0.1));
+    dWorldSetAutoDisableAverageSamplesCount(ctx.world, 10);
+    dWorldSetAutoDisableSteps(ctx.world, 20);
+    dWorldSetAutoDisableIslands(ctx.world, islands ? 1 : 0);
+    dCreatePlane(ctx.staticSpace, 0, 0, 1, 0);
+
+    for (int pile = 0; pile < 4; pile++) {
+        dReal baseX = REAL(80.0) + REAL(60.0) * (dReal)(pile & 1);
+        dReal baseY = REAL(80.0) + REAL(60.0) * (dReal)(pile >> 1);
+        for (int layer = 0; layer < 2; layer++) {
+            for (int i = 0; i < 100; i++) {
+                dReal x = baseX + REAL(0.505) * (dReal)(i % 10);
+                dReal y = baseY + REAL(0.505) * (dReal)(i / 10);
+                dReal z = REAL(0.25) + REAL(0.5) * (dReal)layer;
+                createBoxPrim(ctx, x, y, z, REAL(0.5));
+            }
+        }
+    }
+}
+
+static void setupSleepingPilesBodies(BenchContext &ctx)
+{
+    setupSleepingPiles(ctx, false);
+}
+
+static void setupSleepingPilesIslands(BenchContext &ctx)
+{
+    setupSleepingPiles(ctx, true);
+}
+
+// the mesh_piles layout with icosahedron prims, once as convex hulls and
+// once as trimeshes of the same faces
+static void setupHullPiles(BenchContext &ctx, bool mesh)
+{
+    createTerrain(ctx, 256);
+    createHullData(ctx, REAL(0.5));
+
+    for (int pile = 0; pile < 4; pile++) {
+        dReal baseX = REAL(80.0) + REAL(60.0) * (dReal)(pile & 1);
+        dReal baseY = REAL(80.0) + REAL(60.0) * (dReal)(pile >> 1);
+        for (int layer = 0; layer < 2; layer++) {
+            for (int i = 0; i < 100; i++) {
+                dReal x = baseX + REAL(1.05) * (dReal)(i % 10) + benchRandom(ctx, REAL(-0.1), REAL(0.1));
+                dReal y = baseY + REAL(1.05) * (dReal)(i / 10) + benchRandom(ctx, REAL(-0.1), REAL(0.1));
+                dReal z = terrainHeightAt(x, y) + REAL(0.6) + REAL(1.1) * (dReal)layer;
+                createHullPrim(ctx, x, y, z, mesh);
+            }
+        }
+    }
+}
+
+static void setupHullPilesConvex(BenchContext &ctx)
+{
+    setupHullPiles(ctx, false);
+}
+
+static void setupHullPilesMesh(BenchContext &ctx)
+{
+    setupHullPiles(ctx, true);
+}
+
+static void setupLinksets(BenchContext &ctx)
+{
+    createTerrain(ctx, 256);
+
+    // four linksets of 255 boxes, every child fixed to the root prim
+    const dReal size = REAL(0.4);
+    for (int linkset = 0; linkset < 4; linkset++) {
+        dReal baseX = REAL(100.0) + REAL(20.0) * (dReal)linkset;
+        dReal baseY = REAL(128.0);
+        dReal baseZ = terrainHeightAt(baseX, baseY) + REAL(3.0);
+
+        linksetIds[linkset] = linkset;
+        dBodyID root = NULL;
+        for (int prim = 0; prim < 255; prim++) {
+            dReal x = baseX + size * (dReal)(prim % 5);
+            dReal y = baseY + size * (dReal)((prim / 5) % 5);
+            dReal z = baseZ + size * (dReal)(prim / 25);
+            dBodyID body = createBoxPrim(ctx, x, y, z, size);
+            dGeomSetData(dBodyGetFirstGeom(body), &linksetIds[linkset]);
+
+            if (root == NULL) {
+                root = body;
+            }
+            else {
+                dJointID joint = dJointCreateFixed(ctx.world, 0);
+                dJointAttach(joint, root, body);
+                dJointSetFixed(joint);
+            }
+        }
+    }
+}
+
+// one island of boxes on a plane: every layer is shifted by half a box
+// so each box rests on four below it
+static void setupPyramid(BenchContext &ctx, int side)
+{
+    dCreatePlane(ctx.staticSpace, 0, 0, 1, 0);
+
+    const dReal size = REAL(0.5);
+    for (int layer = 0; layer < side; layer++) {
+        int count = side - layer;
+        dReal base = REAL(128.0) + REAL(0.5) * size * (dReal)layer;
+        dReal z = REAL(0.5) * size + REAL(0.998) * size * (dReal)layer;
+        for (int i = 0; i < count * count; i++) {
+            createBoxPrim(ctx, base + size * (dReal)(i % count), base + size * (dReal)(i / count), z, size);
+        }
+    }
+}
+
+static void setupPyramid1k(BenchContext &ctx)
+{
+    setupPyramid(ctx, 6);
+}
+
+static void setupPyramid10k(BenchContext &ctx)
+{
+    setupPyramid(ctx, 13);
+}
+
+static void setupStaticPrims(BenchContext &ctx)
+{
+    createTerrain(ctx, 256);
+
+    for (int i = 0; i < 4000; i++) {
+        dReal x = benchRandom(ctx, REAL(4.0), REAL(252.0));
+        dReal y = benchRandom(ctx, REAL(4.0), REAL(252.0));
+        dReal size = benchRandom(ctx, REAL(0.5), REAL(4.0));
+        dGeomID geom = (i & 3) == 0
+            ? dCreateSphere(ctx.staticSpace, size * REAL(0.5))
+            : dCreateBox(ctx.staticSpace, size, size, benchRandom(ctx, REAL(0.5), REAL(4.0)));
+        dGeomSetPosition(geom, x, y, terrainHeightAt(x, y) + size * REAL(0.25));
+    }
+
+    createAvatars(ctx, 100, REAL(16.0), REAL(240.0));
+}
+
+// static sculpt prims using 8 assets. every prim decodes its own copy of
+// the asset like the region loader does, then gets its own data built or
+// a reference to the shared one
+static void setupSculpts(BenchContext &ctx, bool shared)
+{
+    createTerrain(ctx, 256);
+
+    const int count = 800;
+    float *vertices = (float *)malloc(sizeof(float) * SCULPT_VERTICES * 3);
+    int *indices = (int *)malloc(sizeof(int) * SCULPT_INDICES);
+    ctx.sculptData = (dTriMeshDataID *)malloc(sizeof(dTriMeshDataID) * count);
+    ctx.sculptVertices = (float **)calloc(count, sizeof(float *));
+    ctx.sculptIndices = (int **)calloc(count, sizeof(int *));
+
+    for (int i = 0; i < count; i++) {
+        createSculptMesh(i & 7, vertices, indices);
+
+        dTriMeshDataID data;
+        if (shared) {
+            data = dGeomTriMeshDataCreateShared(vertices, SCULPT_VERTICES,
+                (const dTriIndex *)indices, SCULPT_INDICES, NULL, 0);
+        }
+        else {
+            // the arrays must outlive the data
+            float *ownVertices = (float *)malloc(sizeof(float) * SCULPT_VERTICES * 3);
+            int *ownIndices = (int *)malloc(sizeof(int) * SCULPT_INDICES);
+            memcpy(ownVertices, vertices, sizeof(float) * SCULPT_VERTICES * 3);
+            memcpy(ownIndices, indices, sizeof(int) * SCULPT_INDICES);
+            data = dGeomTriMeshDataCreate();
+            dGeomTriMeshDataBuildSingle(data, ownVertices, 3 * sizeof(float), SCULPT_VERTICES,
+                ownIndices, SCULPT_INDICES, 3 * sizeof(int));
+            dGeomTriMeshDataPreprocess(data);
+            ctx.sculptVertices[ctx.sculptCount] = ownVertices;
+            ctx.sculptIndices[ctx.sculptCount] = ownIndices;
+        }
+        ctx.sculptData[ctx.sculptCount++] = data;
+
+        dReal x = benchRandom(ctx, REAL(8.0), REAL(248.0));
+        dReal y = benchRandom(ctx, REAL(8.0), REAL(248.0));
+        dGeomID geom = dCreateTriMesh(ctx.staticSpace, data, NULL, NULL, NULL);
+        dGeomSetPosition(geom, x, y, terrainHeightAt(x, y) + REAL(0.3));
+    }
+
+    free(vertices);
+    free(indices);
+
+    createAvatars(ctx, 100, REAL(16.0), REAL(240.0));
+}
+
+static void setupSculptsOwned(BenchContext &ctx)
+{
+    setupSculpts(ctx, false);
+}
+
+static void setupSculptsShared(BenchContext &ctx)
+{
+    setupSculpts(ctx, true);
+}
+
+// the mesh_piles layout with every other prim a cylinder, tipped over in
+// the upper layer, and the rest boxes, spheres and capsules
+static void setupCylinderPiles(BenchContext &ctx)
+{
+    createTerrain(ctx, 256);
+
+    for (int pile = 0; pile < 4; pile++) {
+        dReal baseX = REAL(80.0) + REAL(60.0) * (dReal)(pile & 1);
+        dReal baseY = REAL(80.0) + REAL(60.0) * (dReal)(pile >> 1);
+        for (int layer = 0; layer < 2; layer++) {
+            for (int i = 0; i < 100; i++) {
+                dReal x = baseX + REAL(1.05) * (dReal)(i % 10) + benchRandom(ctx, REAL(-0.1), REAL(0.1));
+                dReal y = baseY + REAL(1.05) * (dReal)(i / 10) + benchRandom(ctx, REAL(-0.1), REAL(0.1));
+                dReal z = terrainHeightAt(x, y) + REAL(0.6) + REAL(1.1) * (dReal)layer;
+
+                dBodyID body;
+                switch (i & 7) {
+                    case 1: body = createBoxPrim(ctx, x, y, z, REAL(0.9)); break;
+                    case 3: body = createSpherePrim(ctx, x, y, z, REAL(0.9)); break;
+                    case 5: body = createCapsulePrim(ctx, x, y, z, REAL(0.9)); break;
+                    default: body = createCylinderPrim(ctx, x, y, z, REAL(0.9)); break;
+                }
+
+                if (layer == 1) {
+                    dMatrix3 R;
+                    dRFromEulerAngles(R, benchRandom(ctx, 0, REAL(6.2831853)), benchRandom(ctx, 0, REAL(6.2831853)), 0);
+                    dBodySetRotation(body, R);
+                }
+            }
+        }
+    }
+}
+
+// every collider that takes the terrain, on a region wide spread so
+// that the parallel pass collides many objects against it at once
+static void setupTerrainStress(BenchContext &ctx, bool quantized)
+{
+    createTerrain(ctx, 256, quantized);
+    createMeshData(ctx, REAL(0.5));
+
+    for (int i = 0; i < 1000; i++) {
+        dReal x = benchRandom(ctx, REAL(8.0), REAL(248.0));
+        dReal y = benchRandom(ctx, REAL(8.0), REAL(248.0));
+        dReal z = terrainHeightAt(x, y) + benchRandom(ctx, REAL(0.5), REAL(4.0));
+        dReal size = benchRandom(ctx, REAL(0.4), REAL(1.6));
+
+        dBodyID body;
+        switch (i & 3) {
+            case 0: body = createSpherePrim(ctx, x, y, z, size); break;
+            case 1: body = createBoxPrim(ctx, x, y, z, size); break;
+            case 2: body = createCapsulePrim(ctx, x, y, z, size); break;
+            default: body = createMeshPrim(ctx, x, y, z); break;
+        }
+
+        dMatrix3 R;
+        dRFromEulerAngles(R, benchRandom(ctx, 0, REAL(6.2831853)), benchRandom(ctx, 0, REAL(6.2831853)), benchRandom(ctx, 0, REAL(6.2831853)));
+        dBodySetRotation(body, R);
+    }
+}
+
+static void setupTerrainStressFloat(BenchContext &ctx)
+{
+    setupTerrainStress(ctx, false);
+}
+
+static void setupTerrainStressQuantized(BenchContext &ctx)
+{
+    setupTerrainStress(ctx, true);
+}
+
+struct BenchScene
+{
+    const char *name;
+    const char *description;
+    void (*setup)(BenchContext &ctx);
+};
+
+static const BenchScene benchScenes[] = {
+    { "terrain256_avatars", "256x256 terrain, 100 walking avatars", &setupAvatars256 },
+    { "terrain2048_avatars", "2048x2048 terrain, 100 walking avatars", &setupAvatars2048 },
+    { "terrain2048_avatars_q16", "terrain2048_avatars with 16 bit quantized heights", &setupAvatars2048Quantized },
+    { "mesh_piles", "four piles of 200 physical trimesh prims on terrain", &setupMeshPilesPlain },
+    { "mesh_rest", "mesh_piles with damping, for runs with a longer warmup", &setupMeshRestPlain },
+    { "mesh_rest_tc", "mesh_rest with temporal coherence for mesh and terrain pairs", &setupMeshRestTC },
+    { "sleeping_piles", "four piles of 200 boxes on a plane auto-disabled per body, run with a longer -w", &setupSleepingPilesBodies },
+    { "sleeping_piles_islands", "sleeping_piles auto-disabled per island", &setupSleepingPilesIslands },
+    { "hull_piles", "four piles of 200 physical convex hull prims on terrain", &setupHullPilesConvex },
+    { "hull_piles_mesh", "hull_piles with the hulls as trimeshes", &setupHullPilesMesh },
+    { "cylinder_piles", "four piles of 200 physical prims, half of them cylinders, on terrain", &setupCylinderPiles },
+    { "linksets", "four 255 prim linksets joined with fixed joints", &setupLinksets },
+    { "pyramid_1k", "one island of 91 boxes in a pyramid, about 1k contacts, for -g", &setupPyramid1k },
+    { "pyramid_10k", "one island of 819 boxes in a pyramid, about 10k contacts, for -g", &setupPyramid10k },
+    { "static_prims", "4000 static prims and 100 walking avatars", &setupStaticPrims },
+    { "sculpts", "800 static sculpt prims of 8 assets, one mesh data each, 100 walking avatars", &setupSculptsOwned },
+    { "sculpts_shared", "sculpts with mesh data shared per asset", &setupSculptsShared },
+    { "terrain_stress", "1000 spheres, boxes, capsules and meshes over the whole terrain", &setupTerrainStressFloat },
+    { "terrain_stress_q16", "terrain_stress with 16 bit quantized heights", &setupTerrainStressQuantized },
+    { "projectiles", "200 10cm spheres fired at 40-80 m/s into a 5cm wall", &setupProjectilesPlain },
+    { "projectiles_ccd", "projectiles with continuous collision on the spheres", &setupProjectilesCCD },
+    { "rez_churn", "400 linked prims, 40 derezzed and rezzed again every step, 100 walking avatars", &setupRezChurn },
+};
+
+#define BENCH_SCENE_COUNT ((int)(sizeof(benchScenes) / sizeof(benchScenes[0])))
+
+
+//****************************************************************************
+// running and reporting
+
+struct BenchOptions
+{
+    int steps;
+    int warmup;
+    int threads;
+    int regions;
+    bool parallelCollide;
+    bool verifyParallel;
+    bool mallocObjects;
+    double tolerance;
+    bool coloredSolver;
+    const char *snapshotPrefix;
+    const char *selected[BENCH_SCENE_COUNT];
+    int selectedCount;
+    FILE *output;
+};
+
+struct Distribution
+{
+    double mean, p50, p90, p99, max;
+};
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static Distribution computeDistribution(double *samples, int count)
+{
+    Distribution d;
+    qsort(samples, (size_t)count, sizeof(double), &compareDoubles);
+
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    d.mean = sum / count;
+    d.p50 = samples[(count - 1) * 50 / 100];
+    d.p90 = samples[(count - 1) * 90 / 100];
+    d.p99 = samples[(count - 1) * 99 / 100];
+    d.max = samples[count - 1];
+    return d;
+}
+
+static void printDistribution(FILE *out, const char *name, const Distribution &d)
+{
+    fprintf(out, "\"%s\":{\"mean\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+        name, d.mean, d.p50, d.p90, d.p99, d.max);
+}
+
+// one of the worlds stepped at once with -r
+struct BenchRegion
+{
+    const BenchScene *scene;
+    const BenchOptions *options;
+    dThreadingSchedulerID scheduler;
+    dThreadingImplementationID threading;
+    int index;
+    int mismatches;
+};
+
+// the linkset ids are the only user data of the scenes, saved as index + 1.
+// the replay does not collide geoms with the same data id
+static duint64 saveSnapshotRef(void *context, int kind, void *object)
+{
+    (void)context;
+    if (kind == dSnapshotRefGeomData) {
+        return (duint64)((int *)object - linksetIds) + 1;
+    }
+    return 0;
+}
+
+static void saveSnapshot(BenchContext &ctx, const BenchScene &scene,
+    const BenchOptions &options, const BenchRegion *region)
+{
+    char path[1024];
+    if (region != NULL) {
+        snprintf(path, sizeof(path), "%s%s_%d.snap", options.snapshotPrefix, scene.name, region->index);
+    }
+    else {
+        snprintf(path, sizeof(path), "%s%s.snap", options.snapshotPrefix, scene.name);
+    }
+
+    dSnapshotReplayInfo replay;
+    memset(&replay, 0, sizeof(replay));
+    replay.step_size = STEP_SIZE;
+    replay.quickstep = 1;
+    replay.max_contacts = MAX_CONTACTS;
+    setContactSurface(replay.surface);
+
+    dSnapshotCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.save_ref = &saveSnapshotRef;
+
+    size_t size = dWorldSnapshotSave(ctx.world, ctx.topSpace, &replay, &callbacks, dSnapshotEmbedData, NULL, 0);
+    void *buffer = malloc(size);
+    dWorldSnapshotSave(ctx.world, ctx.topSpace, &replay, &callbacks, dSnapshotEmbedData, buffer, size);
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(buffer, 1, size, file) != size) {
+        perror(path);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    free(buffer);
+}
+
+// returns the number of parallel collision mismatches found with -v
+static int runScene(const BenchScene &scene, const BenchOptions &options,
+    dThreadingImplementationID threading, const BenchRegion *region = NULL)
+{
+    BenchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.seed = 12345;
+
+    ctx.world = dWorldCreate();
+    dWorldSetGravity(ctx.world, 0, 0, REAL(-9.8));
+    dWorldSetQuickStepNumIterations(ctx.world, 10);
+    dWorldSetQuickStepTolerance(ctx.world, (dReal)options.tolerance);
+    if (options.coloredSolver) {
+        dWorldSetQuickStepSolverMode(ctx.world, dQuickStepSolverColored);
+    }
+    dWorldSetContactMaxCorrectingVel(ctx.world, REAL(5.0));
+    dWorldSetContactSurfaceLayer(ctx.world, REAL(0.001));
+    dWorldSetStepStatsEnabled(ctx.world, 1);
+    if (threading != NULL) {
+        dWorldSetStepThreadingImplementation(ctx.world, dThreadingImplementationGetFunctions(threading), threading);
+    }
+
+    ctx.topSpace = dSimpleSpaceCreate(0);
+    ctx.activeSpace = dHashSpaceCreate(ctx.topSpace);
+    ctx.staticSpace = dHashSpaceCreate(ctx.topSpace);
+    dHashSpaceSetLevels(ctx.activeSpace, -2, 8);
+    dHashSpaceSetLevels(ctx.staticSpace, -2, 8);
+    dGeomSetCategoryBits((dGeomID)ctx.staticSpace, 2);
+    dGeomSetCollideBits((dGeomID)ctx.staticSpace, 4);
+    dGeomSetCategoryBits((dGeomID)ctx.activeSpace, 4);
+    dGeomSetCollideBits((dGeomID)ctx.activeSpace, 1 | 2);
+    ctx.contactGroup = dJointGroupCreate(0);
+
+    ctx.parallelCollide = options.parallelCollide;
+    ctx.verifyParallel = options.parallelCollide && options.verifyParallel;
+    if (ctx.parallelCollide) {
+        ctx.parallelContacts = (dContactGeom *)malloc(sizeof(dContactGeom) * PARALLEL_CONTACTS);
+        ctx.parallelPairs = (dCollidePair *)malloc(sizeof(dCollidePair) * PARALLEL_PAIRS);
+    }
+
+    double setupStart = benchNow();
+    scene.setup(ctx);
+    double setupTime = benchNow() - setupStart;
+
+    double *stepTimes = (double *)malloc(sizeof(double) * (size_t)options.steps);
+    double *collideTimes = (double *)malloc(sizeof(double) * (size_t)options.steps);
+    double *solveTimes = (double *)malloc(sizeof(double) * (size_t)options.steps);
+    double contactSum = 0, lcpSum = 0, rowSum = 0, islandSum = 0;
+    double iterationSum = 0, islandIterationSum = 0, islandStepSum = 0;
+    int iterationMax = 0, colorMax = 0;
+    dWorldIslandStepStats *islandStats = (dWorldIslandStepStats *)malloc(sizeof(dWorldIslandStepStats) * BENCH_ISLAND_STATS);
+
+    for (int step = -options.warmup; step < options.steps; step++) {
+        double start = benchNow();
+        if (step == 0) {
+            if (options.snapshotPrefix != NULL) {
+                saveSnapshot(ctx, scene, options, region);
+                start = benchNow();
+            }
+            ctx.tunnelled = 0;
+            ctx.churnTime = 0;
+            if (region != NULL) {
+                dThreadingSchedulerUsage usage;
+                dThreadingSchedulerGetUsage(region->scheduler, threading, &usage, 1);
+            }
+        }
+        walkAvatars(ctx);
+        fireProjectiles(ctx);
+        churnPrims(ctx);
+        collide(ctx);
+        double collided = benchNow();
+        dWorldQuickStep(ctx.world, STEP_SIZE);
+        dJointGroupEmpty(ctx.contactGroup);
+        double end = benchNow();
+
+        if (step >= 0) {
+            stepTimes[step] = (end - start) * 1000.0;
+            collideTimes[step] = (collided - start) * 1000.0;
+            solveTimes[step] = (end - collided) * 1000.0;
+
+            dWorldStepStats stats;
+            dWorldGetStepStats(ctx.world, &stats);
+            contactSum += ctx.contactsThisStep;
+            lcpSum += stats.lcp_time * 1000.0;
+            rowSum += stats.rows;
+            islandSum += stats.islands;
+            iterationSum += stats.lcp_iterations;
+
+            int islandCount = dWorldGetIslandStepStats(ctx.world, islandStats, BENCH_ISLAND_STATS);
+            for (int i = 0; i < islandCount; i++) {
+                if (islandStats[i].rows == 0) continue;
+                islandIterationSum += islandStats[i].lcp_iterations;
+                islandStepSum += 1;
+                if (islandStats[i].lcp_iterations > iterationMax) iterationMax = islandStats[i].lcp_iterations;
+                if (islandStats[i].colors > colorMax) colorMax = islandStats[i].colors;
+            }
+        }
+    }
+
+    FILE *out = options.output;
+#ifndef WIN32
+    flockfile(out);
+#endif
+    fprintf(out, "{\"scene\":\"%s\",\"steps\":%d,\"threads\":%d,\"parallel_collide\":%d,"
+        "\"bodies\":%d,\"geoms\":%d,\"terrain_bytes\":%lu,\"setup_ms\":%.1f,",
+        scene.name, options.steps, options.threads, options.parallelCollide ? 1 : 0,
+        ctx.bodyCount,
+        dSpaceGetNumGeoms(ctx.activeSpace) + dSpaceGetNumGeoms(ctx.staticSpace) + 1,
+        ctx.terrainData != NULL ? (unsigned long)dGeomOSTerrainDataGetMemoryUsage(ctx.terrainData) : 0UL,
+        setupTime * 1000.0);
+    printDistribution(out, "step_ms", computeDistribution(stepTimes, options.steps));
+    fputc(',', out);
+    printDistribution(out, "collide_ms", computeDistribution(collideTimes, options.steps));
+    fputc(',', out);
+    printDistribution(out, "solve_ms", computeDistribution(solveTimes, options.steps));
+    fprintf(out, ",\"contacts_mean\":%.1f,\"islands_mean\":%.1f,\"rows_mean\":%.1f,\"lcp_ms_mean\":%.4f",
+        contactSum / options.steps, islandSum / options.steps, rowSum / options.steps, lcpSum / options.steps);
+    fprintf(out, ",\"lcp_iterations_mean\":%.1f,\"island_iterations_mean\":%.2f,\"island_iterations_max\":%d",
+        iterationSum / options.steps, islandStepSum != 0 ? islandIterationSum / islandStepSum : 0.0, iterationMax);
+    if (options.coloredSolver) {
+        fprintf(out, ",\"colors_max\":%d", colorMax);
+    }
+    dWorldSleepCounts sleep;
+    dWorldGetSleepCounts(ctx.world, &sleep);
+    fprintf(out, ",\"awake_bodies\":%d,\"sleeping_bodies\":%d", sleep.awake_bodies, sleep.sleeping_bodies);
+    if (ctx.projectileCount != 0) {
+        fprintf(out, ",\"tunnelled\":%d", ctx.tunnelled);
+    }
+    if (ctx.verifyParallel) {
+        fprintf(out, ",\"mismatches\":%d", ctx.mismatches);
+    }
+    if (ctx.churnCount != 0) {
+        fprintf(out, ",\"churn_ms_mean\":%.4f", ctx.churnTime * 1000.0 / options.steps);
+    }
+    dMemoryPoolStats pools;
+    dMemoryPoolGetStats(-1, &pools);
+    fprintf(out, ",\"pools\":%d,\"pool_reserved_kb\":%lu,\"pool_used_kb\":%lu",
+        dMemoryPoolIsEnabled(), (unsigned long)(pools.reserved_bytes >> 10), (unsigned long)(pools.used_bytes >> 10));
+    if (region != NULL) {
+        dThreadingSchedulerUsage usage;
+        dThreadingSchedulerGetUsage(region->scheduler, threading, &usage, 0);
+        fprintf(out, ",\"region\":%d,\"regions\":%d,\"scheduler_cpu_ms\":%.1f,\"scheduler_calls\":%lu",
+            region->index, options.regions, (double)usage.cpu_nsec * 1e-6, (unsigned long)usage.call_count);
+    }
+    fputs("}\n", out);
+    fflush(out);
+#ifndef WIN32
+    funlockfile(out);
+#endif
+
+    free(solveTimes);
+    free(islandStats);
+    free(collideTimes);
+    free(stepTimes);
+
+    dJointGroupDestroy(ctx.contactGroup);
+    dSpaceDestroy(ctx.topSpace);
+    dWorldDestroy(ctx.world);
+
+    if (ctx.terrainData != NULL) dGeomOSTerrainDataDestroy(ctx.terrainData);
+    if (ctx.meshData != NULL) dGeomTriMeshDataDestroy(ctx.meshData);
+    for (int i = 0; i < ctx.sculptCount; i++) {
+        dGeomTriMeshDataDestroy(ctx.sculptData[i]);
+        free(ctx.sculptVertices[i]);
+        free(ctx.sculptIndices[i]);
+    }
+    free(ctx.sculptData);
+    free(ctx.sculptVertices);
+    free(ctx.sculptIndices);
+    free(ctx.meshVertices);
+    free(ctx.meshIndices);
+    free(ctx.hullPlanes);
+    free(ctx.hullPoints);
+    free(ctx.hullPolygons);
+    free(ctx.avatars);
+    free(ctx.projectiles);
+    free(ctx.churnBodies);
+    free(ctx.churnJoints);
+    free(ctx.parallelContacts);
+    free(ctx.parallelPairs);
+
+    return ctx.mismatches;
+}
+
+#ifndef WIN32
+
+static void *regionThread(void *param)
+{
+    BenchRegion *region = (BenchRegion *)param;
+    dAllocateODEDataForThread(dAllocateMaskAll);
+    region->mismatches = runScene(*region->scene, *region->options, region->threading, region);
+    return NULL;
+}
+
+// steps options.regions copies of the scene from as many threads, all
+// worlds sharing the scheduler
+static int runRegions(const BenchScene &scene, const BenchOptions &options,
+    dThreadingSchedulerID scheduler)
+{
+    BenchRegion *regions = (BenchRegion *)calloc((size_t)options.regions, sizeof(BenchRegion));
+    pthread_t *threads = (pthread_t *)calloc((size_t)options.regions, sizeof(pthread_t));
+
+    for (int i = 0; i < options.regions; i++) {
+        regions[i].scene = &scene;
+        regions[i].options = &options;
+        regions[i].scheduler = scheduler;
+        regions[i].threading = dThreadingSchedulerAllocateImplementation(scheduler);
+        regions[i].index = i;
+        pthread_create(&threads[i], NULL, &regionThread, &regions[i]);
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < options.regions; i++) {
+        pthread_join(threads[i], NULL);
+        mismatches += regions[i].mismatches;
+        dThreadingFreeImplementation(regions[i].threading);
+    }
+
+    free(threads);
+    free(regions);
+    return mismatches;
+}
+
+#endif
+
+static bool isSceneSelected(const BenchOptions &options, const char *name)
+{
+    if (options.selectedCount == 0) {
+        return true;
+    }
+    for (int i = 0; i < options.selectedCount; i++) {
+        if (strcmp(options.selected[i], name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: ode_bench [-l] [-s scene]... [-n steps] [-w warmup] [-t threads] [-r regions] [-p] [-v] [-m] [-e tolerance] [-g] [-d prefix] [-o file]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    memset(&options, 0, sizeof(options));
+    options.steps = 300;
+    options.warmup = 30;
+    options.threads = 1;
+    options.regions = 1;
+    options.output = stdout;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "-l") == 0) {
+            for (int s = 0; s < BENCH_SCENE_COUNT; s++) {
+                printf("%-22s %s\n", benchScenes[s].name, benchScenes[s].description);
+            }
+            return 0;
+        }
+        else if (strcmp(arg, "-p") == 0) {
+            options.parallelCollide = true;
+        }
+        else if (strcmp(arg, "-v") == 0) {
+            options.verifyParallel = true;
+        }
+        else if (strcmp(arg, "-m") == 0) {
+            options.mallocObjects = true;
+        }
+        else if (strcmp(arg, "-s") == 0 && hasValue) {
+            if (options.selectedCount == BENCH_SCENE_COUNT) usage();
+            options.selected[options.selectedCount++] = argv[++i];
+        }
+        else if (strcmp(arg, "-n") == 0 && hasValue) {
+            options.steps = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-w") == 0 && hasValue) {
+            options.warmup = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-t") == 0 && hasValue) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-r") == 0 && hasValue) {
+            options.regions = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-g") == 0) {
+            options.coloredSolver = true;
+        }
+        else if (strcmp(arg, "-e") == 0 && hasValue) {
+            options.tolerance = atof(argv[++i]);
+        }
+        else if (strcmp(arg, "-d") == 0 && hasValue) {
+            options.snapshotPrefix = argv[++i];
+        }
+        else if (strcmp(arg, "-o") == 0 && hasValue) {
+            options.output = fopen(argv[++i], "w");
+            if (options.output == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else {
+            usage();
+        }
+    }
+    if (options.steps <= 0 || options.warmup < 0 || options.threads <= 0 || options.regions <= 0 || options.tolerance < 0) {
+        usage();
+    }
+#ifdef WIN32
+    if (options.regions > 1) {
+        usage();
+    }
+#endif
+
+    if (options.mallocObjects) {
+        dMemoryPoolSetEnabled(0);
+    }
+    dInitODE2(0);
+    dAllocateODEDataForThread(dAllocateMaskAll);
+
+    dThreadingImplementationID threading = NULL;
+    dThreadingThreadPoolID pool = NULL;
+    dThreadingSchedulerID scheduler = NULL;
+    if (options.regions > 1) {
+        scheduler = dThreadingAllocateScheduler(options.threads, 0, dAllocateMaskAll, NULL, 0);
+        if (scheduler == NULL) {
+            fprintf(stderr, "ode_bench: no scheduler available for -r\n");
+            return 1;
+        }
+    }
+    else if (options.threads > 1) {
+        threading = dThreadingAllocateMultiThreadedImplementation();
+        pool = threading != NULL ? dThreadingAllocateThreadPool(options.threads, 0, dAllocateMaskAll, NULL) : NULL;
+        if (pool != NULL) {
+            dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        }
+        else {
+            fprintf(stderr, "ode_bench: no thread pool available, stepping single threaded\n");
+            if (threading != NULL) dThreadingFreeImplementation(threading);
+            threading = NULL;
+            options.threads = 1;
+        }
+    }
+
+    int mismatches = 0;
+    for (int s = 0; s < BENCH_SCENE_COUNT; s++) {
+        if (!isSceneSelected(options, benchScenes[s].name)) {
+            continue;
+        }
+#ifndef WIN32
+        if (scheduler != NULL) {
+            mismatches += runRegions(benchScenes[s], options, scheduler);
+            continue;
+        }
+#endif
+        mismatches += runScene(benchScenes[s], options, threading);
+    }
+
+    if (scheduler != NULL) {
+        dThreadingFreeScheduler(scheduler);
+    }
+
+    if (pool != NULL) {
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+        dThreadingFreeImplementation(threading);
+    }
+
+    if (options.output != stdout) {
+        fclose(options.output);
+    }
+
+    dCloseODE();
+    return mismatches != 0 ? 1 : 0;
+}
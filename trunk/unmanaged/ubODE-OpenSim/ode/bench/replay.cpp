@@ -0,0 +1,477 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+replays a world snapshot saved by dWorldSnapshotSave, e.g. by ode_bench -d,
+and writes the timings of every step as one JSON object per line, followed
+by a summary with their distribution. the contacts are made again every
+step with the surface and contact count saved in the snapshot; geoms of
+the same body, or with the same data id, do not collide. the top space is
+collided with itself, and so is every space in it that holds geoms with a
+body.
+
+usage: ode_replay [-n steps] [-t threads] [-c] [-o file] snapshot
+
+  -n steps    steps to replay (default 300)
+  -t threads  step with a thread pool of this many threads, which is not
+              deterministic. without it the world is stepped on one thread
+              (see dWorldSetDeterministic)
+  -c          load the snapshot twice, step both worlds in lockstep and
+              compare the bodies of the geoms bit for bit after every step.
+              the exit status is 1 if they diverge
+  -o file     write the results to file instead of stdout
+
+*/
+
+#include <ode/ode.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+
+#define REPLAY_MAX_CONTACTS 64
+
+
+static double replayNow()
+{
+#ifdef WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+//****************************************************************************
+// loading
+
+struct Replay
+{
+    dWorldID world;
+    dSpaceID space;
+    dJointGroupID contactGroup;
+    dSnapshotReplayInfo info;
+    unsigned long seed;
+
+    // spaces collided with themselves every step
+    dSpaceID spaces[64];
+    int spaceCount;
+
+    // data objects rebuilt from the snapshot
+    void *data[256];
+    int dataKinds[256];
+    int dataCount;
+    bool dataLost;
+
+    int contactsThisStep;
+};
+
+// the data ids only need to tell the geoms apart
+static void *loadSnapshotRef(void *context, int kind, duint64 id)
+{
+    (void)context;
+    return kind == dSnapshotRefGeomData ? (void *)(size_t)id : NULL;
+}
+
+static void snapshotDataLoaded(void *context, int kind, void *data)
+{
+    Replay &replay = *(Replay *)context;
+    if (replay.dataCount == 256) {
+        replay.dataLost = true;
+        return;
+    }
+    replay.data[replay.dataCount] = data;
+    replay.dataKinds[replay.dataCount] = kind;
+    replay.dataCount++;
+}
+
+static bool hasBodyGeoms(dSpaceID space)
+{
+    int count = dSpaceGetNumGeoms(space);
+    for (int i = 0; i < count; i++) {
+        dGeomID g = dSpaceGetGeom(space, i);
+        if (!dGeomIsSpace(g) && dGeomGetBody(g) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool loadReplay(Replay &replay, const void *buffer, size_t size)
+{
+    memset(&replay, 0, sizeof(replay));
+
+    dSnapshotCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.context = &replay;
+    callbacks.load_ref = &loadSnapshotRef;
+    callbacks.data_loaded = &snapshotDataLoaded;
+    if (!dWorldSnapshotLoad(buffer, size, &callbacks, &replay.world, &replay.space, &replay.info)) {
+        return false;
+    }
+    replay.seed = replay.info.rand_seed;
+    replay.contactGroup = dJointGroupCreate(0);
+
+    if (replay.space != NULL) {
+        replay.spaces[replay.spaceCount++] = replay.space;
+        int count = dSpaceGetNumGeoms(replay.space);
+        for (int i = 0; i < count && replay.spaceCount < 64; i++) {
+            dGeomID g = dSpaceGetGeom(replay.space, i);
+            if (dGeomIsSpace(g) && hasBodyGeoms((dSpaceID)g)) {
+                replay.spaces[replay.spaceCount++] = (dSpaceID)g;
+            }
+        }
+    }
+
+    if (replay.info.max_contacts <= 0 || replay.info.max_contacts > REPLAY_MAX_CONTACTS) {
+        replay.info.max_contacts = REPLAY_MAX_CONTACTS;
+    }
+    return !replay.dataLost;
+}
+
+static void destroyReplay(Replay &replay)
+{
+    if (replay.world == NULL) {
+        return;
+    }
+    dJointGroupDestroy(replay.contactGroup);
+    if (replay.space != NULL) {
+        dSpaceDestroy(replay.space);
+    }
+    dWorldDestroy(replay.world);
+    for (int i = 0; i < replay.dataCount; i++) {
+        dSnapshotDataDestroy(replay.dataKinds[i], replay.data[i]);
+    }
+}
+
+//****************************************************************************
+// stepping
+
+static void nearCallback(void *data, dGeomID o1, dGeomID o2)
+{
+    Replay &replay = *(Replay *)data;
+
+    if (dGeomIsSpace(o1) || dGeomIsSpace(o2)) {
+        dSpaceCollide2(o1, o2, data, &nearCallback);
+        return;
+    }
+
+    dBodyID b1 = dGeomGetBody(o1);
+    dBodyID b2 = dGeomGetBody(o2);
+    if (b1 == b2) {
+        return;
+    }
+    void *data1 = dGeomGetData(o1);
+    if (data1 != NULL && data1 == dGeomGetData(o2)) {
+        return;
+    }
+
+    dContact contacts[REPLAY_MAX_CONTACTS];
+    int count = dCollide(o1, o2, replay.info.max_contacts, &contacts[0].geom, sizeof(dContact));
+    for (int i = 0; i < count; i++) {
+        contacts[i].surface = replay.info.surface;
+        dJointID joint = dJointCreateContact(replay.world, replay.contactGroup, contacts + i);
+        dJointAttach(joint, b1, b2);
+    }
+    replay.contactsThisStep += count;
+}
+
+// returns the collision time in seconds. the random generator is shared,
+// so every replay keeps its own seed
+static double stepReplay(Replay &replay)
+{
+    double start = replayNow();
+    replay.contactsThisStep = 0;
+    for (int i = 0; i < replay.spaceCount; i++) {
+        dSpaceCollide(replay.spaces[i], &replay, &nearCallback);
+    }
+    double collided = replayNow();
+
+    dRandSetSeed(replay.seed);
+    if (replay.info.quickstep) {
+        dWorldQuickStep(replay.world, replay.info.step_size);
+    }
+    else {
+        dWorldStep(replay.world, replay.info.step_size);
+    }
+    replay.seed = dRandGetSeed();
+    dJointGroupEmpty(replay.contactGroup);
+    return collided - start;
+}
+
+static bool sameBody(dBodyID x, dBodyID y)
+{
+    return memcmp(dBodyGetPosition(x), dBodyGetPosition(y), sizeof(dReal) * 3) == 0
+        && memcmp(dBodyGetQuaternion(x), dBodyGetQuaternion(y), sizeof(dReal) * 4) == 0
+        && memcmp(dBodyGetLinearVel(x), dBodyGetLinearVel(y), sizeof(dReal) * 3) == 0
+        && memcmp(dBodyGetAngularVel(x), dBodyGetAngularVel(y), sizeof(dReal) * 3) == 0
+        && dBodyIsEnabled(x) == dBodyIsEnabled(y);
+}
+
+// compares the bodies of the geoms, both spaces were loaded from the same
+// snapshot so they hold the geoms in the same order
+static bool sameBodies(dSpaceID a, dSpaceID b)
+{
+    int count = dSpaceGetNumGeoms(a);
+    if (count != dSpaceGetNumGeoms(b)) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        dGeomID x = dSpaceGetGeom(a, i);
+        dGeomID y = dSpaceGetGeom(b, i);
+        if (dGeomIsSpace(x) != dGeomIsSpace(y)) {
+            return false;
+        }
+        if (dGeomIsSpace(x)) {
+            if (!sameBodies((dSpaceID)x, (dSpaceID)y)) return false;
+            continue;
+        }
+        dBodyID bx = dGeomGetBody(x), by = dGeomGetBody(y);
+        if ((bx == NULL) != (by == NULL) || (bx != NULL && !sameBody(bx, by))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//****************************************************************************
+// reporting
+
+struct Distribution
+{
+    double mean, p50, p90, p99, max;
+};
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static Distribution computeDistribution(double *samples, int count)
+{
+    Distribution d;
+    qsort(samples, (size_t)count, sizeof(double), &compareDoubles);
+
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    d.mean = sum / count;
+    d.p50 = samples[(count - 1) * 50 / 100];
+    d.p90 = samples[(count - 1) * 90 / 100];
+    d.p99 = samples[(count - 1) * 99 / 100];
+    d.max = samples[count - 1];
+    return d;
+}
+
+static void printDistribution(FILE *out, const char *name, const Distribution &d)
+{
+    fprintf(out, "\"%s\":{\"mean\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+        name, d.mean, d.p50, d.p90, d.p99, d.max);
+}
+
+static void *readFile(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    void *buffer = length > 0 ? malloc((size_t)length) : NULL;
+    if (buffer != NULL && fread(buffer, 1, (size_t)length, file) != (size_t)length) {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+    *size = (size_t)length;
+    return buffer;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: ode_replay [-n steps] [-t threads] [-c] [-o file] snapshot\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int steps = 300;
+    int threads = 1;
+    bool compare = false;
+    const char *path = NULL;
+    FILE *out = stdout;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "-c") == 0) {
+            compare = true;
+        }
+        else if (strcmp(arg, "-n") == 0 && hasValue) {
+            steps = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-t") == 0 && hasValue) {
+            threads = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-o") == 0 && hasValue) {
+            out = fopen(argv[++i], "w");
+            if (out == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else if (arg[0] != '-' && path == NULL) {
+            path = arg;
+        }
+        else {
+            usage();
+        }
+    }
+    if (path == NULL || steps <= 0 || threads <= 0) {
+        usage();
+    }
+
+    size_t size = 0;
+    void *buffer = readFile(path, &size);
+    if (buffer == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    dInitODE2(0);
+    dAllocateODEDataForThread(dAllocateMaskAll);
+
+    Replay replays[2];
+    const int replayCount = compare ? 2 : 1;
+    double loadStart = replayNow();
+    bool loaded = loadReplay(replays[0], buffer, size);
+    double loadTime = replayNow() - loadStart;
+    if (loaded && compare) {
+        loaded = loadReplay(replays[1], buffer, size);
+    }
+    free(buffer);
+    if (!loaded) {
+        fprintf(stderr, "ode_replay: %s is not a snapshot of this build\n", path);
+        for (int i = 0; i < replayCount; i++) destroyReplay(replays[i]);
+        dCloseODE();
+        return 1;
+    }
+
+    dThreadingImplementationID threading = NULL;
+    dThreadingThreadPoolID pool = NULL;
+    if (threads > 1) {
+        threading = dThreadingAllocateMultiThreadedImplementation();
+        pool = threading != NULL ? dThreadingAllocateThreadPool(threads, 0, dAllocateMaskAll, NULL) : NULL;
+        if (pool != NULL) {
+            dThreadingThreadPoolServeMultiThreadedImplementation(pool, threading);
+        }
+        else {
+            fprintf(stderr, "ode_replay: no thread pool available, stepping single threaded\n");
+            if (threading != NULL) dThreadingFreeImplementation(threading);
+            threading = NULL;
+            threads = 1;
+        }
+    }
+    for (int i = 0; i < replayCount; i++) {
+        dWorldSetDeterministic(replays[i].world, threading == NULL);
+        if (threading != NULL) {
+            dWorldSetStepThreadingImplementation(replays[i].world, dThreadingImplementationGetFunctions(threading), threading);
+        }
+    }
+
+    double *stepTimes = (double *)malloc(sizeof(double) * (size_t)steps);
+    double *collideTimes = (double *)malloc(sizeof(double) * (size_t)steps);
+    double *solveTimes = (double *)malloc(sizeof(double) * (size_t)steps);
+    double contactSum = 0;
+    int divergedAt = -1;
+
+    for (int step = 0; step < steps; step++) {
+        double start = replayNow();
+        double collideTime = stepReplay(replays[0]);
+        double end = replayNow();
+
+        stepTimes[step] = (end - start) * 1000.0;
+        collideTimes[step] = collideTime * 1000.0;
+        solveTimes[step] = (end - start - collideTime) * 1000.0;
+        contactSum += replays[0].contactsThisStep;
+        fprintf(out, "{\"step\":%d,\"step_ms\":%.4f,\"collide_ms\":%.4f,\"solve_ms\":%.4f,\"contacts\":%d}\n",
+            step, stepTimes[step], collideTimes[step], solveTimes[step], replays[0].contactsThisStep);
+
+        if (compare && divergedAt < 0) {
+            stepReplay(replays[1]);
+            if (replays[0].space != NULL && !sameBodies(replays[0].space, replays[1].space)) {
+                divergedAt = step;
+            }
+        }
+    }
+
+    dWorldSleepCounts sleep;
+    dWorldGetSleepCounts(replays[0].world, &sleep);
+    fprintf(out, "{\"snapshot\":\"%s\",\"steps\":%d,\"threads\":%d,\"deterministic\":%d,"
+        "\"awake_bodies\":%d,\"sleeping_bodies\":%d,\"load_ms\":%.1f,",
+        path, steps, threads, dWorldGetDeterministic(replays[0].world),
+        sleep.awake_bodies, sleep.sleeping_bodies, loadTime * 1000.0);
+    printDistribution(out, "step_ms", computeDistribution(stepTimes, steps));
+    fputc(',', out);
+    printDistribution(out, "collide_ms", computeDistribution(collideTimes, steps));
+    fputc(',', out);
+    printDistribution(out, "solve_ms", computeDistribution(solveTimes, steps));
+    fprintf(out, ",\"contacts_mean\":%.1f", contactSum / steps);
+    if (compare) {
+        fprintf(out, ",\"diverged_at\":%d", divergedAt);
+    }
+    fputs("}\n", out);
+
+    free(solveTimes);
+    free(collideTimes);
+    free(stepTimes);
+
+    for (int i = 0; i < replayCount; i++) {
+        destroyReplay(replays[i]);
+    }
+
+    if (pool != NULL) {
+        dThreadingImplementationShutdownProcessing(threading);
+        dThreadingFreeThreadPool(pool);
+        dThreadingFreeImplementation(threading);
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    dCloseODE();
+    return divergedAt >= 0 ? 1 : 0;
+}
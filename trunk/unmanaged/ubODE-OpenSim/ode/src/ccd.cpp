@@ -0,0 +1,151 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+a body with a ccd radius has its step motion swept at the end of
+dWorldStep/dWorldQuickStep. a ray is cast from the start position of the
+body centre to its end position, extended by the radius, against the top
+space of the body's geoms, reusing the ray colliders (OPCODE for trimeshes,
+the terrain walker for OSTerrain). on a hit the body is moved back so its
+centre stays the radius short of the hit point and the velocity into the
+surface is removed. the contact itself is left to the next collide pass,
+which now finds the body touching the surface instead of past it.
+
+the sweep is of the centre only, so the radius should be no larger than
+the body's smallest half extent; a thin wall narrower than the body is
+still caught because the centre has to cross it.
+
+*/
+
+#include <ode/common.h>
+#include <ode/collision.h>
+#include "config.h"
+#include "odemath.h"
+#include "objects.h"
+#include "collision_kernel.h"
+#include "collision_std.h"
+#include "ccd.h"
+
+
+struct dxCCDSweep {
+    dxBody *body;
+    dxRay *ray;
+    dReal depth;            // closest hit along the ray
+    dVector3 normal;
+};
+
+
+static void ccdNearCallback(void *data, dxGeom *o1, dxGeom *o2)
+{
+    dxCCDSweep *sweep = (dxCCDSweep *)data;
+    dxGeom *g = (o1 == sweep->ray) ? o2 : o1;
+
+    if (IS_SPACE(g)) {
+        dSpaceCollide2(g, sweep->ray, data, &ccdNearCallback);
+        return;
+    }
+    if (g->body == sweep->body)
+        return;
+
+    dContactGeom contact;
+    if (dCollide(sweep->ray, g, 1, &contact, sizeof(dContactGeom)) != 0
+        && contact.depth < sweep->depth) {
+        sweep->depth = contact.depth;
+        dCopyVector3(sweep->normal, contact.normal);
+    }
+}
+
+
+void dxWorldCCDBeginStep(dxWorld *w)
+{
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        if (b->flags & dxBodyCCD)
+            dCopyVector3(b->ccd_pos, b->posr.pos);
+    }
+}
+
+
+void dxWorldCCDEndStep(dxWorld *w)
+{
+    dxRay ray(0, 1);
+    dGeomRaySetClosestHit(&ray, 1);
+    dGeomRaySetBackfaceCull(&ray, 1);
+
+    dxCCDSweep sweep;
+    sweep.ray = &ray;
+
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        if ((b->flags & (dxBodyCCD | dxBodyDisabled)) != dxBodyCCD || !b->geom)
+            continue;
+
+        dVector3 dir;
+        dSubtractVectors3(dir, b->posr.pos, b->ccd_pos);
+        dReal len2 = dCalcVectorLengthSquare3(dir);
+        dReal threshold = b->ccd_threshold > 0 ? b->ccd_threshold : b->ccd_radius;
+        if (len2 <= threshold * threshold)
+            continue;
+
+        // sweep against everything that shares the top space with the body
+        dxSpace *top = b->geom->parent_space;
+        if (!top)
+            continue;
+        while (top->parent_space)
+            top = top->parent_space;
+
+        unsigned long category = 0, collide = 0;
+        for (dxGeom *g = b->geom; g; g = g->body_next) {
+            category |= g->category_bits;
+            collide |= g->collide_bits;
+        }
+        ray.category_bits = category;
+        ray.collide_bits = collide;
+
+        dReal len = dSqrt(len2);
+        dScaleVector3(dir, dRecip(len));
+        dGeomRaySet(&ray, b->ccd_pos[0], b->ccd_pos[1], b->ccd_pos[2],
+            dir[0], dir[1], dir[2]);
+        ray.length = len + b->ccd_radius;
+
+        sweep.body = b;
+        sweep.depth = dInfinity;
+        dSpaceCollide2(top, &ray, &sweep, &ccdNearCallback);
+
+        dReal travel = sweep.depth - b->ccd_radius;
+        if (travel >= len)
+            continue;
+        if (travel < 0)
+            travel = 0;
+
+        dAddScaledVectors3(b->posr.pos, b->ccd_pos, dir, 1, travel);
+        for (dxGeom *g = b->geom; g; g = g->body_next)
+            dGeomMoved(g);
+
+        // face the normal against the motion and drop the velocity into it
+        dReal *n = sweep.normal;
+        if (dCalcVectorDot3(n, dir) > 0)
+            dNegateVector3(n);
+        dReal vn = dCalcVectorDot3(b->lvel, n);
+        if (vn < 0)
+            dAddScaledVectors3(b->lvel, b->lvel, n, 1, -vn);
+    }
+}
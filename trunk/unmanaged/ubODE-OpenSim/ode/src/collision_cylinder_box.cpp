@@ -55,6 +55,7 @@ struct sCylinderBoxData
     int _cldTestSeparatingAxes();
     int _cldClipCylinderToBox();
     void _cldClipBoxToCylinder();
+    void _cldAddDeepestContact();
     int PerformCollisionChecking();
 
     // cylinder parameters
@@ -883,9 +884,15 @@ void sCylinderBoxData::_cldClipBoxToCylinder()
     int iTmpCounter2 = 0;
     dVector4 plPlane;
 
+    // plane of the other circle, deep box faces can go past it
+    dVector3 vOppositeCircleNormal_Rel;
+    dCopyNegatedVector3r4(vOppositeCircleNormal_Rel, vCylinderCircleNormal_Rel);
+    dConstructPlane(plPlane, vOppositeCircleNormal_Rel, m_fCylinderSize);
+    dClipPolyToPlane(avPoints, 4, avTempArray2, iTmpCounter2, plPlane);
+
     // plane of cylinder that contains circle for intersection
     dConstructPlane(plPlane, vCylinderCircleNormal_Rel,REAL(0.0));
-    dClipPolyToPlane(avPoints, 4, avTempArray1, iTmpCounter1, plPlane);
+    dClipPolyToPlane(avTempArray2, iTmpCounter2, avTempArray1, iTmpCounter1, plPlane);
 
 
     // Body of base circle of Cylinder
@@ -982,6 +989,38 @@ void sCylinderBoxData::_cldClipBoxToCylinder()
     }
 }
 
+// single contact at the cylinder point deepest along the best axis
+void sCylinderBoxData::_cldAddDeepestContact()
+{
+    dIASSERT(m_nContacts == 0);
+
+    dReal fdot = dCalcVectorDot3(m_vCylinderAxis, m_vNormal);
+    dVector3 vN;
+    vN[0] = m_vNormal[0] - m_vCylinderAxis[0]*fdot;
+    vN[1] = m_vNormal[1] - m_vCylinderAxis[1]*fdot;
+    vN[2] = m_vNormal[2] - m_vCylinderAxis[2]*fdot;
+
+    dReal fLen = dCalcVectorLength3(vN);
+    dReal fRadial = (fLen > REAL(1e-5)) ? m_fCylinderRadius / fLen : REAL(0.0);
+    dReal fAxial = (fdot > REAL(0.0)) ? m_fCylinderSize*REAL(0.5) : -m_fCylinderSize*REAL(0.5);
+
+    // m_vNormal points from cylinder to box, go back half the depth
+    dReal fBack = m_fBestDepth*REAL(0.5);
+
+    dContactGeom* Contact0 = SAFECONTACT(m_iFlags, m_gContact, 0, m_iSkip);
+    Contact0->pos[0] = m_vCylinderPos[0] + vN[0]*fRadial + m_vCylinderAxis[0]*fAxial - m_vNormal[0]*fBack;
+    Contact0->pos[1] = m_vCylinderPos[1] + vN[1]*fRadial + m_vCylinderAxis[1]*fAxial - m_vNormal[1]*fBack;
+    Contact0->pos[2] = m_vCylinderPos[2] + vN[2]*fRadial + m_vCylinderAxis[2]*fAxial - m_vNormal[2]*fBack;
+    Contact0->depth = m_fBestDepth;
+    dCopyVector3r4(Contact0->normal, m_vNormal);
+    dNegateVector3r4(Contact0->normal);
+    Contact0->g1 = m_gCylinder;
+    Contact0->g2 = m_gBox;
+    Contact0->side1 = -1;
+    Contact0->side2 = -1;
+    m_nContacts = 1;
+}
+
 int sCylinderBoxData::PerformCollisionChecking()
 {
     // initialize collider
@@ -1008,16 +1047,20 @@ int sCylinderBoxData::PerformCollisionChecking()
     if (dFabs(fdot) < REAL(0.9) ) 
     {
         // clip cylinder over box
-        if(!_cldClipCylinderToBox()) 
-        {
-            return 0;
-        }
+        _cldClipCylinderToBox();
     } 
     else 
     {
         _cldClipBoxToCylinder();  
     }
 
+    // on deep penetration the clipped feature can be outside the other shape,
+    // the shapes still overlap
+    if (m_nContacts == 0)
+    {
+        _cldAddDeepestContact();
+    }
+
     return m_nContacts;
 }
 
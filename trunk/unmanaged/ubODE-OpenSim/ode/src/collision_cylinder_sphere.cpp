@@ -213,9 +213,18 @@ int dCollideCylinderSphere(dxGeom* Cylinder, dxGeom* Sphere,
                 contact->pos[0] = C[0] + SpherePos[0];
                 contact->pos[1] = C[1] + SpherePos[1];
                 contact->pos[2] = C[2] + SpherePos[2];
-                contact->normal[0] = C[0] / t;
-                contact->normal[1] = C[1] / t;
-                contact->normal[2] = C[2] / t;
+                if(t > toleranz)
+                {
+                    contact->normal[0] = C[0] / t;
+                    contact->normal[1] = C[1] / t;
+                    contact->normal[2] = C[2] / t;
+                }
+                else
+                {
+                    // sphere center on the axis, any radial direction will do
+                    dVector3 q;
+                    dPlaneSpace(vDir1, contact->normal, q);
+                }
                 contact->g1 = Cylinder;
                 contact->g2 = Sphere;
                 contact->side1 = -1;
@@ -730,10 +730,16 @@ void sCylinderTrimeshColliderData::_cldClipCylinderToTriangle(
     int iTmpCounter2 = 0;
     dVector4 plPlane;
 
+    // plane of the other circle, deep triangles can go past it
+    dVector3 vOppositeCircleNormal_Rel;
+    dCopyNegatedVector3r4(vOppositeCircleNormal_Rel, vCylinderCircleNormal_Rel);
+    dConstructPlane(plPlane, vOppositeCircleNormal_Rel, m_fCylinderSize);
+    dClipPolyToPlane(avPoints, 3, avTempArray2, iTmpCounter2, plPlane);
+
     // plane of cylinder that contains circle for intersection
     //plPlane = Plane4f( vCylinderCircleNormal_Rel, 0.0f );
     dConstructPlane(plPlane, vCylinderCircleNormal_Rel,REAL(0.0));
-    dClipPolyToPlane(avPoints, 3, avTempArray1, iTmpCounter1, plPlane);
+    dClipPolyToPlane(avTempArray2, iTmpCounter2, avTempArray1, iTmpCounter1, plPlane);
 
     // Body of base circle of Cylinder
     int nCircleSegment = 0;
@@ -69,7 +69,7 @@ static inline dxPosR* dAllocPosr()
     if (!retPosR)
 #endif
     {
-        retPosR = (dxPosR*) dAlloc (sizeof(dxPosR));
+        retPosR = (dxPosR*) dSlabAlloc (sizeof(dxPosR));
     }
 
     return retPosR;
@@ -81,7 +81,7 @@ static inline void dFreePosr(dxPosR *oldPosR)
     if (!AtomicCompareExchangePointer(&s_cachedPosR, NULL, (atomicptr)oldPosR))
 #endif
     {
-        dFree(oldPosR, sizeof(dxPosR));
+        dSlabFree(oldPosR, sizeof(dxPosR));
     }
 }
 
@@ -94,7 +94,7 @@ static inline void dFreePosr(dxPosR *oldPosR)
 
     if (existingPosR)
     {
-        dFree(existingPosR, sizeof(dxPosR));
+        dSlabFree(existingPosR, sizeof(dxPosR));
 
         s_cachedPosR = 0;
     }
@@ -194,7 +194,7 @@ static void setAllColliders (int i, dColliderFn *fn)
     setCollider (dRayClass,dBoxClass,&dCollideRayBox);
     setCollider (dRayClass,dCapsuleClass,&dCollideRayCapsule);
     setCollider (dRayClass,dPlaneClass,&dCollideRayPlane);
-//    setCollider (dRayClass,dCylinderClass,&dCollideRayCylinder);
+    setCollider (dRayClass,dCylinderClass,&dCollideRayCylinder);
 
     setCollider (dTriMeshClass,dSphereClass,&dCollideSTL);
     setCollider (dTriMeshClass,dBoxClass,&dCollideBTL);
@@ -202,57 +202,25 @@ static void setAllColliders (int i, dColliderFn *fn)
     setCollider (dTriMeshClass,dTriMeshClass,&dCollideTTL);
     setCollider (dTriMeshClass,dCapsuleClass,&dCollideCCTL);
     setCollider (dTriMeshClass,dPlaneClass,&dCollideTrimeshPlane);
-//    setCollider (dCylinderClass,dTriMeshClass,&dCollideCylinderTrimesh);
-/*
-#ifdef dLIBCCD_BOX_CYL
-    setCollider (dBoxClass,dCylinderClass,&dCollideBoxCylinderCCD);
-#else
+    setCollider (dCylinderClass,dTriMeshClass,&dCollideCylinderTrimesh);
+
     setCollider (dCylinderClass,dBoxClass,&dCollideCylinderBox);
-#endif
     setCollider (dCylinderClass,dSphereClass,&dCollideCylinderSphere);
     setCollider (dCylinderClass,dPlaneClass,&dCollideCylinderPlane);
-
-#ifdef dLIBCCD_CYL_CYL
-    setCollider (dCylinderClass, dCylinderClass, &dCollideCylinderCylinder);
-#endif
-#ifdef dLIBCCD_CAP_CYL
-    setCollider (dCapsuleClass, dCylinderClass, &dCollideCapsuleCylinder);
-#endif
+    setCollider (dCylinderClass,dCylinderClass,&dCollideCylinderCylinder);
+    setCollider (dCylinderClass,dCapsuleClass,&dCollideCylinderCapsule);
 
     //--> Convex Collision
-
-#ifdef dLIBCCD_CONVEX_BOX
-    setCollider (dConvexClass, dBoxClass, &dCollideConvexBoxCCD);
-#else
     setCollider (dConvexClass,dBoxClass,&dCollideConvexBox);
-#endif
-
-#ifdef dLIBCCD_CONVEX_CAP
-    setCollider (dConvexClass,dCapsuleClass,&dCollideConvexCapsuleCCD);
-#else
     setCollider (dConvexClass,dCapsuleClass,&dCollideConvexCapsule);
-#endif
-
-#ifdef dLIBCCD_CONVEX_CYL
-    setCollider (dConvexClass,dCylinderClass,&dCollideConvexCylinderCCD);
-#endif
-
-#ifdef dLIBCCD_CONVEX_SPHERE
-    setCollider (dConvexClass,dSphereClass,&dCollideConvexSphereCCD);
-#else
+    setCollider (dConvexClass,dCylinderClass,&dCollideConvexCylinder);
     setCollider (dSphereClass,dConvexClass,&dCollideSphereConvex);
-#endif
-
-#ifdef dLIBCCD_CONVEX_CONVEX
-    setCollider (dConvexClass,dConvexClass,&dCollideConvexConvexCCD);
-#else
     setCollider (dConvexClass,dConvexClass,&dCollideConvexConvex);
-#endif
-
-//    setCollider (dConvexClass,dPlaneClass,&dCollideConvexPlane);
-//    setCollider (dRayClass,dConvexClass,&dCollideRayConvex);
+    setCollider (dConvexClass,dPlaneClass,&dCollideConvexPlane);
+    setCollider (dRayClass,dConvexClass,&dCollideRayConvex);
+    setCollider (dConvexClass,dTriMeshClass,&dCollideConvexTrimesh);
     //<-- Convex Collision
-*/
+
     //--> dHeightfield Collision
     setCollider (dHeightfieldClass,dRayClass,&dCollideHeightfield);
     setCollider (dHeightfieldClass,dSphereClass,&dCollideHeightfield);
@@ -270,8 +238,8 @@ static void setAllColliders (int i, dColliderFn *fn)
     setCollider (dOSTerrainClass,dSphereClass,&dCollideOSTerrain);
     setCollider (dOSTerrainClass,dBoxClass,&dCollideOSTerrain);
     setCollider (dOSTerrainClass,dCapsuleClass,&dCollideOSTerrain);
-//    setCollider (dOSTerrainClass,dCylinderClass,&dCollideOSTerrain);
-//    setCollider (dOSTerrainClass,dConvexClass,&dCollideOSTerrain);
+    setCollider (dOSTerrainClass,dCylinderClass,&dCollideOSTerrain);
+    setCollider (dOSTerrainClass,dConvexClass,&dCollideOSTerrain);
 
     setCollider (dOSTerrainClass,dTriMeshClass,&dCollideOSTerrain);
 
@@ -98,7 +98,7 @@ enum dxContactMergeOptions {
 // the pos and R of the body (if body nonzero).
 // a dGeomID is a pointer to this object.
 
-struct dxGeom : public dBase
+struct dxGeom : public dPooledBase
 {
     int type;		// geom type number, set by subclass constructor
     int gflags;		// flags used by geom and space
@@ -0,0 +1,389 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+multithreaded collision pass
+
+the candidate pairs of a space are gathered on the calling thread (that is
+also where the user filter callback runs), then the world threads claim
+chunks of pairs and run dCollide into their own contact buffers. pairs
+that touch colliders with shared scratch data (heightfields, trimeshes
+with temporal coherence, and trimeshes and terrains when ODE is built
+without TLS) all go to a single worker so they never run concurrently.
+finally the buffers are merged in pair order into the caller arrays.
+
+*/
+
+#include <ode/common.h>
+#include <ode/collision.h>
+#include "config.h"
+#include "odemath.h"
+#include "collision_kernel.h"
+#include "collision_parallel.h"
+#include "collision_trimesh_internal.h"
+#include "threadingutils.h"
+
+
+dxParallelCollideContext::~dxParallelCollideContext()
+{
+    for (int i = 0; i < m_workers.size(); i++) {
+        delete m_workers[i];
+    }
+}
+
+
+bool dxParallelCollideContext::IsGeomCollisionReentrant(const dxGeom *g)
+{
+    switch (g->type) {
+#if dTLS_ENABLED
+        case dTriMeshClass: {       // OPCODE collider caches are per thread, TC caches are per geom
+            const dxTriMesh *mesh = static_cast<const dxTriMesh *>(g);
+            return !(mesh->doSphereTC || mesh->doBoxTC || mesh->doCapsuleTC
+                || mesh->doTriMeshTC || mesh->doTerrainTC);
+        }
+
+        case dOSTerrainClass:       // scratch buffers are per thread
+            return true;
+#else
+        case dTriMeshClass:         // global OPCODE collider caches
+        case dOSTerrainClass:       // global scratch buffers
+            return false;
+#endif
+
+        case dHeightfieldClass:     // per geom temporary buffers
+        case dGeomTransformClass:   // may wrap any of the above
+            return false;
+
+        default:
+            return g->type < dFirstUserClass;
+    }
+}
+
+
+void dxParallelCollideContext::GatherPairs_Callback(void *data, dxGeom *o1, dxGeom *o2)
+{
+    static_cast<dxParallelCollideContext *>(data)->GatherPair(o1, o2);
+}
+
+void dxParallelCollideContext::GatherPair(dxGeom *o1, dxGeom *o2)
+{
+    if (IS_SPACE(o1) || IS_SPACE(o2)) {
+        dSpaceCollide2(o1, o2, this, &GatherPairs_Callback);
+        return;
+    }
+
+    int maxContacts = m_maxContactsPerPair;
+    if (m_filter != NULL) {
+        int requested = m_filter(m_filterData, o1, o2);
+        if (requested <= 0) {
+            return;
+        }
+        if (requested < maxContacts) {
+            maxContacts = requested;
+        }
+    }
+
+    dxParallelCollidePair pair;
+    pair.g1 = o1;
+    pair.g2 = o2;
+    pair.maxContacts = maxContacts;
+    pair.count = 0;
+    pair.worker = 0;
+    pair.offset = 0;
+
+    unsigned pairIndex = (unsigned)m_pairs.size();
+    m_pairs.push(pair);
+
+    if (IsGeomCollisionReentrant(o1) && IsGeomCollisionReentrant(o2)) {
+        m_parallelPairs.push(pairIndex);
+    } else {
+        m_serialPairs.push(pairIndex);
+    }
+}
+
+
+bool dxParallelCollideContext::PrepareWorkers(unsigned workerCount)
+{
+    while ((unsigned)m_workers.size() < workerCount) {
+        dxParallelCollideWorker *worker = new dxParallelCollideWorker();
+        if (worker == NULL) {
+            return false;
+        }
+        m_workers.push(worker);
+    }
+
+    for (unsigned i = 0; i != workerCount; i++) {
+        m_workers[i]->m_used = 0;
+    }
+    return true;
+}
+
+
+void dxParallelCollideContext::CollidePair(dxParallelCollideWorker *worker, unsigned workerIndex, dxParallelCollidePair *pair)
+{
+    dContactGeom *target = worker->ReserveContacts((unsigned)pair->maxContacts);
+    int count = dCollide(pair->g1, pair->g2, pair->maxContacts, target, sizeof(dContactGeom));
+    dIASSERT(count <= pair->maxContacts);
+
+    pair->count = count;
+    pair->worker = workerIndex;
+    pair->offset = worker->m_used;
+    worker->m_used += (unsigned)count;
+}
+
+
+void dxParallelCollideContext::ProcessPairsSerially()
+{
+    dxParallelCollideWorker *worker = m_workers[0];
+    dxParallelCollidePair *pairs = m_pairs.data();
+
+    const int pairCount = m_pairs.size();
+    for (int i = 0; i < pairCount; i++) {
+        CollidePair(worker, 0, pairs + i);
+    }
+}
+
+
+bool dxParallelCollideContext::ProcessPairsThreaded(unsigned workerCount)
+{
+    bool result = false;
+
+    dxWorld *world = m_world;
+    dCallWaitID callWait = NULL;
+
+    do {
+        // The group call plus one call per worker
+        if (!world->PreallocateResourcesForThreadedCalls(1 + workerCount)) {
+            break;
+        }
+
+        callWait = world->AllocThreadedCallWait();
+        if (callWait == NULL) {
+            break;
+        }
+
+        m_parallelChunkCount = ((size_t)m_parallelPairs.size() + (PARALLEL_CHUNK_SIZE - 1)) / PARALLEL_CHUNK_SIZE;
+        m_nextParallelChunk = 0;
+
+        int summaryFault = 0;
+
+        dCallReleaseeID groupReleasee;
+        // The group call depends on all the workers and signals the wait when they are done
+        world->PostThreadedCall(&summaryFault, &groupReleasee, workerCount, NULL, callWait,
+            &dxParallelCollideContext::ThreadedProcessGroup_Callback, (void *)this, 0, "Parallel Collision Group");
+
+        // Summary fault flag may be omitted as any failures will automatically propagate to dependent releasee (i.e. to groupReleasee)
+        world->PostThreadedCallsGroup(NULL, workerCount, groupReleasee,
+            &dxParallelCollideContext::ThreadedProcessWorker_Callback, (void *)this, "Parallel Collision Worker");
+
+        world->WaitThreadedCallExclusively(NULL, callWait, NULL, "Parallel Collision Wait");
+
+        if (summaryFault != 0) {
+            break;
+        }
+
+        result = true;
+    }
+    while (false);
+
+    if (callWait != NULL) {
+        world->FreeThreadedCallWait(callWait);
+    }
+
+    return result;
+}
+
+int dxParallelCollideContext::ThreadedProcessGroup_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    (void)callContext; // unused
+    (void)callInstanceIndex; // unused
+    (void)callThisReleasee; // unused
+    // Do nothing - it's just a wrapper call
+    return true;
+}
+
+int dxParallelCollideContext::ThreadedProcessWorker_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    (void)callThisReleasee; // unused
+    static_cast<dxParallelCollideContext *>(callContext)->ThreadedProcessWorker((unsigned)callInstanceIndex);
+    return true;
+}
+
+void dxParallelCollideContext::ThreadedProcessWorker(unsigned workerIndex)
+{
+    dxParallelCollideWorker *worker = m_workers[workerIndex];
+    dxParallelCollidePair *pairs = m_pairs.data();
+
+    // The first worker takes the pairs that may not run concurrently before joining the others
+    if (workerIndex == 0) {
+        const unsigned *serialPairs = m_serialPairs.data();
+        const int serialCount = m_serialPairs.size();
+        for (int i = 0; i < serialCount; i++) {
+            CollidePair(worker, workerIndex, pairs + serialPairs[i]);
+        }
+    }
+
+    const unsigned *parallelPairs = m_parallelPairs.data();
+    const size_t parallelCount = (size_t)m_parallelPairs.size();
+    const size_t chunkCount = m_parallelChunkCount;
+
+    size_t chunk;
+    while ((chunk = ThrsafeIncrementSizeUpToLimit(&m_nextParallelChunk, chunkCount)) != chunkCount) {
+        size_t first = chunk * PARALLEL_CHUNK_SIZE;
+        size_t last = first + PARALLEL_CHUNK_SIZE;
+        if (last > parallelCount) {
+            last = parallelCount;
+        }
+
+        for (size_t i = first; i != last; i++) {
+            CollidePair(worker, workerIndex, pairs + parallelPairs[i]);
+        }
+    }
+}
+
+
+int dxParallelCollideContext::MergeContacts(dContactGeom *contacts, int maxContacts, dCollidePair *pairs, int maxPairs, int *pairCount)
+{
+    int contactCount = 0;
+    int recordCount = 0;
+
+    const dxParallelCollidePair *pair = m_pairs.data();
+    const dxParallelCollidePair *const pairsEnd = pair + m_pairs.size();
+
+    for (; pair != pairsEnd && contactCount != maxContacts && recordCount != maxPairs; pair++) {
+        int count = pair->count;
+        if (count == 0) {
+            continue;
+        }
+
+        if (count > maxContacts - contactCount) {
+            count = maxContacts - contactCount;
+        }
+
+        const dContactGeom *source = m_workers[pair->worker]->m_contacts.data() + pair->offset;
+        memcpy(contacts + contactCount, source, (size_t)count * sizeof(dContactGeom));
+
+        dCollidePair *record = pairs + recordCount;
+        record->g1 = pair->g1;
+        record->g2 = pair->g2;
+        record->first = contactCount;
+        record->count = count;
+
+        contactCount += count;
+        recordCount++;
+    }
+
+    if (pairCount != NULL) {
+        *pairCount = recordCount;
+    }
+
+    return contactCount;
+}
+
+
+int dxParallelCollideContext::Collide(dxWorld *world, dxSpace *space, void *data, dPairFilterCallback *filter, int maxContactsPerPair,
+    dContactGeom *contacts, int maxContacts, dCollidePair *pairs, int maxPairs, int *pairCount)
+{
+    m_world = world;
+    m_filter = filter;
+    m_filterData = data;
+    m_maxContactsPerPair = maxContactsPerPair;
+
+    m_pairs.setSize(0);
+    m_parallelPairs.setSize(0);
+    m_serialPairs.setSize(0);
+
+    // Broadphase and user filtering on the calling thread
+    space->collide(this, &GatherPairs_Callback);
+
+    int result = 0;
+
+    do {
+        if (m_pairs.size() == 0) {
+            if (pairCount != NULL) {
+                *pairCount = 0;
+            }
+            break;
+        }
+
+        unsigned workerCount = world->GetThreadingIslandsMaxThreadsCount();
+        dIASSERT(workerCount != 0);
+
+        // No point in waking more threads than there are chunks of work
+        size_t jobCount = ((size_t)m_parallelPairs.size() + (PARALLEL_CHUNK_SIZE - 1)) / PARALLEL_CHUNK_SIZE;
+        if (m_serialPairs.size() != 0 && jobCount == 0) {
+            jobCount = 1;
+        }
+        if (jobCount < workerCount) {
+            workerCount = (unsigned)jobCount;
+        }
+
+        if (!PrepareWorkers(workerCount)) {
+            break;
+        }
+
+        if (workerCount == 1 || !ProcessPairsThreaded(workerCount)) {
+            PrepareWorkers(1);
+            ProcessPairsSerially();
+        }
+
+        result = MergeContacts(contacts, maxContacts, pairs, maxPairs, pairCount);
+    }
+    while (false);
+
+    m_world = NULL;
+    m_filter = NULL;
+    m_filterData = NULL;
+
+    return result;
+}
+
+
+int dSpaceCollideParallel(dxWorld *world, dxSpace *space, void *data, dPairFilterCallback *filter, int maxContactsPerPair,
+    dContactGeom *contacts, int maxContacts, dCollidePair *pairs, int maxPairs, int *pairCount)
+{
+    dAASSERT(world && space);
+    dUASSERT(dGeomIsSpace(space), "argument not a space");
+    dUASSERT(maxContactsPerPair >= 1 && (maxContactsPerPair & ~NUMC_MASK) == 0, "bad maximum contacts per pair");
+    dUASSERT(contacts || maxContacts == 0, "bad contacts argument");
+    dUASSERT(pairs || maxPairs == 0, "bad pairs argument");
+
+    if (pairCount != NULL) {
+        *pairCount = 0;
+    }
+
+    if (maxContacts <= 0 || maxPairs <= 0) {
+        return 0;
+    }
+
+    dxParallelCollideContext *context = world->parallel_collide;
+    if (context == NULL) {
+        context = new dxParallelCollideContext();
+        if (context == NULL) {
+            return 0;
+        }
+        world->parallel_collide = context;
+    }
+
+    return context->Collide(world, space, data, filter, maxContactsPerPair, contacts, maxContacts, pairs, maxPairs, pairCount);
+}
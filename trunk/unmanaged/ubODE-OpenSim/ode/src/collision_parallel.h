@@ -0,0 +1,115 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+multithreaded collision pass: candidate pairs are gathered serially and
+then collided by the world threads into per thread contact buffers
+
+*/
+
+#ifndef _ODE_COLLISION_PARALLEL_H_
+#define _ODE_COLLISION_PARALLEL_H_
+
+#include <ode/common.h>
+#include <ode/collision.h>
+#include "array.h"
+#include "objects.h"
+
+
+struct dxParallelCollidePair
+{
+    dxGeom *g1, *g2;
+    int maxContacts;        // contact limit passed to dCollide
+    int count;              // contacts generated
+    unsigned worker;        // worker holding the contacts
+    unsigned offset;        // position of the contacts in the worker buffer
+};
+
+struct dxParallelCollideWorker:
+    public dBase
+{
+    dxParallelCollideWorker(): m_used(0) {}
+
+    // makes sure the next `count' contacts fit and returns where they go
+    dContactGeom *ReserveContacts(unsigned count)
+    {
+        unsigned required = m_used + count;
+        if ((unsigned)m_contacts.size() < required) {
+            m_contacts.setSize((int)required);
+        }
+        return m_contacts.data() + m_used;
+    }
+
+    dArray<dContactGeom> m_contacts;
+    unsigned m_used;
+};
+
+class dxParallelCollideContext:
+    public dBase
+{
+public:
+    dxParallelCollideContext(): m_world(NULL), m_filter(NULL), m_filterData(NULL),
+        m_maxContactsPerPair(0), m_parallelChunkCount(0), m_nextParallelChunk(0) {}
+    ~dxParallelCollideContext();
+
+    int Collide(dxWorld *world, dxSpace *space, void *data, dPairFilterCallback *filter, int maxContactsPerPair,
+        dContactGeom *contacts, int maxContacts, dCollidePair *pairs, int maxPairs, int *pairCount);
+
+    // Number of pairs handed to a worker at a time
+    enum { PARALLEL_CHUNK_SIZE = 8 };
+
+private:
+    static void GatherPairs_Callback(void *data, dxGeom *o1, dxGeom *o2);
+    void GatherPair(dxGeom *o1, dxGeom *o2);
+
+    static bool IsGeomCollisionReentrant(const dxGeom *g);
+
+    bool PrepareWorkers(unsigned workerCount);
+    void ProcessPairsSerially();
+    bool ProcessPairsThreaded(unsigned workerCount);
+
+    static int ThreadedProcessGroup_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+    static int ThreadedProcessWorker_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+    void ThreadedProcessWorker(unsigned workerIndex);
+
+    void CollidePair(dxParallelCollideWorker *worker, unsigned workerIndex, dxParallelCollidePair *pair);
+
+    int MergeContacts(dContactGeom *contacts, int maxContacts, dCollidePair *pairs, int maxPairs, int *pairCount);
+
+private:
+    dxWorld                         *m_world;
+    dPairFilterCallback             *m_filter;
+    void                            *m_filterData;
+    int                             m_maxContactsPerPair;
+
+    dArray<dxParallelCollidePair>   m_pairs;
+    dArray<unsigned>                m_parallelPairs;    // pairs any thread may collide
+    dArray<unsigned>                m_serialPairs;      // pairs that must be collided one at a time
+    dArray<dxParallelCollideWorker *> m_workers;
+
+    size_t                          m_parallelChunkCount;
+    size_t                          volatile m_nextParallelChunk;
+};
+
+
+#endif // _ODE_COLLISION_PARALLEL_H_
@@ -28,6 +28,7 @@
 #include <ode/collision.h>
 #include "config.h"
 #include "matrix.h"
+#include "odemath.h"
 #include "collision_kernel.h"
 
 #include "collision_space_internal.h"
@@ -276,6 +277,11 @@ struct dxQuadTreeSpace : public dxSpace
 
     dArray<dxGeom*> DirtyList;
 
+    // creation parameters
+    dVector3 TreeCenter;
+    dVector3 TreeExtents;
+    int TreeDepth;
+
     dxQuadTreeSpace(dSpaceID _space, const dVector3 Center, const dVector3 Extents, int Depth);
     ~dxQuadTreeSpace();
 
@@ -307,6 +313,9 @@ namespace {
 dxQuadTreeSpace::dxQuadTreeSpace(dSpaceID _space, const dVector3 Center, const dVector3 Extents, int Depth) : dxSpace(_space)
 {
     type = dQuadTreeSpaceClass;
+    dCopyVector3(TreeCenter, Center);
+    dCopyVector3(TreeExtents, Extents);
+    TreeDepth = Depth;
     BlockCount = numNodes(Depth);
     if (BlockCount <= 0)
         return;
@@ -346,72 +355,8 @@ dxQuadTreeSpace::~dxQuadTreeSpace()
 dxGeom* dxQuadTreeSpace::getGeom(int Index){
     dUASSERT(Index >= 0 && Index < count, "index out of range");
 
-    //@@@
-    dDebug (0,"dxQuadTreeSpace::getGeom() not yet implemented");
-    return 0;
-    // This doesnt work
-/*
-    if (CurrentIndex == Index){
-        // Loop through all objects in the local list
-CHILDRECURSE:
-        if (CurrentObject){
-            dGeomID g = CurrentObject;
-            CurrentObject = CurrentObject->next_ex;
-            CurrentIndex++;
-
-#ifdef DRAWBLOCKS
-            DrawBlock(CurrentBlock);
-#endif	//DRAWBLOCKS
-            return g;
-        }
-        else{
-            // Now lets loop through our children. Starting at index 0.
-            if (CurrentBlock->Children){
-                CurrentChild[CurrentLevel] = 0;
-PARENTRECURSE:
-                for (int& i = CurrentChild[CurrentLevel]; i < SPLITS; i++){
-                    if (CurrentBlock->Children[i].GeomCount == 0){
-                        continue;
-                    }
-                    CurrentBlock = &CurrentBlock->Children[i];
-                    CurrentObject = CurrentBlock->First;
-
-                    i++;
-
-                    CurrentLevel++;
-                    goto CHILDRECURSE;
-                }
-            }
-        }
-
-        // Now lets go back to the parent so it can continue processing its other children.
-        if (CurrentBlock->Parent){
-            CurrentBlock = CurrentBlock->Parent;
-            CurrentLevel--;
-            goto PARENTRECURSE;
-        }
-    }
-    else{
-        CurrentBlock = &Blocks[0];
-        CurrentLevel = 0;
-        CurrentObject = CurrentObject;
-        CurrentIndex = 0;
-
-        // Other states are already set
-        CurrentObject = CurrentBlock->First;
-    }
-
-
-    if (current_geom && current_index == Index - 1){
-        //current_geom = current_geom->next_ex; // next
-        current_index = Index;
-        return current_geom;
-    }
-    else for (int i = 0; i < Index; i++){	// this will be verrrrrrry slow
-        getGeom(i);
-    }
-    return 0;
-    */
+    // the blocks hold the geoms in next_ex, the space list is still kept
+    return dxSpace::getGeom(Index);
 }
 
 void dxQuadTreeSpace::add(dxGeom* g)
@@ -538,3 +483,12 @@ dSpaceID dQuadTreeSpaceCreate(dxSpace* space, const dVector3 Center, const dVect
 {
     return new dxQuadTreeSpace(space, Center, Extents, Depth);
 }
+
+void dxQuadTreeSpaceGetParams(dxSpace* space, dVector3 Center, dVector3 Extents, int* Depth)
+{
+    dIASSERT(space->type == dQuadTreeSpaceClass);
+    dxQuadTreeSpace* qs = (dxQuadTreeSpace*)space;
+    dCopyVector3(Center, qs->TreeCenter);
+    dCopyVector3(Extents, qs->TreeExtents);
+    *Depth = qs->TreeDepth;
+}
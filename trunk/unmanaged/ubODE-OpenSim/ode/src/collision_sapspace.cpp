@@ -148,6 +148,11 @@ struct dxSAPSpace : public dxSpace
     virtual void collide( void *data, dNearCallback *callback );
     virtual void collide2( void *data, dxGeom *geom, dNearCallback *callback );
 
+    // axis order the space was created with
+    int getAxisOrder() const { return (ax0idx >> 1) | ((ax1idx >> 1) << 2) | ((ax2idx >> 1) << 4); }
+    // getGeom returns the dirty geoms first
+    int getDirtyCount() const { return DirtyList.size(); }
+
 private:
 
     //--------------------------------------------------------------------------
@@ -215,6 +220,18 @@ dSpaceID dSweepAndPruneSpaceCreate( dxSpace* space, int axisorder )
     return new dxSAPSpace( space, axisorder );
 }
 
+int dxSAPSpaceGetAxisOrder( dxSpace* space )
+{
+    dIASSERT( space->type == dSweepAndPruneSpaceClass );
+    return ((dxSAPSpace*)space)->getAxisOrder();
+}
+
+int dxSAPSpaceGetDirtyCount( dxSpace* space )
+{
+    dIASSERT( space->type == dSweepAndPruneSpaceClass );
+    return ((dxSAPSpace*)space)->getDirtyCount();
+}
+
 
 //==============================================================================
 
@@ -239,6 +256,7 @@ static void collideGeomsNoAABBs( dxGeom *g1, dxGeom *g2, void *data, dNearCallba
 
     // no contacts if both geoms on the same body, and the body is not 0
     if (g1->body && g1->body == g2->body) return;
+    if (geomsAsleep(g1, g2)) return;
 
     // test if the category and collide bitfields match
     if ( ((g1->category_bits & g2->collide_bits) || (g2->category_bits & g1->collide_bits)) == 0)
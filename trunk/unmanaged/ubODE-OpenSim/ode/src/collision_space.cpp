@@ -640,7 +640,7 @@ void dxHashSpace::collide(void *cdata, dNearCallback *callback)
         for (dxAABB *aabb2 = big_boxes; aabb2; aabb2 = aabb2->next)
         {
             if (testCollideAABBs(aabb->geom, aabb2->geom))
-                callback(data, aabb->geom, aabb2->geom);
+                callback(cdata, aabb->geom, aabb2->geom);
         }
     }
 
@@ -650,7 +650,7 @@ void dxHashSpace::collide(void *cdata, dNearCallback *callback)
         for (dxAABB *aabb2 = aabb->next; aabb2; aabb2 = aabb2->next)
         {
             if (testCollideAABBs(aabb->geom, aabb2->geom))
-                callback(data, aabb->geom, aabb2->geom);
+                callback(cdata, aabb->geom, aabb2->geom);
         }
     }
 
@@ -31,6 +31,19 @@ stuff common to all spaces
 
 #define ALLOCA(x) dALLOCA16(x)
 
+// geoms of bodies that fell asleep with their island (see
+// dWorldSetAutoDisableIslands) are not collided with each other or with
+// static geoms. spaces have no body but are not static.
+static inline bool geomsAsleep(const dxGeom *g1, const dxGeom *g2)
+{
+    const dxBody *b1 = g1->body, *b2 = g2->body;
+    bool asleep1 = b1 && (b1->flags & dxBodyIslandAsleep) != 0;
+    bool asleep2 = b2 && (b2->flags & dxBodyIslandAsleep) != 0;
+    if (!asleep1 && !asleep2)
+        return false;
+    return (asleep1 || (!b1 && !IS_SPACE(g1))) && (asleep2 || (!b2 && !IS_SPACE(g2)));
+}
+
 // collide two geoms together. for the hash table space, this is
 // called if the two AABBs inhabit the same hash table cells.
 // this only calls the callback function if the AABBs actually
@@ -48,6 +61,7 @@ static inline void collideAABBs(dxGeom *g1, dxGeom *g2,
 
     // no contacts if both geoms on the same body, and the body is not 0
     if (g1->body && g1->body == g2->body) return;
+    if (geomsAsleep(g1, g2)) return;
 
     // test if the category and collide bitfields match
     if ( ((g1->category_bits & g2->collide_bits) || (g2->category_bits & g1->collide_bits)) == 0)
@@ -76,6 +90,12 @@ static inline void collideAABBs(dxGeom *g1, dxGeom *g2,
     callback (data,g1,g2);
 }
 
+// creation parameters of the quadtree and SAP spaces, and the number of
+// geoms of a SAP space not sorted since they were added or moved
+void dxQuadTreeSpaceGetParams(dxSpace *space, dVector3 center, dVector3 extents, int *depth);
+int dxSAPSpaceGetAxisOrder(dxSpace *space);
+int dxSAPSpaceGetDirtyCount(dxSpace *space);
+
 static inline bool testCollideAABBs(dxGeom *g1, dxGeom *g2)
 {
     dIASSERT((g1->gflags & GEOM_AABB_BAD) == 0);
@@ -83,6 +103,7 @@ static inline bool testCollideAABBs(dxGeom *g1, dxGeom *g2)
 
     // no contacts if both geoms on the same body, and the body is not 0
     if (g1->body && g1->body == g2->body) return false;
+    if (geomsAsleep(g1, g2)) return false;
 
     // test if the category and collide bitfields match
     if (((g1->category_bits & g2->collide_bits) || (g2->category_bits & g1->collide_bits)) == 0)
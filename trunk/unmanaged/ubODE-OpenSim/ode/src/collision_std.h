@@ -68,7 +68,6 @@ int dCollideRayCylinder (dxGeom *o1, dxGeom *o2, int flags,
 
 // Cylinder - Box/Sphere by (C) CroTeam
 // Ported by Nguyen Binh
-/*
 int dCollideCylinderBox(dxGeom *o1, dxGeom *o2, 
                         int flags, dContactGeom *contact, int skip);
 int dCollideCylinderSphere(dxGeom *gCylinder, dxGeom *gSphere, 
@@ -89,8 +88,14 @@ int dCollideConvexConvex (dxGeom *o1, dxGeom *o2, int flags,
                           dContactGeom *contact, int skip);
 int dCollideRayConvex (dxGeom *o1, dxGeom *o2, int flags, 
                        dContactGeom *contact, int skip);
+// cylinders as prisms, with the convex code
+int dCollideConvexCylinder (dxGeom *o1, dxGeom *o2, int flags,
+                            dContactGeom *contact, int skip);
+int dCollideCylinderCylinder (dxGeom *o1, dxGeom *o2, int flags,
+                              dContactGeom *contact, int skip);
+int dCollideCylinderCapsule (dxGeom *o1, dxGeom *o2, int flags,
+                             dContactGeom *contact, int skip);
 //<-- Convex Collision
-*/
 
 // dHeightfield
 int dCollideHeightfield( dxGeom *o1, dxGeom *o2, 
@@ -143,6 +148,8 @@ struct dxRay : public dxGeom {
     void computeAABB();
 };
 
+#define dCONVEX_SAT_CACHE_SIZE 4
+
 struct dxConvex : public dxGeom 
 {  
     dReal *planes; /*!< An array of planes in the form:
@@ -153,7 +160,7 @@ struct dxConvex : public dxGeom
     unsigned int planecount; /*!< Amount of planes in planes */
     unsigned int pointcount;/*!< Amount of points in points */
     unsigned int edgecount;/*!< Amount of edges in convex */
-    dReal saabb[6];/*!< Static AABB */
+    dReal saabb[6];/*!< Static AABB, in convex space */
     dxConvex(dSpaceID space,
         dReal *planes,
         unsigned int planecount,
@@ -169,9 +176,18 @@ struct dxConvex : public dxGeom
     {
         unsigned int first;
         unsigned int second;
+        unsigned int faces[2]; /*!< the polygons sharing the edge */
     };
     edge* edges;
 
+    /*! Last separating or contact axis found against recent partners, see
+    convex.cpp. Only a hint, so it is not locked for parallel collisions */
+    volatile duint64 satCache[dCONVEX_SAT_CACHE_SIZE];
+
+    /*! \brief Recomputes the edges and the static AABB, call whenever the
+    arrays change */
+    void UpdateTopology();
+
     /*! \brief A Support mapping function for convex shapes
     \param dir [IN] direction to find the Support Point for
     \return the index of the support vertex.
@@ -218,6 +218,10 @@ struct dxTriMeshData  : public dBase
 
     void Build(const void* Vertices, int VertexCount,
         const void* Indices, int IndexCount);
+    bool BuildFromSerialized(const void* Vertices, int VertexCount,
+        const void* Indices, int IndexCount, const void* buf, int bufLen);
+    int GetSerializedSize() const;
+    int Serialize(void* buf, int bufLen) const;
 
     /* aabb in model space */
     dVector3 AABBCenter;
@@ -226,8 +230,65 @@ struct dxTriMeshData  : public dBase
     // data for use in collision resolution
     //const void* Normals;
     uint8* UseFlags;
+
+    // dGeomTriMeshDataCreateShared state, the arrays are owned copies
+    duint64 ContentHash;
+    dReal* SharedVertices;
+    dTriIndex* SharedIndices;
+    int SharedRefCount;
+    dxTriMeshData* NextShared;
+};
+
+// Temporal coherence against other trimeshes and terrains. A set holds the
+// triangle pairs, or for terrains the vertices, that can touch as long as
+// the pair has not moved more than Margin from where the set was built.
+// Sets are only built for pairs that moved little since the last query.
+#define dTRIMESH_PAIR_TC_SIZE 16
+#define dTRIMESH_PAIR_TC_MARGIN REAL(0.05)  // times the smaller mesh radius
+#define dTRIMESH_PAIR_TC_REST REAL(0.5)     // times the margin, motion since the last query of a resting pair
+
+struct TriMeshPairTC
+{
+    dxGeom* Geom;           // other geom, NULL when the slot is free
+    const void* Data;       // its trimesh or terrain data
+    unsigned Stamp;         // owner PairTCStamp at the last use
+    bool HasLast;
+    bool Valid;             // the set can be used
+    dReal Margin;
+    dReal Height;           // terrains, zone height the set was built for
+    dVector3 SetPos;        // relative transform of the set
+    dMatrix3 SetR;
+    dVector3 LastPos;       // relative transform of the last query
+    dMatrix3 LastR;
+    dArray<unsigned> Set;
+
+    void Reset(dxGeom* Other, const void* OtherData)
+    {
+        Geom = Other;
+        Data = OtherData;
+        HasLast = false;
+        Valid = false;
+        Set.setSize(0);
+    }
 };
 
+// bound on the motion of points within Radius of the origin between two transforms
+inline dReal TriMeshPairTCMotion(const dVector3 Pos0, const dMatrix3 R0,
+                                 const dVector3 Pos1, const dMatrix3 R1, dReal Radius)
+{
+    dReal rot = REAL(0.0);
+    for (int i = 0; i < 12; i++)
+    {
+        if ((i & 3) == 3)
+            continue;
+        const dReal d = R1[i] - R0[i];
+        rot += d * d;
+    }
+    dVector3 move;
+    dSubtractVectors3(move, Pos1, Pos0);
+    return dCalcVectorLength3(move) + dSqrt(rot) * Radius;
+}
+
 struct dxTriMesh : public dxGeom
 {
     // Callbacks
@@ -242,12 +303,16 @@ struct dxTriMesh : public dxGeom
     bool doSphereTC;
     bool doBoxTC;
     bool doCapsuleTC;
+    bool doTriMeshTC;
+    bool doTerrainTC;
 
     // Functions
     dxTriMesh(dSpaceID Space, dTriMeshDataID Data);
     ~dxTriMesh();
 
     void ClearTCCache();
+    TriMeshPairTC* GetPairTC(dxGeom* Other, const void* OtherData);
+    dReal GetRadius() const;
 
 //    bool controlGeometry(int controlClass, int controlCode, void *dataValue, int *dataSize);
 
@@ -281,6 +346,9 @@ struct dxTriMesh : public dxGeom
     };
     dArray<CapsuleTC> CapsuleTCCache;
 
+    TriMeshPairTC* PairTCCache;   // dTRIMESH_PAIR_TC_SIZE slots, allocated on first use
+    unsigned PairTCStamp;         // counts GetPairTC calls
+
 };
 
 #if 0
@@ -29,6 +29,7 @@
 #include "odemath.h"
 #include "collision_util.h"
 #include "collision_trimesh_internal.h"
+#include "threadingutils.h"
 
 void TrimeshCollidersCache::InitOPCODECaches()
 {
@@ -63,7 +64,12 @@ void TrimeshCollidersCache::InitOPCODECaches()
 }
 
 // Trimesh data
-dxTriMeshData::dxTriMeshData() : UseFlags( NULL )
+dxTriMeshData::dxTriMeshData() : UseFlags( NULL ),
+    ContentHash( 0 ),
+    SharedVertices( NULL ),
+    SharedIndices( NULL ),
+    SharedRefCount( 0 ),
+    NextShared( NULL )
 {
 }
 
@@ -71,6 +77,8 @@ dxTriMeshData::~dxTriMeshData()
 {
     if ( UseFlags )
         delete [] UseFlags;
+    delete [] SharedVertices;
+    delete [] SharedIndices;
 }
 
 void 
@@ -144,6 +152,172 @@ dxTriMeshData::Build(const void* Vertices,int VertexCount,
     UseFlags = 0;
 }
 
+// Serialized data, see dGeomTriMeshDataSerialize
+// the header is followed by the tree nodes and the use flags
+#define TRIMESH_SERIALIZED_MAGIC    0x424d544f // "OTMB"
+#define TRIMESH_SERIALIZED_VERSION  1
+
+struct dxTriMeshSerializedHeader
+{
+    duint32 Magic;
+    duint32 Version;
+    duint32 NodeSize;
+    duint32 NodeCount;
+    duint32 TriangleCount;
+    duint32 VertexCount;
+    duint32 HasUseFlags;
+    duint32 MeshFlags;
+    duint64 ContentHash;
+    duint64 DataHash;       // of the AABB and everything after the header
+    dReal AABBCenter[3];
+    dReal AABBExtents[3];
+};
+
+#define TRIMESH_HASH_BASIS  0xcbf29ce484222325ULL
+#define TRIMESH_HASH_PRIME  0x100000001b3ULL
+
+// FNV-1a, one 32 bit word at a time
+static duint64 HashTriMeshBytes(duint64 hash, const void* data, size_t size)
+{
+    const duint32* words = (const duint32*)data;
+    const size_t count = size / sizeof(duint32);
+    for (size_t i = 0; i < count; i++)
+        hash = (hash ^ words[i]) * TRIMESH_HASH_PRIME;
+
+    const uint8* bytes = (const uint8*)(words + count);
+    for (size_t i = 0; i < size % sizeof(duint32); i++)
+        hash = (hash ^ bytes[i]) * TRIMESH_HASH_PRIME;
+
+    return hash;
+}
+
+static duint64 ComputeTriMeshHash(const void* Vertices, int VertexCount,
+                                  const void* Indices, int IndexCount)
+{
+    duint64 hash = TRIMESH_HASH_BASIS;
+
+    hash = (hash ^ (duint32)VertexCount) * TRIMESH_HASH_PRIME;
+    hash = (hash ^ (duint32)IndexCount) * TRIMESH_HASH_PRIME;
+
+    hash = HashTriMeshBytes(hash, Vertices, (size_t)VertexCount * sizeof(Point));
+    return HashTriMeshBytes(hash, Indices, (size_t)IndexCount * sizeof(dTriIndex));
+}
+
+static duint64 ComputeSerializedHash(const dxTriMeshSerializedHeader* header, size_t size)
+{
+    duint64 hash = HashTriMeshBytes(TRIMESH_HASH_BASIS, header->AABBCenter, sizeof(header->AABBCenter));
+    hash = HashTriMeshBytes(hash, header->AABBExtents, sizeof(header->AABBExtents));
+    return HashTriMeshBytes(hash, header + 1, size - sizeof(dxTriMeshSerializedHeader));
+}
+
+bool dxTriMeshData::BuildFromSerialized(const void* Vertices, int VertexCount,
+                                        const void* Indices, int IndexCount,
+                                        const void* buf, int bufLen)
+{
+    if (!buf || bufLen < (int)sizeof(dxTriMeshSerializedHeader))
+        return false;
+
+    const dxTriMeshSerializedHeader* header = (const dxTriMeshSerializedHeader*)buf;
+    const udword numTris = IndexCount / 3;
+
+    if (header->Magic != TRIMESH_SERIALIZED_MAGIC
+        || header->Version != TRIMESH_SERIALIZED_VERSION
+        || header->NodeSize != sizeof(AABBNoLeafSerializedNode)
+        || header->TriangleCount != numTris
+        || header->NodeCount >= numTris
+        || header->VertexCount != (duint32)VertexCount)
+        return false;
+
+    const size_t flagsOffset = sizeof(dxTriMeshSerializedHeader)
+        + (size_t)header->NodeCount * sizeof(AABBNoLeafSerializedNode);
+    const size_t size = flagsOffset + (header->HasUseFlags ? numTris : 0);
+    if ((size_t)bufLen < size)
+        return false;
+
+    if (header->DataHash != ComputeSerializedHash(header, size)
+        || header->ContentHash != ComputeTriMeshHash(Vertices, VertexCount, Indices, IndexCount))
+        return false;
+
+    Mesh.SetNbTriangles(numTris);
+    Mesh.SetNbVertices(VertexCount);
+    Mesh.SetPointers((IndexedTriangle*)Indices, (Point*)Vertices);
+
+    OPCODECREATE TreeLoader;
+    TreeLoader.mIMesh = &Mesh;
+
+    const AABBNoLeafSerializedNode* nodes = (const AABBNoLeafSerializedNode*)
+        ((const uint8*)buf + sizeof(dxTriMeshSerializedHeader));
+    if (!BVTree.Load(TreeLoader, nodes, header->NodeCount))
+    {
+        Mesh.SetNbTriangles(0);
+        return false;
+    }
+
+    dCopyVector3(AABBCenter, header->AABBCenter);
+    dCopyVector3(AABBExtents, header->AABBExtents);
+
+    if ( UseFlags )
+        delete [] UseFlags;
+    UseFlags = NULL;
+
+    if (header->HasUseFlags)
+    {
+        UseFlags = new uint8[numTris];
+        memcpy(UseFlags, (const uint8*)buf + flagsOffset, numTris);
+        meshFlags = (uint8)header->MeshFlags;
+    }
+
+    return true;
+}
+
+int dxTriMeshData::GetSerializedSize() const
+{
+    const udword numTris = Mesh.GetNbTriangles();
+    if (numTris == 0)
+        return 0;
+
+    const udword numNodes = BVTree.HasSingleNode() ? 0 : BVTree.GetNbNodes();
+    return (int)(sizeof(dxTriMeshSerializedHeader)
+        + numNodes * sizeof(AABBNoLeafSerializedNode)
+        + (UseFlags ? numTris : 0));
+}
+
+int dxTriMeshData::Serialize(void* buf, int bufLen) const
+{
+    const int size = GetSerializedSize();
+    if (size == 0 || bufLen < size)
+        return 0;
+
+    const udword numTris = Mesh.GetNbTriangles();
+    const udword numNodes = BVTree.HasSingleNode() ? 0 : BVTree.GetNbNodes();
+
+    dxTriMeshSerializedHeader* header = (dxTriMeshSerializedHeader*)buf;
+    header->Magic = TRIMESH_SERIALIZED_MAGIC;
+    header->Version = TRIMESH_SERIALIZED_VERSION;
+    header->NodeSize = sizeof(AABBNoLeafSerializedNode);
+    header->NodeCount = numNodes;
+    header->TriangleCount = numTris;
+    header->VertexCount = Mesh.GetNbVertices();
+    header->HasUseFlags = UseFlags ? 1 : 0;
+    header->MeshFlags = UseFlags ? meshFlags : 0;
+    header->ContentHash = ComputeTriMeshHash(Mesh.GetVerts(), Mesh.GetNbVertices(),
+        Mesh.GetTris(), numTris * 3);
+    dCopyVector3(header->AABBCenter, AABBCenter);
+    dCopyVector3(header->AABBExtents, AABBExtents);
+
+    uint8* data = (uint8*)buf + sizeof(dxTriMeshSerializedHeader);
+    if (numNodes != 0)
+    {
+        ((const AABBNoLeafTree*)BVTree.GetTree())->Serialize((AABBNoLeafSerializedNode*)data);
+        data += numNodes * sizeof(AABBNoLeafSerializedNode);
+    }
+    if (UseFlags)
+        memcpy(data, UseFlags, numTris);
+
+    header->DataHash = ComputeSerializedHash(header, size);
+    return size;
+}
+
 struct EdgeRecord
 {
     int VertIdx1;	// Index into vertex array for this edges vertices
@@ -372,7 +546,119 @@ dTriMeshDataID dGeomTriMeshDataCreate(){
     return new dxTriMeshData();
 }
 
+// Shared trimesh data, chained by content hash
+#define TRIMESH_SHARED_BUCKETS 1024
+
+static dxTriMeshData* g_SharedTriMeshData[TRIMESH_SHARED_BUCKETS];
+static volatile atomicord32 g_SharedTriMeshLock = 0;
+
+static void LockSharedTriMeshData()
+{
+    while (!ThrsafeCompareExchange(&g_SharedTriMeshLock, 0, 1)) {
+        // the lock only guards list updates
+    }
+}
+
+static void UnlockSharedTriMeshData()
+{
+    ThrsafeExchange(&g_SharedTriMeshLock, 0);
+}
+
+static dxTriMeshData*& SharedTriMeshBucket(duint64 hash)
+{
+    return g_SharedTriMeshData[(size_t)(hash ^ (hash >> 32)) & (TRIMESH_SHARED_BUCKETS - 1)];
+}
+
+// must be called with the lock held
+static dxTriMeshData* FindSharedTriMeshData(duint64 hash,
+                                            const dReal* Vertices, int VertexCount,
+                                            const dTriIndex* Indices, int IndexCount)
+{
+    for (dxTriMeshData* data = SharedTriMeshBucket(hash); data; data = data->NextShared)
+    {
+        if (data->ContentHash == hash
+            && data->Mesh.GetNbVertices() == (udword)VertexCount
+            && data->Mesh.GetNbTriangles() * 3 == (udword)IndexCount
+            && memcmp(data->SharedVertices, Vertices, VertexCount * sizeof(Point)) == 0
+            && memcmp(data->SharedIndices, Indices, IndexCount * sizeof(dTriIndex)) == 0)
+            return data;
+    }
+    return NULL;
+}
+
+dTriMeshDataID dGeomTriMeshDataCreateShared(const dReal* Vertices, int VertexCount,
+                                            const dTriIndex* Indices, int IndexCount,
+                                            const void* Serialized, int SerializedLen)
+{
+    dUASSERT(Vertices && Indices, "argument not mesh arrays");
+
+    const duint64 hash = ComputeTriMeshHash(Vertices, VertexCount, Indices, IndexCount);
+
+    LockSharedTriMeshData();
+    dxTriMeshData* found = FindSharedTriMeshData(hash, Vertices, VertexCount, Indices, IndexCount);
+    if (found)
+        found->SharedRefCount++;
+    UnlockSharedTriMeshData();
+
+    if (found)
+        return found;
+
+    // build outside of the lock
+    dxTriMeshData* data = new dxTriMeshData();
+    // one spare value, the AVX bounds loop loads four floats per vertex
+    data->SharedVertices = new dReal[VertexCount * 3 + 1];
+    memcpy(data->SharedVertices, Vertices, VertexCount * sizeof(Point));
+    data->SharedIndices = new dTriIndex[IndexCount];
+    memcpy(data->SharedIndices, Indices, IndexCount * sizeof(dTriIndex));
+
+    if (!data->BuildFromSerialized(data->SharedVertices, VertexCount,
+            data->SharedIndices, IndexCount, Serialized, SerializedLen))
+        data->Build(data->SharedVertices, VertexCount, data->SharedIndices, IndexCount);
+    data->Preprocess();
+
+    data->ContentHash = hash;
+    data->SharedRefCount = 1;
+
+    // another thread may have added the same mesh meanwhile
+    LockSharedTriMeshData();
+    found = FindSharedTriMeshData(hash, Vertices, VertexCount, Indices, IndexCount);
+    if (found)
+        found->SharedRefCount++;
+    else
+    {
+        dxTriMeshData*& bucket = SharedTriMeshBucket(hash);
+        data->NextShared = bucket;
+        bucket = data;
+    }
+    UnlockSharedTriMeshData();
+
+    if (found)
+    {
+        delete data;
+        return found;
+    }
+    return data;
+}
+
+// returns true when the last reference was released
+static bool ReleaseSharedTriMeshData(dxTriMeshData* g)
+{
+    LockSharedTriMeshData();
+    const bool last = --g->SharedRefCount == 0;
+    if (last)
+    {
+        dxTriMeshData** link = &SharedTriMeshBucket(g->ContentHash);
+        while (*link != g)
+            link = &(*link)->NextShared;
+        *link = g->NextShared;
+    }
+    UnlockSharedTriMeshData();
+    return last;
+}
+
 void dGeomTriMeshDataDestroy(dTriMeshDataID g){
+    if (g->SharedRefCount != 0 && !ReleaseSharedTriMeshData(g))
+        return;
     delete g;
 }
 
@@ -477,6 +763,27 @@ void dGeomTriMeshDataSetBuffer(dTriMeshDataID g, unsigned char* buf)
     g->UseFlags = buf;
 }
 
+int dGeomTriMeshDataGetSerializedSize(dTriMeshDataID g)
+{
+    dUASSERT(g, "argument not trimesh data");
+    return g->GetSerializedSize();
+}
+
+int dGeomTriMeshDataSerialize(dTriMeshDataID g, void* buf, int bufLen)
+{
+    dUASSERT(g, "argument not trimesh data");
+    return g->Serialize(buf, bufLen);
+}
+
+int dGeomTriMeshDataBuildFromSerialized(dTriMeshDataID g,
+                                        const dReal* Vertices, int VertexCount,
+                                        const dTriIndex* Indices, int IndexCount,
+                                        const void* buf, int bufLen)
+{
+    dUASSERT(g, "argument not trimesh data");
+    return g->BuildFromSerialized(Vertices, VertexCount, Indices, IndexCount, buf, bufLen) ? 1 : 0;
+}
+
 
 dxTriMesh::dxTriMesh(dSpaceID Space, dTriMeshDataID Data) : dxGeom(Space, 1)
 {
@@ -494,6 +801,11 @@ dxTriMesh::dxTriMesh(dSpaceID Space, dTriMeshDataID Data) : dxGeom(Space, 1)
     this->doSphereTC = false;
     this->doBoxTC = false;
     this->doCapsuleTC = false;
+    this->doTriMeshTC = false;
+    this->doTerrainTC = false;
+
+    PairTCCache = NULL;
+    PairTCStamp = 0;
 
     SphereContactsMergeOption = (dxContactMergeOptions)MERGE_NORMALS__SPHERE_DEFAULT;
 
@@ -502,7 +814,7 @@ dxTriMesh::dxTriMesh(dSpaceID Space, dTriMeshDataID Data) : dxGeom(Space, 1)
 }
 
 dxTriMesh::~dxTriMesh(){
-    //
+    delete[] PairTCCache;
 }
 
 // Cleanup for allocations when shutting down ODE
@@ -539,6 +851,55 @@ void dxTriMesh::ClearTCCache()
         CapsuleTCCache[i].~CapsuleTC();
     }
     CapsuleTCCache.setSize(0);
+    if (PairTCCache) {
+        for( i = 0; i < dTRIMESH_PAIR_TC_SIZE; ++i ) {
+            PairTCCache[i].Reset(NULL, NULL);
+        }
+    }
+}
+
+// the slot for Other, or a free or stale slot. NULL when all slots were used
+// recently, cycling through more partners than slots would only thrash them
+TriMeshPairTC* dxTriMesh::GetPairTC(dxGeom* Other, const void* OtherData)
+{
+    if (!PairTCCache)
+    {
+        PairTCCache = new TriMeshPairTC[dTRIMESH_PAIR_TC_SIZE];
+        for (int i = 0; i < dTRIMESH_PAIR_TC_SIZE; i++)
+            PairTCCache[i].Reset(NULL, NULL);
+    }
+    PairTCStamp++;
+
+    TriMeshPairTC* tc = NULL;
+    for (int i = 0; i < dTRIMESH_PAIR_TC_SIZE; i++)
+    {
+        TriMeshPairTC* slot = &PairTCCache[i];
+        if (slot->Geom == Other && slot->Data == OtherData)
+        {
+            slot->Stamp = PairTCStamp;
+            return slot;
+        }
+        if (slot->Geom == NULL)
+        {
+            if (!tc || tc->Geom != NULL)
+                tc = slot;
+        }
+        else if (!tc || (tc->Geom != NULL && PairTCStamp - slot->Stamp > PairTCStamp - tc->Stamp))
+            tc = slot;
+    }
+
+    if (tc->Geom != NULL && PairTCStamp - tc->Stamp <= 2 * dTRIMESH_PAIR_TC_SIZE)
+        return NULL;
+
+    tc->Reset(Other, OtherData);
+    tc->Stamp = PairTCStamp;
+    return tc;
+}
+
+// distance from the mesh origin to the farthest corner of its aabb
+dReal dxTriMesh::GetRadius() const
+{
+    return dCalcVectorLength3(Data->AABBCenter) + dCalcVectorLength3(Data->AABBExtents);
 }
 
 /*
@@ -698,6 +1059,7 @@ void dGeomTriMeshSetData(dGeomID g, dTriMeshDataID Data)
 {
     dUASSERT(g && g->type == dTriMeshClass, "argument not a trimesh");
     ((dxTriMesh*)g)->Data = Data;
+    ((dxTriMesh*)g)->ClearTCCache();
     // I changed my data -- I know nothing about my own AABB anymore.
     ((dxTriMesh*)g)->gflags |= (GEOM_DIRTY|GEOM_AABB_BAD);
 }
@@ -725,6 +1087,12 @@ void dGeomTriMeshEnableTC(dGeomID g, int geomClass, int enable)
     case dCapsuleClass:
         ((dxTriMesh*)g)->doCapsuleTC = (1 == enable);
         break;
+    case dTriMeshClass:
+        ((dxTriMesh*)g)->doTriMeshTC = (1 == enable);
+        break;
+    case dOSTerrainClass:
+        ((dxTriMesh*)g)->doTerrainTC = (1 == enable);
+        break;
     }
 }
 
@@ -746,6 +1114,14 @@ int dGeomTriMeshIsTCEnabled(dGeomID g, int geomClass)
         if (((dxTriMesh*)g)->doCapsuleTC)
             return 1;
         break;
+    case dTriMeshClass:
+        if (((dxTriMesh*)g)->doTriMeshTC)
+            return 1;
+        break;
+    case dOSTerrainClass:
+        if (((dxTriMesh*)g)->doTerrainTC)
+            return 1;
+        break;
     }
     return 0;
 }
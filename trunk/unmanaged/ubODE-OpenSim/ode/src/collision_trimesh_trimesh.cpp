@@ -682,10 +682,65 @@ int dCollideTTL(dxGeom* g1, dxGeom* g2, int Flags, dContactGeom* Contacts, int S
     ////Prepare contact list
     ClearContactSet(hashcontactset);
 
+    MakeMatrix(TLPosition1, TLRotation1, amatrix);
+    MakeMatrix(TLPosition2, TLRotation2, bmatrix);
+
+    dxTriMesh *TriMesh1 = (dxTriMesh*)g1;
+    dxTriMesh *TriMesh2 = (dxTriMesh*)g2;
+    TriMeshPairTC *tc = NULL;
+    if (TriMesh1->doTriMeshTC || TriMesh2->doTriMeshTC)
+        tc = TriMesh1->GetPairTC(g2, TriData2);
+
     // Collision query
-    BOOL IsOk = Collider.Collide(ColCache,
-        &MakeMatrix(TLPosition1, TLRotation1, amatrix),
-        &MakeMatrix(TLPosition2, TLRotation2, bmatrix));
+    BOOL IsOk;
+    if (tc)
+    {
+        // pose of mesh 2 in mesh 1 space
+        dVector3 RelPos, Offset;
+        dMatrix3 RelR;
+        dSubtractVectors3(Offset, TLPosition2, TLPosition1);
+        dMultiply1_331(RelPos, TLRotation1, Offset);
+        dMultiply1_333(RelR, TLRotation1, TLRotation2);
+
+        const dReal Radius = TriMesh2->GetRadius();
+        tc->Margin = dTRIMESH_PAIR_TC_MARGIN * dcMIN(TriMesh1->GetRadius(), Radius);
+
+        if (tc->Valid && TriMeshPairTCMotion(tc->SetPos, tc->SetR, RelPos, RelR, Radius) <= tc->Margin)
+        {
+            IsOk = Collider.CollidePairs(ColCache, tc->Set.data(), tc->Set.size() / 2, &amatrix, &bmatrix);
+        }
+        else if (tc->HasLast && TriMeshPairTCMotion(tc->LastPos, tc->LastR, RelPos, RelR, Radius) <= tc->Margin * dTRIMESH_PAIR_TC_REST)
+        {
+            // resting, keep every pair that can touch within the margin
+            Collider.SetMargin((float)tc->Margin);
+            IsOk = Collider.Collide(ColCache, &amatrix, &bmatrix);
+            Collider.SetMargin(0.0f);
+
+            tc->Valid = IsOk != 0;
+            if (tc->Valid)
+            {
+                const int NbEntries = (int)Collider.GetNbPairs() * 2;
+                tc->Set.setSize(NbEntries);
+                memcpy(tc->Set.data(), Collider.GetPairs(), NbEntries * sizeof(unsigned));
+                dCopyVector3(tc->SetPos, RelPos);
+                dCopyMatrix4x3(tc->SetR, RelR);
+                IsOk = Collider.CollidePairs(ColCache, tc->Set.data(), tc->Set.size() / 2, &amatrix, &bmatrix);
+            }
+        }
+        else
+        {
+            tc->Valid = false;
+            IsOk = Collider.Collide(ColCache, &amatrix, &bmatrix);
+        }
+
+        dCopyVector3(tc->LastPos, RelPos);
+        dCopyMatrix4x3(tc->LastR, RelR);
+        tc->HasLast = true;
+    }
+    else
+    {
+        IsOk = Collider.Collide(ColCache, &amatrix, &bmatrix);
+    }
 
     if (IsOk && Collider.GetContactStatus())
     {
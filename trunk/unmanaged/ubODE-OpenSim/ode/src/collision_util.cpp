@@ -533,7 +533,7 @@ int dClipEdgeToPlane( dVector3 &vEpnt0, dVector3 &vEpnt1, const dVector4& plPlan
     } else if ((fDistance0 > 0 && fDistance1 < 0) || ( fDistance0 < 0 && fDistance1 > 0)) 
     {
         // find intersection point of edge and plane
-        dReal factor = fDistance0 / (fDistance1 - fDistance0);
+        dReal factor = fDistance0 / (fDistance0 - fDistance1);
         // clamp correct edge to intersection point
         if ( fDistance0 < 0 ) 
         {
@@ -32,6 +32,8 @@ By Rodrigo Hernandez
 #include "collision_kernel.h"
 #include "collision_std.h"
 #include "collision_util.h"
+#include "util.h"
+#include "collision_trimesh_internal.h"
 
 #ifdef _MSC_VER
 #pragma warning(disable:4291)  // for VC++, no complaints about "no matching operator delete found"
@@ -67,7 +69,8 @@ dxConvex::dxConvex (dSpaceID space,
     pointcount = _pointcount;
     polygons=_polygons;
     edges = NULL;
-    FillEdges();
+    edgecount = 0;
+    UpdateTopology();
 #ifndef dNODEBUG
     // Check for properly build polygons by calculating the determinant
     // of the 3x3 matrix composed of the first 3 points in the polygon.
@@ -120,41 +123,48 @@ void dxConvex::computeAABB()
     }
 }
 
-/*! \brief Populates the edges set, should be called only once whenever the polygon array gets updated */
+/*! \brief Populates the edges set and the polygons sharing each edge, should be called only once whenever the polygon array gets updated */
 void dxConvex::FillEdges()
 {
-    unsigned int *points_in_poly=polygons;
-    unsigned int *index=polygons+1;
     if (edges!=NULL) delete[] edges;
+    edges = NULL;
     edgecount = 0;
-    edge e;
-    bool isinset;
+
+    // every edge is a side of two polygons, so there are at most as many
+    // edges as polygon sides
+    unsigned int sides = 0;
+    unsigned int *points_in_poly=polygons;
+    for(unsigned int i=0;i<planecount;++i)
+    {
+        sides+=*points_in_poly;
+        points_in_poly+=(*points_in_poly+1);
+    }
+    if(sides==0) return;
+    edges = new edge[sides];
+
+    points_in_poly=polygons;
+    unsigned int *index=polygons+1;
     for(unsigned int i=0;i<planecount;++i)
     {
         for(unsigned int j=0;j<*points_in_poly;++j)
         {
-            e.first = dMIN(index[j],index[(j+1)%*points_in_poly]);
-            e.second = dMAX(index[j],index[(j+1)%*points_in_poly]);
-            isinset=false;
-            for(unsigned int k=0;k<edgecount;++k)
+            const unsigned int first = dMIN(index[j],index[(j+1)%*points_in_poly]);
+            const unsigned int second = dMAX(index[j],index[(j+1)%*points_in_poly]);
+            unsigned int k;
+            for(k=0;k<edgecount;++k)
             {
-                if((edges[k].first==e.first)&&(edges[k].second==e.second))
+                if((edges[k].first==first)&&(edges[k].second==second))
                 {
-                    isinset=true;
+                    edges[k].faces[1]=i;
                     break;
                 }
             }
-            if(!isinset)
+            if(k==edgecount)
             {
-                edge* tmp = new edge[edgecount+1];
-                if(edgecount!=0)
-                {
-                    memcpy(tmp,edges,(edgecount)*sizeof(edge));
-                    delete[] edges;
-                }
-                tmp[edgecount].first=e.first;
-                tmp[edgecount].second=e.second;
-                edges = tmp;
+                edges[edgecount].first=first;
+                edges[edgecount].second=second;
+                edges[edgecount].faces[0]=i;
+                edges[edgecount].faces[1]=i;
                 ++edgecount;
             }
         }
@@ -162,48 +172,27 @@ void dxConvex::FillEdges()
         index=points_in_poly+1;
     }
 }
-#if 0
-dxConvex::BSPNode* dxConvex::CreateNode(std::vector<Arc> Arcs,std::vector<Polygon> Polygons)
-{
-#if 0
-    dVector3 ea,eb,e;
-    dCopyVector3r4(ea, points+((edges.begin()+Arcs[0].edge)first*3));
-    dMultiply0_331(e1b,cvx1.final_posr->R,cvx1.points+(i->second*3));
 
-    dVector3Copy(points[edges[Arcs[0].edge]
-#endif
-    return NULL;
-}
-
-void dxConvex::CreateTree()
+void dxConvex::UpdateTopology()
 {
-    std::vector<Arc> A;
-    A.reserve(edgecount);
-    for(unsigned int i=0;i<edgecount;++i)
-    {
-        this->GetFacesSharedByEdge(i,A[i].normals);
-        A[i].edge = i;
-    }
-    std::vector<Polygon> S;
-    S.reserve(pointcount);
-    for(unsigned int i=0;i<pointcount;++i)
+    FillEdges();
+
+    saabb[0] = saabb[1] = points[0];
+    saabb[2] = saabb[3] = points[1];
+    saabb[4] = saabb[5] = points[2];
+    for(unsigned int i=3;i<(pointcount*3);i+=3)
     {
-        this->GetFacesSharedByVertex(i,S[i].normals);
-        S[i].vertex=i;
+        saabb[0] = dMIN(saabb[0],points[i]);
+        saabb[1] = dMAX(saabb[1],points[i]);
+        saabb[2] = dMIN(saabb[2],points[i+1]);
+        saabb[3] = dMAX(saabb[3],points[i+1]);
+        saabb[4] = dMIN(saabb[4],points[i+2]);
+        saabb[5] = dMAX(saabb[5],points[i+2]);
     }
-    this->tree = CreateNode(A,S);
-}
 
-void dxConvex::GetFacesSharedByVertex(int i, std::vector<int> f)
-{
-}
-void dxConvex::GetFacesSharedByEdge(int i, int* f)
-{
+    for(unsigned int i=0;i<dCONVEX_SAT_CACHE_SIZE;++i)
+        satCache[i] = 0;
 }
-void dxConvex::GetFaceNormal(int i, dVector3 normal)
-{
-}
-#endif
 
 dGeomID dCreateConvex (dSpaceID space,dReal *_planes,unsigned int _planecount,
                        dReal *_points,
@@ -230,76 +219,63 @@ void dGeomSetConvex (dGeomID g,dReal *_planes,unsigned int _planecount,
     s->points = _points;
     s->pointcount = _pointcount;
     s->polygons=_polygons;
+    s->UpdateTopology();
+    dGeomMoved (g);
+}
+
+dReal dGeomConvexPointDepth (dGeomID g, dReal x, dReal y, dReal z)
+{
+    dUASSERT (g && g->type == dConvexClass,"argument not a convex shape");
+    g->recomputePosr();
+    dxConvex *Convex = (dxConvex*) g;
+
+    dVector3 p,lp;
+    p[0] = x - Convex->final_posr->pos[0];
+    p[1] = y - Convex->final_posr->pos[1];
+    p[2] = z - Convex->final_posr->pos[2];
+    dMultiply1_331 (lp,Convex->final_posr->R,p);
+
+    // the plane the point is furthest out of gives the depth, exact inside
+    dReal depth = dInfinity;
+    for(unsigned int i=0;i<Convex->planecount;++i)
+    {
+        const dReal *plane = Convex->planes+(i*4);
+        const dReal d = plane[3] - (plane[0]*lp[0] + plane[1]*lp[1] + plane[2]*lp[2]);
+        if(d < depth) depth = d;
+    }
+    return depth;
 }
 
 //****************************************************************************
 // Helper Inlines
 //
 
-/*! \brief Returns Whether or not the segment ab intersects plane p
-  \param a origin of the segment
-  \param b segment destination
-  \param p plane to test for intersection
-  \param t returns the time "t" in the segment ray that gives us the intersecting
-  point
-  \param q returns the intersection point
-  \return true if there is an intersection, otherwise false.
-*/
-bool IntersectSegmentPlane(dVector3 a,
-                           dVector3 b,
-                           dVector4 p,
-                           dReal &t,
-                           dVector3 q)
+// the convex arrays are packed 3 values per point, so they are not read
+// with the 4 wide vector helpers
+static inline void ConvexTransformPoint(dReal *res, const dReal *R, const dReal *pos, const dReal *p)
 {
-    // Compute the t value for the directed line ab intersecting the plane
-    dVector3 ab;
-    ab[0]= b[0] - a[0];
-    ab[1]= b[1] - a[1];
-    ab[2]= b[2] - a[2];
+    res[0] = R[0]*p[0] + R[1]*p[1] + R[2]*p[2] + pos[0];
+    res[1] = R[4]*p[0] + R[5]*p[1] + R[6]*p[2] + pos[1];
+    res[2] = R[8]*p[0] + R[9]*p[1] + R[10]*p[2] + pos[2];
+}
 
-    t = (p[3] - dCalcVectorDot3(p,a)) / dCalcVectorDot3(p,ab);
+static inline void ConvexRotateVector(dReal *res, const dReal *R, const dReal *v)
+{
+    res[0] = R[0]*v[0] + R[1]*v[1] + R[2]*v[2];
+    res[1] = R[4]*v[0] + R[5]*v[1] + R[6]*v[2];
+    res[2] = R[8]*v[0] + R[9]*v[1] + R[10]*v[2];
+}
 
-    // If t in [0..1] compute and return intersection point
-    if (t >= 0.0 && t <= 1.0)
-    {
-        q[0] = a[0] + t * ab[0];
-        q[1] = a[1] + t * ab[1];
-        q[2] = a[2] + t * ab[2];
-        return true;
-    }
-    // Else no intersection
-    return false;
+static inline dReal ConvexDot(const dReal *a, const dReal *b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
 }
 
-/*! \brief Returns the Closest Point in Ray 1 to Ray 2
-  \param Origin1 The origin of Ray 1
-  \param Direction1 The direction of Ray 1
-  \param Origin1 The origin of Ray 2
-  \param Direction1 The direction of Ray 3
-  \param t the time "t" in Ray 1 that gives us the closest point
-  (closest_point=Origin1+(Direction1*t).
-  \return true if there is a closest point, false if the rays are paralell.
-*/
-inline bool ClosestPointInRay(const dVector3 Origin1,
-                              const dVector3 Direction1,
-                              const dVector3 Origin2,
-                              const dVector3 Direction2,
-                              dReal& t)
+static inline void ConvexCross(dReal *res, const dReal *a, const dReal *b)
 {
-    dVector3 w;
-    dSubtractVectors3r4(w, Origin1, Origin2);
-    dReal a = dCalcVectorLengthSquare3(Direction1);
-    dReal b = dCalcVectorDot3(Direction1 , Direction2);
-    dReal c = dCalcVectorLengthSquare3(Direction2);
-    dReal d = dCalcVectorDot3(Direction1 , w);
-    dReal e = dCalcVectorDot3(Direction2 , w);
-    dReal denominator = (a*c)-(b*b);
-    if(denominator==0.0f)
-    {
-        return false;
-    }
-    t = ((a*e)-(b*d))/denominator;
-    return true;
+    res[0] = a[1]*b[2] - a[2]*b[1];
+    res[1] = a[2]*b[0] - a[0]*b[2];
+    res[2] = a[0]*b[1] - a[1]*b[0];
 }
 
 /*! \brief Clamp n to lie within the range [min, max] */
@@ -314,17 +290,17 @@ inline float Clamp(float n, float min, float max)
   \param q1 end of segment 1
   \param p2 start of segment 2
   \param q2 end of segment 2
-  \param t the time "t" in Ray 1 that gives us the closest point
-  (closest_point=Origin1+(Direction1*t).
-  \return true if there is a closest point, false if the rays are paralell.
+  \param c1 closest point on segment 1
+  \param c2 closest point on segment 2
+  \return the squared distance between c1 and c2.
   \note Adapted from Christer Ericson's Real Time Collision Detection Book.
 */
-inline float ClosestPointBetweenSegments(dVector3& p1,
-                                         dVector3& q1,
-                                         dVector3& p2,
-                                         dVector3& q2,
-                                         dVector3& c1,
-                                         dVector3& c2)
+inline float ClosestPointBetweenSegments(const dReal *p1,
+                                         const dReal *q1,
+                                         const dReal *p2,
+                                         const dReal *q2,
+                                         dReal *c1,
+                                         dReal *c2)
 {
     // s & t were originaly part of the output args, but since
     // we don't really need them, we'll just declare them in here
@@ -339,21 +315,16 @@ inline float ClosestPointBetweenSegments(dVector3& p1,
     dVector3 r  = {p1[0] - p2[0],
         p1[1] - p2[1],
         p1[2] - p2[2]};
-    float a = dCalcVectorLengthSquare3(d1);
-    float e = dCalcVectorLengthSquare3(d2);
-    float f = dCalcVectorDot3(d2, r);
+    float a = ConvexDot(d1, d1);
+    float e = ConvexDot(d2, d2);
+    float f = ConvexDot(d2, r);
     // Check if either or both segments degenerate into points
     if (a <= dEpsilon && e <= dEpsilon)
     {
         // Both segments degenerate into points
         s = t = 0.0f;
-        dCopyVector3r4(c1, p1);
-        dCopyVector3r4(c2, p2);
-        return (c1[0] - c2[0])*(c1[0] - c2[0])+
-            (c1[1] - c2[1])*(c1[1] - c2[1])+
-            (c1[2] - c2[2])*(c1[2] - c2[2]);
     }
-    if (a <= dEpsilon)
+    else if (a <= dEpsilon)
     {
         // First segment degenerates into a point
         s = 0.0f;
@@ -362,7 +333,7 @@ inline float ClosestPointBetweenSegments(dVector3& p1,
     }
     else
     {
-        float c = dCalcVectorDot3(d1, r);
+        float c = ConvexDot(d1, r);
         if (e <= dEpsilon)
         {
             // Second segment degenerates into a point
@@ -372,7 +343,7 @@ inline float ClosestPointBetweenSegments(dVector3& p1,
         else
         {
             // The general non degenerate case starts here
-            float b = dCalcVectorDot3(d1, d2);
+            float b = ConvexDot(d1, d2);
             float denom = a*e-b*b; // Always nonnegative
 
             // If segments not parallel, compute closest point on L1 to L2, and
@@ -382,22 +353,9 @@ inline float ClosestPointBetweenSegments(dVector3& p1,
                 s = Clamp((b*f - c*e) / denom, 0.0f, 1.0f);
             }
             else s = 0.0f;
-#if 0
-            // Compute point on L2 closest to S1(s) using
-            // t = Dot((P1+D1*s)-P2,D2) / Dot(D2,D2) = (b*s + f) / e
-            t = (b*s + f) / e;
-
-            // If t in [0,1] done. Else clamp t, recompute s for the new value
-            // of t using s = Dot((P2+D2*t)-P1,D1) / Dot(D1,D1)= (t*b - c) / a
-            // and clamp s to [0, 1]
-            if (t < 0.0f) {
-                t = 0.0f;
-                s = Clamp(-c / a, 0.0f, 1.0f);
-            } else if (t > 1.0f) {
-                t = 1.0f;
-                s = Clamp((b - c) / a, 0.0f, 1.0f);
-            }
-#else
+
+            // Compute point on L2 closest to S1(s), if it is outside of
+            // the segment clamp it and recompute s
             float tnom = b*s + f;
             if (tnom < 0.0f)
             {
@@ -413,7 +371,6 @@ inline float ClosestPointBetweenSegments(dVector3& p1,
             {
                 t = tnom / e;
             }
-#endif
         }
     }
 
@@ -428,163 +385,790 @@ inline float ClosestPointBetweenSegments(dVector3& p1,
         (c1[2] - c2[2])*(c1[2] - c2[2]);
 }
 
-#if 0
-float tnom = b*s + f;
-if (tnom < 0.0f) {
-    t = 0.0f;
-    s = Clamp(-c / a, 0.0f, 1.0f);
-} else if (tnom > e) {
-    t = 1.0f;
-    s = Clamp((b - c) / a, 0.0f, 1.0f);
-} else {
-    t = tnom / e;
+/*! \brief Finds the closest point of a convex polygon to a point in the
+  polygon plane or in front of it
+  \param p the point, in convex space
+  \param polygon the polygon, point count followed by the point indices
+  \param plane the polygon plane
+  \param points the convex points
+  \param out the closest point
+  \return true if p projects inside the polygon
+*/
+static bool ClosestPointOnPolygon(const dReal *p,
+                                  const unsigned int *polygon,
+                                  const dReal *plane,
+                                  const dReal *points,
+                                  dVector3 out)
+{
+    const unsigned int count = polygon[0];
+    const unsigned int *index = polygon + 1;
+    dIASSERT(count != 0);
+
+    bool inside = true;
+    dReal best = dInfinity;
+    const dReal *a = points + index[count-1]*3;
+    for(unsigned int i=0;i!=count;++i)
+    {
+        const dReal *b = points + index[i]*3;
+        dVector3 ab, ap, side;
+        dSubtractVectors3(ab, b, a);
+        dSubtractVectors3(ap, p, a);
+        ConvexCross(side, ab, plane);
+        if(ConvexDot(ap, side) > REAL(0.0))
+        {
+            // outside of this side, the closest point may be on it
+            inside = false;
+            const dReal ab_m2 = ConvexDot(ab, ab);
+            dReal s = ab_m2 != REAL(0.0) ? ConvexDot(ab, ap) / ab_m2 : REAL(0.0);
+            s = dMAX(REAL(0.0), dMIN(REAL(1.0), s));
+            dVector3 q, pq;
+            dAddScaledVector3(q, a, ab, s);
+            dSubtractVectors3(pq, p, q);
+            const dReal d = ConvexDot(pq, pq);
+            if(d < best)
+            {
+                best = d;
+                dCopyVector3(out, q);
+            }
+        }
+        a = b;
+    }
+    if(inside)
+    {
+        const dReal d = ConvexDot(plane, p) - plane[3];
+        dAddScaledVector3(out, p, plane, -d);
+    }
+    return inside;
+}
+
+static const unsigned int *ConvexGetPolygon(const unsigned int *polygons, unsigned int face)
+{
+    for(unsigned int i=0;i<face;++i)
+        polygons+=polygons[0]+1;
+    return polygons;
 }
-#endif
 
-/*! \brief Returns the Ray on which 2 planes intersect if they do.
-  \param p1 Plane 1
-  \param p2 Plane 2
-  \param p Contains the origin of the ray upon returning if planes intersect
-  \param d Contains the direction of the ray upon returning if planes intersect
-  \return true if the planes intersect, false if paralell.
-*/
-inline bool IntersectPlanes(const dVector4 p1, const dVector4 p2, dVector3 p, dVector3 d)
+
+//****************************************************************************
+// Separating axis test between convex polytopes, used by the convex vs
+// convex, box and triangle colliders. Everything is in world space.
+//
+// Edge pairs are only tested when their arcs cross on the Gauss map (see
+// D. Gregorius, "The Separating Axis Test between Convex Polyhedra",
+// GDC 2013), so most of the E1*E2 cross products are never formed.
+// The axis found last is cached per pair, it proves separation on its own
+// for pairs whose boxes overlap but that do not touch.
+
+// a convex polytope in world space
+struct dxConvexPolytope
 {
-    // Compute direction of intersection line
-    dCalcVectorCross3r4(d,p1,p2);
-    // If d is (near) zero, the planes are parallel (and separated)
-    // or coincident, so they're not considered intersecting
-    dReal denom = dCalcVectorDot3(d, d);
-    if (denom < dEpsilon) return false;
-    dVector3 n;
-    n[0]=p1[3]*p2[0] - p2[3]*p1[0];
-    n[1]=p1[3]*p2[1] - p2[3]*p1[1];
-    n[2]=p1[3]*p2[2] - p2[3]*p1[2];
-    // Compute point on intersection line
-    dCalcVectorCross3r4(p,n,d);
-    p[0]/=denom;
-    p[1]/=denom;
-    p[2]/=denom;
-    return true;
+    const dReal *points;            // 3 values per point
+    unsigned int pointCount;
+    const dReal *planes;            // unit normal and distance per plane
+    unsigned int planeCount;        // planes tested for separation
+    unsigned int faceCount;         // the first planes, the ones with a polygon
+    const unsigned int *polygons;   // dxConvex::polygons layout
+    const dxConvex::edge *edges;    // faces index planes
+    unsigned int edgeCount;
+};
+
+// an edge with the normals of its two planes, the arc on the Gauss map
+struct dxConvexEdgeArc
+{
+    dVector3 a, b;
+    dVector3 bxa;
+    dVector3 direction;
+    const dReal *point;
+};
+
+// a contact point before it is written out
+struct dxConvexContactPoint
+{
+    dVector3 pos;
+    dReal depth;
+};
+
+#define CONVEX_SAT_NONE     0
+#define CONVEX_SAT_FACE_A   1
+#define CONVEX_SAT_FACE_B   2
+#define CONVEX_SAT_EDGES    3
+#define CONVEX_SAT_INDEX_BITS 15
+
+// a separating or contact axis, kind and one or two feature indices
+static inline duint32 ConvexSATFeature(duint32 kind, unsigned int i, unsigned int j)
+{
+    if (i >> CONVEX_SAT_INDEX_BITS || j >> CONVEX_SAT_INDEX_BITS)
+        return CONVEX_SAT_NONE;
+    return kind | (i << 2) | (j << (2 + CONVEX_SAT_INDEX_BITS));
+}
+
+static inline duint32 ConvexCacheKey(const dxGeom *other)
+{
+    const size_t address = (size_t)other;
+    return (duint32)(address ^ (address >> 16));
 }
 
+static inline unsigned int ConvexCacheSlot(const dxGeom *other)
+{
+    return (unsigned int)((size_t)other >> 4) & (dCONVEX_SAT_CACHE_SIZE - 1);
+}
 
-#if 0
-/*! \brief Finds out if a point lies inside a convex
-  \param p Point to test
-  \param convex a pointer to convex to test against
-  \return true if the point lies inside the convex, false if not.
-*/
-inline bool IsPointInConvex(dVector3 p,
-                            dxConvex *convex)
+// the whole entry is read and written at once, a stale or foreign entry
+// only costs a wasted test
+static duint32 ConvexCacheGet(const dxConvex *cvx, const dxGeom *other)
+{
+    const duint64 entry = cvx->satCache[ConvexCacheSlot(other)];
+    return (duint32)(entry >> 32) == ConvexCacheKey(other) ? (duint32)entry : CONVEX_SAT_NONE;
+}
+
+static void ConvexCacheSet(dxConvex *cvx, const dxGeom *other, duint32 feature)
+{
+    cvx->satCache[ConvexCacheSlot(other)] = ((duint64)ConvexCacheKey(other) << 32) | feature;
+}
+
+static dReal ConvexMinProjection(const dxConvexPolytope &p, const dReal *axis)
 {
-    dVector3 lp,tmp;
-    // move point into convex space to avoid plane local to world calculations
-    tmp[0] = p[0] - convex->final_posr->pos[0];
-    tmp[1] = p[1] - convex->final_posr->pos[1];
-    tmp[2] = p[2] - convex->final_posr->pos[2];
-    dMultiply1_331 (lp,convex->final_posr->R,tmp);
-    for(unsigned int i=0;i<convex->planecount;++i)
+    const dReal *point = p.points;
+    dReal result = ConvexDot(axis, point);
+    for(unsigned int i=1;i<p.pointCount;++i)
     {
-        if((
-            ((convex->planes+(i*4))[0]*lp[0])+
-            ((convex->planes+(i*4))[1]*lp[1])+
-            ((convex->planes+(i*4))[2]*lp[2])+
-            -(convex->planes+(i*4))[3]
-        )>0)
+        point += 3;
+        const dReal d = ConvexDot(axis, point);
+        if(d < result) result = d;
+    }
+    return result;
+}
+
+static void ConvexProjection(const dxConvexPolytope &p, const dReal *axis, dReal &min, dReal &max)
+{
+    const dReal *point = p.points;
+    min = max = ConvexDot(axis, point);
+    for(unsigned int i=1;i<p.pointCount;++i)
+    {
+        point += 3;
+        const dReal d = ConvexDot(axis, point);
+        if(d < min) min = d;
+        else if(d > max) max = d;
+    }
+}
+
+static inline dReal ConvexFaceSeparation(const dxConvexPolytope &a, unsigned int i, const dxConvexPolytope &b)
+{
+    const dReal *plane = a.planes + i*4;
+    return ConvexMinProjection(b, plane) - plane[3];
+}
+
+static void ConvexGetEdgeArc(const dxConvexPolytope &p, unsigned int i, bool negate, dxConvexEdgeArc &arc)
+{
+    const dxConvex::edge &e = p.edges[i];
+    const dReal *na = p.planes + e.faces[0]*4;
+    const dReal *nb = p.planes + e.faces[1]*4;
+    if(negate)
+    {
+        dCopyNegatedVector3(arc.a, na);
+        dCopyNegatedVector3(arc.b, nb);
+    }
+    else
+    {
+        dCopyVector3(arc.a, na);
+        dCopyVector3(arc.b, nb);
+    }
+    ConvexCross(arc.bxa, arc.b, arc.a);
+    arc.point = p.points + e.first*3;
+    dSubtractVectors3(arc.direction, p.points + e.second*3, arc.point);
+}
+
+// the arcs of a and of the negated b cross, so the edges build a face of
+// the Minkowski difference
+static inline bool ConvexIsMinkowskiFace(const dxConvexEdgeArc &ea, const dxConvexEdgeArc &eb)
+{
+    const dReal cba = ConvexDot(eb.a, ea.bxa);
+    const dReal dba = ConvexDot(eb.b, ea.bxa);
+    const dReal adc = ConvexDot(ea.a, eb.bxa);
+    const dReal bdc = ConvexDot(ea.b, eb.bxa);
+    return cba*dba < 0 && adc*bdc < 0 && cba*bdc > 0;
+}
+
+// the axis of an edge pair pointing out of a, false for parallel edges
+static bool ConvexEdgeAxis(const dxConvexEdgeArc &ea, const dxConvexEdgeArc &eb, dVector3 axis)
+{
+    ConvexCross(axis, ea.direction, eb.direction);
+    const dReal length2 = ConvexDot(axis, axis);
+    if(length2 < REAL(1e-6) * ConvexDot(ea.direction, ea.direction) * ConvexDot(eb.direction, eb.direction))
+        return false;
+    dReal scale = dRecipSqrt(length2);
+    dVector3 outward;
+    dAddVectors3(outward, ea.a, ea.b);
+    if(ConvexDot(axis, outward) < 0) scale = -scale;
+    dScaleVector3(axis, scale);
+    return true;
+}
+
+// best face of a, false and the separating plane if a plane of a separates
+static bool ConvexQueryFaces(const dxConvexPolytope &a, const dxConvexPolytope &b,
+                             unsigned int &face, dReal &separation)
+{
+    face = 0;
+    separation = -dInfinity;
+    for(unsigned int i=0;i<a.planeCount;++i)
+    {
+        const dReal s = ConvexFaceSeparation(a, i, b);
+        if(s > 0)
         {
+            face = i;
+            separation = s;
             return false;
         }
+        if(i < a.faceCount && s > separation)
+        {
+            face = i;
+            separation = s;
+        }
     }
     return true;
 }
-#endif
 
-/*! \brief Finds out if a point lies inside a 2D polygon
-  \param p Point to test
-  \param polygon a pointer to the start of the convex polygon index buffer
-  \param out the closest point in the polygon if the point is not inside
-  \return true if the point lies inside of the polygon, false if not.
-*/
-inline bool IsPointInPolygon(dVector3 p,
-                             unsigned int *polygon,
-			                 dReal *plane,
-                             dxConvex *convex,
-                             dVector3 out)
+// best edge pair, false and the separating pair if one separates
+static bool ConvexQueryEdges(const dxConvexPolytope &a, const dxConvexPolytope &b,
+                             unsigned int &edgeA, unsigned int &edgeB, dReal &separation)
 {
-    // p is the point we want to check,
-    // polygon is a pointer to the polygon we
-    // are checking against, remember it goes
-    // number of vertices then that many indexes
-    // out returns the closest point on the border of the
-    // polygon if the point is not inside it.
-    dVector3 a;
-    dVector3 b;
-    dVector3 ab;
-    dVector3 ap;
-    dVector3 v;
-
-    unsigned pointcount=polygon[0];
-    dIASSERT(pointcount != 0);
-    polygon++; // skip past pointcount
-
-    dMultiply0_331 (b,convex->final_posr->R,
-        &convex->points[(polygon[pointcount-1]*3)]);
-    b[0]=convex->final_posr->pos[0]+b[0];
-    b[1]=convex->final_posr->pos[1]+b[1];
-    b[2]=convex->final_posr->pos[2]+b[2];
-    
-    for(unsigned i=0; i != pointcount; ++i)
+    edgeA = edgeB = 0;
+    separation = -dInfinity;
+    if(a.edgeCount == 0 || b.edgeCount == 0)
+        return true;
+
+    dxConvexEdgeArc *arcsB = (dxConvexEdgeArc*)dALLOCA16(b.edgeCount * sizeof(dxConvexEdgeArc));
+    for(unsigned int j=0;j<b.edgeCount;++j)
+        ConvexGetEdgeArc(b, j, true, arcsB[j]);
+
+    dxConvexEdgeArc arcA;
+    dVector3 axis, offset;
+    for(unsigned int i=0;i<a.edgeCount;++i)
     {
-        a[0] = b[0];
-        a[1] = b[1];
-        a[2] = b[2];
+        ConvexGetEdgeArc(a, i, false, arcA);
+        for(unsigned int j=0;j<b.edgeCount;++j)
+        {
+            const dxConvexEdgeArc &arcB = arcsB[j];
+            if(!ConvexIsMinkowskiFace(arcA, arcB)) continue;
+            if(!ConvexEdgeAxis(arcA, arcB, axis)) continue;
+
+            dSubtractVectors3(offset, arcB.point, arcA.point);
+            const dReal s = ConvexDot(axis, offset);
+            if(s > separation)
+            {
+                edgeA = i;
+                edgeB = j;
+                separation = s;
+                if(s > 0) return false;
+            }
+        }
+    }
+    return true;
+}
 
-        dMultiply0_331 (b,convex->final_posr->R,&convex->points[(polygon[i]*3)]);
-        b[0]=convex->final_posr->pos[0]+b[0];
-        b[1]=convex->final_posr->pos[1]+b[1];
-        b[2]=convex->final_posr->pos[2]+b[2];
+// separation along a cached axis, the full extent of both shapes is used
+// so any axis gives a valid answer
+static dReal ConvexFeatureSeparation(const dxConvexPolytope &a, const dxConvexPolytope &b, duint32 feature)
+{
+    const unsigned int i = (feature >> 2) & ((1 << CONVEX_SAT_INDEX_BITS) - 1);
+    const unsigned int j = feature >> (2 + CONVEX_SAT_INDEX_BITS);
+    switch(feature & 3)
+    {
+        case CONVEX_SAT_FACE_A:
+            if(i < a.planeCount) return ConvexFaceSeparation(a, i, b);
+            break;
+
+        case CONVEX_SAT_FACE_B:
+            if(i < b.planeCount) return ConvexFaceSeparation(b, i, a);
+            break;
+
+        case CONVEX_SAT_EDGES:
+            if(i < a.edgeCount && j < b.edgeCount)
+            {
+                dxConvexEdgeArc arcA, arcB;
+                ConvexGetEdgeArc(a, i, false, arcA);
+                ConvexGetEdgeArc(b, j, true, arcB);
+                dVector3 axis;
+                if(!ConvexEdgeAxis(arcA, arcB, axis)) break;
+                dReal minA, maxA, minB, maxB;
+                ConvexProjection(a, axis, minA, maxA);
+                ConvexProjection(b, axis, minB, maxB);
+                return dMAX(minB - maxA, minA - maxB);
+            }
+            break;
+    }
+    return -dInfinity;
+}
 
-        ab[0] = b[0] - a[0];
-        ab[1] = b[1] - a[1];
-        ab[2] = b[2] - a[2];
-        ap[0] = p[0] - a[0];
-        ap[1] = p[1] - a[1];
-        ap[2] = p[2] - a[2];
+// keeps the deepest point, then each time the point furthest from the
+// ones kept
+static int ConvexReducePoints(dxConvexContactPoint *points, int count, int maxc)
+{
+    if(count <= maxc) return count;
 
-        dCalcVectorCross3r4(v, ab, plane);
+    int deepest = 0;
+    for(int i=1;i<count;++i)
+        if(points[i].depth > points[deepest].depth) deepest = i;
+    dxConvexContactPoint tmp = points[0]; points[0] = points[deepest]; points[deepest] = tmp;
 
-        if (dCalcVectorDot3(ap, v) > REAL(0.0))
+    for(int k=1;k<maxc;++k)
+    {
+        int furthest = k;
+        dReal furthestDistance = -REAL(1.0);
+        for(int i=k;i<count;++i)
         {
-            dReal ab_m2 = dCalcVectorDot3(ab, ab);
-            dReal s = ab_m2 != REAL(0.0) ? dCalcVectorDot3(ab, ap) / ab_m2 : REAL(0.0);
-            
-            if (s <= REAL(0.0))
+            dReal distance = dInfinity;
+            for(int j=0;j<k;++j)
             {
-                out[0] = a[0];
-                out[1] = a[1];
-                out[2] = a[2];
+                dVector3 d;
+                dSubtractVectors3(d, points[i].pos, points[j].pos);
+                distance = dMIN(distance, ConvexDot(d, d));
             }
-            else if (s >= REAL(1.0)) 
+            if(distance > furthestDistance)
             {
-                out[0] = b[0];
-                out[1] = b[1];
-                out[2] = b[2];
+                furthestDistance = distance;
+                furthest = i;
             }
-            else
+        }
+        tmp = points[k]; points[k] = points[furthest]; points[furthest] = tmp;
+    }
+    return maxc;
+}
+
+static int ConvexWriteContacts(const dxConvexContactPoint *points, int count, const dReal *normal,
+                               int flags, dContactGeom *contact, int skip)
+{
+    for(int i=0;i<count;++i)
+    {
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        dCopyVector3(target->pos, points[i].pos);
+        dCopyVector3(target->normal, normal);
+        target->depth = points[i].depth;
+        target->side1 = -1;
+        target->side2 = -1;
+    }
+    return count;
+}
+
+// clips the most antiparallel face of incident against the side planes of
+// the reference face, the points below the reference face are the contacts
+static int ConvexFaceContacts(const dxConvexPolytope &reference, unsigned int face,
+                              const dxConvexPolytope &incident, dReal separation,
+                              dxConvexContactPoint *result, int maxc)
+{
+    const dReal *n = reference.planes + face*4;
+
+    unsigned int incidentFace = 0;
+    dReal minDot = dInfinity;
+    for(unsigned int i=0;i<incident.faceCount;++i)
+    {
+        const dReal d = ConvexDot(incident.planes + i*4, n);
+        if(d < minDot)
+        {
+            minDot = d;
+            incidentFace = i;
+        }
+    }
+
+    const unsigned int *refPoly = ConvexGetPolygon(reference.polygons, face);
+    const unsigned int *incPoly = ConvexGetPolygon(incident.polygons, incidentFace);
+    const unsigned int refCount = refPoly[0];
+    const unsigned int incCount = incPoly[0];
+
+    // each side can add one point
+    const unsigned int capacity = incCount + refCount;
+    dReal *input = (dReal*)dALLOCA16(capacity * 3 * sizeof(dReal));
+    dReal *output = (dReal*)dALLOCA16(capacity * 3 * sizeof(dReal));
+    for(unsigned int i=0;i<incCount;++i)
+        dCopyVector3(input + i*3, incident.points + incPoly[1+i]*3);
+    unsigned int count = incCount;
+
+    dVector3 center = {0, 0, 0};
+    for(unsigned int i=0;i<refCount;++i)
+        dAddVector3(center, reference.points + refPoly[1+i]*3);
+    dScaleVector3(center, REAL(1.0) / refCount);
+
+    const dReal *v0 = reference.points + refPoly[refCount]*3;
+    for(unsigned int k=0;k<refCount && count!=0;++k)
+    {
+        const dReal *v1 = reference.points + refPoly[1+k]*3;
+        dVector3 edge, side, toCenter;
+        dSubtractVectors3(edge, v1, v0);
+        ConvexCross(side, edge, n);
+        dSubtractVectors3(toCenter, center, v0);
+        if(ConvexDot(side, toCenter) > 0) dNegateVector3(side);
+        const dReal sideDistance = ConvexDot(side, v0);
+
+        unsigned int outCount = 0;
+        const dReal *p = input + (count-1)*3;
+        dReal dp = ConvexDot(side, p) - sideDistance;
+        for(unsigned int i=0;i<count;++i)
+        {
+            const dReal *q = input + i*3;
+            const dReal dq = ConvexDot(side, q) - sideDistance;
+            // rounding can leave the polygon slightly concave when faces
+            // coincide, never write past the buffers
+            if((dp <= 0) != (dq <= 0) && outCount < capacity)
+            {
+                const dReal t = dp / (dp - dq);
+                dReal *x = output + outCount*3;
+                x[0] = p[0] + (q[0] - p[0])*t;
+                x[1] = p[1] + (q[1] - p[1])*t;
+                x[2] = p[2] + (q[2] - p[2])*t;
+                ++outCount;
+            }
+            if(dq <= 0 && outCount < capacity)
             {
-                out[0] = a[0] + ab[0] * s;
-                out[1] = a[1] + ab[1] * s;
-                out[2] = a[2] + ab[2] * s;
+                dCopyVector3(output + outCount*3, q);
+                ++outCount;
             }
+            p = q;
+            dp = dq;
+        }
 
-            return false;
+        dReal *swap = input; input = output; output = swap;
+        count = outCount;
+        v0 = v1;
+    }
+
+    int found = 0;
+    const int maxFound = (int)capacity;
+    dxConvexContactPoint *points = (dxConvexContactPoint*)dALLOCA16(maxFound * sizeof(dxConvexContactPoint));
+    for(unsigned int i=0;i<count;++i)
+    {
+        const dReal *p = input + i*3;
+        const dReal d = ConvexDot(n, p) - n[3];
+        if(d <= 0)
+        {
+            dCopyVector3(points[found].pos, p);
+            points[found].depth = -d;
+            ++found;
+        }
+    }
+
+    if(found == 0)
+    {
+        // numerical corner, use the deepest incident point
+        const dReal *deepest = incident.points;
+        dReal deepestDistance = dInfinity;
+        for(unsigned int i=0;i<incident.pointCount;++i)
+        {
+            const dReal d = ConvexDot(n, incident.points + i*3);
+            if(d < deepestDistance)
+            {
+                deepestDistance = d;
+                deepest = incident.points + i*3;
+            }
         }
+        dCopyVector3(result[0].pos, deepest);
+        result[0].depth = -separation;
+        return 1;
+    }
+
+    found = ConvexReducePoints(points, found, maxc);
+    for(int i=0;i<found;++i)
+        result[i] = points[i];
+    return found;
+}
+
+/*! \brief Collides two polytopes, the normal points into a like for the
+  other colliders
+  \param feature [IN/OUT] axis to test first, set to the axis found
+  \param normal [OUT] contact normal
+  \param result [OUT] at most maxc contact points
+  \return the number of contact points
+*/
+static int ConvexCollidePolytopes(const dxConvexPolytope &a, const dxConvexPolytope &b,
+                                  duint32 &feature, dVector3 normal,
+                                  dxConvexContactPoint *result, int maxc)
+{
+    if(feature != CONVEX_SAT_NONE && ConvexFeatureSeparation(a, b, feature) > 0)
+        return 0;
+
+    unsigned int faceA, faceB, edgeA, edgeB;
+    dReal separationA, separationB, separationE;
+    if(!ConvexQueryFaces(a, b, faceA, separationA))
+    {
+        feature = ConvexSATFeature(CONVEX_SAT_FACE_A, faceA, 0);
+        return 0;
+    }
+    if(!ConvexQueryFaces(b, a, faceB, separationB))
+    {
+        feature = ConvexSATFeature(CONVEX_SAT_FACE_B, faceB, 0);
+        return 0;
+    }
+    if(!ConvexQueryEdges(a, b, edgeA, edgeB, separationE))
+    {
+        feature = ConvexSATFeature(CONVEX_SAT_EDGES, edgeA, edgeB);
+        return 0;
+    }
+
+    // faces make better manifolds, so they win unless clearly shallower
+    const dReal relativeTolerance = REAL(0.95);
+    const dReal absoluteTolerance = REAL(0.001);
+    const dReal separationF = dMAX(separationA, separationB);
+
+    if(separationE > relativeTolerance*separationF + absoluteTolerance)
+    {
+        feature = ConvexSATFeature(CONVEX_SAT_EDGES, edgeA, edgeB);
+
+        dxConvexEdgeArc arcA, arcB;
+        ConvexGetEdgeArc(a, edgeA, false, arcA);
+        ConvexGetEdgeArc(b, edgeB, true, arcB);
+        dVector3 axis;
+        ConvexEdgeAxis(arcA, arcB, axis);
+        dCopyNegatedVector3(normal, axis);
+
+        const dxConvex::edge &ea = a.edges[edgeA];
+        const dxConvex::edge &eb = b.edges[edgeB];
+        dVector3 c1, c2;
+        ClosestPointBetweenSegments(a.points + ea.first*3, a.points + ea.second*3,
+                                    b.points + eb.first*3, b.points + eb.second*3, c1, c2);
+        result[0].pos[0] = (c1[0] + c2[0]) * REAL(0.5);
+        result[0].pos[1] = (c1[1] + c2[1]) * REAL(0.5);
+        result[0].pos[2] = (c1[2] + c2[2]) * REAL(0.5);
+        result[0].depth = -separationE;
+        return 1;
+    }
+
+    if(separationB > relativeTolerance*separationA + absoluteTolerance)
+    {
+        feature = ConvexSATFeature(CONVEX_SAT_FACE_B, faceB, 0);
+        dCopyVector3(normal, b.planes + faceB*4);
+        return ConvexFaceContacts(b, faceB, a, separationB, result, maxc);
+    }
+
+    feature = ConvexSATFeature(CONVEX_SAT_FACE_A, faceA, 0);
+    dCopyNegatedVector3(normal, a.planes + faceA*4);
+    return ConvexFaceContacts(a, faceA, b, separationA, result, maxc);
+}
+
+// the hull data of a convex, or of a shape built like one on the stack
+struct dxConvexShape
+{
+    const dReal *planes;
+    unsigned int planecount;
+    const dReal *points;
+    unsigned int pointcount;
+    const unsigned int *polygons;
+    const dxConvex::edge *edges;
+    unsigned int edgecount;
+    const dxPosR *final_posr;
+};
+
+static void ConvexGetShape(const dxConvex *cvx, dxConvexShape &shape)
+{
+    shape.planes = cvx->planes;
+    shape.planecount = cvx->planecount;
+    shape.points = cvx->points;
+    shape.pointcount = cvx->pointcount;
+    shape.polygons = cvx->polygons;
+    shape.edges = cvx->edges;
+    shape.edgecount = cvx->edgecount;
+    shape.final_posr = cvx->final_posr;
+}
+
+// cylinders are handled as prisms. the vertices are pushed out so that the
+// sides are as much outside the circle at the corners as inside it at the
+// middle, under 1% of the radius with 16 sides
+#define CYLINDER_PRISM_SIDES 16
+
+struct dxCylinderPrism
+{
+    dReal points[2*CYLINDER_PRISM_SIDES*3];
+    dReal planes[(CYLINDER_PRISM_SIDES+2)*4];
+    unsigned int polygons[CYLINDER_PRISM_SIDES*5 + 2*(CYLINDER_PRISM_SIDES+1)];
+    dxConvex::edge edges[3*CYLINDER_PRISM_SIDES];
+};
+
+// bottom ring first, then the top ring. the sides come first, then the
+// top and the bottom
+static void ConvexGetCylinderShape(const dxCylinder *cyl, dxCylinderPrism &prism, dxConvexShape &shape)
+{
+    const unsigned int n = CYLINDER_PRISM_SIDES;
+    const dReal halfAngle = M_PI / n;
+    const dReal cosHalf = dCos(halfAngle);
+    const dReal corner = cyl->radius * REAL(2.0) / (REAL(1.0) + cosHalf);
+    const dReal h = cyl->lz * REAL(0.5);
+
+    unsigned int *polygon = prism.polygons;
+    for(unsigned int i=0;i<n;++i)
+    {
+        const unsigned int j = (i + 1) % n;
+        const dReal angle = (dReal)(2*i) * halfAngle;
+        const dReal c = dCos(angle), s = dSin(angle);
+        dReal *bottom = prism.points + i*3;
+        dReal *top = prism.points + (n + i)*3;
+        bottom[0] = top[0] = corner * c;
+        bottom[1] = top[1] = corner * s;
+        bottom[2] = -h;
+        top[2] = h;
+
+        dReal *plane = prism.planes + i*4;
+        plane[0] = dCos(angle + halfAngle);
+        plane[1] = dSin(angle + halfAngle);
+        plane[2] = 0;
+        plane[3] = corner * cosHalf;
+
+        polygon[0] = 4;
+        polygon[1] = i;
+        polygon[2] = j;
+        polygon[3] = n + j;
+        polygon[4] = n + i;
+        polygon += 5;
+
+        dxConvex::edge *e = prism.edges + i*3;
+        e[0].first = i; e[0].second = j; e[0].faces[0] = i; e[0].faces[1] = n + 1;
+        e[1].first = n + i; e[1].second = n + j; e[1].faces[0] = i; e[1].faces[1] = n;
+        e[2].first = j; e[2].second = n + j; e[2].faces[0] = i; e[2].faces[1] = j;
+    }
+
+    dReal *top = prism.planes + n*4;
+    top[0] = 0; top[1] = 0; top[2] = 1; top[3] = h;
+    dReal *bottom = prism.planes + (n + 1)*4;
+    bottom[0] = 0; bottom[1] = 0; bottom[2] = -1; bottom[3] = h;
+
+    polygon[0] = n;
+    for(unsigned int i=0;i<n;++i) polygon[1 + i] = n + i;
+    polygon += n + 1;
+    polygon[0] = n;
+    for(unsigned int i=0;i<n;++i) polygon[1 + i] = n - 1 - i;
+
+    shape.planes = prism.planes;
+    shape.planecount = n + 2;
+    shape.points = prism.points;
+    shape.pointcount = 2*n;
+    shape.polygons = prism.polygons;
+    shape.edges = prism.edges;
+    shape.edgecount = 3*n;
+    shape.final_posr = cyl->final_posr;
+}
+
+// world space polytope of a shape, points must hold pointcount*3 values
+// and planes planecount*4
+static void ConvexGetPolytope(const dxConvexShape &shape, dReal *points, dReal *planes, dxConvexPolytope &p)
+{
+    const dReal *R = shape.final_posr->R;
+    const dReal *pos = shape.final_posr->pos;
+    for(unsigned int i=0;i<shape.pointcount;++i)
+        ConvexTransformPoint(points + i*3, R, pos, shape.points + i*3);
+    for(unsigned int i=0;i<shape.planecount;++i)
+    {
+        dReal *plane = planes + i*4;
+        ConvexRotateVector(plane, R, shape.planes + i*4);
+        plane[3] = shape.planes[i*4+3] + ConvexDot(plane, pos);
+    }
+
+    p.points = points;
+    p.pointCount = shape.pointcount;
+    p.planes = planes;
+    p.planeCount = shape.planecount;
+    p.faceCount = shape.planecount;
+    p.polygons = shape.polygons;
+    p.edges = shape.edges;
+    p.edgeCount = shape.edgecount;
+}
+
+// box corners are numbered by the signs of x, y and z in bits 0, 1 and 2,
+// faces are +x, -x, +y, -y, +z and -z
+static const unsigned int s_boxPolygons[6*5] =
+{
+    4, 1,3,7,5,
+    4, 0,4,6,2,
+    4, 2,6,7,3,
+    4, 0,1,5,4,
+    4, 4,5,7,6,
+    4, 0,2,3,1
+};
+
+static const dxConvex::edge s_boxEdges[12] =
+{
+    { 0,1, {3,5} }, { 2,3, {2,5} }, { 4,5, {3,4} }, { 6,7, {2,4} },
+    { 0,2, {1,5} }, { 1,3, {0,5} }, { 4,6, {1,4} }, { 5,7, {0,4} },
+    { 0,4, {1,3} }, { 1,5, {0,3} }, { 2,6, {1,2} }, { 3,7, {0,2} }
+};
+
+static void ConvexGetBoxPolytope(const dxBox *box, dReal points[8*3], dReal planes[6*4], dxConvexPolytope &p)
+{
+    const dReal *R = box->final_posr->R;
+    const dReal *pos = box->final_posr->pos;
+    const dReal *h = box->halfside;
+    for(unsigned int i=0;i<8;++i)
+    {
+        const dVector3 corner = { (i & 1) ? h[0] : -h[0], (i & 2) ? h[1] : -h[1], (i & 4) ? h[2] : -h[2] };
+        ConvexTransformPoint(points + i*3, R, pos, corner);
+    }
+    for(unsigned int k=0;k<3;++k)
+    {
+        dReal *plane = planes + k*8;
+        plane[0] = R[k];
+        plane[1] = R[4+k];
+        plane[2] = R[8+k];
+        const dReal d = ConvexDot(plane, pos);
+        plane[3] = d + h[k];
+        plane[4] = -plane[0];
+        plane[5] = -plane[1];
+        plane[6] = -plane[2];
+        plane[7] = h[k] - d;
     }
 
+    p.points = points;
+    p.pointCount = 8;
+    p.planes = planes;
+    p.planeCount = 6;
+    p.faceCount = 6;
+    p.polygons = s_boxPolygons;
+    p.edges = s_boxEdges;
+    p.edgeCount = 12;
+}
+
+// a triangle as the top of a prism: its front face, then the side planes
+// that only bound separation, each edge arc runs from the front to a side
+static const unsigned int s_trianglePolygon[4] = { 3, 0,1,2 };
+
+static const dxConvex::edge s_triangleEdges[3] =
+{
+    { 0,1, {0,1} }, { 1,2, {0,2} }, { 2,0, {0,3} }
+};
+
+static bool ConvexGetTrianglePolytope(const dVector3 v[3], dReal points[3*3], dReal planes[4*4], dxConvexPolytope &p)
+{
+    dVector3 e1, e2;
+    dSubtractVectors3(e1, v[1], v[0]);
+    dSubtractVectors3(e2, v[2], v[0]);
+    ConvexCross(planes, e1, e2);
+    const dReal length2 = ConvexDot(planes, planes);
+    if(length2 < dEpsilon * dEpsilon) return false;
+    dScaleVector3(planes, dRecipSqrt(length2));
+    planes[3] = ConvexDot(planes, v[0]);
+
+    for(unsigned int i=0;i<3;++i)
+    {
+        dCopyVector3(points + i*3, v[i]);
+        dReal *side = planes + (i+1)*4;
+        dVector3 edge;
+        dSubtractVectors3(edge, v[(i+1)%3], v[i]);
+        ConvexCross(side, edge, planes);
+        dSafeNormalize3(side);
+        side[3] = ConvexDot(side, v[i]);
+    }
+
+    p.points = points;
+    p.pointCount = 3;
+    p.planes = planes;
+    p.planeCount = 4;
+    p.faceCount = 1;
+    p.polygons = s_trianglePolygon;
+    p.edges = s_triangleEdges;
+    p.edgeCount = 3;
     return true;
 }
 
+
+//****************************************************************************
+// Convex colliders
+//
+
 int dCollideConvexPlane (dxGeom *o1, dxGeom *o2, int flags,
                          dContactGeom *contact, int skip)
 {
@@ -595,54 +1179,42 @@ int dCollideConvexPlane (dxGeom *o1, dxGeom *o2, int flags,
 
     dxConvex *Convex = (dxConvex*) o1;
     dxPlane *Plane = (dxPlane*) o2;
-    unsigned int contacts=0;
-    unsigned int maxc = flags & NUMC_MASK;
-    dVector3 v2;
+    const int maxc = flags & NUMC_MASK;
 
-#define LTEQ_ZERO	0x10000000
-#define GTEQ_ZERO	0x20000000
-#define BOTH_SIGNS	(LTEQ_ZERO | GTEQ_ZERO)
-    dIASSERT((BOTH_SIGNS & NUMC_MASK) == 0); // used in conditional operator later
+    // the plane in convex space, so the points are not transformed
+    dVector4 plane;
+    dMultiply1_331 (plane,Convex->final_posr->R,Plane->p);
+    plane[3] = Plane->p[3] - dCalcVectorDot3(Plane->p, Convex->final_posr->pos);
 
-    unsigned int totalsign = 0;
+    dxConvexContactPoint *points = (dxConvexContactPoint*)dALLOCA16(Convex->pointcount * sizeof(dxConvexContactPoint));
+    int count = 0;
     for(unsigned int i=0;i<Convex->pointcount;++i)
     {
-        dMultiply0_331 (v2,Convex->final_posr->R,&Convex->points[(i*3)]);
-        dAddVectors3r4(v2, Convex->final_posr->pos, v2);
-
-        unsigned int distance2sign = GTEQ_ZERO;
-        dReal distance2 = dCalcVectorDot3(Plane->p, v2) - Plane->p[3]; // Ax + By + Cz - D
-        if((distance2 <= REAL(0.0)))
+        const dReal *point = Convex->points + i*3;
+        const dReal distance = ConvexDot(plane, point) - plane[3];
+        if(distance <= REAL(0.0))
         {
-            distance2sign = distance2 != REAL(0.0) ? LTEQ_ZERO : BOTH_SIGNS;
-
-            if (contacts != maxc)
-            {
-                dContactGeom *target = SAFECONTACT(flags, contact, contacts, skip);
-                dCopyVector3r4(target->normal, Plane->p);
-                dCopyVector3r4(target->pos, v2);
-                target->depth = -distance2;
-                target->g1 = Convex;
-                target->g2 = Plane;
-                target->side1 = -1; // TODO: set plane index?
-                target->side2 = -1;
-                contacts++;
-            }
+            dCopyVector3(points[count].pos, point);
+            points[count].depth = -distance;
+            ++count;
+            if((flags & CONTACTS_UNIMPORTANT) && count == maxc) break;
         }
+    }
+    if(count == 0) return 0;
 
-        // Take new sign into account
-        totalsign |= distance2sign;
-        // Check if contacts are full and both signs have been already found
-        if (((contacts ^ maxc) | totalsign) == BOTH_SIGNS) // harder to comprehend but requires one register less
-        {
-            break; // Nothing can be changed any more
-        }
+    count = ConvexReducePoints(points, count, maxc);
+    for(int i=0;i<count;++i)
+    {
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        ConvexTransformPoint(target->pos, Convex->final_posr->R, Convex->final_posr->pos, points[i].pos);
+        dCopyVector3(target->normal, Plane->p);
+        target->depth = points[i].depth;
+        target->g1 = Convex;
+        target->g2 = Plane;
+        target->side1 = -1;
+        target->side2 = -1;
     }
-    if (totalsign == BOTH_SIGNS) return contacts;
-    return 0;
-#undef BOTH_SIGNS
-#undef GTEQ_ZERO
-#undef LTEQ_ZERO
+    return count;
 }
 
 int dCollideSphereConvex (dxGeom *o1, dxGeom *o2, int flags,
@@ -655,728 +1227,364 @@ int dCollideSphereConvex (dxGeom *o1, dxGeom *o2, int flags,
 
     dxSphere *Sphere = (dxSphere*) o1;
     dxConvex *Convex = (dxConvex*) o2;
-    dReal dist,closestdist=dInfinity;
-    dVector4 plane;
-    // dVector3 contactpoint;
-    dVector3 offsetpos,out,temp;
-    unsigned int *pPoly=Convex->polygons;
-    int closestplane=-1;
-    bool sphereinside=true;
-    /*
-    Do a good old sphere vs plane check first,
-    if a collision is found then check if the contact point
-    is within the polygon
-    */
-    // offset the sphere final_posr->position into the convex space
-    offsetpos[0]=Sphere->final_posr->pos[0]-Convex->final_posr->pos[0];
-    offsetpos[1]=Sphere->final_posr->pos[1]-Convex->final_posr->pos[1];
-    offsetpos[2]=Sphere->final_posr->pos[2]-Convex->final_posr->pos[2];
+    const dReal radius = Sphere->radius;
+
+    // sphere center in convex space
+    dVector3 offset,center;
+    dSubtractVectors3(offset, Sphere->final_posr->pos, Convex->final_posr->pos);
+    dMultiply1_331(center, Convex->final_posr->R, offset);
+
+    unsigned int closestPlane = 0;
+    dReal maxDistance = -dInfinity;
     for(unsigned int i=0;i<Convex->planecount;++i)
     {
-        // apply rotation to the plane
-        dMultiply0_331(plane,Convex->final_posr->R,&Convex->planes[(i*4)]);
-        plane[3]=(&Convex->planes[(i*4)])[3];
-        // Get the distance from the sphere origin to the plane
-        dist = dCalcVectorDot3(plane, offsetpos) - plane[3]; // Ax + By + Cz - D
-        if(dist>0)
+        const dReal *plane = Convex->planes + i*4;
+        const dReal distance = ConvexDot(plane, center) - plane[3];
+        if(distance > radius) return 0;
+        if(distance > maxDistance)
+        {
+            maxDistance = distance;
+            closestPlane = i;
+        }
+    }
+
+    dVector3 normal, pos;
+    dReal depth;
+    if(maxDistance <= REAL(0.0))
+    {
+        // the center is inside, push out through the closest plane
+        const dReal *plane = Convex->planes + closestPlane*4;
+        dCopyVector3(normal, plane);
+        dAddScaledVector3(pos, center, plane, -maxDistance);
+        depth = radius - maxDistance;
+    }
+    else
+    {
+        // the closest point is on one of the faces the center is in front of,
+        // the furthest plane usually has it
+        dVector3 closest;
+        dReal closestDistance2 = dInfinity;
+        if(ClosestPointOnPolygon(center, ConvexGetPolygon(Convex->polygons, closestPlane),
+                                 Convex->planes + closestPlane*4, Convex->points, closest))
         {
-            // if we get here, we know the center of the sphere is
-            // outside of the convex hull.
-            if(dist<Sphere->radius)
+            closestDistance2 = maxDistance * maxDistance;
+        }
+        else
+        {
+            const unsigned int *polygon = Convex->polygons;
+            for(unsigned int i=0;i<Convex->planecount;++i)
             {
-                // if we get here we know the sphere surface penetrates
-                // the plane
-                if(IsPointInPolygon(Sphere->final_posr->pos,pPoly,plane,Convex,out))
+                const dReal *plane = Convex->planes + i*4;
+                const dReal distance = ConvexDot(plane, center) - plane[3];
+                if(distance > REAL(0.0) && distance*distance < closestDistance2)
                 {
-                    // finally if we get here we know that the
-                    // sphere is directly touching the inside of the polyhedron
-                    contact->normal[0] = plane[0];
-                    contact->normal[1] = plane[1];
-                    contact->normal[2] = plane[2];
-                    contact->pos[0] = Sphere->final_posr->pos[0]+
-                        (-contact->normal[0]*Sphere->radius);
-                    contact->pos[1] = Sphere->final_posr->pos[1]+
-                        (-contact->normal[1]*Sphere->radius);
-                    contact->pos[2] = Sphere->final_posr->pos[2]+
-                        (-contact->normal[2]*Sphere->radius);
-                    contact->depth = Sphere->radius-dist;
-                    contact->g1 = Sphere;
-                    contact->g2 = Convex;
-                    contact->side1 = -1;
-                    contact->side2 = -1; // TODO: set plane index?
-                    return 1;
-                }
-                else
-                {
-                    // the sphere may not be directly touching
-                    // the polyhedron, but it may be touching
-                    // a point or an edge, if the distance between
-                    // the closest point on the poly (out) and the
-                    // center of the sphere is less than the sphere
-                    // radius we have a hit.
-                    temp[0] = (Sphere->final_posr->pos[0]-out[0]);
-                    temp[1] = (Sphere->final_posr->pos[1]-out[1]);
-                    temp[2] = (Sphere->final_posr->pos[2]-out[2]);
-                    dist=(temp[0]*temp[0])+(temp[1]*temp[1])+(temp[2]*temp[2]);
-                    // avoid the sqrt unless really necesary
-                    if(dist<(Sphere->radius*Sphere->radius))
+                    dVector3 q, d;
+                    ClosestPointOnPolygon(center, polygon, plane, Convex->points, q);
+                    dSubtractVectors3(d, center, q);
+                    const dReal distance2 = ConvexDot(d, d);
+                    if(distance2 < closestDistance2)
                     {
-                        // We got an indirect hit
-                        dist=dSqrt(dist);
-                        contact->normal[0] = temp[0]/dist;
-                        contact->normal[1] = temp[1]/dist;
-                        contact->normal[2] = temp[2]/dist;
-                        contact->pos[0] = Sphere->final_posr->pos[0]+
-                            (-contact->normal[0]*Sphere->radius);
-                        contact->pos[1] = Sphere->final_posr->pos[1]+
-                            (-contact->normal[1]*Sphere->radius);
-                        contact->pos[2] = Sphere->final_posr->pos[2]+
-                            (-contact->normal[2]*Sphere->radius);
-                        contact->depth = Sphere->radius-dist;
-                        contact->g1 = Sphere;
-                        contact->g2 = Convex;
-                        contact->side1 = -1;
-                        contact->side2 = -1; // TODO: set plane index?
-                        return 1;
+                        closestDistance2 = distance2;
+                        dCopyVector3(closest, q);
                     }
                 }
+                polygon += polygon[0] + 1;
             }
-            sphereinside=false;
         }
-        if(sphereinside)
+        if(closestDistance2 > radius*radius) return 0;
+
+        const dReal distance = dSqrt(closestDistance2);
+        if(distance > dEpsilon)
         {
-            if(closestdist>dFabs(dist))
-            {
-                closestdist=dFabs(dist);
-                closestplane=i;
-            }
+            dSubtractVectors3(normal, center, closest);
+            dScaleVector3(normal, REAL(1.0) / distance);
         }
-        pPoly+=pPoly[0]+1;
-    }
-    if(sphereinside)
-    {
-        // if the center of the sphere is inside
-        // the Convex, we need to pop it out
-        dMultiply0_331(contact->normal,
-            Convex->final_posr->R,
-            &Convex->planes[(closestplane*4)]);
-        contact->pos[0] = Sphere->final_posr->pos[0];
-        contact->pos[1] = Sphere->final_posr->pos[1];
-        contact->pos[2] = Sphere->final_posr->pos[2];
-        contact->depth = closestdist+Sphere->radius;
-        contact->g1 = Sphere;
-        contact->g2 = Convex;
-        contact->side1 = -1;
-        contact->side2 = -1; // TODO: set plane index?
-        return 1;
+        else
+        {
+            dCopyVector3(normal, Convex->planes + closestPlane*4);
+        }
+        dCopyVector3(pos, closest);
+        depth = radius - distance;
     }
-    return 0;
+
+    dMultiply0_331(contact->normal, Convex->final_posr->R, normal);
+    ConvexTransformPoint(contact->pos, Convex->final_posr->R, Convex->final_posr->pos, pos);
+    contact->depth = depth;
+    contact->g1 = Sphere;
+    contact->g2 = Convex;
+    contact->side1 = -1;
+    contact->side2 = -1;
+    return 1;
 }
 
 int dCollideConvexBox (dxGeom *o1, dxGeom *o2, int flags,
-                       dContactGeom * /*contact*/, int skip)
+                       dContactGeom *contact, int skip)
 {
     dIASSERT (skip >= (int)sizeof(dContactGeom));
     dIASSERT (o1->type == dConvexClass);
     dIASSERT (o2->type == dBoxClass);
     dIASSERT ((flags & NUMC_MASK) >= 1);
 
-    //dxConvex *Convex = (dxConvex*) o1;
-    //dxBox *Box = (dxBox*) o2;
-
-    return 0;
+    dxConvex *Convex = (dxConvex*) o1;
+    dxBox *Box = (dxBox*) o2;
+    const int maxc = flags & NUMC_MASK;
+
+    dxConvexPolytope a, b;
+    dReal *pointsA = (dReal*)dALLOCA16(Convex->pointcount * 3 * sizeof(dReal));
+    dReal *planesA = (dReal*)dALLOCA16(Convex->planecount * 4 * sizeof(dReal));
+    dxConvexShape shape;
+    ConvexGetShape(Convex, shape);
+    ConvexGetPolytope(shape, pointsA, planesA, a);
+    dReal pointsB[8*3], planesB[6*4];
+    ConvexGetBoxPolytope(Box, pointsB, planesB, b);
+
+    duint32 feature = ConvexCacheGet(Convex, Box);
+    dVector3 normal;
+    dxConvexContactPoint *points = (dxConvexContactPoint*)dALLOCA16(maxc * sizeof(dxConvexContactPoint));
+    const int count = ConvexCollidePolytopes(a, b, feature, normal, points, maxc);
+    ConvexCacheSet(Convex, Box, feature);
+
+    ConvexWriteContacts(points, count, normal, flags, contact, skip);
+    for(int i=0;i<count;++i)
+    {
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        target->g1 = Convex;
+        target->g2 = Box;
+    }
+    return count;
 }
 
-int dCollideConvexCapsule (dxGeom *o1, dxGeom *o2,
-                           int flags, dContactGeom * /*contact*/, int skip)
+/*! \brief Contacts of a capsule segment over a face, the part of the segment
+  above the face polygon is clipped and its ends pushed out along the face
+  normal
+  \return the number of contacts, at most 2 and maxc
+*/
+static int ConvexCapsuleFaceContacts(const dxConvexShape *Convex, unsigned int face,
+                                     const dReal *p0, const dReal *segment, dReal radius,
+                                     dxConvexContactPoint *points, int maxc)
 {
-    dIASSERT (skip >= (int)sizeof(dContactGeom));
-    dIASSERT (o1->type == dConvexClass);
-    dIASSERT (o2->type == dCapsuleClass);
-    dIASSERT ((flags & NUMC_MASK) >= 1);
-
-    //dxConvex *Convex = (dxConvex*) o1;
-    //dxCapsule *Capsule = (dxCapsule*) o2;
+    const dReal *plane = Convex->planes + face*4;
+    const unsigned int *polygon = ConvexGetPolygon(Convex->polygons, face);
+    const unsigned int sides = polygon[0];
+
+    dVector3 p1;
+    dAddVectors3(p1, p0, segment);
+    dReal t0 = 0, t1 = 1;
+    const dReal *a = Convex->points + polygon[sides]*3;
+    for(unsigned int k=1;k<=sides && t0<=t1;++k)
+    {
+        const dReal *b = Convex->points + polygon[k]*3;
+        dVector3 edge, side;
+        dSubtractVectors3(edge, b, a);
+        ConvexCross(side, edge, plane);
+        const dReal sideDistance = ConvexDot(side, a);
+        const dReal d0 = ConvexDot(side, p0) - sideDistance;
+        const dReal d1 = ConvexDot(side, p1) - sideDistance;
+        if(d0 > 0 && d1 > 0) return 0;
+        else if(d0 > 0) t0 = dMAX(t0, d0 / (d0 - d1));
+        else if(d1 > 0) t1 = dMIN(t1, d0 / (d0 - d1));
+        a = b;
+    }
+    if(t0 > t1) return 0;
 
-    return 0;
+    int count = 0;
+    for(unsigned int k=0;k<2;++k)
+    {
+        dVector3 x;
+        dAddScaledVector3(x, p0, segment, k ? t1 : t0);
+        const dReal s = ConvexDot(plane, x) - plane[3];
+        if(s >= radius) continue;
+        if(count == maxc)
+        {
+            // only room for the deepest
+            if(radius - s <= points[0].depth) continue;
+            count = 0;
+        }
+        dAddScaledVector3(points[count].pos, x, plane, -s);
+        points[count].depth = radius - s;
+        ++count;
+    }
+    return count;
 }
 
-inline void ComputeInterval(dxConvex& cvx,dVector4 axis,dReal& min,dReal& max)
+// capsule against a convex shape, the contacts have g1 as first geom
+static int ConvexCollideCapsule (const dxConvexShape *Convex, dxGeom *g1, dxCapsule *Capsule,
+                                 int flags, dContactGeom *contact, int skip)
 {
-    /* TODO: Use Support points here */
-    dVector3 point;
-    dReal value;
-    //fprintf(stdout,"Compute Interval Axis %f,%f,%f\n",axis[0],axis[1],axis[2]);
-    dMultiply0_331(point,cvx.final_posr->R,cvx.points);
-    //fprintf(stdout,"initial point %f,%f,%f\n",point[0],point[1],point[2]);
-    point[0]+=cvx.final_posr->pos[0];
-    point[1]+=cvx.final_posr->pos[1];
-    point[2]+=cvx.final_posr->pos[2];
-    max = min = dCalcVectorDot3(point,axis)-axis[3];//(*)
-    for (unsigned int i = 1; i < cvx.pointcount; ++i)
+    const int maxc = flags & NUMC_MASK;
+    const dReal radius = Capsule->radius;
+
+    // capsule segment in convex space
+    dVector3 offset, center, axis, p[2];
+    dSubtractVectors3(offset, Capsule->final_posr->pos, Convex->final_posr->pos);
+    dMultiply1_331(center, Convex->final_posr->R, offset);
+    const dVector3 capsuleAxis = { Capsule->final_posr->R[2], Capsule->final_posr->R[6], Capsule->final_posr->R[10] };
+    dMultiply1_331(axis, Convex->final_posr->R, capsuleAxis);
+    dAddScaledVector3(p[0], center, axis, -Capsule->halfLenZ);
+    dAddScaledVector3(p[1], center, axis, Capsule->halfLenZ);
+    dVector3 segment;
+    dSubtractVectors3(segment, p[1], p[0]);
+
+    // the segment is clipped by every plane on the way, Cyrus-Beck
+    unsigned int bestPlane = 0;
+    dReal bestSeparation = -dInfinity;
+    dReal tEnter = 0, tExit = 1;
+    for(unsigned int i=0;i<Convex->planecount;++i)
     {
-        dMultiply0_331(point,cvx.final_posr->R,cvx.points+(i*3));
-        point[0]+=cvx.final_posr->pos[0];
-        point[1]+=cvx.final_posr->pos[1];
-        point[2]+=cvx.final_posr->pos[2];
-        value=dCalcVectorDot3(point,axis)-axis[3];//(*)
-        if(value<min)
-        {
-            min=value;
-        }
-        else if(value>max)
+        const dReal *plane = Convex->planes + i*4;
+        const dReal s0 = ConvexDot(plane, p[0]) - plane[3];
+        const dReal s1 = ConvexDot(plane, p[1]) - plane[3];
+        const dReal s = dMIN(s0, s1);
+        if(s > radius) return 0;
+        if(s > bestSeparation)
         {
-            max=value;
+            bestSeparation = s;
+            bestPlane = i;
         }
+        if(s0 > 0 && s1 > 0) tEnter = REAL(2.0);
+        else if(s0 > 0) tEnter = dMAX(tEnter, s0 / (s0 - s1));
+        else if(s1 > 0) tExit = dMIN(tExit, s0 / (s0 - s1));
     }
-    // *: usually using the distance part of the plane (axis) is
-    // not necesary, however, here we need it here in order to know
-    // which face to pick when there are 2 parallel sides.
-}
 
-bool CheckEdgeIntersection(dxConvex& cvx1,dxConvex& cvx2, int flags,int& curc,
-                           dContactGeom *contact, int skip)
-{
-    int maxc = flags & NUMC_MASK;
-    dIASSERT(maxc != 0);
-    dVector3 e1,e2,q;
-    dVector4 plane,depthplane;
-    dReal t;
-    for(unsigned int i = 0;i<cvx1.edgecount;++i)
+    dxConvexContactPoint points[2];
+    dVector3 normal;
+    int count = 0;
+
+    if(tEnter > tExit)
     {
-        // Rotate
-        dMultiply0_331(e1,cvx1.final_posr->R,cvx1.points+(cvx1.edges[i].first*3));
-        // translate
-        e1[0]+=cvx1.final_posr->pos[0];
-        e1[1]+=cvx1.final_posr->pos[1];
-        e1[2]+=cvx1.final_posr->pos[2];
-        // Rotate
-        dMultiply0_331(e2,cvx1.final_posr->R,cvx1.points+(cvx1.edges[i].second*3));
-        // translate
-        e2[0]+=cvx1.final_posr->pos[0];
-        e2[1]+=cvx1.final_posr->pos[1];
-        e2[2]+=cvx1.final_posr->pos[2];
-        unsigned int* pPoly=cvx2.polygons;
-        for(size_t j=0;j<cvx2.planecount;++j)
+        // the segment is outside, find the closest points on the faces it
+        // is in front of. no face is closer than its plane
+        dVector3 closestSegment, closestHull;
+        dReal closestDistance2 = dInfinity;
+        const unsigned int *polygon = Convex->polygons;
+        for(unsigned int i=0;i<Convex->planecount;++i)
         {
-            // Rotate
-            dMultiply0_331(plane,cvx2.final_posr->R,cvx2.planes+(j*4));
-            dNormalize3(plane);
-            // Translate
-            plane[3]=
-                (cvx2.planes[(j*4)+3])+
-                ((plane[0] * cvx2.final_posr->pos[0]) +
-                (plane[1] * cvx2.final_posr->pos[1]) +
-                (plane[2] * cvx2.final_posr->pos[2]));
-            dContactGeom *target = SAFECONTACT(flags, contact, curc, skip);
-            target->g1=&cvx1; // g1 is the one pushed
-            target->g2=&cvx2;
-            if(IntersectSegmentPlane(e1,e2,plane,t,target->pos))
+            const dReal *plane = Convex->planes + i*4;
+            const dReal s0 = ConvexDot(plane, p[0]) - plane[3];
+            const dReal s1 = ConvexDot(plane, p[1]) - plane[3];
+            const dReal lowerBound = dMAX(REAL(0.0), dMIN(s0, s1));
+            if((s0 > 0 || s1 > 0) && lowerBound*lowerBound < closestDistance2 && lowerBound <= radius)
             {
-                if(IsPointInPolygon(target->pos,pPoly,plane,&cvx2,q))
+                // the ends in front of the face
+                for(unsigned int k=0;k<2;++k)
                 {
-                    target->depth = dInfinity;
-                    for(size_t k=0;k<cvx2.planecount;++k)
+                    const dReal s = k ? s1 : s0;
+                    if(s < 0) continue;
+                    dVector3 q;
+                    if(ClosestPointOnPolygon(p[k], polygon, plane, Convex->points, q) && s*s < closestDistance2)
                     {
-                        if(k==j) continue; // we're already at 0 depth on this plane
-                        // Rotate
-                        dMultiply0_331(depthplane,cvx2.final_posr->R,cvx2.planes+(k*4));
-                        dNormalize3(depthplane);
-                        // Translate
-                        depthplane[3]=
-                            (cvx2.planes[(k*4)+3])+
-                            ((plane[0] * cvx2.final_posr->pos[0]) +
-                            (plane[1] * cvx2.final_posr->pos[1]) +
-                            (plane[2] * cvx2.final_posr->pos[2]));
-                        dReal depth = (dCalcVectorDot3(depthplane, target->pos) - depthplane[3]); // Ax + By + Cz - D
-                        if((dFabs(depth)<dFabs(target->depth))&&((depth<-dEpsilon)||(depth>dEpsilon)))
-                        {
-                            target->depth=depth;
-                            dCopyVector3r4(target->normal, depthplane);
-                        }
+                        closestDistance2 = s*s;
+                        dCopyVector3(closestSegment, p[k]);
+                        dCopyVector3(closestHull, q);
                     }
-                    ++curc;
-                    if(curc==maxc)
-                        return true;
+                }
+                // the sides of the face
+                const unsigned int sides = polygon[0];
+                const dReal *a = Convex->points + polygon[sides]*3;
+                for(unsigned int k=1;k<=sides;++k)
+                {
+                    const dReal *b = Convex->points + polygon[k]*3;
+                    dVector3 c1, c2;
+                    const dReal d2 = ClosestPointBetweenSegments(p[0], p[1], a, b, c1, c2);
+                    if(d2 < closestDistance2)
+                    {
+                        closestDistance2 = d2;
+                        dCopyVector3(closestSegment, c1);
+                        dCopyVector3(closestHull, c2);
+                    }
+                    a = b;
                 }
             }
-            pPoly+=pPoly[0]+1;
+            polygon += polygon[0] + 1;
         }
-    }
-    return false;
-}
-
-/*
-Helper struct
-*/
-struct ConvexConvexSATOutput
-{
-    dReal min_depth;
-    int depth_type;
-    dVector3 dist; // distance from center to center, from cvx1 to cvx2
-    dVector3 e1a,e1b,e2a,e2b; // e1a to e1b = edge in cvx1,e2a to e2b = edge in cvx2.
-};
+        if(closestDistance2 > radius*radius) return 0;
 
-/*! \brief Does an axis separation test using cvx1 planes on cvx1 and cvx2, returns true for a collision false for no collision
-  \param cvx1 [IN] First Convex object, its planes are used to do the tests
-  \param cvx2 [IN] Second Convex object
-  \param min_depth [IN/OUT] Used to input as well as output the minimum depth so far, must be set to a huge value such as dInfinity for initialization.
-  \param g1 [OUT] Pointer to the convex which should be used in the returned contact as g1
-  \param g2 [OUT] Pointer to the convex which should be used in the returned contact as g2
- */
-inline bool CheckSATConvexFaces(dxConvex& cvx1,
-                                dxConvex& cvx2,
-                                ConvexConvexSATOutput& ccso)
-{
-    dReal min,max,min1,max1,min2,max2,depth;
-    dVector4 plane;
-    for(unsigned int i=0;i<cvx1.planecount;++i)
-    {
-        // -- Apply Transforms --
-        // Rotate
-        dMultiply0_331(plane,cvx1.final_posr->R,cvx1.planes+(i*4));
-        dNormalize3(plane);
-        // Translate
-        plane[3]=
-            (cvx1.planes[(i*4)+3])+
-            ((plane[0] * cvx1.final_posr->pos[0]) +
-            (plane[1] * cvx1.final_posr->pos[1])  +
-            (plane[2] * cvx1.final_posr->pos[2]));
-        ComputeInterval(cvx1,plane,min1,max1);
-        ComputeInterval(cvx2,plane,min2,max2);
-        if(max2<min1 || max1<min2) return false;
-        min = dMAX(min1, min2);
-        max = dMIN(max1, max2);
-        depth = max-min;
-        /*
-        Take only into account the faces that penetrate cvx1 to determine
-        minimum depth
-        ((max2*min2)<=0) = different sign, or one is zero and thus
-        cvx2 barelly touches cvx1
-        */
-        if (((max2*min2)<=0) && (dFabs(depth)<dFabs(ccso.min_depth)))
+        const dReal distance = dSqrt(closestDistance2);
+        if(distance > dEpsilon)
         {
-            // Flip plane because the contact normal must point INTO g1,
-            // plus the integrator seems to like positive depths better than negative ones
-            ccso.min_depth=-depth;
-            ccso.depth_type = 1; // 1 = face-something
+            dSubtractVectors3(normal, closestSegment, closestHull);
+            dScaleVector3(normal, REAL(1.0) / distance);
         }
-    }
-    return true;
-}
-/*! \brief Does an axis separation test using cvx1 and cvx2 edges, returns true for a collision false for no collision
-  \param cvx1 [IN] First Convex object
-  \param cvx2 [IN] Second Convex object
-  \param min_depth [IN/OUT] Used to input as well as output the minimum depth so far, must be set to a huge value such as dInfinity for initialization.
-  \param g1 [OUT] Pointer to the convex which should be used in the returned contact as g1
-  \param g2 [OUT] Pointer to the convex which should be used in the returned contact as g2
- */
-inline bool CheckSATConvexEdges(dxConvex& cvx1,
-                                dxConvex& cvx2,
-                                ConvexConvexSATOutput& ccso)
-{
-    // Test cross products of pairs of edges
-    dReal depth,min,max,min1,max1,min2,max2;
-    dVector4 plane;
-    dVector3 e1,e2,e1a,e1b,e2a,e2b;
-    dVector3 dist;
-    dCopyVector3r4(dist, ccso.dist);
-    unsigned int s1 = cvx1.SupportIndex(dist);
-    // invert direction
-    dNegateVector3r4(dist);
-    unsigned int s2 = cvx2.SupportIndex(dist);
-    for(unsigned int i = 0;i<cvx1.edgecount;++i)
-    {
-        // Skip edge if it doesn't contain the extremal vertex
-        if((cvx1.edges[i].first!=s1)&&(cvx1.edges[i].second!=s1)) continue;
-        // we only need to apply rotation here
-        dMultiply0_331(e1a,cvx1.final_posr->R,cvx1.points+(cvx1.edges[i].first*3));
-        dMultiply0_331(e1b,cvx1.final_posr->R,cvx1.points+(cvx1.edges[i].second*3));
-        e1[0]=e1b[0]-e1a[0];
-        e1[1]=e1b[1]-e1a[1];
-        e1[2]=e1b[2]-e1a[2];
-        for(unsigned int j = 0;j<cvx2.edgecount;++j)
+        else
+        {
+            dCopyVector3(normal, Convex->planes + bestPlane*4);
+        }
+
+        // lying on a face, use both ends of the segment over it
+        unsigned int face = 0;
+        dReal faceDot = -dInfinity;
+        for(unsigned int i=0;i<Convex->planecount;++i)
         {
-            // Skip edge if it doesn't contain the extremal vertex
-            if((cvx2.edges[j].first!=s2)&&(cvx2.edges[j].second!=s2)) continue;
-            // we only need to apply rotation here
-            dMultiply0_331 (e2a,cvx2.final_posr->R,cvx2.points+(cvx2.edges[j].first*3));
-            dMultiply0_331 (e2b,cvx2.final_posr->R,cvx2.points+(cvx2.edges[j].second*3));
-            e2[0]=e2b[0]-e2a[0];
-            e2[1]=e2b[1]-e2a[1];
-            e2[2]=e2b[2]-e2a[2];
-            dCalcVectorCross3r4(plane,e1,e2);
-            if(dCalcVectorDot3(plane,plane)<dEpsilon) /* edges are parallel */ continue;
-            dNormalize3(plane);
-            plane[3]=0;
-            ComputeInterval(cvx1,plane,min1,max1);
-            ComputeInterval(cvx2,plane,min2,max2);
-            if(max2 < min1 || max1 < min2) return false;
-            min = dMAX(min1, min2);
-            max = dMIN(max1, max2);
-            depth = max-min;
-            if (((dFabs(depth)+dEpsilon)<dFabs(ccso.min_depth)))
+            const dReal d = ConvexDot(Convex->planes + i*4, normal);
+            if(d > faceDot)
             {
-                ccso.min_depth=depth;
-                ccso.depth_type = 2; // 2 means edge-edge
-                // use cached values, add position
-                dCopyVector3r4(ccso.e1a, e1a);
-                dCopyVector3r4(ccso.e1b, e1b);
-                ccso.e1a[0]+=cvx1.final_posr->pos[0];
-                ccso.e1a[1]+=cvx1.final_posr->pos[1];
-                ccso.e1a[2]+=cvx1.final_posr->pos[2];
-                ccso.e1b[0]+=cvx1.final_posr->pos[0];
-                ccso.e1b[1]+=cvx1.final_posr->pos[1];
-                ccso.e1b[2]+=cvx1.final_posr->pos[2];
-                dCopyVector3r4(ccso.e2a, e2a);
-                dCopyVector3r4(ccso.e2b, e2b);
-                ccso.e2a[0]+=cvx2.final_posr->pos[0];
-                ccso.e2a[1]+=cvx2.final_posr->pos[1];
-                ccso.e2a[2]+=cvx2.final_posr->pos[2];
-                ccso.e2b[0]+=cvx2.final_posr->pos[0];
-                ccso.e2b[1]+=cvx2.final_posr->pos[1];
-                ccso.e2b[2]+=cvx2.final_posr->pos[2];
+                faceDot = d;
+                face = i;
             }
         }
+        const dReal *plane = Convex->planes + face*4;
+        const dReal segmentLength2 = ConvexDot(segment, segment);
+        const dReal slope = ConvexDot(plane, segment);
+        if(maxc >= 2 && faceDot > REAL(0.99) && slope*slope < REAL(0.01)*segmentLength2)
+        {
+            count = ConvexCapsuleFaceContacts(Convex, face, p[0], segment, radius, points, maxc);
+            if(count != 0) dCopyVector3(normal, plane);
+        }
+        if(count == 0)
+        {
+            dCopyVector3(points[0].pos, closestHull);
+            points[0].depth = radius - distance;
+            count = 1;
+        }
     }
-    return true;
-}
-
-#if 0
-/*! \brief Returns the index of the plane/side of the incident convex (ccso.g2)
- *  which is closer to the reference convex (ccso.g1) side
- *
- *  This function just looks for the incident face that is facing the reference face
- *  and is the closest to being parallel to it, which sometimes is.
- */
-inline unsigned int GetIncidentSide(ConvexConvexSATOutput& ccso)
-{
-    dVector3 nis; // (N)ormal in (I)ncident convex (S)pace
-    dReal SavedDot;
-    dReal Dot;
-    unsigned int incident_side=0;
-    // Rotate the plane normal into incident convex space
-    // (things like this should be done all over this file,
-    //  will look into that)
-    dMultiply1_331(nis,ccso.g2->final_posr->R,ccso.plane);
-    SavedDot = dCalcVectorDot3(nis,ccso.g2->planes);
-    for(unsigned int i=1;i<ccso.g2->planecount;++i)
+    else
     {
-        Dot = dCalcVectorDot3(nis,ccso.g2->planes+(i*4));
-        if(Dot>SavedDot)
+        // the segment goes through the hull, push it out through the plane
+        // it is the least deep behind
+        const dReal *plane = Convex->planes + bestPlane*4;
+        dCopyVector3(normal, plane);
+        count = ConvexCapsuleFaceContacts(Convex, bestPlane, p[0], segment, radius, points, maxc);
+        if(count == 0)
         {
-            SavedDot=Dot;
-            incident_side=i;
+            // the segment passes beside the face, use its deeper end
+            const dReal s0 = ConvexDot(plane, p[0]) - plane[3];
+            const dReal s1 = ConvexDot(plane, p[1]) - plane[3];
+            const dReal *deeper = s0 < s1 ? p[0] : p[1];
+            dAddScaledVector3(points[0].pos, deeper, plane, -bestSeparation);
+            points[0].depth = radius - bestSeparation;
+            count = 1;
         }
     }
-    return incident_side;
-}
-#endif
 
-inline unsigned int GetSupportSide(dVector3& dir,dxConvex& cvx)
-{
-    dVector3 dics,tmp; // Direction in convex space
-    dReal SavedDot;
-    dReal Dot;
-    unsigned int side=0;
-    dCopyVector3r4(tmp, dir);
-    dNormalize3(tmp);
-    dMultiply1_331(dics,cvx.final_posr->R,tmp);
-    SavedDot = dCalcVectorDot3(dics,cvx.planes);
-    for(unsigned int i=1;i<cvx.planecount;++i)
+    // the normal points into the convex
+    dVector3 worldNormal;
+    dMultiply0_331(worldNormal, Convex->final_posr->R, normal);
+    dNegateVector3(worldNormal);
+    for(int i=0;i<count;++i)
     {
-        Dot = dCalcVectorDot3(dics,cvx.planes+(i*4));
-        if(Dot>SavedDot)
-        {
-            SavedDot=Dot;
-            side=i;
-        }
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        ConvexTransformPoint(target->pos, Convex->final_posr->R, Convex->final_posr->pos, points[i].pos);
+        dCopyVector3(target->normal, worldNormal);
+        target->depth = points[i].depth;
+        target->g1 = g1;
+        target->g2 = Capsule;
+        target->side1 = -1;
+        target->side2 = -1;
     }
-    return side;
+    return count;
 }
 
-/*! \brief Does an axis separation test between the 2 convex shapes
-using faces and edges */
-int TestConvexIntersection(dxConvex& cvx1,dxConvex& cvx2, int flags,
-                           dContactGeom *contact, int skip)
+int dCollideConvexCapsule (dxGeom *o1, dxGeom *o2,
+                           int flags, dContactGeom *contact, int skip)
 {
-    ConvexConvexSATOutput ccso;
-#ifndef dNDEBUG
-    memset(&ccso, 0, sizeof(ccso)); // get rid of 'uninitialized values' warning
-#endif
-    ccso.min_depth=dInfinity; // Min not min at all
-    ccso.depth_type=0; // no type
-    // precompute distance vector
-    ccso.dist[0] = cvx2.final_posr->pos[0]-cvx1.final_posr->pos[0];
-    ccso.dist[1] = cvx2.final_posr->pos[1]-cvx1.final_posr->pos[1];
-    ccso.dist[2] = cvx2.final_posr->pos[2]-cvx1.final_posr->pos[2];
-    int maxc = flags & NUMC_MASK;
-    dIASSERT(maxc != 0);
-    dVector3 i1,i2,r1,r2; // edges of incident and reference faces respectively
-    int contacts=0;
-    if(!CheckSATConvexFaces(cvx1,cvx2,ccso))
-    {
-        return 0;
-    }
-    else
-        if(!CheckSATConvexFaces(cvx2,cvx1,ccso))
-        {
-            return 0;
-        }
-        else if(!CheckSATConvexEdges(cvx1,cvx2,ccso))
-        {
-            return 0;
-        }
-        // If we get here, there was a collision
-        if(ccso.depth_type==1) // face-face
-        {
-            // cvx1 MUST always be in contact->g1 and cvx2 in contact->g2
-            // This was learned the hard way :(
-            unsigned int incident_side;
-            unsigned int* pIncidentPoly;
-            unsigned int* pIncidentPoints;
-            unsigned int reference_side;
-            unsigned int* pReferencePoly;
-            unsigned int* pReferencePoints;
-            dVector4 plane,rplane,iplane;
-            dVector3 tmp;
-            dVector3 dist,p;
-            dReal t,d,d1,d2;
-            bool outside,out;
-            dCopyVector3r4(dist, ccso.dist);
-            reference_side = GetSupportSide(dist,cvx1);
-            dist[0]=-dist[0];
-            dist[1]=-dist[1];
-            dist[2]=-dist[2];
-            incident_side = GetSupportSide(dist,cvx2);
-
-            pReferencePoly = cvx1.polygons;
-            pIncidentPoly  = cvx2.polygons;
-            // Get Reference plane (We may not have to apply transforms Optimization Oportunity)
-            // Rotate
-            dMultiply0_331(rplane,cvx1.final_posr->R,cvx1.planes+(reference_side*4));
-            dNormalize3(rplane);
-            // Translate
-            rplane[3]=
-                (cvx1.planes[(reference_side*4)+3])+
-                ((rplane[0] * cvx1.final_posr->pos[0]) +
-                (rplane[1] * cvx1.final_posr->pos[1]) +
-                (rplane[2] * cvx1.final_posr->pos[2]));
-            // flip
-            rplane[0]=-rplane[0];
-            rplane[1]=-rplane[1];
-            rplane[2]=-rplane[2];
-            rplane[3]=-rplane[3];
-            for(unsigned int i=0;i<incident_side;++i)
-            {
-                pIncidentPoly+=pIncidentPoly[0]+1;
-            }
-            pIncidentPoints = pIncidentPoly+1;
-            // Get the first point of the incident face
-            dMultiply0_331(i2,cvx2.final_posr->R,&cvx2.points[(pIncidentPoints[0]*3)]);
-            dAddVectors3r4(i2,cvx2.final_posr->pos,i2);
-            // Get the same point in the reference convex space
-            dCopyVector3r4(r2, i2);
-            dSubtractVectors3r4(r2, cvx1.final_posr->pos, r2);
-            dCopyVector3r4(tmp, r2);
-            dMultiply1_331(r2,cvx1.final_posr->R,tmp);
-            for(unsigned int i=0;i<pIncidentPoly[0];++i)
-            {
-                // Move i2 to i1, r2 to r1
-                dCopyVector3r4(i1, i2);
-                dCopyVector3r4(r1, r2);
-                dMultiply0_331(i2,cvx2.final_posr->R,&cvx2.points[(pIncidentPoints[(i+1)%pIncidentPoly[0]]*3)]);
-                dAddVectors3r4(i2,cvx2.final_posr->pos,i2);
-                // Get the same point in the reference convex space
-                dCopyVector3r4(r2, i2);
-                dSubtractVectors3r4(r2,cvx1.final_posr->pos,r2);
-                dCopyVector3r4(tmp, r2);
-                dMultiply1_331(r2,cvx1.final_posr->R,tmp);
-                outside=false;
-                for(unsigned int j=0;j<cvx1.planecount;++j)
-                {
-                    plane[0]=cvx1.planes[(j*4)+0];
-                    plane[1]=cvx1.planes[(j*4)+1];
-                    plane[2]=cvx1.planes[(j*4)+2];
-                    plane[3]=cvx1.planes[(j*4)+3];
-                    // Get the distance from the points to the plane
-                    d1 = r1[0]*plane[0]+
-                        r1[1]*plane[1]+
-                        r1[2]*plane[2]-
-                        plane[3];
-                    d2 = r2[0]*plane[0]+
-                        r2[1]*plane[1]+
-                        r2[2]*plane[2]-
-                        plane[3];
-                    if(d1*d2<0)
-                    {
-                        // Edge intersects plane
-                        IntersectSegmentPlane(r1,r2,plane,t,p);
-                        // Check the resulting point again to make sure it is inside the reference convex
-                        out=false;
-                        for(unsigned int k=0;k<cvx1.planecount;++k)
-                        {
-                            d = p[0]*cvx1.planes[(k*4)+0]+
-                                p[1]*cvx1.planes[(k*4)+1]+
-                                p[2]*cvx1.planes[(k*4)+2]-
-                                cvx1.planes[(k*4)+3];
-                            if(d>0)
-                            {
-                                out = true;
-                                break;
-                            };
-                        }
-                        if(!out)
-                        {
-#if 0
-                            // Use t to move p into global space
-                            p[0] = i1[0]+((i2[0]-i1[0])*t);
-                            p[1] = i1[1]+((i2[1]-i1[1])*t);
-                            p[2] = i1[2]+((i2[2]-i1[2])*t);
-#else
-                            // Apply reference convex transformations to p
-                            // The commented out piece of code is likelly to
-                            // produce less operations than this one, but
-                            // this way we know we are getting the right data
-                            dMultiply0_331(tmp,cvx1.final_posr->R,p);
-                            dAddVectors3r4(p, tmp, cvx1.final_posr->pos);
-#endif
-                            // get p's distance to reference plane
-                            d = p[0]*rplane[0]+
-                                p[1]*rplane[1]+
-                                p[2]*rplane[2]-
-                                rplane[3];
-                            if(d>0)
-                            {
-                                dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->pos, p);
-                                dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->normal, rplane);
-                                SAFECONTACT(flags, contact, contacts, skip)->g1=&cvx1;
-                                SAFECONTACT(flags, contact, contacts, skip)->g2=&cvx2;
-                                SAFECONTACT(flags, contact, contacts, skip)->depth=d;
-                                ++contacts;
-                                if (contacts==maxc) return contacts;
-                            }
-                        }
-                    }
-                    if(d1>0)
-                    {
-                        outside=true;
-                    }
-                }
-                if(outside) continue;
-                d = i1[0]*rplane[0]+
-                    i1[1]*rplane[1]+
-                    i1[2]*rplane[2]-
-                    rplane[3];
-                if(d>0)
-                {
-                    dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->pos, i1);
-                    dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->normal, rplane);
-                    SAFECONTACT(flags, contact, contacts, skip)->g1=&cvx1;
-                    SAFECONTACT(flags, contact, contacts, skip)->g2=&cvx2;
-                    SAFECONTACT(flags, contact, contacts, skip)->depth=d;
-                    ++contacts;
-                    if (contacts==maxc) return contacts;
-                }
-            }
-            // IF we get here, we got the easiest contacts to calculate,
-            // but there is still space in the contacts array for more.
-            // So, project the Reference's face points onto the Incident face
-            // plane and test them for inclusion in the reference plane as well.
-            // We already have computed intersections so, skip those.
-
-            /* Get Incident plane, we need it for projection */
-            /* Rotate */
-            dMultiply0_331(iplane,cvx2.final_posr->R,cvx2.planes+(incident_side*4));
-            dNormalize3(iplane);
-            /* Translate */
-            iplane[3]=
-                (cvx2.planes[(incident_side*4)+3])     +
-                ((iplane[0] * cvx2.final_posr->pos[0]) +
-                (iplane[1] * cvx2.final_posr->pos[1])  +
-                (iplane[2] * cvx2.final_posr->pos[2]));
-            // get reference face
-            for(unsigned int i=0;i<reference_side;++i)
-            {
-                pReferencePoly+=pReferencePoly[0]+1;
-            }
-            pReferencePoints = pReferencePoly+1;
-            for(unsigned int i=0;i<pReferencePoly[0];++i)
-            {
-                dMultiply0_331(i1,cvx1.final_posr->R,&cvx1.points[(pReferencePoints[i]*3)]);
-                dAddVectors3r4(i1, cvx1.final_posr->pos, i1);
-                // Project onto Incident face plane
-                t = -(i1[0]*iplane[0]+
-                    i1[1]*iplane[1]+
-                    i1[2]*iplane[2]-
-                    iplane[3]);
-                i1[0]+=iplane[0]*t;
-                i1[1]+=iplane[1]*t;
-                i1[2]+=iplane[2]*t;
-                // Get the same point in the incident convex space
-                dCopyVector3r4(r1, i1);
-                dSubtractVectors3r4(r1,cvx2.final_posr->pos,r1);
-                dCopyVector3r4(tmp, r1);
-                dMultiply1_331(r1,cvx2.final_posr->R,tmp);
-                // Check if it is outside the incident convex
-                out = false;
-                for(unsigned int j=0;j<cvx2.planecount;++j)
-                {
-                    d = r1[0]*cvx2.planes[(j*4)+0]+
-                        r1[1]*cvx2.planes[(j*4)+1]+
-                        r1[2]*cvx2.planes[(j*4)+2]-
-                        cvx2.planes[(j*4)+3];
-                    if(d>=0){out = true;break;};
-                }
-                if(!out)
-                {
-                    // check that the point is not a duplicate
-                    outside = false;
-                    for(int j=0;j<contacts;++j)
-                    {
-                        if((SAFECONTACT(flags, contact, j, skip)->pos[0]==i1[0])&&
-                            (SAFECONTACT(flags, contact, j, skip)->pos[1]==i1[1])&&
-                            (SAFECONTACT(flags, contact, j, skip)->pos[2]==i1[2]))
-                        {
-                            outside=true;
-                        }
-                    }
-                    if(!outside)
-                    {
-                        d = i1[0]*rplane[0]+
-                            i1[1]*rplane[1]+
-                            i1[2]*rplane[2]-
-                            rplane[3];
-                        if(d>0)
-                        {
-                            dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->pos, i1);
-                            dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->normal, rplane);
-                            SAFECONTACT(flags, contact, contacts, skip)->g1=&cvx1;
-                            SAFECONTACT(flags, contact, contacts, skip)->g2=&cvx2;
-                            SAFECONTACT(flags, contact, contacts, skip)->depth=d;
-                            ++contacts;
-                            if (contacts==maxc) return contacts;
-                        }
-                    }
-                }
-            }
-        }
-        else if(ccso.depth_type==2) // edge-edge
-        {
-            dVector3 c1,c2;
-            //float s,t;
-            SAFECONTACT(flags, contact, contacts, skip)->depth = 
-                dSqrt(ClosestPointBetweenSegments(ccso.e1a,ccso.e1b,ccso.e2a,ccso.e2b,c1,c2));
-            SAFECONTACT(flags, contact, contacts, skip)->g1=&cvx1;
-            SAFECONTACT(flags, contact, contacts, skip)->g2=&cvx2;
-            dCopyVector3r4(SAFECONTACT(flags, contact, contacts, skip)->pos, c1);
-            SAFECONTACT(flags, contact, contacts, skip)->normal[0] = c2[0]-c1[0];
-            SAFECONTACT(flags, contact, contacts, skip)->normal[1] = c2[1]-c1[1];
-            SAFECONTACT(flags, contact, contacts, skip)->normal[2] = c2[2]-c1[2];    
-            dNormalize3(SAFECONTACT(flags, contact, contacts, skip)->normal);
-            contacts++;
-        }
-        return contacts;
+    dIASSERT (skip >= (int)sizeof(dContactGeom));
+    dIASSERT (o1->type == dConvexClass);
+    dIASSERT (o2->type == dCapsuleClass);
+    dIASSERT ((flags & NUMC_MASK) >= 1);
+
+    dxConvexShape shape;
+    ConvexGetShape((dxConvex*) o1, shape);
+    return ConvexCollideCapsule(&shape, o1, (dxCapsule*) o2, flags, contact, skip);
 }
 
 int dCollideConvexConvex (dxGeom *o1, dxGeom *o2, int flags,
@@ -1388,73 +1596,128 @@ int dCollideConvexConvex (dxGeom *o1, dxGeom *o2, int flags,
     dIASSERT ((flags & NUMC_MASK) >= 1);
     dxConvex *Convex1 = (dxConvex*) o1;
     dxConvex *Convex2 = (dxConvex*) o2;
-    return TestConvexIntersection(*Convex1,*Convex2,flags,
-        contact,skip);
+    const int maxc = flags & NUMC_MASK;
+
+    dxConvexPolytope a, b;
+    dReal *pointsA = (dReal*)dALLOCA16(Convex1->pointcount * 3 * sizeof(dReal));
+    dReal *planesA = (dReal*)dALLOCA16(Convex1->planecount * 4 * sizeof(dReal));
+    dxConvexShape shape1, shape2;
+    ConvexGetShape(Convex1, shape1);
+    ConvexGetShape(Convex2, shape2);
+    ConvexGetPolytope(shape1, pointsA, planesA, a);
+    dReal *pointsB = (dReal*)dALLOCA16(Convex2->pointcount * 3 * sizeof(dReal));
+    dReal *planesB = (dReal*)dALLOCA16(Convex2->planecount * 4 * sizeof(dReal));
+    ConvexGetPolytope(shape2, pointsB, planesB, b);
+
+    duint32 feature = ConvexCacheGet(Convex1, Convex2);
+    dVector3 normal;
+    dxConvexContactPoint *points = (dxConvexContactPoint*)dALLOCA16(maxc * sizeof(dxConvexContactPoint));
+    const int count = ConvexCollidePolytopes(a, b, feature, normal, points, maxc);
+    ConvexCacheSet(Convex1, Convex2, feature);
+
+    ConvexWriteContacts(points, count, normal, flags, contact, skip);
+    for(int i=0;i<count;++i)
+    {
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        target->g1 = Convex1;
+        target->g2 = Convex2;
+    }
+    return count;
 }
 
-#if 0
-int dCollideRayConvex (dxGeom *o1, dxGeom *o2, int flags,
-                       dContactGeom *contact, int skip)
+int dCollideConvexCylinder (dxGeom *o1, dxGeom *o2, int flags,
+                            dContactGeom *contact, int skip)
 {
     dIASSERT (skip >= (int)sizeof(dContactGeom));
-    dIASSERT( o1->type == dRayClass );
-    dIASSERT( o2->type == dConvexClass );
+    dIASSERT (o1->type == dConvexClass);
+    dIASSERT (o2->type == dCylinderClass);
     dIASSERT ((flags & NUMC_MASK) >= 1);
-    dxRay* ray = (dxRay*) o1;
-    dxConvex* convex = (dxConvex*) o2;
-    dVector3 origin,destination,contactpoint,out;
-    dReal depth;
-    dVector4 plane;
-    unsigned int *pPoly=convex->polygons;
-    // Calculate ray origin and destination
-    destination[0]=0;
-    destination[1]=0;
-    destination[2]= ray->length;
-    // -- Rotate --
-    dMultiply0_331(destination,ray->final_posr->R,destination);
-    origin[0]=ray->final_posr->pos[0];
-    origin[1]=ray->final_posr->pos[1];
-    origin[2]=ray->final_posr->pos[2];
-    destination[0]+=origin[0];
-    destination[1]+=origin[1];
-    destination[2]+=origin[2];
-    for(int i=0;i<convex->planecount;++i)
+    dxConvex *Convex = (dxConvex*) o1;
+    dxCylinder *Cylinder = (dxCylinder*) o2;
+    const int maxc = flags & NUMC_MASK;
+
+    dxConvexShape shape1, shape2;
+    dxCylinderPrism prism;
+    ConvexGetShape(Convex, shape1);
+    ConvexGetCylinderShape(Cylinder, prism, shape2);
+
+    dxConvexPolytope a, b;
+    dReal *pointsA = (dReal*)dALLOCA16(Convex->pointcount * 3 * sizeof(dReal));
+    dReal *planesA = (dReal*)dALLOCA16(Convex->planecount * 4 * sizeof(dReal));
+    ConvexGetPolytope(shape1, pointsA, planesA, a);
+    dReal pointsB[2*CYLINDER_PRISM_SIDES*3];
+    dReal planesB[(CYLINDER_PRISM_SIDES+2)*4];
+    ConvexGetPolytope(shape2, pointsB, planesB, b);
+
+    duint32 feature = ConvexCacheGet(Convex, Cylinder);
+    dVector3 normal;
+    dxConvexContactPoint *points = (dxConvexContactPoint*)dALLOCA16(maxc * sizeof(dxConvexContactPoint));
+    const int count = ConvexCollidePolytopes(a, b, feature, normal, points, maxc);
+    ConvexCacheSet(Convex, Cylinder, feature);
+
+    ConvexWriteContacts(points, count, normal, flags, contact, skip);
+    for(int i=0;i<count;++i)
     {
-        // Rotate
-        dMultiply0_331(plane,convex->final_posr->R,convex->planes+(i*4));
-        // Translate
-        plane[3]=
-            (convex->planes[(i*4)+3])+
-            ((plane[0] * convex->final_posr->pos[0]) +
-            (plane[1] * convex->final_posr->pos[1]) +
-            (plane[2] * convex->final_posr->pos[2]));
-        if(IntersectSegmentPlane(origin,
-            destination,
-            plane,
-            depth,
-            contactpoint))
-        {
-            if(IsPointInPolygon(contactpoint,pPoly,plane,convex,out))
-            {
-                contact->pos[0]=contactpoint[0];
-                contact->pos[1]=contactpoint[1];
-                contact->pos[2]=contactpoint[2];
-                contact->normal[0]=plane[0];
-                contact->normal[1]=plane[1];
-                contact->normal[2]=plane[2];
-                contact->depth=depth;
-                contact->g1 = ray;
-                contact->g2 = convex;
-                contact->side1 = -1;
-                contact->side2 = -1; // TODO: set plane index?
-                return 1;
-            }
-        }
-        pPoly+=pPoly[0]+1;
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        target->g1 = Convex;
+        target->g2 = Cylinder;
     }
-    return 0;
+    return count;
 }
-#else
+
+int dCollideCylinderCylinder (dxGeom *o1, dxGeom *o2, int flags,
+                              dContactGeom *contact, int skip)
+{
+    dIASSERT (skip >= (int)sizeof(dContactGeom));
+    dIASSERT (o1->type == dCylinderClass);
+    dIASSERT (o2->type == dCylinderClass);
+    dIASSERT ((flags & NUMC_MASK) >= 1);
+    dxCylinder *Cylinder1 = (dxCylinder*) o1;
+    dxCylinder *Cylinder2 = (dxCylinder*) o2;
+    const int maxc = flags & NUMC_MASK;
+
+    dxConvexShape shape1, shape2;
+    dxCylinderPrism prism1, prism2;
+    ConvexGetCylinderShape(Cylinder1, prism1, shape1);
+    ConvexGetCylinderShape(Cylinder2, prism2, shape2);
+
+    dxConvexPolytope a, b;
+    dReal pointsA[2*CYLINDER_PRISM_SIDES*3];
+    dReal planesA[(CYLINDER_PRISM_SIDES+2)*4];
+    ConvexGetPolytope(shape1, pointsA, planesA, a);
+    dReal pointsB[2*CYLINDER_PRISM_SIDES*3];
+    dReal planesB[(CYLINDER_PRISM_SIDES+2)*4];
+    ConvexGetPolytope(shape2, pointsB, planesB, b);
+
+    duint32 feature = CONVEX_SAT_NONE;
+    dVector3 normal;
+    dxConvexContactPoint *points = (dxConvexContactPoint*)dALLOCA16(maxc * sizeof(dxConvexContactPoint));
+    const int count = ConvexCollidePolytopes(a, b, feature, normal, points, maxc);
+
+    ConvexWriteContacts(points, count, normal, flags, contact, skip);
+    for(int i=0;i<count;++i)
+    {
+        dContactGeom *target = SAFECONTACT(flags, contact, i, skip);
+        target->g1 = Cylinder1;
+        target->g2 = Cylinder2;
+    }
+    return count;
+}
+
+int dCollideCylinderCapsule (dxGeom *o1, dxGeom *o2, int flags,
+                             dContactGeom *contact, int skip)
+{
+    dIASSERT (skip >= (int)sizeof(dContactGeom));
+    dIASSERT (o1->type == dCylinderClass);
+    dIASSERT (o2->type == dCapsuleClass);
+    dIASSERT ((flags & NUMC_MASK) >= 1);
+
+    dxConvexShape shape;
+    dxCylinderPrism prism;
+    ConvexGetCylinderShape((dxCylinder*) o1, prism, shape);
+    return ConvexCollideCapsule(&shape, o1, (dxCapsule*) o2, flags, contact, skip);
+}
+
 // Ray - Convex collider by David Walters, June 2006
 int dCollideRayConvex( dxGeom *o1, dxGeom *o2,
                       int flags, dContactGeom *contact, int skip )
@@ -1472,6 +1735,13 @@ int dCollideRayConvex( dxGeom *o1, dxGeom *o2,
     contact->side1 = -1;
     contact->side2 = -1; // TODO: set plane index?
 
+    // the planes are in convex space, so is the ray
+    dVector3 offset, origin, direction;
+    dSubtractVectors3(offset, ray->final_posr->pos, convex->final_posr->pos);
+    dMultiply1_331(origin, convex->final_posr->R, offset);
+    const dVector3 rayDirection = { ray->final_posr->R[2], ray->final_posr->R[6], ray->final_posr->R[10] };
+    dMultiply1_331(direction, convex->final_posr->R, rayDirection);
+
     dReal alpha, beta, nsign;
     int flag;
 
@@ -1487,7 +1757,7 @@ int dCollideRayConvex( dxGeom *o1, dxGeom *o2,
         dReal* plane = convex->planes + ( i * 4 );
 
         // If alpha >= 0 then start point is outside of plane.
-        alpha = dCalcVectorDot3( plane, ray->final_posr->pos ) - plane[3];
+        alpha = ConvexDot( plane, origin ) - plane[3];
 
         // If any alpha is positive, then
         // the ray start is _outside_ of the hull
@@ -1508,6 +1778,7 @@ int dCollideRayConvex( dxGeom *o1, dxGeom *o2,
 
     // Assume no contacts.
     contact->depth = dInfinity;
+    dVector3 pos, normal;
 
     for ( unsigned int i = 0; i < convex->planecount; ++i )
     {
@@ -1515,62 +1786,65 @@ int dCollideRayConvex( dxGeom *o1, dxGeom *o2,
         dReal* plane = convex->planes + ( i * 4 );
 
         // If alpha >= 0 then point is outside of plane.
-        alpha = nsign * ( dCalcVectorDot3( plane, ray->final_posr->pos ) - plane[3] );
+        alpha = nsign * ( ConvexDot( plane, origin ) - plane[3] );
 
         // Compute [ plane-normal DOT ray-normal ], (/flip)
-        beta = dCalcVectorDot3_13( plane, ray->final_posr->R+2 ) * nsign;
+        beta = ConvexDot( plane, direction ) * nsign;
 
         // Ray is pointing at the plane? ( beta < 0 )
         // Ray start to plane is within maximum ray length?
         // Ray start to plane is closer than the current best distance?
-        if ( beta < -dEpsilon &&
-            alpha >= 0 && alpha <= ray->length &&
-            alpha < contact->depth )
+        if ( beta < -dEpsilon )
         {
-            // Compute contact point on convex hull surface.
-            contact->pos[0] = ray->final_posr->pos[0] + alpha * ray->final_posr->R[0*4+2];
-            contact->pos[1] = ray->final_posr->pos[1] + alpha * ray->final_posr->R[1*4+2];
-            contact->pos[2] = ray->final_posr->pos[2] + alpha * ray->final_posr->R[2*4+2];
+            // distance along the ray to the plane
+            alpha = -alpha / beta;
+            if ( alpha >= 0 && alpha <= ray->length && alpha < contact->depth )
+            {
+                // Compute contact point on convex hull surface.
+                dAddScaledVector3( pos, origin, direction, alpha );
 
-            flag = 0;
+                flag = 0;
 
-            // For all _other_ planes.
-            for ( unsigned int j = 0; j < convex->planecount; ++j )
-            {
-                if ( i == j )
-                    continue;	// Skip self.
+                // For all _other_ planes.
+                for ( unsigned int j = 0; j < convex->planecount; ++j )
+                {
+                    if ( i == j )
+                        continue;	// Skip self.
 
-                // Alias this plane.
-                dReal* planej = convex->planes + ( j * 4 );
+                    // Alias this plane.
+                    dReal* planej = convex->planes + ( j * 4 );
 
-                // If beta >= 0 then start is outside of plane.
-                beta = dCalcVectorDot3( planej, contact->pos ) - plane[3];
+                    // If beta >= 0 then start is outside of plane.
+                    beta = ConvexDot( planej, pos ) - planej[3];
 
-                // If any beta is positive, then the contact point
-                // is not on the surface of the convex hull - it's just
-                // intersecting some part of its infinite extent.
-                if ( beta > dEpsilon )
-                {
-                    flag = 1;
-                    break;
+                    // If any beta is positive, then the contact point
+                    // is not on the surface of the convex hull - it's just
+                    // intersecting some part of its infinite extent.
+                    if ( beta > dEpsilon )
+                    {
+                        flag = 1;
+                        break;
+                    }
                 }
-            }
 
-            // Contact point isn't outside hull's surface? then it's a good contact!
-            if ( flag == 0 )
-            {
-                // Store the contact normal, possibly flipped.
-                contact->normal[0] = nsign * plane[0];
-                contact->normal[1] = nsign * plane[1];
-                contact->normal[2] = nsign * plane[2];
+                // Contact point isn't outside hull's surface? then it's a good contact!
+                if ( flag == 0 )
+                {
+                    // Store the contact normal, possibly flipped.
+                    normal[0] = nsign * plane[0];
+                    normal[1] = nsign * plane[1];
+                    normal[2] = nsign * plane[2];
+                    ConvexTransformPoint( contact->pos, convex->final_posr->R, convex->final_posr->pos, pos );
+                    dMultiply0_331( contact->normal, convex->final_posr->R, normal );
 
-                // Store depth
-                contact->depth = alpha;
+                    // Store depth
+                    contact->depth = alpha;
 
-                if ((flags & CONTACTS_UNIMPORTANT) && contact->depth <= ray->length )
-                {
-                    // Break on any contact if contacts are not important
-                    break;
+                    if ((flags & CONTACTS_UNIMPORTANT) && contact->depth <= ray->length )
+                    {
+                        // Break on any contact if contacts are not important
+                        break;
+                    }
                 }
             }
         }
@@ -1579,5 +1853,124 @@ int dCollideRayConvex( dxGeom *o1, dxGeom *o2,
     return ( contact->depth <= ray->length );
 }
 
-#endif
-//<-- Convex Collision
+// Convex - Trimesh, every triangle the convex box touches is a polytope
+int dCollideConvexTrimesh (dxGeom *o1, dxGeom *o2, int flags,
+                           dContactGeom *contact, int skip)
+{
+    dIASSERT (skip >= (int)sizeof(dContactGeom));
+    dIASSERT (o1->type == dConvexClass);
+    dIASSERT (o2->type == dTriMeshClass);
+    dIASSERT ((flags & NUMC_MASK) >= 1);
+
+    dxConvex *Convex = (dxConvex*) o1;
+    dxTriMesh *TriMesh = (dxTriMesh*) o2;
+    const int maxc = flags & NUMC_MASK;
+
+    const dReal *R = Convex->final_posr->R;
+    const dReal *pos = Convex->final_posr->pos;
+
+    // the static box in world space, as OPCODE wants it
+    const dVector3 localCenter = {
+        (Convex->saabb[0] + Convex->saabb[1]) * REAL(0.5),
+        (Convex->saabb[2] + Convex->saabb[3]) * REAL(0.5),
+        (Convex->saabb[4] + Convex->saabb[5]) * REAL(0.5) };
+    dVector3 center;
+    ConvexTransformPoint(center, R, pos, localCenter);
+
+    OBB Box;
+    Box.mCenter.x = center[0];
+    Box.mCenter.y = center[1];
+    Box.mCenter.z = center[2];
+    Box.mExtents.x = (Convex->saabb[1] - Convex->saabb[0]) * REAL(0.5);
+    Box.mExtents.y = (Convex->saabb[3] - Convex->saabb[2]) * REAL(0.5);
+    Box.mExtents.z = (Convex->saabb[5] - Convex->saabb[4]) * REAL(0.5);
+    for(unsigned int i=0;i<3;++i)
+        for(unsigned int j=0;j<3;++j)
+            Box.mRot.m[i][j] = R[j*4+i];
+
+    const unsigned uiTLSKind = TriMesh->getParentSpaceTLSKind();
+    dIASSERT(uiTLSKind == Convex->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
+    TrimeshCollidersCache *pccColliderCache = GetTrimeshCollidersCache(uiTLSKind);
+    OBBCollider& Collider = pccColliderCache->_OBBCollider;
+
+    const dMatrix3& mRotMesh = *(const dMatrix3*)dGeomGetRotation(TriMesh);
+    const dVector3& vPosMesh = *(const dVector3*)dGeomGetPosition(TriMesh);
+    Matrix4x4 amatrix;
+    Collider.SetTemporalCoherence(false);
+    Collider.Collide(pccColliderCache->defaultBoxCache, Box, TriMesh->Data->BVTree, null,
+        &MakeMatrix(vPosMesh, mRotMesh, amatrix));
+
+    const int TriCount = Collider.GetNbTouchedPrimitives();
+    if (TriCount == 0)
+        return 0;
+    const int* Triangles = (const int*)Collider.GetTouchedPrimitives();
+
+    if (TriMesh->ArrayCallback != null)
+    {
+        TriMesh->ArrayCallback(TriMesh, Convex, Triangles, TriCount);
+    }
+
+    dxConvexPolytope a;
+    dReal *pointsA = (dReal*)dALLOCA16(Convex->pointcount * 3 * sizeof(dReal));
+    dReal *planesA = (dReal*)dALLOCA16(Convex->planecount * 4 * sizeof(dReal));
+    dxConvexShape shape;
+    ConvexGetShape(Convex, shape);
+    ConvexGetPolytope(shape, pointsA, planesA, a);
+
+    // a triangle gives at most 3 points, more only come from the clipping
+    const int triangleMaxc = maxc < 3 ? maxc : 3;
+    dxConvexContactPoint points[3];
+    int count = 0;
+
+    for (int i = 0; i < TriCount; i++)
+    {
+        const int Triint = Triangles[i];
+        if (!Callback(TriMesh, Convex, Triint))
+            continue;
+
+        dVector3 dv[3];
+        FetchTriangle(TriMesh, Triint, vPosMesh, mRotMesh, dv);
+
+        dxConvexPolytope b;
+        dReal pointsB[3*3], planesB[4*4];
+        if (!ConvexGetTrianglePolytope(dv, pointsB, planesB, b))
+            continue;
+
+        duint32 feature = CONVEX_SAT_NONE;
+        dVector3 normal;
+        const int found = ConvexCollidePolytopes(a, b, feature, normal, points, triangleMaxc);
+
+        for (int j = 0; j < found; j++)
+        {
+            dContactGeom *target;
+            if (count < maxc)
+            {
+                target = SAFECONTACT(flags, contact, count, skip);
+                ++count;
+            }
+            else
+            {
+                // full, replace the shallowest contact if this one is deeper
+                target = SAFECONTACT(flags, contact, 0, skip);
+                for (int k = 1; k < count; k++)
+                {
+                    dContactGeom *other = SAFECONTACT(flags, contact, k, skip);
+                    if (other->depth < target->depth) target = other;
+                }
+                if (target->depth >= points[j].depth)
+                    continue;
+            }
+            dCopyVector3(target->pos, points[j].pos);
+            dCopyVector3(target->normal, normal);
+            target->depth = points[j].depth;
+            target->g1 = Convex;
+            target->g2 = TriMesh;
+            target->side1 = -1;
+            target->side2 = Triint;
+        }
+
+        if ((flags & CONTACTS_UNIMPORTANT) && count == maxc)
+            break;
+    }
+    return count;
+}
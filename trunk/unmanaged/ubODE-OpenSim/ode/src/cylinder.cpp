@@ -105,4 +105,23 @@ void dGeomCylinderGetParams (dGeomID cylinder, dReal *radius, dReal *length)
     *length = c->lz;
 }
 
+dReal dGeomCylinderPointDepth (dGeomID cylinder, dReal x, dReal y, dReal z)
+{
+    dUASSERT (cylinder && cylinder->type == dCylinderClass,"argument not a cylinder");
+    cylinder->recomputePosr();
+    dxCylinder *c = (dxCylinder*) cylinder;
+
+    dVector3 p,lp;
+    p[0] = x - c->final_posr->pos[0];
+    p[1] = y - c->final_posr->pos[1];
+    p[2] = z - c->final_posr->pos[2];
+    dMultiply1_331 (lp,c->final_posr->R,p);
 
+    // distances inside the side and inside the caps
+    dReal radial = c->radius - dSqrt(lp[0]*lp[0] + lp[1]*lp[1]);
+    dReal axial = c->lz*REAL(0.5) - dFabs(lp[2]);
+
+    if (radial < 0 && axial < 0)
+        return -dSqrt(radial*radial + axial*axial);
+    return radial < axial ? radial : axial;
+}
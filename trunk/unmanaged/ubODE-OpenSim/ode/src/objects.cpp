@@ -31,6 +31,7 @@
 #include "objects.h"
 #include "util.h"
 #include "threading_impl.h"
+#include "collision_parallel.h"
 
 
 #define dWORLD_DEFAULT_GLOBAL_ERP REAL(0.2)
@@ -72,7 +73,9 @@ dxDampingParameters::dxDampingParameters(void *):
 
 dxQuickStepParameters::dxQuickStepParameters(void *):
     num_iterations(20),
-    w(REAL(1.3))
+    w(REAL(1.3)),
+    tolerance(REAL(0.0)),
+    solver_mode(dQuickStepSolverSequential)
 {
 }
 
@@ -82,6 +85,23 @@ dxContactParameters::dxContactParameters(void *):
 {
 }
 
+dxMovedBodiesParameters::dxMovedBodiesParameters(void *)
+{
+    set(REAL(0.0), REAL(0.0), REAL(0.0), REAL(0.0));
+}
+
+void dxMovedBodiesParameters::set(dReal new_position, dReal new_angle, dReal new_linear_vel, dReal new_angular_vel)
+{
+    position = new_position;
+    angle = new_angle;
+    linear_vel = new_linear_vel;
+    angular_vel = new_angular_vel;
+    position_sq = new_position * new_position;
+    half_angle_cos = dCos(new_angle * REAL(0.5));
+    linear_vel_sq = new_linear_vel * new_linear_vel;
+    angular_vel_sq = new_angular_vel * new_angular_vel;
+}
+
 dxWorld::dxWorld():
     dBase(),
     dxThreadingBase(),
@@ -94,11 +114,21 @@ dxWorld::dxWorld():
     adis(NULL),
     body_flags(0),
     islands_max_threads(dWORLDSTEP_THREADCOUNT_UNLIMITED),
+    deterministic(0),
     wmem(NULL),
+    parallel_collide(NULL),
     qs(NULL),
     contactp(NULL),
     dampingp(NULL),
     max_angular_speed(dInfinity),
+    movedp(NULL),
+    stepstats(),
+    nccd(0),
+    adis_islands(0),
+    awake_islands(0),
+    awake_bodies(0),
+    asleep_islands(0),
+    asleep_bodies(0),
     userdata(0)
 {
     dxThreadingBase::SetThreadingDefaultImplProvider(this);
@@ -113,6 +143,8 @@ dxWorld::~dxWorld()
         wmem->CleanupWorldReferences(this);
         wmem->Release();
     }
+
+    delete parallel_collide;
 }
 
 bool dxWorld::InitializeDefaultThreading()
@@ -166,6 +198,11 @@ unsigned dxWorld::GetThreadingIslandsMaxThreadsCount(unsigned *out_active_thread
         *out_active_thread_count_ptr = active_thread_count;
     }
 
+    if (deterministic)
+    {
+        return 1;
+    }
+
     return islands_max_threads == dWORLDSTEP_THREADCOUNT_UNLIMITED 
         ? active_thread_count 
         : (islands_max_threads < active_thread_count ? islands_max_threads : active_thread_count);
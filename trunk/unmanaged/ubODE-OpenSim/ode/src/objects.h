@@ -32,10 +32,13 @@
 #include "error.h"
 #include "array.h"
 #include "threading_base.h"
+#include "stepstats.h"
+#include "slabpool.h"
 
 
 class dxStepWorkingMemory;
 class dxWorldProcessContext;
+class dxParallelCollideContext;
 
 // some body flags
 
@@ -48,7 +51,11 @@ enum {
     dxBodyLinearDamping =             32, // use linear damping
     dxBodyAngularDamping =            64, // use angular damping
     dxBodyMaxAngularSpeed =           128,// use maximum angular speed
-    dxBodyGyroscopic =                256 // use gyroscopic term
+    dxBodyGyroscopic =                256,// use gyroscopic term
+    dxBodyMovedReported =             512,// state was returned by dWorldGetMovedBodies
+    dxBodyMovedReportedDisabled =     1024,// body was disabled when its state was returned
+    dxBodyCCD =                       2048,// sweep the body's motion at the end of each step
+    dxBodyIslandAsleep =              4096 // auto-disabled together with its island
 };
 
 
@@ -63,9 +70,19 @@ struct dBase {
 };
 
 
+// base class for objects created and destroyed in large numbers, these
+// come from the slab pools
+
+struct dPooledBase : public dBase {
+    void *operator new (size_t size) { return dSlabAlloc (size); }
+    void *operator new (size_t, void *p) { return p; }
+    void operator delete (void *ptr, size_t size) { dSlabFree (ptr,size); }
+};
+
+
 // base class for bodies and joints
 
-struct dObject : public dBase {
+struct dObject : public dPooledBase {
     dxWorld *world;		// world this object is in
     dObject *next;		// next object of this type in list
     dObject **tome;		// pointer to previous object's next ptr
@@ -106,6 +123,8 @@ struct dxDampingParameters {
 struct dxQuickStepParameters {
     int num_iterations;		// number of SOR iterations to perform
     dReal w;			// the SOR over-relaxation parameter
+    dReal tolerance;		// relative lambda change for early exit, 0 to disable
+    int solver_mode;		// dQuickStepSolverSequential or dQuickStepSolverColored
 
     dxQuickStepParameters() {}
     explicit dxQuickStepParameters(void *);
@@ -121,6 +140,23 @@ struct dxContactParameters {
     explicit dxContactParameters(void *);
 };
 
+// moved bodies report thresholds
+struct dxMovedBodiesParameters {
+    dReal position;             // position change threshold
+    dReal angle;                // orientation change threshold (radians)
+    dReal linear_vel;           // linear velocity change threshold
+    dReal angular_vel;          // angular velocity change threshold
+    dReal position_sq;          // cached squared thresholds
+    dReal half_angle_cos;       //   and cosine of half the angle threshold
+    dReal linear_vel_sq;
+    dReal angular_vel_sq;
+
+    dxMovedBodiesParameters() {}
+    explicit dxMovedBodiesParameters(void *);
+
+    void set(dReal new_position, dReal new_angle, dReal new_linear_vel, dReal new_angular_vel);
+};
+
 // position vector and rotation matrix for geometry objects that are not
 // connected to bodies.
 struct dxPosR {
@@ -149,11 +185,22 @@ struct dxBody : public dObject {
     dVector3* average_avel_buffer;      // buffer for the angular average velocity calculation
     unsigned int average_counter;      // counter/index to fill the average-buffers
     int average_ready;            // indicates ( with = 1 ), if the Body's buffers are ready for average-calculations
+    dxBody *adis_island_next;     // ring of the island it fell asleep with, 0=none
 
     void (*moved_callback)(dxBody*); // let the user know the body moved
     dxDampingParameters dampingp; // damping parameters, depends on flags
     dReal max_angular_speed;      // limit the angular velocity to this magnitude
 
+    // continuous collision, see ccd.cpp
+    dReal ccd_radius;             // radius kept clear of other geoms, 0=off
+    dReal ccd_threshold;          // step motion that triggers a sweep, 0=use radius
+    dVector3 ccd_pos;             // position at the start of the step
+
+    // state last returned by dWorldGetMovedBodies
+    dVector3 reported_pos;
+    dQuaternion reported_q;
+    dVector3 reported_lvel, reported_avel;
+
     dxBody(dxWorld *w);
 };
 
@@ -168,12 +215,20 @@ struct dxWorld : public dBase, public dxThreadingBase, private dxIThreadingDefau
     dxAutoDisable adis;		// auto-disable parameters
     int body_flags;               // flags for new bodies
     unsigned islands_max_threads; // maximum threads to allocate for island processing
+    int deterministic;            // step on a single thread, see dWorldSetDeterministic
     dxStepWorkingMemory *wmem; // Working memory object for dWorldStep/dWorldQuickStep
+    dxParallelCollideContext *parallel_collide; // Pairs and contact buffers for dSpaceCollideParallel
 
     dxQuickStepParameters qs;
     dxContactParameters contactp;
     dxDampingParameters dampingp; // damping parameters
     dReal max_angular_speed;      // limit the angular velocity to this magnitude
+    dxMovedBodiesParameters movedp; // dWorldGetMovedBodies thresholds
+    dxStepStats stepstats;        // dWorldGetStepStats counters
+    int nccd;                     // number of bodies with dxBodyCCD set
+    int adis_islands;             // auto-disable whole islands, see dWorldSetAutoDisableIslands
+    int awake_islands, awake_bodies;       // stepped by the last step
+    int asleep_islands, asleep_bodies;     // dxBodyIslandAsleep rings
 
     void* userdata;
 
@@ -53,7 +53,7 @@ dObStack::~dObStack()
     a = m_first;
     while (a) {
         nexta = a->m_next;
-        dFree (a,dOBSTACK_ARENA_SIZE);
+        dSlabFree (a,dOBSTACK_ARENA_SIZE);
         a = nexta;
     }
 }
@@ -82,7 +82,7 @@ void *dObStack::alloc (size_t num_bytes)
     }
 
     if (last_alloc_needed) {
-        Arena *new_last = (Arena *) dAlloc (dOBSTACK_ARENA_SIZE);
+        Arena *new_last = (Arena *) dSlabAlloc (dOBSTACK_ARENA_SIZE);
         new_last->m_next = 0;
         *last_ptr = new_last;
         if (m_first == NULL) {
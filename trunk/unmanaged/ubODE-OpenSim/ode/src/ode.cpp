@@ -39,6 +39,7 @@
 #include "quickstep.h"
 #include "util.h"
 #include "odetls.h"
+#include "ccd.h"
 
 // misc defines
 #define ALLOCA dALLOCA16
@@ -269,6 +270,7 @@ dxBody *dBodyCreate (dxWorld *w)
     b->adis_timeleft = b->adis.idle_time;
     b->average_counter = 0;
     b->average_ready = 0; // average buffer not filled on the beginning
+    b->adis_island_next = 0;
     dBodySetAutoDisableAverageSamplesCount(b, b->adis.average_samples);
 
     b->moved_callback = 0;
@@ -278,6 +280,9 @@ dxBody *dBodyCreate (dxWorld *w)
     b->flags |= w->body_flags & dxBodyMaxAngularSpeed;
     b->max_angular_speed = w->max_angular_speed;
 
+    b->ccd_radius = 0;
+    b->ccd_threshold = 0;
+
     b->flags |= dxBodyGyroscopic;
 
     return b;
@@ -292,6 +297,10 @@ void dBodyDestroy (dxBody *b)
     // to disappear. note that the call to dGeomSetBody(geom,0) will result in
     // dGeomGetBodyNext() returning 0 for the body, so we must get the next body
     // before setting the body to 0.
+    // the rest of its sleeping island may have rested on it
+    if (b->flags & dxBodyIslandAsleep)
+        dxWakeIsland(b);
+
     dxGeom *next_geom = 0;
     for (dxGeom *geom = b->geom; geom; geom = next_geom) {
         next_geom = dGeomGetBodyNext (geom);
@@ -311,6 +320,8 @@ void dBodyDestroy (dxBody *b)
     }
     removeObjectFromList (b);
     b->world->nb--;
+    if (b->flags & dxBodyCCD)
+        b->world->nccd--;
 
     // delete the average buffers
     if(b->average_lvel_buffer)
@@ -826,6 +837,8 @@ int dBodyIsKinematic (dBodyID b)
 void dBodyEnable (dBodyID b)
 {
     dAASSERT (b);
+    if (b->flags & dxBodyIslandAsleep)
+        dxWakeIsland(b);
     b->flags &= ~dxBodyDisabled;
     b->adis_stepsleft = b->adis.idle_steps;
     b->adis_timeleft = b->adis.idle_time;
@@ -1088,6 +1101,43 @@ void dBodySetMaxAngularSpeed(dBodyID b, dReal max_speed)
     b->max_angular_speed = max_speed;
 }
 
+dReal dBodyGetCCDRadius(dBodyID b)
+{
+    dAASSERT(b);
+    return b->ccd_radius;
+}
+
+void dBodySetCCDRadius(dBodyID b, dReal radius)
+{
+    dAASSERT(b);
+    dUASSERT(radius >= 0, "radius must be >= 0");
+    bool was_on = (b->flags & dxBodyCCD) != 0;
+    if (radius > 0) {
+        b->flags |= dxBodyCCD;
+        if (!was_on)
+            b->world->nccd++;
+    }
+    else {
+        b->flags &= ~dxBodyCCD;
+        if (was_on)
+            b->world->nccd--;
+    }
+    b->ccd_radius = radius;
+}
+
+dReal dBodyGetCCDThreshold(dBodyID b)
+{
+    dAASSERT(b);
+    return b->ccd_threshold;
+}
+
+void dBodySetCCDThreshold(dBodyID b, dReal threshold)
+{
+    dAASSERT(b);
+    dUASSERT(threshold >= 0, "threshold must be >= 0");
+    b->ccd_threshold = threshold;
+}
+
 void dBodySetMovedCallback(dBodyID b, void (*callback)(dBodyID))
 {
     dAASSERT(b);
@@ -1176,6 +1226,87 @@ dxJoint * dJointCreateContact (dWorldID w, dJointGroupID group,
 }
 
 
+static inline dxJoint *createAttachedContact (dWorldID w, dJointGroupID group,
+                                              const dContact *c, dxBody *b1, dxBody *b2)
+{
+    dxJointContact *j = (dxJointContact *)
+        createJoint<dxJointContact> (w,group);
+    j->contact = *c;
+    dJointAttach (j,b1,b2);
+    return j;
+}
+
+
+int dJointCreateContactsBatch (dWorldID w, dJointGroupID group,
+                               const dContact *contacts, const dBodyPairs *bodies, int n)
+{
+    dAASSERT (w && (contacts || n == 0));
+
+    int created = 0;
+    for (int i = 0; i < n; i++) {
+        const dContact *c = contacts + i;
+        dxBody *b1, *b2;
+        if (bodies) {
+            b1 = bodies[i].b1;
+            b2 = bodies[i].b2;
+        }
+        else {
+            b1 = dGeomGetBody (c->geom.g1);
+            b2 = dGeomGetBody (c->geom.g2);
+        }
+        // contacts between static geoms or within one body constrain nothing
+        if (b1 == b2)
+            continue;
+
+        createAttachedContact (w,group,c,b1,b2);
+        created++;
+    }
+    return created;
+}
+
+
+int dCollideAndCreateContacts (dWorldID w, dJointGroupID group,
+                               const dGeomID *geomPairs, const dSurfaceParameters *surfaces, int pairCount,
+                               int maxContactsPerPair, dContactGeom *contacts, int maxContacts)
+{
+    dAASSERT (w && (geomPairs || pairCount == 0) && (surfaces || pairCount == 0));
+    dUASSERT (maxContactsPerPair >= 1 && maxContactsPerPair <= 0xffff,"bad maximum contacts per pair");
+    dUASSERT (contacts || maxContacts == 0,"bad contacts argument");
+
+    dContact c;
+    dSetZero (c.fdir1,4);
+
+    int created = 0;
+    int used = 0;
+    for (int i = 0; i < pairCount && used < maxContacts; i++) {
+        dxGeom *g1 = geomPairs[2*i];
+        dxGeom *g2 = geomPairs[2*i+1];
+        dxBody *b1 = dGeomGetBody (g1);
+        dxBody *b2 = dGeomGetBody (g2);
+        if (b1 == b2)
+            continue;
+
+        int limit = maxContacts - used;
+        if (limit > maxContactsPerPair)
+            limit = maxContactsPerPair;
+
+        dContactGeom *pairContacts = contacts + used;
+        int n = dCollide (g1,g2,limit,pairContacts,sizeof(dContactGeom));
+        if (n == 0)
+            continue;
+
+        c.surface = surfaces[i];
+        for (int k = 0; k < n; k++) {
+            c.geom = pairContacts[k];
+            createAttachedContact (w,group,&c,b1,b2);
+        }
+        created += n;
+        used += n;
+    }
+    return created;
+}
+
+
 dxJoint * dJointCreateHinge2 (dWorldID w, dJointGroupID group)
 {
     dAASSERT (w);
@@ -1583,9 +1714,7 @@ void dWorldDestroy (dxWorld *w)
         }
         else {
             // TODO: shouldn't we call dJointDestroy()?
-            size_t sz = j->size();
-            j->~dxJoint();
-            dFree (j,sz);
+            delete j;
         }
         j = nextj;
     }
@@ -1664,6 +1793,18 @@ unsigned dWorldGetStepIslandsProcessingMaxThreadCount(dWorldID w)
     return w->islands_max_threads;
 }
 
+void dWorldSetDeterministic(dWorldID w, int deterministic)
+{
+    dAASSERT (w);
+    w->deterministic = deterministic != 0;
+}
+
+int dWorldGetDeterministic(dWorldID w)
+{
+    dAASSERT (w);
+    return w->deterministic;
+}
+
 int dWorldUseSharedWorkingMemory(dWorldID w, dWorldID from_world)
 {
     dUASSERT (w,"bad world argument");
@@ -1801,15 +1942,29 @@ int dWorldStep (dWorldID w, dReal stepsize)
 
     bool result = false;
 
+    if (w->stepstats.IsEnabled()) {
+        w->stepstats.BeginStep();
+    }
+    dxStepStatsLap statsLap(w->stepstats);
+
     dxWorldProcessIslandsInfo islandsinfo;
     if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateStepMemoryRequirements))
     {
+        if (w->nccd != 0) {
+            dxWorldCCDBeginStep(w);
+        }
+
         if (dxProcessIslands (w, islandsinfo, stepsize, &dxStepIsland, &dxEstimateStepMaxCallCount))
         {
+            if (w->nccd != 0) {
+                dxWorldCCDEndStep(w);
+            }
             result = true;
         }
     }
 
+    statsLap.Lap(dxSST_TOTAL);
+
     return result;
 }
 
@@ -1820,15 +1975,29 @@ int dWorldQuickStep (dWorldID w, dReal stepsize)
 
     bool result = false;
 
+    if (w->stepstats.IsEnabled()) {
+        w->stepstats.BeginStep();
+    }
+    dxStepStatsLap statsLap(w->stepstats);
+
     dxWorldProcessIslandsInfo islandsinfo;
     if (dxReallocateWorldProcessContext (w, islandsinfo, stepsize, &dxEstimateQuickStepMemoryRequirements))
     {
+        if (w->nccd != 0) {
+            dxWorldCCDBeginStep(w);
+        }
+
         if (dxProcessIslands (w, islandsinfo, stepsize, &dxQuickStepIsland, &dxEstimateQuickStepMaxCallCount))
         {
+            if (w->nccd != 0) {
+                dxWorldCCDEndStep(w);
+            }
             result = true;
         }
     }
 
+    statsLap.Lap(dxSST_TOTAL);
+
     return result;
 }
 
@@ -1935,6 +2104,31 @@ void dWorldSetAutoDisableFlag (dWorldID w, int do_auto_disable)
 }
 
 
+int dWorldGetAutoDisableIslands (dWorldID w)
+{
+    dAASSERT(w);
+    return w->adis_islands;
+}
+
+
+void dWorldSetAutoDisableIslands (dWorldID w, int do_islands)
+{
+    dAASSERT(w);
+    w->adis_islands = do_islands != 0;
+}
+
+
+void dWorldGetSleepCounts (dWorldID w, dWorldSleepCounts *counts)
+{
+    dAASSERT(w);
+    dUASSERT(counts, "bad counts argument");
+    counts->awake_islands = w->awake_islands;
+    counts->awake_bodies = w->awake_bodies;
+    counts->sleeping_islands = w->asleep_islands;
+    counts->sleeping_bodies = w->asleep_bodies;
+}
+
+
 // world damping functions
 
 dReal dWorldGetLinearDampingThreshold(dWorldID w)
@@ -2045,6 +2239,36 @@ dReal dWorldGetQuickStepW (dWorldID w)
 }
 
 
+void dWorldSetQuickStepTolerance (dWorldID w, dReal tolerance)
+{
+    dAASSERT(w);
+    dUASSERT(tolerance >= 0, "tolerance must not be negative");
+    w->qs.tolerance = tolerance;
+}
+
+
+dReal dWorldGetQuickStepTolerance (dWorldID w)
+{
+    dAASSERT(w);
+    return w->qs.tolerance;
+}
+
+
+void dWorldSetQuickStepSolverMode (dWorldID w, int mode)
+{
+    dAASSERT(w);
+    dUASSERT(mode == dQuickStepSolverSequential || mode == dQuickStepSolverColored, "invalid solver mode");
+    w->qs.solver_mode = mode;
+}
+
+
+int dWorldGetQuickStepSolverMode (dWorldID w)
+{
+    dAASSERT(w);
+    return w->qs.solver_mode;
+}
+
+
 void dWorldSetContactMaxCorrectingVel (dWorldID w, dReal vel)
 {
     dAASSERT(w);
@@ -2072,6 +2296,116 @@ dReal dWorldGetContactSurfaceLayer (dWorldID w)
     return w->contactp.min_depth;
 }
 
+
+void dWorldSetMovedBodiesThresholds (dWorldID w, dReal position, dReal angle,
+                                     dReal linear_vel, dReal angular_vel)
+{
+    dAASSERT(w);
+    dUASSERT(position >= 0 && angle >= 0 && linear_vel >= 0 && angular_vel >= 0,
+        "thresholds must be >= 0");
+    w->movedp.set(position, angle, linear_vel, angular_vel);
+}
+
+
+void dWorldGetMovedBodiesThresholds (dWorldID w, dReal *position, dReal *angle,
+                                     dReal *linear_vel, dReal *angular_vel)
+{
+    dAASSERT(w);
+    if (position) *position = w->movedp.position;
+    if (angle) *angle = w->movedp.angle;
+    if (linear_vel) *linear_vel = w->movedp.linear_vel;
+    if (angular_vel) *angular_vel = w->movedp.angular_vel;
+}
+
+
+// returns true if an enabled body drifted from its reported state by more
+// than the world thresholds
+static bool bodyMovedSinceReport (const dxBody *b, const dxMovedBodiesParameters &p)
+{
+    dVector3 d;
+    dSubtractVectors3(d, b->posr.pos, b->reported_pos);
+    if (dCalcVectorLengthSquare3(d) > p.position_sq)
+        return true;
+
+    // |q.q'| is the cosine of half the rotation between the two orientations
+    if (dFabs(dCalcVectorDot4(b->q, b->reported_q)) < p.half_angle_cos)
+        return true;
+
+    dSubtractVectors3(d, b->lvel, b->reported_lvel);
+    if (dCalcVectorLengthSquare3(d) > p.linear_vel_sq)
+        return true;
+
+    dSubtractVectors3(d, b->avel, b->reported_avel);
+    return dCalcVectorLengthSquare3(d) > p.angular_vel_sq;
+}
+
+
+int dWorldGetMovedBodies (dWorldID w, dMovedBodyState *buffer, int capacity)
+{
+    dAASSERT(w);
+    dUASSERT(buffer || capacity == 0, "bad buffer argument");
+
+    const dxMovedBodiesParameters &p = w->movedp;
+
+    int count = 0;
+    for (dxBody *b = w->firstbody; b && count < capacity; b = (dxBody *)b->next) {
+        const unsigned flags = b->flags;
+        const bool disabled = (flags & dxBodyDisabled) != 0;
+
+        if (flags & dxBodyMovedReported) {
+            bool was_disabled = (flags & dxBodyMovedReportedDisabled) != 0;
+            if (disabled == was_disabled && !bodyMovedSinceReport(b, p))
+                continue;
+        }
+
+        dCopyVector3(b->reported_pos, b->posr.pos);
+        dCopyVector4(b->reported_q, b->q);
+        dCopyVector3(b->reported_lvel, b->lvel);
+        dCopyVector3(b->reported_avel, b->avel);
+        b->flags = disabled
+            ? (flags | dxBodyMovedReported | dxBodyMovedReportedDisabled)
+            : ((flags | dxBodyMovedReported) & ~dxBodyMovedReportedDisabled);
+
+        dMovedBodyState *s = buffer + count++;
+        s->body = b;
+        s->data = b->userdata;
+        dCopyVector3(s->pos, b->posr.pos);
+        dCopyVector4(s->q, b->q);
+        dCopyVector3(s->lvel, b->lvel);
+        dCopyVector3(s->avel, b->avel);
+        s->enabled = !disabled;
+    }
+    return count;
+}
+
+
+void dWorldSetStepStatsEnabled (dWorldID w, int enabled)
+{
+    dAASSERT(w);
+    w->stepstats.SetEnabled(enabled != 0);
+}
+
+int dWorldGetStepStatsEnabled (dWorldID w)
+{
+    dAASSERT(w);
+    return w->stepstats.IsEnabled();
+}
+
+int dWorldGetStepStats (dWorldID w, dWorldStepStats *stats)
+{
+    dAASSERT(w);
+    dUASSERT(stats, "bad stats argument");
+    return w->stepstats.GetStats(stats);
+}
+
+int dWorldGetIslandStepStats (dWorldID w, dWorldIslandStepStats *buffer, int capacity)
+{
+    dAASSERT(w);
+    dUASSERT(buffer || capacity == 0, "bad buffer argument");
+    dUASSERT(capacity >= 0, "bad capacity argument");
+    return w->stepstats.GetIslandStats(buffer, capacity);
+}
+
 //****************************************************************************
 // testing
 
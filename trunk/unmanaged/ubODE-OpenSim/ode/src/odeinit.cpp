@@ -32,9 +32,11 @@ ODE initialization/finalization code
 #include "odemath.h"
 #include "collision_kernel.h"
 #include "collision_trimesh_internal.h"
+#include "osTerrain.h"
 #include "odetls.h"
 #include "odeou.h"
 #include "objects.h"
+#include "slabpool.h"
 #include "util.h"
 
 
@@ -156,6 +158,24 @@ static bool AllocateThreadCollisionData(EODETLSKIND tkTlsKind)
             break;
         }
 
+        dxOSTerrainCollidersCache *pccTerrainCache = new dxOSTerrainCollidersCache();
+        if (!COdeTls::AssignOSTerrainCollidersCache(tkTlsKind, pccTerrainCache))
+        {
+            delete pccTerrainCache;
+            COdeTls::DestroyTrimeshCollidersCache(tkTlsKind);
+    COdeTls::DestroyOSTerrainCollidersCache(tkTlsKind);
+            break;
+        }
+
+        dxSlabThreadCache *pscSlabCache = dAllocateSlabThreadCache();
+        if (!pscSlabCache || !COdeTls::AssignSlabThreadCache(tkTlsKind, pscSlabCache))
+        {
+            if (pscSlabCache) dFreeSlabThreadCache(pscSlabCache);
+            COdeTls::DestroyTrimeshCollidersCache(tkTlsKind);
+            COdeTls::DestroyOSTerrainCollidersCache(tkTlsKind);
+            break;
+        }
+
         COdeTls::SignalDataAllocationFlags(tkTlsKind, TLD_INTERNAL_COLLISIONDATA_ALLOCATED);
 
         bResult = true;
@@ -205,6 +225,8 @@ static void FreeThreadCollisionData(EODEINITMODE imInitMode)
     EODETLSKIND tkTlsKind = g_atkTLSKindsByInitMode[imInitMode];
 
     COdeTls::DestroyTrimeshCollidersCache(tkTlsKind);
+    COdeTls::DestroyOSTerrainCollidersCache(tkTlsKind);
+    COdeTls::DestroySlabThreadCache(tkTlsKind);
 
     COdeTls::DropDataAllocationFlags(tkTlsKind, TLD_INTERNAL_COLLISIONDATA_ALLOCATED);
 #else
@@ -230,6 +252,7 @@ static bool InitODEForMode(EODEINITMODE imInitMode)
     (void)imInitMode; // unused
 #endif
 
+    bool bSlabPoolsInitialized = false;
     bool bWorldThreadingInitialized = false;
 
     do
@@ -268,6 +291,13 @@ static bool InitODEForMode(EODEINITMODE imInitMode)
 
         if (!bAnyModeAlreadyInitialized)
         {
+            if (!dInitSlabPools())
+            {
+                break;
+            }
+
+            bSlabPoolsInitialized = true;
+
             if (!dxWorld::InitializeDefaultThreading())
             {
                 break;
@@ -293,6 +323,11 @@ static bool InitODEForMode(EODEINITMODE imInitMode)
             dxWorld::FinalizeDefaultThreading();
         }
 
+        if (bSlabPoolsInitialized)
+        {
+            dFinitSlabPools();
+        }
+
 #if dTLS_ENABLED
         if (bTlsInitialized)
         {
@@ -375,6 +410,8 @@ static void CloseODEForMode(EODEINITMODE imInitMode)
         Opcode::CloseOpcode();
 
         dxWorld::FinalizeDefaultThreading();
+
+        dFinitSlabPools();
     }
 
 #if dTLS_ENABLED
@@ -36,6 +36,8 @@ ODE Thread Local Storage access stub implementation.
 #include "odemath.h"
 #include "odetls.h"
 #include "collision_trimesh_internal.h"
+#include "osTerrain.h"
+#include "slabpool.h"
 #include "util.h"
 
 
@@ -127,6 +129,50 @@ void COdeTls::DestroyTrimeshCollidersCache(EODETLSKIND tkTLSKind)
 }
 
 
+
+bool COdeTls::AssignOSTerrainCollidersCache(EODETLSKIND tkTLSKind, dxOSTerrainCollidersCache *pccInstance)
+{
+    dIASSERT(!CThreadLocalStorage::GetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_OSTERRAIN_COLLIDER_CACHE));
+
+    bool bResult = CThreadLocalStorage::SetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_OSTERRAIN_COLLIDER_CACHE, (tlsvaluetype)pccInstance, &COdeTls::FreeOSTerrainCollidersCache_Callback);
+    return bResult;
+}
+
+void COdeTls::DestroyOSTerrainCollidersCache(EODETLSKIND tkTLSKind)
+{
+    dxOSTerrainCollidersCache *pccCacheInstance = (dxOSTerrainCollidersCache *)CThreadLocalStorage::GetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_OSTERRAIN_COLLIDER_CACHE);
+
+    if (pccCacheInstance)
+    {
+        FreeOSTerrainCollidersCache(pccCacheInstance);
+
+        CThreadLocalStorage::UnsafeSetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_OSTERRAIN_COLLIDER_CACHE, (tlsvaluetype)NULL);
+    }
+}
+
+
+
+bool COdeTls::AssignSlabThreadCache(EODETLSKIND tkTLSKind, dxSlabThreadCache *pscInstance)
+{
+    dIASSERT(!CThreadLocalStorage::GetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_SLAB_THREAD_CACHE));
+
+    bool bResult = CThreadLocalStorage::SetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_SLAB_THREAD_CACHE, (tlsvaluetype)pscInstance, &COdeTls::FreeSlabThreadCache_Callback);
+    return bResult;
+}
+
+void COdeTls::DestroySlabThreadCache(EODETLSKIND tkTLSKind)
+{
+    dxSlabThreadCache *pscInstance = (dxSlabThreadCache *)CThreadLocalStorage::GetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_SLAB_THREAD_CACHE);
+
+    if (pscInstance)
+    {
+        dFreeSlabThreadCache(pscInstance);
+
+        CThreadLocalStorage::UnsafeSetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_SLAB_THREAD_CACHE, (tlsvaluetype)NULL);
+    }
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // Value type destructors
 
@@ -135,6 +181,11 @@ void COdeTls::FreeTrimeshCollidersCache(TrimeshCollidersCache *pccCacheInstance)
     delete pccCacheInstance;
 }
 
+void COdeTls::FreeOSTerrainCollidersCache(dxOSTerrainCollidersCache *pccCacheInstance)
+{
+    delete pccCacheInstance;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 // Value type destructor callbacks
@@ -145,6 +196,18 @@ void COdeTls::FreeTrimeshCollidersCache_Callback(tlsvaluetype vValueData)
     FreeTrimeshCollidersCache(pccCacheInstance);
 }
 
+void COdeTls::FreeOSTerrainCollidersCache_Callback(tlsvaluetype vValueData)
+{
+    dxOSTerrainCollidersCache *pccCacheInstance = (dxOSTerrainCollidersCache *)vValueData;
+    FreeOSTerrainCollidersCache(pccCacheInstance);
+}
+
+void COdeTls::FreeSlabThreadCache_Callback(tlsvaluetype vValueData)
+{
+    dxSlabThreadCache *pscInstance = (dxSlabThreadCache *)vValueData;
+    dFreeSlabThreadCache(pscInstance);
+}
+
 
 #endif // #if dTLS_ENABLED
 
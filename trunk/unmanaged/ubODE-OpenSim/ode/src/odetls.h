@@ -48,6 +48,8 @@ using _OU_NAMESPACE::CThreadLocalStorage;
 
 
 struct TrimeshCollidersCache;
+struct dxOSTerrainCollidersCache;
+struct dxSlabThreadCache;
 
 
 enum EODETLSKIND
@@ -66,6 +68,8 @@ enum EODETLSITEM
 {
     OTI_DATA_ALLOCATION_FLAGS,
     OTI_TRIMESH_TRIMESH_COLLIDER_CACHE,
+    OTI_OSTERRAIN_COLLIDER_CACHE,
+    OTI_SLAB_THREAD_CACHE,
 
     OTI__MAX,
 };
@@ -103,17 +107,48 @@ public:
         return (TrimeshCollidersCache *)CThreadLocalStorage::UnsafeGetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_TRIMESH_TRIMESH_COLLIDER_CACHE);
     }
 
+    static dxOSTerrainCollidersCache *GetOSTerrainCollidersCache(EODETLSKIND tkTLSKind)
+    { 
+        return (dxOSTerrainCollidersCache *)CThreadLocalStorage::UnsafeGetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_OSTERRAIN_COLLIDER_CACHE);
+    }
+
+    // The slab pools do not know the TLS kind of the caller, the first cache found is used
+    static dxSlabThreadCache *FindSlabThreadCache()
+    {
+        for (unsigned tkTLSKind = OTK__MIN; tkTLSKind != OTK__MAX; ++tkTLSKind)
+        {
+            if (m_ahtkStorageKeys[tkTLSKind])
+            {
+                dxSlabThreadCache *pscInstance = (dxSlabThreadCache *)CThreadLocalStorage::GetStorageValue(m_ahtkStorageKeys[tkTLSKind], OTI_SLAB_THREAD_CACHE);
+                if (pscInstance)
+                {
+                    return pscInstance;
+                }
+            }
+        }
+        return NULL;
+    }
+
 public:
     static bool AssignDataAllocationFlags(EODETLSKIND tkTLSKind, unsigned uInitializationFlags);
 
     static bool AssignTrimeshCollidersCache(EODETLSKIND tkTLSKind, TrimeshCollidersCache *pccInstance);
     static void DestroyTrimeshCollidersCache(EODETLSKIND tkTLSKind);
 
+    static bool AssignOSTerrainCollidersCache(EODETLSKIND tkTLSKind, dxOSTerrainCollidersCache *pccInstance);
+    static void DestroyOSTerrainCollidersCache(EODETLSKIND tkTLSKind);
+
+    static bool AssignSlabThreadCache(EODETLSKIND tkTLSKind, dxSlabThreadCache *pscInstance);
+    static void DestroySlabThreadCache(EODETLSKIND tkTLSKind);
+
 private:
     static void FreeTrimeshCollidersCache(TrimeshCollidersCache *pccCacheInstance);
+    static void FreeOSTerrainCollidersCache(dxOSTerrainCollidersCache *pccCacheInstance);
 
 private:
     static void _OU_CONVENTION_CALLBACK FreeTrimeshCollidersCache_Callback(tlsvaluetype vValueData);
+    static void _OU_CONVENTION_CALLBACK FreeOSTerrainCollidersCache_Callback(tlsvaluetype vValueData);
+    static void _OU_CONVENTION_CALLBACK FreeSlabThreadCache_Callback(tlsvaluetype vValueData);
 
 private:
     static HTLSKEY				m_ahtkStorageKeys[OTK__MAX];
@@ -24,6 +24,7 @@
 #include "ode/timer.h"
 
 #include "collision_trimesh_colliders.h"
+#include "collision_trimesh_internal.h"
 
 #define dMIN(A,B)  ((A)>(B) ? (B) : (A))
 #define dMAX(A,B)  ((A)>(B) ? (A) : (B))
@@ -92,9 +93,20 @@ dxOSTerrainData::dxOSTerrainData() :	m_fWidth( 0 ),
 											m_nDepthSamples( 0 ),
 											m_bCopyHeightData( 0 ),
 											
-											m_pHeightData( NULL )
+											m_pHeightData( NULL ),
+
+											m_bQuantized( 0 ),
+											m_pQuantizedHeights( NULL ),
+											m_nQuantizedTilesX( 0 ),
+											m_fQuantizedOffset( 0 ),
+											m_fQuantizedStep( 0 ),
+
+											m_pMinMax( NULL ),
+											m_nMinMaxLevels( 0 ),
+
+											m_bBuildPlanes( 0 ),
+											m_pPlaneScale( NULL )
 {
-	memset( m_contacts, 0, sizeof( m_contacts ) );
 }
 
 // build OSTerrain data
@@ -132,6 +144,20 @@ void dxOSTerrainData::ComputeHeightBounds()
 
     m_fMinHeight = dInfinity;
     m_fMaxHeight = -dInfinity;
+    if (m_pQuantizedHeights)
+    {
+        for (int y = 0; y < m_nDepthSamples; y++)
+        {
+            for (int x = 0; x < m_nWidthSamples; x++)
+            {
+                h = GetSample(x, y);
+                if (h < m_fMinHeight)	m_fMinHeight = h;
+                if (h > m_fMaxHeight)	m_fMaxHeight = h;
+            }
+        }
+        return;
+    }
+
     int tot = m_nWidthSamples*m_nDepthSamples;
     for (i=0; i < tot; i++)
     {
@@ -141,6 +167,351 @@ void dxOSTerrainData::ComputeHeightBounds()
     }
 }
 
+// builds the min/max heights pyramid
+// leaf nodes hold the bounds of a block of cells, each coarser level
+// halves the node count per side down to a single root node
+void dxOSTerrainData::BuildMinMax()
+{
+    FreeMinMax();
+
+    const int cellsX = m_nWidthSamples - 1;
+    const int cellsY = m_nDepthSamples - 1;
+    const int leafSize = 1 << OSTERRAINMINMAXLEAFSHIFT;
+
+    int levelWidth = (cellsX + leafSize - 1) >> OSTERRAINMINMAXLEAFSHIFT;
+    int levelDepth = (cellsY + leafSize - 1) >> OSTERRAINMINMAXLEAFSHIFT;
+    size_t totalNodes = 0;
+    int level = 0;
+
+    while (true)
+    {
+        dIASSERT(level < OSTERRAINMINMAXMAXLEVELS);
+        m_nMinMaxLevelWidth[level] = levelWidth;
+        m_nMinMaxLevelDepth[level] = levelDepth;
+        m_nMinMaxLevelOffset[level] = totalNodes;
+        totalNodes += (size_t)levelWidth * levelDepth;
+        level++;
+        if (levelWidth == 1 && levelDepth == 1)
+            break;
+        levelWidth = (levelWidth + 1) >> 1;
+        levelDepth = (levelDepth + 1) >> 1;
+    }
+    m_nMinMaxLevels = level;
+    m_pMinMax = new float[totalNodes * 2];
+
+    // leafs from samples, including the shared border samples
+    float *node = m_pMinMax;
+    for (int ny = 0; ny < m_nMinMaxLevelDepth[0]; ny++)
+    {
+        const int y0 = ny << OSTERRAINMINMAXLEAFSHIFT;
+        const int y1 = dMIN(y0 + leafSize, cellsY);
+        for (int nx = 0; nx < m_nMinMaxLevelWidth[0]; nx++)
+        {
+            const int x0 = nx << OSTERRAINMINMAXLEAFSHIFT;
+            const int x1 = dMIN(x0 + leafSize, cellsX);
+            float minZ = GetSample(x0, y0);
+            float maxZ = minZ;
+            for (int y = y0; y <= y1; y++)
+            {
+                for (int x = x0; x <= x1; x++)
+                {
+                    const float h = GetSample(x, y);
+                    if (h < minZ) minZ = h;
+                    if (h > maxZ) maxZ = h;
+                }
+            }
+            *node++ = minZ;
+            *node++ = maxZ;
+        }
+    }
+
+    // coarser levels from their children
+    for (level = 1; level < m_nMinMaxLevels; level++)
+    {
+        const int childWidth = m_nMinMaxLevelWidth[level - 1];
+        const int childDepth = m_nMinMaxLevelDepth[level - 1];
+        const float *children = m_pMinMax + 2 * m_nMinMaxLevelOffset[level - 1];
+        node = m_pMinMax + 2 * m_nMinMaxLevelOffset[level];
+
+        for (int ny = 0; ny < m_nMinMaxLevelDepth[level]; ny++)
+        {
+            const int cy1 = dMIN(2 * ny + 1, childDepth - 1);
+            for (int nx = 0; nx < m_nMinMaxLevelWidth[level]; nx++)
+            {
+                const int cx1 = dMIN(2 * nx + 1, childWidth - 1);
+                float minZ = dInfinity;
+                float maxZ = -dInfinity;
+                for (int cy = 2 * ny; cy <= cy1; cy++)
+                {
+                    for (int cx = 2 * nx; cx <= cx1; cx++)
+                    {
+                        const float *child = children + 2 * (cx + cy * childWidth);
+                        if (child[0] < minZ) minZ = child[0];
+                        if (child[1] > maxZ) maxZ = child[1];
+                    }
+                }
+                *node++ = minZ;
+                *node++ = maxZ;
+            }
+        }
+    }
+}
+
+void dxOSTerrainData::FreeMinMax()
+{
+    delete[] m_pMinMax;
+    m_pMinMax = NULL;
+    m_nMinMaxLevels = 0;
+}
+
+// precomputes the normal length of every cell triangle
+// same math as dV3CrossTerrain so contacts don't change with the table
+void dxOSTerrainData::BuildPlanes()
+{
+    FreePlanes();
+
+    m_pPlaneScale = new dReal[2 * m_nWidthSamples * m_nDepthSamples];
+
+    for (int y = 0; y < m_nDepthSamples - 1; y++)
+    {
+        for (int x = 0; x < m_nWidthSamples - 1; x++)
+        {
+            const dReal AHeight = GetHeightSafe(x, y);
+            const dReal BHeight = GetHeightSafe(x + 1, y);
+            const dReal CHeight = GetHeightSafe(x, y + 1);
+            const dReal DHeight = GetHeightSafe(x + 1, y + 1);
+            dReal *scale = m_pPlaneScale + 2 * (x + y * m_nWidthSamples);
+            dReal dx, dy;
+
+            // C A D
+            dx = CHeight - DHeight;
+            dy = AHeight - CHeight;
+            scale[0] = REAL(1.0) / dSqrt(dx * dx + dy * dy + REAL(1.0));
+
+            // B D A
+            dx = AHeight - BHeight;
+            dy = BHeight - DHeight;
+            scale[1] = REAL(1.0) / dSqrt(dx * dx + dy * dy + REAL(1.0));
+        }
+    }
+}
+
+void dxOSTerrainData::FreePlanes()
+{
+    delete[] m_pPlaneScale;
+    m_pPlaneScale = NULL;
+}
+
+// stores the samples as 16 bit steps over their height range
+// tiles of samples keep a collision zone in a few cache lines
+void dxOSTerrainData::BuildQuantized(const float *pHeightData)
+{
+    FreeQuantized();
+
+    const int tileSize = 1 << OSTERRAINQUANTIZEDTILESHIFT;
+    const int tilesX = (m_nWidthSamples + tileSize - 1) >> OSTERRAINQUANTIZEDTILESHIFT;
+    const int tilesY = (m_nDepthSamples + tileSize - 1) >> OSTERRAINQUANTIZEDTILESHIFT;
+    const size_t total = ((size_t)tilesX * tilesY) << (2 * OSTERRAINQUANTIZEDTILESHIFT);
+
+    float minZ = dInfinity;
+    float maxZ = -dInfinity;
+    const size_t count = (size_t)m_nWidthSamples * m_nDepthSamples;
+    for (size_t i = 0; i < count; i++)
+    {
+        const float h = pHeightData[i];
+        if (h < minZ) minZ = h;
+        if (h > maxZ) maxZ = h;
+    }
+
+    m_nQuantizedTilesX = tilesX;
+    m_fQuantizedOffset = minZ;
+    m_fQuantizedStep = (maxZ - minZ) / 65535.0f;
+    m_pQuantizedHeights = new unsigned short[total];
+    memset(m_pQuantizedHeights, 0, total * sizeof(unsigned short));
+
+    const float invStep = m_fQuantizedStep > 0 ? 1.0f / m_fQuantizedStep : 0;
+    for (int y = 0; y < m_nDepthSamples; y++)
+    {
+        const float *row = pHeightData + y * m_nWidthSamples;
+        unsigned short *tileRow = m_pQuantizedHeights
+            + (((size_t)(y >> OSTERRAINQUANTIZEDTILESHIFT) * tilesX) << (2 * OSTERRAINQUANTIZEDTILESHIFT))
+            + ((y & OSTERRAINQUANTIZEDTILEMASK) << OSTERRAINQUANTIZEDTILESHIFT);
+        for (int x = 0; x < m_nWidthSamples; x++)
+        {
+            float q = (row[x] - minZ) * invStep + 0.5f;
+            if (q > 65535.0f) q = 65535.0f;
+            tileRow[((size_t)(x >> OSTERRAINQUANTIZEDTILESHIFT) << (2 * OSTERRAINQUANTIZEDTILESHIFT))
+                + (x & OSTERRAINQUANTIZEDTILEMASK)] = (unsigned short)q;
+        }
+    }
+}
+
+void dxOSTerrainData::FreeQuantized()
+{
+    delete[] m_pQuantizedHeights;
+    m_pQuantizedHeights = NULL;
+}
+
+// height bounds, pyramid and planes of the current samples
+void dxOSTerrainData::RebuildAccelerationData()
+{
+    ComputeHeightBounds();
+
+    BuildMinMax();
+    if ( m_bBuildPlanes )
+        BuildPlanes();
+}
+
+size_t dxOSTerrainData::GetMemoryUsage() const
+{
+    size_t bytes = 0;
+    const size_t samples = (size_t)m_nWidthSamples * m_nDepthSamples;
+
+    if (m_bCopyHeightData && m_pHeightData)
+        bytes += samples * sizeof(float);
+    if (m_pQuantizedHeights)
+    {
+        const size_t tiles = (size_t)m_nQuantizedTilesX
+            * ((m_nDepthSamples + OSTERRAINQUANTIZEDTILEMASK) >> OSTERRAINQUANTIZEDTILESHIFT);
+        bytes += (tiles << (2 * OSTERRAINQUANTIZEDTILESHIFT)) * sizeof(unsigned short);
+    }
+    if (m_pMinMax)
+        bytes += (m_nMinMaxLevelOffset[m_nMinMaxLevels - 1] + 1) * 2 * sizeof(float);
+    if (m_pPlaneScale)
+        bytes += 2 * samples * sizeof(dReal);
+
+    return bytes;
+}
+
+void dxOSTerrainData::GetPlaneNormal(int x, int y, bool second,
+    dReal dx, dReal dy, dReal *normal) const
+{
+    if (m_pPlaneScale)
+    {
+        const dReal dinvlength = m_pPlaneScale[2 * (x + y * m_nWidthSamples) + (second ? 1 : 0)];
+        normal[0] = dx * dinvlength;
+        normal[1] = dy * dinvlength;
+        normal[2] = dinvlength;
+    }
+    else
+        dV3CrossTerrain(normal, dx, dy);
+}
+
+void dxOSTerrainData::GetCellRangeBounds(int minX, int maxX, int minY, int maxY,
+    dReal &minZ, dReal &maxZ) const
+{
+    dIASSERT(m_pMinMax);
+    dIASSERT(minX < maxX && minY < maxY);
+
+    float rangeMin = dInfinity;
+    float rangeMax = -dInfinity;
+
+    // nodes still to visit, as level, x, y
+    int stack[3 * 4 * OSTERRAINMINMAXMAXLEVELS];
+    int top = 0;
+
+    stack[top++] = m_nMinMaxLevels - 1;
+    stack[top++] = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const int ny = stack[--top];
+        const int nx = stack[--top];
+        const int level = stack[--top];
+
+        const int shift = level + OSTERRAINMINMAXLEAFSHIFT;
+        const int x0 = nx << shift;
+        const int x1 = dMIN((nx + 1) << shift, m_nWidthSamples - 1);
+        const int y0 = ny << shift;
+        const int y1 = dMIN((ny + 1) << shift, m_nDepthSamples - 1);
+
+        if (x0 >= maxX || x1 <= minX || y0 >= maxY || y1 <= minY)
+            continue;
+
+        const float *node = m_pMinMax + 2 * (m_nMinMaxLevelOffset[level] + nx + ny * m_nMinMaxLevelWidth[level]);
+        if (node[0] >= rangeMin && node[1] <= rangeMax)
+            continue; // can't change the result
+
+        if (x0 >= minX && x1 <= maxX && y0 >= minY && y1 <= maxY)
+        {
+            if (node[0] < rangeMin) rangeMin = node[0];
+            if (node[1] > rangeMax) rangeMax = node[1];
+            continue;
+        }
+
+        if (level == 0)
+        {
+            // partial leaf, scan the overlapped samples
+            const int sx0 = dMAX(x0, minX);
+            const int sx1 = dMIN(x1, maxX);
+            const int sy0 = dMAX(y0, minY);
+            const int sy1 = dMIN(y1, maxY);
+            for (int y = sy0; y <= sy1; y++)
+            {
+                for (int x = sx0; x <= sx1; x++)
+                {
+                    const float h = GetSample(x, y);
+                    if (h < rangeMin) rangeMin = h;
+                    if (h > rangeMax) rangeMax = h;
+                }
+            }
+            continue;
+        }
+
+        const int childLevel = level - 1;
+        const int cx1 = dMIN(2 * nx + 1, m_nMinMaxLevelWidth[childLevel] - 1);
+        const int cy1 = dMIN(2 * ny + 1, m_nMinMaxLevelDepth[childLevel] - 1);
+        for (int cy = 2 * ny; cy <= cy1; cy++)
+        {
+            for (int cx = 2 * nx; cx <= cx1; cx++)
+            {
+                dIASSERT(top + 3 <= (int)(sizeof(stack) / sizeof(stack[0])));
+                stack[top++] = childLevel;
+                stack[top++] = cx;
+                stack[top++] = cy;
+            }
+        }
+    }
+
+    minZ = rangeMin;
+    maxZ = rangeMax;
+}
+
+void dxOSTerrainData::ShrinkCellRange(dReal minZ, int &minX, int &maxX, int &minY, int &maxY) const
+{
+    dReal stripMin, stripMax;
+
+    while (minX + 1 < maxX)
+    {
+        GetCellRangeBounds(minX, minX + 1, minY, maxY, stripMin, stripMax);
+        if (stripMax > minZ)
+            break;
+        minX++;
+    }
+    while (minX + 1 < maxX)
+    {
+        GetCellRangeBounds(maxX - 1, maxX, minY, maxY, stripMin, stripMax);
+        if (stripMax > minZ)
+            break;
+        maxX--;
+    }
+    while (minY + 1 < maxY)
+    {
+        GetCellRangeBounds(minX, maxX, minY, minY + 1, stripMin, stripMax);
+        if (stripMax > minZ)
+            break;
+        minY++;
+    }
+    while (minY + 1 < maxY)
+    {
+        GetCellRangeBounds(minX, maxX, maxY - 1, maxY, stripMin, stripMax);
+        if (stripMax > minZ)
+            break;
+        maxY--;
+    }
+}
+
 // returns whether point is over terrain Cell triangle?
 bool dxOSTerrainData::IsOnOSTerrain2(const OSTerrainVertex * const CellCorner,
     const dReal *const pos, const bool isFirst) const
@@ -201,7 +572,7 @@ dReal dxOSTerrainData::GetHeight( int x, int y )
     else if ( y >= m_nDepthSamples)
         y = m_nDepthSamples - 1;
 
-    return m_pHeightData[x+(y * m_nWidthSamples)];
+    return GetSample(x, y);
 }
 
 
@@ -217,7 +588,7 @@ inline int dxOSTerrainData::GetTriIndex(int x, int y, bool second)
 // returns height at given sample coordinates
 inline dReal dxOSTerrainData::GetHeightSafe(int x, int y)
 {
-    return m_pHeightData[x + (y * m_nWidthSamples)];
+    return GetSample(x, y);
 }
 
 // returns height at given coordinates
@@ -232,27 +603,22 @@ dReal dxOSTerrainData::GetHeight(dReal x, dReal y)
     int nX = int(dnX);
     int nY = int(dnY);
 
-    nY *= m_nWidthSamples;
-    nY += nX; // index of 0,0
-
     dReal z, z0, z1;
 
-    z0 = m_pHeightData[nY];
+    z0 = GetSample(nX, nY);
     z = z0;
 
     if ( dy > dx )
     {
-        nY += m_nWidthSamples;                  // move to x,1
-        z1 = m_pHeightData[nY];                 // 0,1
+        z1 = GetSample(nX, nY + 1);             // 0,1
         z += (z1 - z0) * dy;                    // 0,1 - 0,0
-        z += (m_pHeightData[nY+1] - z1) * dx;  // 1,1 - 0,1
+        z += (GetSample(nX + 1, nY + 1) - z1) * dx; // 1,1 - 0,1
     }
     else
     {
-        nY++;                                   // move to 1,y
-        z1 = m_pHeightData[nY];                 // 1,0
+        z1 = GetSample(nX + 1, nY);             // 1,0
         z += (z1 - z0) *dx;                     // 1,0 - 0,0
-        z += (m_pHeightData[nY + m_nWidthSamples] - z1) * dy; // 1,1 - 1,0
+        z += (GetSample(nX + 1, nY + 1) - z1) * dy; // 1,1 - 1,0
     }
 
     return z;
@@ -269,27 +635,22 @@ void dxOSTerrainData::GetNormal( dReal x, dReal y ,dReal *normal)
     int nX = int( dnX );
     int nY = int( dnY );
 
-    nY *= m_nWidthSamples;
-    nY += nX; // index of 0,0
-
     dReal z, z0, z1;
     dReal nx,ny;
     
-    z0 = m_pHeightData[nY]; // 0,0
+    z0 = GetSample(nX, nY); // 0,0
 
     if (dy > dx)
     {
-        nY += m_nWidthSamples;
-        z = m_pHeightData[nY]; // 0,1
-        z1 = m_pHeightData[nY + 1]; // 1,1
+        z = GetSample(nX, nY + 1); // 0,1
+        z1 = GetSample(nX + 1, nY + 1); // 1,1
         nx = z - z1;
         ny = z0 - z;
     }
     else
     {
-        nY++;
-        z = m_pHeightData[nY]; // 1,0
-        z1 = m_pHeightData[nY + 1]; // 1,1
+        z = GetSample(nX + 1, nY); // 1,0
+        z1 = GetSample(nX + 1, nY + 1); // 1,1
         nx = z0 - z;
         ny = z - z1;
     }
@@ -306,6 +667,9 @@ dxOSTerrainData::~dxOSTerrainData()
         dIASSERT( m_pHeightData );
         delete [] m_pHeightData;
     }
+    FreeQuantized();
+    FreeMinMax();
+    FreePlanes();
 }
 
 
@@ -316,16 +680,7 @@ dxOSTerrainData::~dxOSTerrainData()
 dxOSTerrain::dxOSTerrain( dSpaceID space,
                              dOSTerrainDataID data,
                              int bPlaceable )			:
-    dxGeom( space, bPlaceable ),
-    tempPlaneBuffer(0),
-	tempPlaneInstances(0),
-    tempPlaneBufferSize(0),
-    tempTriangleBuffer(0),
-    tempTriangleBufferSize(0),
-    tempHeightBuffer(0),
-	tempHeightInstances(0),
-    tempHeightBufferSizeX(0),
-    tempHeightBufferSizeY(0)
+    dxGeom( space, bPlaceable )
 {
     type = dOSTerrainClass;
     this->m_p_data = data;
@@ -355,45 +710,52 @@ void dxOSTerrain::computeAABB()
 // dxOSTerrain destructor
 dxOSTerrain::~dxOSTerrain()
 {
-	resetTriangleBuffer();
-	resetPlaneBuffer();
-	resetHeightBuffer();
 }
 
-void dxOSTerrain::allocateTriangleBuffer(size_t numTri)
+
+//////// dxOSTerrainCollidersCache ///////////////////////////////////////////////////
+
+#if !dTLS_ENABLED
+// Without TLS all threads share this instance and OSTerrain collisions may not run concurrently
+/*extern */dxOSTerrainCollidersCache g_ccOSTerrainCollidersCache;
+#endif
+
+dxOSTerrainCollidersCache::dxOSTerrainCollidersCache() :
+    tempTriangleBuffer(0),
+    tempTriangleBufferSize(0),
+    tempHeightBuffer(0),
+	tempHeightInstances(0),
+    tempHeightBufferSizeX(0),
+    tempHeightBufferSizeY(0),
+    tempCollideBuffer(0),
+    tempCollideBufferSize(0),
+    tempMeshVertexBuffer(0),
+    tempMeshVertexBufferSize(0)
 {
-	size_t alignedNumTri = AlignBufferSize(numTri, TEMP_TRIANGLE_BUFFER_ELEMENT_COUNT_ALIGNMENT);
-	tempTriangleBufferSize = alignedNumTri;
-	tempTriangleBuffer = new OSTerrainTriangle[alignedNumTri];
+	memset( m_contacts, 0, sizeof( m_contacts ) );
 }
 
-void dxOSTerrain::resetTriangleBuffer()
+dxOSTerrainCollidersCache::~dxOSTerrainCollidersCache()
 {
-	delete[] tempTriangleBuffer;
+	resetTriangleBuffer();
+	resetHeightBuffer();
+	resetCollideBuffer();
+	resetMeshVertexBuffer();
 }
 
-void dxOSTerrain::allocatePlaneBuffer(size_t numTri)
+void dxOSTerrainCollidersCache::allocateTriangleBuffer(size_t numTri)
 {
-	size_t alignedNumTri = AlignBufferSize(numTri, TEMP_PLANE_BUFFER_ELEMENT_COUNT_ALIGNMENT);
-	tempPlaneBufferSize = alignedNumTri;
-	tempPlaneBuffer = new OSTerrainPlane *[alignedNumTri];
-	tempPlaneInstances = new OSTerrainPlane[alignedNumTri];
-
-	OSTerrainPlane *ptrPlaneMatrix = tempPlaneInstances;
-	for (size_t indexTri = 0; indexTri != alignedNumTri; indexTri++)
-	{
-		tempPlaneBuffer[indexTri] = ptrPlaneMatrix;
-		ptrPlaneMatrix += 1;
-	}
+	size_t alignedNumTri = AlignBufferSize(numTri, TEMP_TRIANGLE_BUFFER_ELEMENT_COUNT_ALIGNMENT);
+	tempTriangleBufferSize = alignedNumTri;
+	tempTriangleBuffer = new OSTerrainTriangle[alignedNumTri];
 }
 
-void dxOSTerrain::resetPlaneBuffer()
+void dxOSTerrainCollidersCache::resetTriangleBuffer()
 {
-	delete[] tempPlaneInstances;
-    delete[] tempPlaneBuffer;
+	delete[] tempTriangleBuffer;
 }
 
-void dxOSTerrain::allocateHeightBuffer(size_t numX, size_t numY)
+void dxOSTerrainCollidersCache::allocateHeightBuffer(size_t numX, size_t numY)
 {
 	size_t alignedNumX = AlignBufferSize(numX, TEMP_HEIGHT_BUFFER_ELEMENT_COUNT_ALIGNMENT_X);
 	size_t alignedNumY = AlignBufferSize(numY, TEMP_HEIGHT_BUFFER_ELEMENT_COUNT_ALIGNMENT_Y);
@@ -411,12 +773,35 @@ void dxOSTerrain::allocateHeightBuffer(size_t numX, size_t numY)
 	}
 }
 
-void dxOSTerrain::resetHeightBuffer()
+void dxOSTerrainCollidersCache::resetHeightBuffer()
 {
 	delete[] tempHeightInstances;
     delete[] tempHeightBuffer;
 }
 
+void dxOSTerrainCollidersCache::allocateCollideBuffer(size_t numX)
+{
+	size_t alignedNumX = AlignBufferSize(numX, TEMP_COLLIDE_BUFFER_ELEMENT_COUNT_ALIGNMENT);
+	tempCollideBufferSize = alignedNumX;
+	tempCollideBuffer = new bool[2 * alignedNumX];
+}
+
+void dxOSTerrainCollidersCache::resetCollideBuffer()
+{
+	delete[] tempCollideBuffer;
+}
+
+void dxOSTerrainCollidersCache::allocateMeshVertexBuffer(size_t numVertices)
+{
+	tempMeshVertexBufferSize = numVertices;
+	tempMeshVertexBuffer = new OSTerrainMeshVertex[numVertices];
+}
+
+void dxOSTerrainCollidersCache::resetMeshVertexBuffer()
+{
+	delete[] tempMeshVertexBuffer;
+}
+
 //////// OSTerrain data interface ////////////////////////////////////////////////////
 
 
@@ -437,11 +822,25 @@ ODE_API void dGeomOSTerrainDataBuild( dOSTerrainDataID d,
     dIASSERT( widthSamples >= 2 );	// Ensure we're making something with at least one cell.
     dIASSERT( depthSamples >= 2 );
 
+    if ( d->m_bCopyHeightData && d->m_pHeightData )
+    {
+        // rebuilding, release the previous copy
+        delete [] d->m_pHeightData;
+    }
+    d->m_pHeightData = NULL;
+    d->FreeQuantized();
+
     // set info
     d->SetData( widthSamples, depthSamples, samplesize, thickness, bWrap );
     d->m_bCopyHeightData = bCopyHeightData;
 
-    if ( d->m_bCopyHeightData == 0 )
+    if ( d->m_bQuantized )
+    {
+        // the quantized samples are always a copy
+        d->m_bCopyHeightData = 0;
+        d->BuildQuantized( pHeightData );
+    }
+    else if ( d->m_bCopyHeightData == 0 )
     {
         // Data is referenced only.
         d->m_pHeightData = pHeightData;
@@ -458,7 +857,67 @@ ODE_API void dGeomOSTerrainDataBuild( dOSTerrainDataID d,
     }
 
     // Find height bounds
-    d->ComputeHeightBounds();
+    d->RebuildAccelerationData();
+}
+
+
+void dGeomOSTerrainDataUpdate( dOSTerrainDataID d )
+{
+    dUASSERT( d, "Argument not OSTerrain data" );
+    dUASSERT( d->m_pHeightData || d->m_pQuantizedHeights, "OSTerrain data not built" );
+
+    d->RebuildAccelerationData();
+}
+
+
+void dGeomOSTerrainDataSetBuildPlanes( dOSTerrainDataID d, int bBuildPlanes )
+{
+    dUASSERT( d, "Argument not OSTerrain data" );
+
+    d->m_bBuildPlanes = bBuildPlanes;
+    if ( !bBuildPlanes )
+        d->FreePlanes();
+    else if ( d->m_pHeightData || d->m_pQuantizedHeights )
+        d->BuildPlanes();
+}
+
+
+void dGeomOSTerrainDataSetQuantized( dOSTerrainDataID d, int bQuantized )
+{
+    dUASSERT( d, "Argument not OSTerrain data" );
+
+    d->m_bQuantized = bQuantized;
+
+    if ( bQuantized && d->m_pHeightData )
+    {
+        // convert built float samples
+        d->BuildQuantized( d->m_pHeightData );
+        if ( d->m_bCopyHeightData )
+            delete [] d->m_pHeightData;
+        d->m_pHeightData = NULL;
+        d->m_bCopyHeightData = 0;
+        d->RebuildAccelerationData();
+    }
+    else if ( !bQuantized && d->m_pQuantizedHeights )
+    {
+        // back to owned floats, at the quantized precision
+        float *heights = new float[ d->m_nWidthSamples * d->m_nDepthSamples ];
+        for ( int y = 0; y < d->m_nDepthSamples; y++ )
+            for ( int x = 0; x < d->m_nWidthSamples; x++ )
+                heights[ x + y * d->m_nWidthSamples ] = d->GetSample( x, y );
+        d->FreeQuantized();
+        d->m_pHeightData = heights;
+        d->m_bCopyHeightData = 1;
+        d->RebuildAccelerationData();
+    }
+}
+
+
+size_t dGeomOSTerrainDataGetMemoryUsage( dOSTerrainDataID d )
+{
+    dUASSERT( d, "Argument not OSTerrain data" );
+
+    return d->GetMemoryUsage();
 }
 
 
@@ -542,7 +1001,208 @@ void SortPlaneContacts(dContactGeom* PlaneContact,int numPlaneContacts)
         }
     }
 
+// the standard cylinder plane collider only returns the deepest rim points,
+// that mostly fall outside the triangle being tested. Return points all
+// around both rims instead, deepest first
+#define OSTERRAINCYLINDERRIMPOINTS 8
+
+static int OSTerrainCollideCylinderPlane(dxGeom *Cylinder, dxGeom *Plane, int flags, dContactGeom *contact, int skip)
+{
+    dIASSERT (skip >= (int)sizeof(dContactGeom));
+    dIASSERT (Cylinder->type == dCylinderClass);
+    dIASSERT (Plane->type == dPlaneClass);
+    dIASSERT ((flags & NUMC_MASK) >= 1);
+
+    dReal radius, length;
+    dGeomCylinderGetParams(Cylinder, &radius, &length);
+    const dReal *R = Cylinder->final_posr->R;
+    const dReal *pos = Cylinder->final_posr->pos;
+    const dReal *plane = ((dxPlane *)Plane)->p;
+
+    // the rim samples, then the deepest point of each rim, unless the caps
+    // are parallel to the plane
+    dReal angles[OSTERRAINCYLINDERRIMPOINTS + 1];
+    int numAngles = OSTERRAINCYLINDERRIMPOINTS;
+    for (int i = 0; i < OSTERRAINCYLINDERRIMPOINTS; i++)
+        angles[i] = (dReal)i * (REAL(2.0) * M_PI / OSTERRAINCYLINDERRIMPOINTS);
+    const dReal nx = plane[0] * R[0] + plane[1] * R[4] + plane[2] * R[8];
+    const dReal ny = plane[0] * R[1] + plane[1] * R[5] + plane[2] * R[9];
+    if (nx * nx + ny * ny > REAL(1e-6))
+        angles[numAngles++] = dAtan2(-ny, -nx);
+
+    dContactGeom points[2 * (OSTERRAINCYLINDERRIMPOINTS + 1)];
+    int count = 0;
+    for (int i = 0; i < numAngles; i++)
+    {
+        const dReal x = radius * dCos(angles[i]);
+        const dReal y = radius * dSin(angles[i]);
+        for (int side = 0; side < 2; side++)
+        {
+            const dReal z = side ? length * REAL(0.5) : -length * REAL(0.5);
+            dContactGeom *c = &points[count];
+            c->pos[0] = pos[0] + R[0] * x + R[1] * y + R[2] * z;
+            c->pos[1] = pos[1] + R[4] * x + R[5] * y + R[6] * z;
+            c->pos[2] = pos[2] + R[8] * x + R[9] * y + R[10] * z;
+            c->depth = plane[3] - dCalcVectorDot3(plane, c->pos);
+            if (c->depth >= 0)
+                count++;
+        }
+    }
+
+    SortPlaneContacts(points, count);
+    const int maxc = flags & NUMC_MASK;
+    if (count > maxc)
+        count = maxc;
+
+    for (int i = 0; i < count; i++)
+    {
+        dContactGeom *c = CONTACT(contact, i * skip);
+        dCopyVector3r4(c->pos, points[i].pos);
+        dCopyVector3r4(c->normal, plane);
+        c->depth = points[i].depth;
+        c->g1 = Cylinder;
+        c->g2 = Plane;
+        c->side1 = -1;
+        c->side2 = -1;
+    }
+    return count;
+}
+
+// collects the trimesh vertices that can be under the zone, at most maxZ
+// high, in the order dCollideTrimeshPlane visits them. They are transformed
+// once for all the zone planes. With temporal coherence the vertices that
+// can come under maxZ + margin are kept and reused while the mesh rests,
+// the terrain itself is not expected to move
+static int OSTerrainGetMeshVertices(dxOSTerrain *terrain, dxTriMesh *mesh, const dReal maxZ,
+                                    dxOSTerrainCollidersCache *cache)
+{
+    dxPosR *posr = mesh->GetRecomputePosR();
+    const dVector3 &pos = *(const dVector3 *)posr->pos;
+    const dMatrix3 &R = *(const dMatrix3 *)posr->R;
+
+    const int vertexCount = mesh->Data->Mesh.GetNbVertices();
+    const int triCount = mesh->Data->Mesh.GetNbTriangles();
+    if (cache->tempMeshVertexBufferSize < (size_t)triCount * 3)
+    {
+        cache->resetMeshVertexBuffer();
+        cache->allocateMeshVertexBuffer((size_t)triCount * 3);
+    }
+    OSTerrainMeshVertex *out = cache->tempMeshVertexBuffer;
+    int count = 0;
+
+    TriMeshPairTC *tc = NULL;
+    dReal radius = 0;
+    bool resting = false;
+    if (mesh->doTerrainTC)
+        tc = mesh->GetPairTC(terrain, terrain->m_p_data);
+    if (tc)
+    {
+        radius = mesh->GetRadius();
+        tc->Margin = dTRIMESH_PAIR_TC_MARGIN * radius;
+
+        // vertices left out of the set stay above the zone
+        if (tc->Valid && maxZ + TriMeshPairTCMotion(tc->SetPos, tc->SetR, pos, R, radius) <= tc->Height + tc->Margin)
+        {
+            VertexPointersEx VPE;
+            const unsigned *set = tc->Set.data();
+            const int setCount = tc->Set.size() / 2;
+            for (int i = 0; i < setCount; i++)
+            {
+                mesh->Data->Mesh.GetExTriangle(VPE, set[i * 2 + 1]);
+                const Point *vertex = VPE.vp.Vertex[set[i * 2]];
+                dMultiply0_331(out->pos, R, (const dReal *)vertex);
+                dAddVector3r4(out->pos, pos);
+                out->tri = (int)set[i * 2 + 1];
+                out++;
+            }
+            dCopyVector3(tc->LastPos, pos);
+            dCopyMatrix4x3(tc->LastR, R);
+            return setCount;
+        }
+
+        resting = tc->HasLast && TriMeshPairTCMotion(tc->LastPos, tc->LastR, pos, R, radius) <= tc->Margin * dTRIMESH_PAIR_TC_REST;
+        tc->Set.setSize(0);
+    }
+
+    const dReal limit = resting ? maxZ + tc->Margin : maxZ;
+
+    const unsigned uiTLSKind = mesh->getParentSpaceTLSKind();
+    VertexUseCache &vertexUses = GetTrimeshCollidersCache(uiTLSKind)->VertexUses;
+    const bool useFlags = vertexUses.ResizeAndResetVertexUSEDFlags(vertexCount);
+
+    VertexPointersEx VPE;
+    for (int t = 0; t < triCount; t++)
+    {
+        mesh->Data->Mesh.GetExTriangle(VPE, t);
+        for (int v = 0; v < 3; v++)
+        {
+            if (useFlags)
+            {
+                const unsigned index = VPE.Index[v];
+                if (vertexUses.GetVertexUSEDFlag(index))
+                    continue;
+                vertexUses.SetVertexUSEDFlag(index);
+            }
+
+            dMultiply0_331(out->pos, R, (const dReal *)VPE.vp.Vertex[v]);
+            dAddVector3r4(out->pos, pos);
+            if (out->pos[2] > limit)
+                continue;
+
+            out->tri = t;
+            out++;
+            count++;
+            if (resting)
+            {
+                // the corner and the triangle, the vertex index may be shared
+                tc->Set.push((unsigned)v);
+                tc->Set.push((unsigned)t);
+            }
+        }
+    }
+
+    if (tc)
+    {
+        tc->Valid = resting;
+        if (resting)
+        {
+            tc->Height = maxZ;
+            dCopyVector3(tc->SetPos, pos);
+            dCopyMatrix4x3(tc->SetR, R);
+        }
+        dCopyVector3(tc->LastPos, pos);
+        dCopyMatrix4x3(tc->LastR, R);
+        tc->HasLast = true;
+    }
+    return count;
+}
+
+// dCollideTrimeshPlane on the vertices from OSTerrainGetMeshVertices
+static int OSTerrainCollideMeshVerticesPlane(const OSTerrainMeshVertex *vertices, int numVertices,
+                                             const dReal *plane, int maxContacts, dContactGeom *contact)
+{
+    int count = 0;
+    for (int i = 0; i < numVertices; i++)
+    {
+        const dReal depth = plane[3] - dCalcVectorDot3(plane, vertices[i].pos);
+        if (depth > 0)
+        {
+            dContactGeom *c = contact + count;
+            dCopyVector3r4(c->pos, vertices[i].pos);
+            dCopyVector3r4(c->normal, plane);
+            c->depth = depth;
+            c->side1 = vertices[i].tri;
+            c->side2 = -1;
+            if (++count >= maxContacts)
+                break;
+        }
+    }
+    return count;
+}
+
 int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const int minY, const int maxY, 
+                                           const dReal minZ, const dReal maxZ,
+                                           dxOSTerrainCollidersCache *cache,
                                            dxGeom* o2, const int numMaxContactsPossible,
                                            int flags, dContactGeom* contact, 
                                            int skip )
@@ -572,47 +1232,9 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
     dReal offsetX;
     dReal offsetY;
     
-    if (tempHeightBufferSizeX < numX || tempHeightBufferSizeY < numY)
-    {
-        resetHeightBuffer();
-        allocateHeightBuffer(numX, numY);
-    }
-
     offsetX = final_posr->pos[0] - m_p_data->m_fHalfWidth;
     offsetY = final_posr->pos[1] - m_p_data->m_fHalfDepth;
 
-    dReal Xpos;
-    dReal Ypos = minY + offsetY;
-
-    OSTerrainVertex *OSTerrainRow;
-
-    dReal maxZ = - dInfinity;
-    dReal minZ = dInfinity;
-
-    for ( y = minY, y_local = 0; y_local < numY; y++, y_local++)
-    {
-        OSTerrainRow = tempHeightBuffer[y_local];
-
-        Xpos = minX + offsetX;
-
-        for ( x = minX ; x < maxX + 1; x++)
-        {
-            const dReal h = m_p_data->GetHeightSafe(x, y);
-            OSTerrainRow->vertex[0] = Xpos;
-            OSTerrainRow->vertex[1] = Ypos;
-            OSTerrainRow->vertex[2] = h;
-            OSTerrainRow++;
-
-            if(h > maxZ)
-                maxZ = h;
-            if(h < minZ)
-                minZ = h;
-
-            Xpos += REAL(1.0);
-        }
-        Ypos += REAL(1.0);
-    }
-
     const dReal minO2Height = o2->aabb[4];
     const dReal maxO2Height = o2->aabb[5];
 
@@ -682,21 +1304,21 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
         geomNDepthGetter		= dGeomCapsulePointDepth;
         // max_collisionContact    = 3;
         break;
-/*
+
     case dCylinderClass:
         geomRayNCollider		= dCollideRayCylinder;
-        geomNPlaneCollider	    = dCollideCylinderPlane;
-        geomNDepthGetter		= NULL;// TODO: dGeomCCylinderPointDepth
+        geomNPlaneCollider	    = OSTerrainCollideCylinderPlane;
+        geomNDepthGetter		= dGeomCylinderPointDepth;
         //max_collisionContact    = 3;
         break;
 
     case dConvexClass:
         geomRayNCollider		= dCollideRayConvex;
         geomNPlaneCollider  	= dCollideConvexPlane;
-        geomNDepthGetter		= NULL;// TODO: dGeomConvexPointDepth;
+        geomNDepthGetter		= dGeomConvexPointDepth;
         //max_collisionContact    = 3;
         break;
-*/
+
     case dTriMeshClass:
         geomRayNCollider		= dCollideRayTrimesh;
         geomNPlaneCollider	    = dCollideTrimeshPlane;
@@ -731,15 +1353,43 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
         }
         return numTerrainContacts;
     }
- 
 
-    dContactGeom *PlaneContact = m_p_data->m_contacts;
+    if (cache->tempHeightBufferSizeX < numX || cache->tempHeightBufferSizeY < numY)
+    {
+        cache->resetHeightBuffer();
+        cache->allocateHeightBuffer(numX, numY);
+    }
+
+    dReal Xpos;
+    dReal Ypos = minY + offsetY;
+
+    OSTerrainVertex *OSTerrainRow;
+
+    for ( y = minY, y_local = 0; y_local < numY; y++, y_local++)
+    {
+        OSTerrainRow = cache->tempHeightBuffer[y_local];
+
+        Xpos = minX + offsetX;
+
+        for ( x = minX ; x < maxX + 1; x++)
+        {
+            OSTerrainRow->vertex[0] = Xpos;
+            OSTerrainRow->vertex[1] = Ypos;
+            OSTerrainRow->vertex[2] = m_p_data->GetHeightSafe(x, y);
+            OSTerrainRow++;
+
+            Xpos += REAL(1.0);
+        }
+        Ypos += REAL(1.0);
+    }
+
+    dContactGeom *PlaneContact = cache->m_contacts;
 
     const unsigned int numTriMax = (maxX - minX) * (maxY - minY) * 2;
-    if (tempTriangleBufferSize < numTriMax)
+    if (cache->tempTriangleBufferSize < numTriMax)
     {
-        resetTriangleBuffer();
-        allocateTriangleBuffer(numTriMax);
+        cache->resetTriangleBuffer();
+        cache->allocateTriangleBuffer(numTriMax);
     }
     
     // Sorting triangle/plane  resulting from heightfield zone
@@ -749,7 +1399,8 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
     // need some test or insights on this before enabling this.
     const bool isContactNumPointsLimited = true;
 
-    bool needFurtherPasses = (o2->type == dTriMeshClass);
+    bool needFurtherPasses = (o2->type == dTriMeshClass || o2->type == dConvexClass ||
+        o2->type == dCylinderClass);
     //compute Ratio between Triangle size and O2 aabb size
     // no FurtherPasses are needed in ray class
     if (o2->type != dRayClass  && needFurtherPasses == false)
@@ -808,8 +1459,8 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
 
     for ( y_local = 0; y_local < maxY_local; y_local++)
     {
-        OSTerrainVertex *OSTerrainRow      = tempHeightBuffer[y_local];
-        OSTerrainVertex *OSTerrainNextRow  = tempHeightBuffer[y_local + 1];
+        OSTerrainVertex *OSTerrainRow      = cache->tempHeightBuffer[y_local];
+        OSTerrainVertex *OSTerrainNextRow  = cache->tempHeightBuffer[y_local + 1];
 
         // First A
         B = &OSTerrainRow[0];
@@ -847,7 +1498,7 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
 
             if (isACollide || isCCollide || isDCollide)
             {
-                CurrTri = &tempTriangleBuffer[numTri++];
+                CurrTri = &cache->tempTriangleBuffer[numTri++];
                 CurrTri->state = false;
 
                 // changing point order here implies to change it in isOnOSTerrain
@@ -864,14 +1515,14 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
                 dz1 = CHeight - DHeight;
                 dz2 = AHeight - CHeight;
 
-                dV3CrossTerrain(plane, dz1, dz2);
+                m_p_data->GetPlaneNormal(minX + x_local, minY + y_local, false, dz1, dz2, plane);
 
                 plane[3] = dCalcVectorDot3(CurrTri->planeDef, C->vertex);
             }
 
             if (isACollide || isBCollide || isDCollide)
             {
-                CurrTri = &tempTriangleBuffer[numTri++];
+                CurrTri = &cache->tempTriangleBuffer[numTri++];
 
                 CurrTri->state = false;
                 // changing point order here implies to change it in isOnOSTerrain
@@ -890,7 +1541,7 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
                 dz1 = AHeight - BHeight;
                 dz2 = BHeight - DHeight;
 
-                dV3CrossTerrain(plane, dz1, dz2);
+                m_p_data->GetPlaneNormal(minX + x_local, minY + y_local, true, dz1, dz2, plane);
 
                 plane[3] = dCalcVectorDot3(CurrTri->planeDef, B->vertex);
             }
@@ -910,6 +1561,11 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
     int planeTestFlags = (flags & ~NUMC_MASK) | numMaxContactsPerPlane;
     dIASSERT((OSTERRAINMAXCONTACTPERCELL & ~NUMC_MASK) == 0);     
 
+    // trimesh vertices are transformed once for all the planes
+    int numMeshVertices = 0;
+    if (o2->type == dTriMeshClass)
+        numMeshVertices = OSTerrainGetMeshVertices(this, (dxTriMesh *)o2, maxZ, cache);
+
     OSTerrainTriangle* tri_base;
     OSTerrainTriangle* tri_test;
     dReal *itPlane;
@@ -918,7 +1574,7 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
 
     for (unsigned int k = 0; k < numTri; k++)
     {
-        tri_base = &tempTriangleBuffer[k];
+        tri_base = &cache->tempTriangleBuffer[k];
 
         if (tri_base->state == true)
             continue;// already tested
@@ -930,7 +1586,11 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
         dCopyVector4((sliding_plane)->p, itPlane);
         dGeomMoved(sliding_plane);
 
-        numPlaneContacts = geomNPlaneCollider (o2, sliding_plane, planeTestFlags, PlaneContact, sizeof(dContactGeom));
+        if (o2->type == dTriMeshClass)
+            numPlaneContacts = OSTerrainCollideMeshVerticesPlane(cache->tempMeshVertexBuffer, numMeshVertices,
+                itPlane, numMaxContactsPerPlane, PlaneContact);
+        else
+            numPlaneContacts = geomNPlaneCollider (o2, sliding_plane, planeTestFlags, PlaneContact, sizeof(dContactGeom));
         if(numPlaneContacts > 0)
         {
             for (i = 0; i < numPlaneContacts; i++)
@@ -968,7 +1628,7 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
 
         for (unsigned int m = k + 1; m < numTri; m++)
         {
-            tri_test = &tempTriangleBuffer[m];
+            tri_test = &cache->tempTriangleBuffer[m];
             if (tri_test->state == true)
                 continue;// already tested or added to plane list.
 
@@ -1033,7 +1693,7 @@ int dxOSTerrain::dCollideOSTerrainZone( const int minX, const int maxX, const in
         //
         for (unsigned int k = 0; k < numTri; k++)
         {
-            const OSTerrainTriangle * const itTriangle = &tempTriangleBuffer[k];
+            const OSTerrainTriangle * const itTriangle = &cache->tempTriangleBuffer[k];
 
             for (size_t i = 0; i < 3; i++)
             {
@@ -1132,6 +1792,7 @@ void inline dOSTerrainAddSphereContact(const dContactGeom* contact, int skip,
 
 
 int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const int minY, const int maxY,
+    dxOSTerrainCollidersCache *cache,
     dxGeom* o2, const int numMaxContactsPossible,
     int flags, dContactGeom* contact,
     int skip)
@@ -1191,7 +1852,7 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
         return 1;
     }
 
-    const dContactGeom *ContactBuffer = m_p_data->m_contacts;
+    const dContactGeom *ContactBuffer = cache->m_contacts;
  
     pContact = CONTACT(ContactBuffer, 0);
     pContact->depth = -1e30;
@@ -1236,8 +1897,15 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
     A--------B-...x
     */
 
-    bool *VtopCollideA = new bool[maxX - minX + 3];
-    bool *VtopCollideB = new bool[maxX - minX + 3];
+    const size_t numVtop = maxX - minX + 3;
+    if (cache->tempCollideBufferSize < numVtop)
+    {
+        cache->resetCollideBuffer();
+        cache->allocateCollideBuffer(numVtop);
+    }
+
+    bool *VtopCollideA = cache->tempCollideBuffer;
+    bool *VtopCollideB = cache->tempCollideBuffer + cache->tempCollideBufferSize;
 
     bool *lastVtopCollide;
     bool *curVtopCollide;
@@ -1356,7 +2024,7 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
                     {
                         dz1 = CHeight - DHeight;
                         dz2 = AHeight - CHeight;
-                        dV3CrossTerrain(normA, dz1, dz2);
+                        m_p_data->GetPlaneNormal(x - 1, y, false, dz1, dz2, normA);
 
                         k = dCalcVectorDot3(tdist, normA);
                         depth = radius - k;
@@ -1390,7 +2058,7 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
                     {
                         dz1 = CHeight - DHeight;
                         dz2 = AHeight - CHeight;
-                        dV3CrossTerrain(normA, dz1, dz2);
+                        m_p_data->GetPlaneNormal(x - 1, y, false, dz1, dz2, normA);
 
                         k = dCalcVectorDot3(tdist, normA);
                         depth = radius - k;
@@ -1419,7 +2087,7 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
                     {
                         dz1 = AHeight - BHeight;
                         dz2 = BHeight - DHeight;
-                        dV3CrossTerrain(normB, dz1, dz2);
+                        m_p_data->GetPlaneNormal(x - 1, y, true, dz1, dz2, normB);
 
                         k = dCalcVectorDot3(tdist, normB);
                         depth = radius - k;
@@ -1552,9 +2220,6 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
 
 //    t1 = getClockTicksMs() - tstart;
 
-    delete[] VtopCollideA;
-    delete[] VtopCollideB;
-
     if (numTerrainContacts > 0)
     {
         dContactGeom *pContactB;
@@ -1627,6 +2292,286 @@ int dxOSTerrain::dCollideOSTerrainSphere(const int minX, const int maxX, const i
 }
 
 
+//
+// OSTerrainRayWalk
+//
+// Walks the cells crossed by a ray with a 2D DDA, descending the min/max
+// pyramid so nodes the ray segment passes above or under are skipped.
+// Cells are visited in ray order, so hits are found nearest first.
+//
+struct OSTerrainRayWalk
+{
+    const dxOSTerrainData *data;
+    dReal ox, oy, oz;           // ray start, terrain local
+    dReal dx, dy, dz;           // ray direction
+    dReal invDx, invDy;
+    dReal worldX, worldY;       // terrain local to world offset
+    bool backfaceCull;
+    bool stopAtFirst;
+    int numMaxContacts;
+    int numContacts;
+    dContactGeom *contact;
+    int skip;
+
+    bool Walk(int level, int ix0, int ix1, int iy0, int iy1, dReal ta, dReal tb);
+    bool Visit(int level, int ix, int iy, dReal ta, dReal tb);
+    bool TestCell(int x, int y, dReal ta, dReal tb);
+    bool TestTriangle(int x, int y, dReal cx, dReal cy, dReal hA, dReal sx, dReal sy,
+        bool second, dReal ta, dReal tb);
+};
+
+// DDA over the nodes [ix0, ix1] x [iy0, iy1] of a pyramid level, or over
+// cells for level -1, restricted to the ray interval [ta, tb]
+// returns true once no more contacts are wanted
+bool OSTerrainRayWalk::Walk(int level, int ix0, int ix1, int iy0, int iy1, dReal ta, dReal tb)
+{
+    const dReal size = (dReal)(level < 0 ? 1 : 1 << (level + OSTERRAINMINMAXLEAFSHIFT));
+
+    int ix = (int)dFloor((ox + dx * ta) / size);
+    int iy = (int)dFloor((oy + dy * ta) / size);
+    ix = dMAX(dMIN(ix, ix1), ix0);
+    iy = dMAX(dMIN(iy, iy1), iy0);
+
+    int stepX, stepY;
+    dReal tMaxX, tMaxY, tDeltaX, tDeltaY;
+
+    if (dx > 0)
+    {
+        stepX = 1;
+        tMaxX = ((ix + 1) * size - ox) * invDx;
+        tDeltaX = size * invDx;
+    }
+    else if (dx < 0)
+    {
+        stepX = -1;
+        tMaxX = (ix * size - ox) * invDx;
+        tDeltaX = -size * invDx;
+    }
+    else
+    {
+        stepX = 0;
+        tMaxX = dInfinity;
+        tDeltaX = 0;
+    }
+
+    if (dy > 0)
+    {
+        stepY = 1;
+        tMaxY = ((iy + 1) * size - oy) * invDy;
+        tDeltaY = size * invDy;
+    }
+    else if (dy < 0)
+    {
+        stepY = -1;
+        tMaxY = (iy * size - oy) * invDy;
+        tDeltaY = -size * invDy;
+    }
+    else
+    {
+        stepY = 0;
+        tMaxY = dInfinity;
+        tDeltaY = 0;
+    }
+
+    dReal tEnter = ta;
+    while (true)
+    {
+        const dReal tExit = dMIN(dMIN(tMaxX, tMaxY), tb);
+        if (tExit > tEnter && Visit(level, ix, iy, tEnter, tExit))
+            return true;
+        if (tExit >= tb)
+            return false;
+
+        if (tMaxX < tMaxY)
+        {
+            ix += stepX;
+            if (ix < ix0 || ix > ix1)
+                return false;
+            tEnter = tMaxX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            iy += stepY;
+            if (iy < iy0 || iy > iy1)
+                return false;
+            tEnter = tMaxY;
+            tMaxY += tDeltaY;
+        }
+    }
+}
+
+bool OSTerrainRayWalk::Visit(int level, int ix, int iy, dReal ta, dReal tb)
+{
+    if (level < 0)
+        return TestCell(ix, iy, ta, tb);
+
+    const float *node = data->m_pMinMax + 2 * (data->m_nMinMaxLevelOffset[level] + ix + iy * data->m_nMinMaxLevelWidth[level]);
+    const dReal za = oz + dz * ta;
+    const dReal zb = oz + dz * tb;
+    if (dMIN(za, zb) > node[1] || dMAX(za, zb) < node[0])
+        return false; // the segment stays above or under every cell of the node
+
+    if (level == 0)
+    {
+        const int x0 = ix << OSTERRAINMINMAXLEAFSHIFT;
+        const int y0 = iy << OSTERRAINMINMAXLEAFSHIFT;
+        const int x1 = dMIN(x0 + (1 << OSTERRAINMINMAXLEAFSHIFT), data->m_nWidthSamples - 1) - 1;
+        const int y1 = dMIN(y0 + (1 << OSTERRAINMINMAXLEAFSHIFT), data->m_nDepthSamples - 1) - 1;
+        return Walk(-1, x0, x1, y0, y1, ta, tb);
+    }
+
+    const int childLevel = level - 1;
+    return Walk(childLevel,
+        2 * ix, dMIN(2 * ix + 1, data->m_nMinMaxLevelWidth[childLevel] - 1),
+        2 * iy, dMIN(2 * iy + 1, data->m_nMinMaxLevelDepth[childLevel] - 1),
+        ta, tb);
+}
+
+bool OSTerrainRayWalk::TestCell(int x, int y, dReal ta, dReal tb)
+{
+    const dReal AHeight = data->GetSample(x, y);
+    const dReal BHeight = data->GetSample(x + 1, y);
+    const dReal CHeight = data->GetSample(x, y + 1);
+    const dReal DHeight = data->GetSample(x + 1, y + 1);
+
+    // ray start relative to the cell corner A
+    const dReal cx = ox - x;
+    const dReal cy = oy - y;
+
+    // split the interval where the ray crosses the A D diagonal
+    // local y > local x is the first triangle (C A D), else the second (B D A)
+    const dReal g0 = cy - cx;
+    const dReal gd = dy - dx;
+    dReal tm = tb;
+    if (gd != 0)
+    {
+        const dReal td = -g0 / gd;
+        if (td > ta && td < tb)
+            tm = td;
+    }
+
+    dReal t0 = ta;
+    dReal t1 = tm;
+    while (true)
+    {
+        const bool second = !(g0 + gd * (t0 + t1) * REAL(0.5) > 0);
+        // triangle height is AHeight + sx * local x + sy * local y
+        const dReal sx = second ? BHeight - AHeight : DHeight - CHeight;
+        const dReal sy = second ? DHeight - BHeight : CHeight - AHeight;
+
+        if (TestTriangle(x, y, cx, cy, AHeight, sx, sy, second, t0, t1))
+            return true;
+        if (t1 >= tb)
+            return false;
+        t0 = t1;
+        t1 = tb;
+    }
+}
+
+// the ray height above the triangle plane is linear in t, a sign change
+// over [ta, tb] is a hit, from above for front faces
+bool OSTerrainRayWalk::TestTriangle(int x, int y, dReal cx, dReal cy, dReal hA, dReal sx, dReal sy,
+    bool second, dReal ta, dReal tb)
+{
+    const dReal f0 = oz - hA - sx * cx - sy * cy;
+    const dReal k = dz - sx * dx - sy * dy;
+    const dReal fa = f0 + k * ta;
+    const dReal fb = f0 + k * tb;
+
+    bool front;
+    if (fa > 0 && fb <= 0)
+        front = true;
+    else if (fa < 0 && fb >= 0 && !backfaceCull)
+        front = false;
+    else
+        return false;
+
+    dReal t = -f0 / k;
+    t = dMAX(dMIN(t, tb), ta);
+
+    dContactGeom *pContact = CONTACT(contact, numContacts * skip);
+    pContact->pos[0] = ox + dx * t + worldX;
+    pContact->pos[1] = oy + dy * t + worldY;
+    pContact->pos[2] = oz + dz * t;
+
+    data->GetPlaneNormal(x, y, second, -sx, -sy, pContact->normal);
+    if (front)
+    {
+        pContact->normal[0] = -pContact->normal[0];
+        pContact->normal[1] = -pContact->normal[1];
+        pContact->normal[2] = -pContact->normal[2];
+    }
+
+    pContact->depth = t;
+    pContact->side1 = -1;
+    pContact->side2 = -1;
+
+    numContacts++;
+    return stopAtFirst || numContacts == numMaxContacts;
+}
+
+int dxOSTerrain::dCollideOSTerrainRay( dxGeom *o2, const int numMaxContacts,
+                                       int flags, dContactGeom *contact, int skip )
+{
+    dIASSERT(o2->type == dRayClass);
+
+    const dReal *start = o2->final_posr->pos;
+    const dReal *R = o2->final_posr->R;
+    const dReal length = ((dxRay *)o2)->length;
+
+    OSTerrainRayWalk walk;
+    walk.data = m_p_data;
+    walk.worldX = final_posr->pos[0] - m_p_data->m_fHalfWidth;
+    walk.worldY = final_posr->pos[1] - m_p_data->m_fHalfDepth;
+    walk.ox = start[0] - walk.worldX;
+    walk.oy = start[1] - walk.worldY;
+    walk.oz = start[2];
+    walk.dx = R[2];
+    walk.dy = R[6];
+    walk.dz = R[10];
+    walk.invDx = walk.dx != 0 ? REAL(1.0) / walk.dx : dInfinity;
+    walk.invDy = walk.dy != 0 ? REAL(1.0) / walk.dy : dInfinity;
+    walk.backfaceCull = (o2->gflags & RAY_BACKFACECULL) != 0;
+    walk.stopAtFirst = (o2->gflags & (RAY_FIRSTCONTACT | RAY_CLOSEST_HIT)) != 0;
+    walk.numMaxContacts = numMaxContacts;
+    walk.numContacts = 0;
+    walk.contact = contact;
+    walk.skip = skip;
+
+    // clip the ray to the terrain rectangle
+    dReal ta = 0;
+    dReal tb = length;
+
+    if (walk.dx != 0)
+    {
+        dReal t0 = -walk.ox * walk.invDx;
+        dReal t1 = (m_p_data->m_fWidth - walk.ox) * walk.invDx;
+        if (t0 > t1) { const dReal t = t0; t0 = t1; t1 = t; }
+        ta = dMAX(ta, t0);
+        tb = dMIN(tb, t1);
+    }
+    else if (walk.ox < 0 || walk.ox > m_p_data->m_fWidth)
+        return 0;
+
+    if (walk.dy != 0)
+    {
+        dReal t0 = -walk.oy * walk.invDy;
+        dReal t1 = (m_p_data->m_fDepth - walk.oy) * walk.invDy;
+        if (t0 > t1) { const dReal t = t0; t0 = t1; t1 = t; }
+        ta = dMAX(ta, t0);
+        tb = dMIN(tb, t1);
+    }
+    else if (walk.oy < 0 || walk.oy > m_p_data->m_fDepth)
+        return 0;
+
+    if (ta > tb)
+        return 0;
+
+    walk.Walk(m_p_data->m_nMinMaxLevels - 1, 0, 0, 0, 0, ta, tb);
+    return walk.numContacts;
+}
+
 int dCollideOSTerrain( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contact, int skip )
 {
     dIASSERT( skip >= (int)sizeof(dContactGeom) );
@@ -1651,6 +2596,19 @@ int dCollideOSTerrain( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contact,
     if(o2->aabb[4] > tdata-> m_fMaxHeight)
         return 0;
 
+    if(o2->type == dRayClass)
+    {
+        numMaxTerrainContacts = (flags & NUMC_MASK);
+        const int numRayContacts = terrain->dCollideOSTerrainRay(o2, numMaxTerrainContacts, flags, contact, skip);
+        for ( i = 0; i < numRayContacts; ++i )
+        {
+            dContactGeom *pRayContact = CONTACT(contact,i*skip);
+            pRayContact->g1 = o1;
+            pRayContact->g2 = o2;
+        }
+        return numRayContacts;
+    }
+
 
     int numTerrainContacts = 0;
 
@@ -1689,20 +2647,35 @@ int dCollideOSTerrain( dxGeom *o1, dxGeom *o2, int flags, dContactGeom* contact,
 	nMaxY = dMIN( nMaxY, tdata->m_nDepthSamples - 1 );
     dIASSERT ((nMinX < nMaxX) && (nMinY < nMaxY));
 
+    // reject using the min/max pyramid before touching any cell
+    dReal regionMinZ, regionMaxZ;
+    tdata->GetCellRangeBounds(nMinX, nMaxX, nMinY, nMaxY, regionMinZ, regionMaxZ);
+    if (o2->aabb[4] - regionMaxZ > -dEpsilon)
+        return 0;
+
+    // skip border cells that are fully under o2
+    // the zone keeps the full region bounds for its flat terrain test
+    if (o2->aabb[4] > regionMinZ)
+        tdata->ShrinkCellRange(o2->aabb[4], nMinX, nMaxX, nMinY, nMaxY);
+
     dContactGeom *pContact;
 
     numMaxTerrainContacts = (flags & NUMC_MASK);
 
+    const unsigned uiTLSKind = terrain->getParentSpaceTLSKind();
+    dIASSERT(uiTLSKind == o2->getParentSpaceTLSKind()); // The colliding spaces must use matching cleanup method
+    dxOSTerrainCollidersCache *pccColliderCache = GetOSTerrainCollidersCache(uiTLSKind);
+
     if(o2->type == dSphereClass)
     {
         numTerrainContacts = terrain->dCollideOSTerrainSphere(
-            nMinX,nMaxX,nMinY,nMaxY,o2,numMaxTerrainContacts - numTerrainContacts,
+            nMinX,nMaxX,nMinY,nMaxY,pccColliderCache,o2,numMaxTerrainContacts - numTerrainContacts,
             flags,CONTACT(contact,numTerrainContacts*skip),skip	);
     }
     else    
     {
         numTerrainContacts = terrain->dCollideOSTerrainZone(
-            nMinX,nMaxX,nMinY,nMaxY,o2,numMaxTerrainContacts - numTerrainContacts,
+            nMinX,nMaxX,nMinY,nMaxY,regionMinZ,regionMaxZ,pccColliderCache,o2,numMaxTerrainContacts - numTerrainContacts,
             flags,CONTACT(contact,numTerrainContacts*skip),skip	);
     }
     dIASSERT( numTerrainContacts <= numMaxTerrainContacts );
@@ -16,6 +16,12 @@
 
 #define OSTERRAINMAXCONTACTPERCELL 10
 
+// min/max pyramid leaf nodes cover (1 << OSTERRAINMINMAXLEAFSHIFT) cells per side
+#define OSTERRAINMINMAXLEAFSHIFT 2
+#define OSTERRAINMINMAXMAXLEVELS 32
+#define OSTERRAINQUANTIZEDTILESHIFT 4
+#define OSTERRAINQUANTIZEDTILEMASK ((1 << OSTERRAINQUANTIZEDTILESHIFT) - 1)
+
 class OSTerrainVertex;
 class OSTerrainEdge;
 class OSTerrainTriangle;
@@ -42,10 +48,26 @@ struct dxOSTerrainData
     int	m_nDepthSamples;       // Vertex count on Z axis edge (number of samples)
     int m_bCopyHeightData;     // Do we own the sample data?
 
-    const float* m_pHeightData; // Sample data array
+    const float* m_pHeightData; // Sample data array, NULL when quantized
+
+    // optional 16 bit samples in square tiles, offset + step * value
+    int     m_bQuantized;
+    unsigned short* m_pQuantizedHeights;
+    int     m_nQuantizedTilesX;
+    float   m_fQuantizedOffset;
+    float   m_fQuantizedStep;
+
+    // min/max heights pyramid, finest level first, two floats per node
+    float*  m_pMinMax;
+    int     m_nMinMaxLevels;
+    int     m_nMinMaxLevelWidth[OSTERRAINMINMAXMAXLEVELS];
+    int     m_nMinMaxLevelDepth[OSTERRAINMINMAXMAXLEVELS];
+    size_t  m_nMinMaxLevelOffset[OSTERRAINMINMAXMAXLEVELS];
+
+    // optional per triangle plane normal scale (1/length), indexed by GetTriIndex
+    int     m_bBuildPlanes;
+    dReal*  m_pPlaneScale;
     
-    dContactGeom            m_contacts[OSTERRAINMAXCONTACTPERCELL];
-
     dxOSTerrainData();
     ~dxOSTerrainData();
 
@@ -55,6 +77,38 @@ struct dxOSTerrainData
 
     void ComputeHeightBounds();
 
+    void BuildMinMax();
+    void FreeMinMax();
+    void BuildPlanes();
+    void FreePlanes();
+    void BuildQuantized(const float *pHeightData);
+    void FreeQuantized();
+    void RebuildAccelerationData();
+    size_t GetMemoryUsage() const;
+
+    // sample height, for both storage formats
+    float GetSample(int x, int y) const
+    {
+        if (m_pQuantizedHeights)
+        {
+            const size_t tile = (size_t)(x >> OSTERRAINQUANTIZEDTILESHIFT)
+                + (size_t)(y >> OSTERRAINQUANTIZEDTILESHIFT) * m_nQuantizedTilesX;
+            const int sample = (x & OSTERRAINQUANTIZEDTILEMASK)
+                + ((y & OSTERRAINQUANTIZEDTILEMASK) << OSTERRAINQUANTIZEDTILESHIFT);
+            return m_fQuantizedOffset + m_fQuantizedStep
+                * (float)m_pQuantizedHeights[(tile << (2 * OSTERRAINQUANTIZEDTILESHIFT)) + sample];
+        }
+        return m_pHeightData[x + y * m_nWidthSamples];
+    }
+
+    // height bounds of the cells [minX, maxX) x [minY, maxY)
+    void GetCellRangeBounds(int minX, int maxX, int minY, int maxY,
+        dReal &minZ, dReal &maxZ) const;
+    // drops border rows and columns of cells that are all at or below minZ
+    void ShrinkCellRange(dReal minZ, int &minX, int &maxX, int &minY, int &maxY) const;
+
+    void GetPlaneNormal(int x, int y, bool second, dReal dx, dReal dy, dReal *normal) const;
+
     bool IsOnOSTerrain2  ( const OSTerrainVertex * const CellCorner, 
         const dReal * const pos,  const bool isABC) const;
 
@@ -102,6 +156,16 @@ public:
     bool                state;
 };
 
+// trimesh vertex in world space, with the first triangle using it
+class OSTerrainMeshVertex
+{
+public:
+    OSTerrainMeshVertex(){};
+
+    dVector3 pos;
+    int tri;
+};
+
 class OSTerrainPlane
 {
 public:
@@ -112,46 +176,34 @@ public:
 };
 
 //
-// dxOSTerrain
+// dxOSTerrainCollidersCache
 //
-// OSTerrain geom structure
+// Scratch storage of the OSTerrain colliders. There is one per thread
+// (see odetls.h) so several threads may collide against the same terrain.
 //
-struct dxOSTerrain : public dxGeom
+struct dxOSTerrainCollidersCache
 {
-    dxOSTerrainData* m_p_data;
-
-    dxOSTerrain( dSpaceID space, dOSTerrainDataID data, int bPlaceable );
-    ~dxOSTerrain();
-
-    void computeAABB();
- 
-    int dCollideOSTerrainSphere( const int minX, const int maxX, const int minZ, const int maxZ,
-        dxGeom *o2, const int numMaxContacts,
-        int flags, dContactGeom *contact, int skip );
-    int dCollideOSTerrainZone( const int minX, const int maxX, const int minZ, const int maxZ,  
-        dxGeom *o2, const int numMaxContacts,
-        int flags, dContactGeom *contact, int skip );
+    dxOSTerrainCollidersCache();
+    ~dxOSTerrainCollidersCache();
 
 	enum
 	{
-		TEMP_PLANE_BUFFER_ELEMENT_COUNT_ALIGNMENT = 4,
 		TEMP_HEIGHT_BUFFER_ELEMENT_COUNT_ALIGNMENT_X = 4,
 		TEMP_HEIGHT_BUFFER_ELEMENT_COUNT_ALIGNMENT_Y = 4,
 		TEMP_TRIANGLE_BUFFER_ELEMENT_COUNT_ALIGNMENT = 1, // Triangles are easy to reallocate and hard to predict
+		TEMP_COLLIDE_BUFFER_ELEMENT_COUNT_ALIGNMENT = 16,
 	};
 
 	static inline size_t AlignBufferSize(size_t value, size_t alignment) { dIASSERT((alignment & (alignment - 1)) == 0); return (value + (alignment - 1)) & ~(alignment - 1); }
 
 	void  allocateTriangleBuffer(size_t numTri);
 	void  resetTriangleBuffer();
-	void  allocatePlaneBuffer(size_t numTri);
-	void  resetPlaneBuffer();
 	void  allocateHeightBuffer(size_t numX, size_t numZ);
     void  resetHeightBuffer();
-
-    OSTerrainPlane    **tempPlaneBuffer;
-    OSTerrainPlane    *tempPlaneInstances;
-    size_t              tempPlaneBufferSize;
+	void  allocateCollideBuffer(size_t numX);
+	void  resetCollideBuffer();
+	void  allocateMeshVertexBuffer(size_t numVertices);
+	void  resetMeshVertexBuffer();
 
     OSTerrainTriangle *tempTriangleBuffer;
     size_t              tempTriangleBufferSize;
@@ -161,6 +213,60 @@ struct dxOSTerrain : public dxGeom
     size_t              tempHeightBufferSizeX;
     size_t              tempHeightBufferSizeY;
 
+    bool                *tempCollideBuffer;     // two rows of sphere vertical edge state
+    size_t              tempCollideBufferSize;
+
+    OSTerrainMeshVertex *tempMeshVertexBuffer;  // trimesh vertices that can touch the zone
+    size_t              tempMeshVertexBufferSize;
+
+    dContactGeom        m_contacts[OSTERRAINMAXCONTACTPERCELL];
+};
+
+#if dTLS_ENABLED
+
+inline dxOSTerrainCollidersCache *GetOSTerrainCollidersCache(unsigned uiTLSKind)
+{
+    return COdeTls::GetOSTerrainCollidersCache((EODETLSKIND)uiTLSKind);
+}
+
+#else // dTLS_ENABLED
+
+inline dxOSTerrainCollidersCache *GetOSTerrainCollidersCache(unsigned uiTLSKind)
+{
+    (void)uiTLSKind; // unused
+
+    extern dxOSTerrainCollidersCache g_ccOSTerrainCollidersCache;
+
+    return &g_ccOSTerrainCollidersCache;
+}
+
+#endif // dTLS_ENABLED
+
+//
+// dxOSTerrain
+//
+// OSTerrain geom structure
+//
+struct dxOSTerrain : public dxGeom
+{
+    dxOSTerrainData* m_p_data;
+
+    dxOSTerrain( dSpaceID space, dOSTerrainDataID data, int bPlaceable );
+    ~dxOSTerrain();
+
+    void computeAABB();
+ 
+    int dCollideOSTerrainSphere( const int minX, const int maxX, const int minY, const int maxY,
+        dxOSTerrainCollidersCache *cache,
+        dxGeom *o2, const int numMaxContacts,
+        int flags, dContactGeom *contact, int skip );
+    int dCollideOSTerrainZone( const int minX, const int maxX, const int minY, const int maxY,
+        const dReal minZ, const dReal maxZ,
+        dxOSTerrainCollidersCache *cache,
+        dxGeom *o2, const int numMaxContacts,
+        int flags, dContactGeom *contact, int skip );
+    int dCollideOSTerrainRay( dxGeom *o2, const int numMaxContacts,
+        int flags, dContactGeom *contact, int skip );
 };
 
 
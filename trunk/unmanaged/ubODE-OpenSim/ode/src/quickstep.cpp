@@ -36,6 +36,12 @@
 
 #include <new>
 
+#ifdef WIN32
+#include "windows.h"
+#else
+#include <sched.h>
+#endif
+
 
 //***************************************************************************
 // configuration
@@ -111,6 +117,23 @@ struct IndexError;
 #define dxQUICKSTEPISLAND_STAGE6A_STEP  16U
 #define dxQUICKSTEPISLAND_STAGE6B_STEP  1U
 
+// the colored solver (see dWorldSetQuickStepSolverMode) is used for islands
+// with at least this many rows, smaller ones keep the sequential sweep
+#define dxQUICKSTEP_COLORED_MIN_ROWS    256U
+// colors handed out to the joints. the joints that find none left are
+// solved after the colors by the island's own thread
+#define dxQUICKSTEP_COLORED_MAX_COLORS  32U
+// rows a thread takes from a color at once
+#define dxQUICKSTEP_COLORED_BATCH_ROWS  32U
+// busy polls of a waiting thread before it yields the CPU
+#define dxQUICKSTEP_COLORED_SPINS       64U
+
+// the phase state holds the color being solved in the upper half and the
+// next batch to take in the lower one
+#define dxCOLORED_PHASE_IDLE            0xFFFEU
+#define dxCOLORED_PHASE_FINISHED        0xFFFFU
+#define dxCOLORED_PHASE_STATE(color, batch) ((atomicord32)(((unsigned int)(color) << 16) | (batch)))
+
 template<unsigned int step_size>
 inline unsigned int CalculateOptimalThreadsCount(unsigned int complexity, unsigned int max_threads)
 {
@@ -436,6 +459,40 @@ struct dxQuickStepperStage4CallContext
 };
 
 
+// joints of an island split in colors that share no body, see
+// dxQuickStepIsland_Stage4LCP_ColorJoints
+struct dxQuickStepperColoredContext
+{
+    void Initialize(dxQuickStepperStage4CallContext *stage4CallContext, dxQuickStepperStage5CallContext *stage5CallContext,
+        unsigned int *colorBatchStart, unsigned int *batchStart, dReal *batchError, dReal *batchMaxChange)
+    {
+        m_stage4CallContext = stage4CallContext;
+        m_stage5CallContext = stage5CallContext;
+        m_colorBatchStart = colorBatchStart;
+        m_batchStart = batchStart;
+        m_batchError = batchError;
+        m_batchMaxChange = batchMaxChange;
+        m_colorCount = 0;
+        m_helperCount = 0;
+        m_dopos = false;
+        m_phaseState = dxCOLORED_PHASE_STATE(dxCOLORED_PHASE_IDLE, 0);
+        m_phaseDone = 0;
+    }
+
+    dxQuickStepperStage4CallContext *m_stage4CallContext;
+    dxQuickStepperStage5CallContext *m_stage5CallContext;
+    unsigned int                    *m_colorBatchStart;     // m_colorCount + 2 entries, the last color is solved serially
+    unsigned int                    *m_batchStart;          // positions in the row order, one more than the batches
+    dReal                           *m_batchError;          // sum of the lambda changes of every batch
+    dReal                           *m_batchMaxChange;      // largest lambda change of every batch
+    unsigned int                    m_colorCount;
+    unsigned int                    m_helperCount;
+    bool                            m_dopos;
+    volatile atomicord32            m_phaseState;
+    volatile atomicord32            m_phaseDone;
+};
+
+
 static int dxQuickStepIsland_Stage4a_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_iMJ_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
 static int dxQuickStepIsland_Stage4LCP_iMJSync_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
@@ -469,8 +526,16 @@ static void dxQuickStepIsland_Stage4LCP_LinksArraysZeroing(dxQuickStepperStage4C
 static void dxQuickStepIsland_Stage4LCP_DependencyMapForNewOrderRebuilding(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_DependencyMapFromSavedLevelsReconstruction(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4LCP_MTIteration(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int initiallyKnownToBeCompletedLevel);
-static dReal dxQuickStepIsland_Stage4LCP_STIteration(dxQuickStepperStage4CallContext *stage4CallContext, bool dopos);
+static dReal dxQuickStepIsland_Stage4LCP_STIteration(dxQuickStepperStage4CallContext *stage4CallContext, bool dopos, dReal &maxChange);
+static bool dxQuickStepIsland_Stage4LCP_IsConverged(dxQuickStepperStage4CallContext *stage4CallContext, dReal tolerance, dReal error, dReal maxChange);
 static dReal dxQuickStepIsland_Stage4LCP_IterationStep(dxQuickStepperStage4CallContext *stage4CallContext, unsigned int i, bool dopos);
+static dxQuickStepperColoredContext *dxQuickStepIsland_Stage4LCP_ColorJoints(dxQuickStepperStage4CallContext *stage4CallContext, 
+    dxQuickStepperStage5CallContext *stage5CallContext, dxWorldProcessMemArena *memarena);
+static int dxQuickStepIsland_Stage4LCP_Colored_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+static int dxQuickStepIsland_Stage4LCP_ColoredComplete_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+static dReal dxQuickStepIsland_Stage4LCP_ColoredIteration(dxQuickStepperColoredContext *coloredContext, bool dopos, dReal &maxChange);
+static void dxQuickStepIsland_Stage4LCP_ColoredPhase(dxQuickStepperColoredContext *coloredContext, unsigned int color);
+static void dxQuickStepIsland_Stage4LCP_ColoredBatch(dxQuickStepperColoredContext *coloredContext, unsigned int batch);
 static void dxQuickStepIsland_Stage4MID(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage4b(dxQuickStepperStage4CallContext *stage4CallContext);
 static void dxQuickStepIsland_Stage5(dxQuickStepperStage5CallContext *stage5CallContext);
@@ -768,9 +833,12 @@ void dxQuickStepIsland(const dxStepperProcessingCallContext *callContext)
 
 //    if (allowedThreads == 1)
     {
+        dxStepStatsLap statsLap(callContext->m_world->stepstats);
+
         IFTIMING(dTimerStart("preprocessing"));
         dxQuickStepIsland_Stage0_Bodies(stage0BodiesCallContext);
         dxQuickStepIsland_Stage0_Joints(stage0JointsCallContext);
+        statsLap.Lap(dxSST_STAGE0);
         dxQuickStepIsland_Stage1(stage1CallContext);
     }
 /*
@@ -1024,6 +1092,9 @@ void dxQuickStepIsland_Stage1(dxQuickStepperStage1CallContext *stage1CallContext
     unsigned int m = stage1CallContext->m_stage0Outputs.m;
     unsigned int mfb = stage1CallContext->m_stage0Outputs.mfb;
 
+    dxStepStatsLap statsLap(callContext->m_world->stepstats);
+    statsLap.Count(dxSSC_ROWS, m);
+
     dxWorldProcessMemArena *memarena = callContext->m_stepperArena;
     memarena->RestoreState(stage1CallContext->m_stageMemArenaState);
     stage1CallContext = NULL; // WARNING! _stage1CallContext is not valid after this point!
@@ -1100,11 +1171,13 @@ void dxQuickStepIsland_Stage1(dxQuickStepperStage1CallContext *stage1CallContext
 
 //        if (allowedThreads == 1)
         {
+            statsLap.Lap(dxSST_STAGE1);
             IFTIMING (dTimerNow ("create J"));
             dxQuickStepIsland_Stage2a(stage2CallContext);
             IFTIMING (dTimerNow ("compute rhs_tmp"));
             dxQuickStepIsland_Stage2b(stage2CallContext);
             dxQuickStepIsland_Stage2c(stage2CallContext);
+            statsLap.Lap(dxSST_STAGE2);
             dxQuickStepIsland_Stage3(stage3CallContext);
         }
 /*
@@ -1135,6 +1208,7 @@ void dxQuickStepIsland_Stage1(dxQuickStepperStage1CallContext *stage1CallContext
 */
     }
     else {
+        statsLap.Lap(dxSST_STAGE1);
         dxQuickStepIsland_Stage3(stage3CallContext);
     }
 }
@@ -1435,6 +1509,8 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
     const dxStepperProcessingCallContext *callContext = stage3CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage3CallContext->m_localContext;
 
+    dxStepStatsLap statsLap(callContext->m_world->stepstats);
+
     dxWorldProcessMemArena *memarena = callContext->m_stepperArena;
     memarena->RestoreState(stage3CallContext->m_stage1MemArenaState);
     stage3CallContext = NULL; // WARNING! stage3CallContext is not valid after this point!
@@ -1445,6 +1521,8 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
     stage5CallContext->Initialize(callContext, localContext, stage3MemarenaState);
 
     unsigned int m = localContext->m_m;
+    unsigned int lcp_iterations = 0;
+    unsigned int colors = 0;
 
     if (m > 0)
     {
@@ -1479,6 +1557,8 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
 
 //        if (singleThreadedExecution)
         {
+            statsLap.Lap(dxSST_STAGE3);
+
             dxQuickStepIsland_Stage4a(stage4CallContext);
 
             IFTIMING (dTimerNow ("solving LCP problem"));
@@ -1489,34 +1569,79 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
             
             dxWorld *world = callContext->m_world;
             const unsigned int num_iterations = world->qs.num_iterations;
-
-            if (IsSORConstraintsReorderRequiredForIteration(0)) {
+            const dReal tolerance = world->qs.tolerance;
+            dReal maxChange;
+
+            dxQuickStepperColoredContext *coloredContext = NULL;
+            dCallReleaseeID coloredCompleteReleasee = NULL;
+
+            if (world->qs.solver_mode == dQuickStepSolverColored && m >= dxQUICKSTEP_COLORED_MIN_ROWS) {
+                // replaces the row order with one grouped by color
+                coloredContext = dxQuickStepIsland_Stage4LCP_ColorJoints(stage4CallContext, stage5CallContext, memarena);
+                colors = coloredContext->m_colorCount;
+
+                if (allowedThreads > 1) {
+                    // the helpers take batches of every color as it is published and
+                    // leave once the sweeps are finished. Stage4b and Stage5 run after
+                    // the last of them, so the arena stays valid for them meanwhile
+                    unsigned int helperCount = allowedThreads - 1;
+                    coloredContext->m_helperCount = helperCount;
+
+                    world->PostThreadedCallForUnawareReleasee(NULL, &coloredCompleteReleasee, helperCount + 1, callContext->m_finalReleasee, 
+                        NULL, &dxQuickStepIsland_Stage4LCP_ColoredComplete_Callback, coloredContext, 0, "QuickStepIsland Stage4LCP_Colored Complete");
+                    world->PostThreadedCallsGroup(NULL, helperCount, coloredCompleteReleasee, &dxQuickStepIsland_Stage4LCP_Colored_Callback, coloredContext, "QuickStepIsland Stage4LCP_Colored");
+                }
+            }
+            else if (IsSORConstraintsReorderRequiredForIteration(0)) {
                 stage4CallContext->ResetSOR_ConstraintsReorderVariables(0);
                     dxQuickStepIsland_Stage4LCP_ConstraintsShuffling(stage4CallContext, 0);
                 }
 
+            statsLap.Lap(dxSST_STAGE4);
+
             for (unsigned int iteration=0; iteration < num_iterations; iteration++) {
 //                if (IsSORConstraintsReorderRequiredForIteration(iteration)) {
 //                    stage4CallContext->ResetSOR_ConstraintsReorderVariables(0);
 //                    dxQuickStepIsland_Stage4LCP_ConstraintsShuffling(stage4CallContext, iteration);
 //                }
-                if(dxQuickStepIsland_Stage4LCP_STIteration(stage4CallContext,true) < REAL(0.0001))
+                ++lcp_iterations;
+                dReal error = coloredContext != NULL
+                    ? dxQuickStepIsland_Stage4LCP_ColoredIteration(coloredContext, true, maxChange)
+                    : dxQuickStepIsland_Stage4LCP_STIteration(stage4CallContext, true, maxChange);
+                if (dxQuickStepIsland_Stage4LCP_IsConverged(stage4CallContext, tolerance, error, maxChange))
                     break;
             }
 
+            statsLap.Lap(dxSST_LCP, dxSST_STAGE4);
             dxQuickStepIsland_Stage4MID(stage4CallContext);
+            statsLap.Lap(dxSST_STAGE4);
 
             for (unsigned int iteration=0; iteration < num_iterations; iteration++) {
 //                if (IsSORConstraintsReorderRequiredForIteration(iteration)) {
 //                    stage4CallContext->ResetSOR_ConstraintsReorderVariables(0);
 //                    dxQuickStepIsland_Stage4LCP_ConstraintsShuffling(stage4CallContext, iteration);
 //                }
-                if(dxQuickStepIsland_Stage4LCP_STIteration(stage4CallContext,false) < REAL(0.0001))
+                ++lcp_iterations;
+                dReal error = coloredContext != NULL
+                    ? dxQuickStepIsland_Stage4LCP_ColoredIteration(coloredContext, false, maxChange)
+                    : dxQuickStepIsland_Stage4LCP_STIteration(stage4CallContext, false, maxChange);
+                if (dxQuickStepIsland_Stage4LCP_IsConverged(stage4CallContext, tolerance, error, maxChange))
                     break;
             }
 
-            dxQuickStepIsland_Stage4b(stage4CallContext);
-            dxQuickStepIsland_Stage5(stage5CallContext);
+            statsLap.Lap(dxSST_LCP, dxSST_STAGE4);
+            statsLap.Count(dxSSC_LCP_ITERATIONS, lcp_iterations);
+
+            if (coloredCompleteReleasee != NULL) {
+                // the arena belongs to the completion call from here on
+                ThrsafeExchange(&coloredContext->m_phaseState, dxCOLORED_PHASE_STATE(dxCOLORED_PHASE_FINISHED, 0));
+                world->AlterThreadedCallDependenciesCount(coloredCompleteReleasee, -1);
+            }
+            else {
+                dxQuickStepIsland_Stage4b(stage4CallContext);
+                statsLap.Lap(dxSST_STAGE4);
+                dxQuickStepIsland_Stage5(stage5CallContext);
+            }
         }
 /*
         else
@@ -1573,9 +1698,11 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
 */
     }
     else {
+        statsLap.Lap(dxSST_STAGE3);
         dxQuickStepIsland_Stage5(stage5CallContext);
     }
 
+    statsLap.RecordIsland(callContext->m_islandBodiesCount, callContext->m_islandJointsCount, m, lcp_iterations, colors);
  }
 
 static 
@@ -2462,17 +2589,347 @@ void dxQuickStepIsland_Stage4LCP_MTIteration(dxQuickStepperStage4CallContext *st
     ThrsafeAdd(&stage4CallContext->m_LCP_iterationThreadsRemaining, (atomicord32)(-1));
 }
 
+// returns the sum of the lambda changes of the sweep, maxChange gets the
+// largest one
 static 
-dReal dxQuickStepIsland_Stage4LCP_STIteration(dxQuickStepperStage4CallContext *stage4CallContext,bool isPos)
+dReal dxQuickStepIsland_Stage4LCP_STIteration(dxQuickStepperStage4CallContext *stage4CallContext, bool isPos, dReal &maxChange)
 {
     const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
     dReal error = 0;
+    dReal largest = 0;
     unsigned int m = localContext->m_m;
-    for (unsigned int i = 0; i != m; ++i)
-        error += dxQuickStepIsland_Stage4LCP_IterationStep(stage4CallContext, i, isPos);
+    for (unsigned int i = 0; i != m; ++i) {
+        dReal change = dxQuickStepIsland_Stage4LCP_IterationStep(stage4CallContext, i, isPos);
+        error += change;
+        if (change > largest)
+            largest = change;
+    }
+    maxChange = largest;
     return error;
 }
 
+// the sweeps stop once the lambdas change by less than 0.0001 in total or,
+// with a tolerance set (see dWorldSetQuickStepTolerance), once the largest
+// change is below the tolerance relative to the largest lambda. the
+// relative test lets small islands stop early regardless of their mass
+static 
+bool dxQuickStepIsland_Stage4LCP_IsConverged(dxQuickStepperStage4CallContext *stage4CallContext, dReal tolerance, dReal error, dReal maxChange)
+{
+    if (error < REAL(0.0001))
+        return true;
+    if (tolerance <= 0)
+        return false;
+
+    const dReal *lambda = stage4CallContext->m_lambda;
+    unsigned int m = stage4CallContext->m_localContext->m_m;
+    dReal maxLambda = 0;
+    for (unsigned int i = 0; i != m; ++i) {
+        dReal magnitude = dFabs(lambda[i]);
+        if (magnitude > maxLambda)
+            maxLambda = magnitude;
+    }
+    return maxChange <= tolerance * maxLambda;
+}
+
+// greedy coloring of the joints: every joint takes the lowest color that
+// neither of its bodies has yet, so the joints of a color can be solved at
+// the same time. consecutive joints of the same body pair, like the contacts
+// of one collision, are colored as one and never split between batches.
+// the rows are reordered by color and joint, and the joints of every color
+// are cut in batches of about dxQUICKSTEP_COLORED_BATCH_ROWS rows. a joint's
+// rows stay together with those without findex first, as in the sequential
+// order, so friction rows see the normal force of the same sweep
+static 
+dxQuickStepperColoredContext *dxQuickStepIsland_Stage4LCP_ColorJoints(dxQuickStepperStage4CallContext *stage4CallContext, 
+    dxQuickStepperStage5CallContext *stage5CallContext, dxWorldProcessMemArena *memarena)
+{
+    const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
+    const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
+
+    unsigned int nb = callContext->m_islandBodiesCount;
+    unsigned int nj = localContext->m_nj;
+    unsigned int m = localContext->m_m;
+    const unsigned int *mindex = localContext->m_mindex;
+    const int *jb = localContext->m_jb;
+    const int *findex = localContext->m_findex;
+
+    dxQuickStepperColoredContext *coloredContext = (dxQuickStepperColoredContext *)memarena->AllocateBlock(sizeof(dxQuickStepperColoredContext));
+    duint32 *bodyColors = memarena->AllocateArray<duint32>(nb);
+    unsigned char *jointColors = memarena->AllocateArray<unsigned char>(nj);
+    unsigned int *jointOrder = memarena->AllocateArray<unsigned int>(nj);
+    unsigned int *colorBatchStart = memarena->AllocateArray<unsigned int>(dxQUICKSTEP_COLORED_MAX_COLORS + 2);
+    unsigned int *batchStart = memarena->AllocateArray<unsigned int>((size_t)nj + 1);
+    dReal *batchError = memarena->AllocateArray<dReal>(nj);
+    dReal *batchMaxChange = memarena->AllocateArray<dReal>(nj);
+    coloredContext->Initialize(stage4CallContext, stage5CallContext, colorBatchStart, batchStart, batchError, batchMaxChange);
+
+    memset(bodyColors, 0, sizeof(duint32) * nb);
+
+    // joints counted per color, the serial remainder last
+    unsigned int colorJoints[dxQUICKSTEP_COLORED_MAX_COLORS + 1];
+    memset(colorJoints, 0, sizeof(colorJoints));
+
+    unsigned int colorCount = 0;
+    int lastB1 = -1, lastB2 = -1;
+    unsigned int lastColor = dxQUICKSTEP_COLORED_MAX_COLORS;
+    for (unsigned int ji = 0; ji != nj; ++ji) {
+        unsigned int ofs = mindex[(size_t)ji * 2];
+        unsigned int color = dxQUICKSTEP_COLORED_MAX_COLORS;
+
+        if (mindex[(size_t)ji * 2 + 2] != ofs) {
+            int b1 = jb[(size_t)ofs * 2];
+            int b2 = jb[(size_t)ofs * 2 + 1];
+            dIASSERT(b1 >= 0);
+
+            if (b1 == lastB1 && b2 == lastB2) {
+                color = lastColor;
+            }
+            else {
+                duint32 used = bodyColors[b1] | (b2 != -1 ? bodyColors[b2] : 0);
+                if (used != 0xFFFFFFFFU) {
+                    color = 0;
+                    while ((used & ((duint32)1 << color)) != 0) ++color;
+
+                    duint32 bit = (duint32)1 << color;
+                    bodyColors[b1] |= bit;
+                    if (b2 != -1) bodyColors[b2] |= bit;
+                    if (color >= colorCount) colorCount = color + 1;
+                }
+                lastB1 = b1;
+                lastB2 = b2;
+                lastColor = color;
+            }
+        }
+
+        jointColors[ji] = (unsigned char)color;
+        colorJoints[color] += 1;
+    }
+
+    // the colors in use are 0 to colorCount-1, move the remainder after them
+    colorJoints[colorCount] = colorJoints[dxQUICKSTEP_COLORED_MAX_COLORS];
+    for (unsigned int ji = 0; ji != nj; ++ji) {
+        if (jointColors[ji] == dxQUICKSTEP_COLORED_MAX_COLORS) jointColors[ji] = (unsigned char)colorCount;
+    }
+
+    unsigned int colorJointStart[dxQUICKSTEP_COLORED_MAX_COLORS + 2];
+    colorJointStart[0] = 0;
+    for (unsigned int color = 0; color <= colorCount; ++color) {
+        colorJointStart[color + 1] = colorJointStart[color] + colorJoints[color];
+        colorJoints[color] = colorJointStart[color];
+    }
+    for (unsigned int ji = 0; ji != nj; ++ji) {
+        jointOrder[colorJoints[jointColors[ji]]++] = ji;
+    }
+
+    // enough rows per batch for a color to have fewer than 64k batches
+    unsigned int batchRows = dMAX(dxQUICKSTEP_COLORED_BATCH_ROWS, m / 0x8000U + 1);
+
+    IndexError *order = stage4CallContext->m_order;
+    unsigned int position = 0, batch = 0;
+
+    for (unsigned int color = 0; color <= colorCount; ++color) {
+        colorBatchStart[color] = batch;
+        unsigned int rowsInBatch = 0;
+        int lastB1 = -1, lastB2 = -1;
+
+        for (unsigned int jo = colorJointStart[color]; jo != colorJointStart[color + 1]; ++jo) {
+            unsigned int ji = jointOrder[jo];
+            unsigned int ofs = mindex[(size_t)ji * 2], end = mindex[(size_t)ji * 2 + 2];
+            if (ofs == end) {
+                continue;
+            }
+
+            // the joints of one body pair follow each other within a color
+            int b1 = jb[(size_t)ofs * 2];
+            int b2 = jb[(size_t)ofs * 2 + 1];
+            if (rowsInBatch >= batchRows && (b1 != lastB1 || b2 != lastB2)) {
+                ++batch;
+                rowsInBatch = 0;
+            }
+            lastB1 = b1;
+            lastB2 = b2;
+
+            if (rowsInBatch == 0) {
+                batchStart[batch] = position;
+            }
+
+            for (unsigned int row = ofs; row != end; ++row) {
+                if (findex[row] == -1) order[position++].index = row;
+            }
+            for (unsigned int row = ofs; row != end; ++row) {
+                if (findex[row] != -1) order[position++].index = row;
+            }
+
+            rowsInBatch += end - ofs;
+        }
+
+        if (rowsInBatch != 0) {
+            ++batch;
+        }
+    }
+    colorBatchStart[colorCount + 1] = batch;
+    batchStart[batch] = position;
+    dIASSERT(position == m);
+    dIASSERT(batch <= nj);
+
+    coloredContext->m_colorCount = colorCount;
+    return coloredContext;
+}
+
+static inline 
+void dxQuickStepColoredSpinWait(unsigned int &spins)
+{
+    if (++spins == dxQUICKSTEP_COLORED_SPINS) {
+        spins = 0;
+#ifdef WIN32
+        Sleep(0);
+#else
+        sched_yield();
+#endif
+    }
+}
+
+// a helper thread of a colored island
+static 
+int dxQuickStepIsland_Stage4LCP_Colored_Callback(void *_coloredContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    (void)callInstanceIndex; // unused
+    (void)callThisReleasee; // unused
+    dxQuickStepperColoredContext *coloredContext = (dxQuickStepperColoredContext *)_coloredContext;
+    const unsigned int *colorBatchStart = coloredContext->m_colorBatchStart;
+
+    unsigned int spins = 0;
+    for (;;) {
+        atomicord32 state = coloredContext->m_phaseState;
+        unsigned int color = (unsigned int)state >> 16;
+        if (color == dxCOLORED_PHASE_FINISHED) {
+            break;
+        }
+
+        if (color != dxCOLORED_PHASE_IDLE) {
+            unsigned int next = (unsigned int)state & 0xFFFFU;
+            unsigned int firstBatch = colorBatchStart[color];
+            if (next != colorBatchStart[color + 1] - firstBatch) {
+                if (ThrsafeCompareExchange(&coloredContext->m_phaseState, state, state + 1)) {
+                    dxQuickStepIsland_Stage4LCP_ColoredBatch(coloredContext, firstBatch + next);
+                    ThrsafeAdd(&coloredContext->m_phaseDone, 1);
+                    spins = 0;
+                }
+                continue;
+            }
+        }
+
+        // waiting for the next color or the end of the sweeps
+        dxQuickStepColoredSpinWait(spins);
+    }
+    return 1;
+}
+
+// runs once the island thread and all the helpers are through
+static 
+int dxQuickStepIsland_Stage4LCP_ColoredComplete_Callback(void *_coloredContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    (void)callInstanceIndex; // unused
+    (void)callThisReleasee; // unused
+    dxQuickStepperColoredContext *coloredContext = (dxQuickStepperColoredContext *)_coloredContext;
+    dxQuickStepperStage4CallContext *stage4CallContext = coloredContext->m_stage4CallContext;
+
+    dxStepStatsLap statsLap(stage4CallContext->m_stepperCallContext->m_world->stepstats);
+    dxQuickStepIsland_Stage4b(stage4CallContext);
+    statsLap.Lap(dxSST_STAGE4);
+    dxQuickStepIsland_Stage5(coloredContext->m_stage5CallContext);
+    return 1;
+}
+
+// one sweep over all the colors, the same sums as
+// dxQuickStepIsland_Stage4LCP_STIteration
+static 
+dReal dxQuickStepIsland_Stage4LCP_ColoredIteration(dxQuickStepperColoredContext *coloredContext, bool dopos, dReal &maxChange)
+{
+    coloredContext->m_dopos = dopos;
+
+    unsigned int colorCount = coloredContext->m_colorCount;
+    for (unsigned int color = 0; color != colorCount; ++color) {
+        dxQuickStepIsland_Stage4LCP_ColoredPhase(coloredContext, color);
+    }
+
+    // the joints that found no color
+    const unsigned int *colorBatchStart = coloredContext->m_colorBatchStart;
+    unsigned int batchCount = colorBatchStart[colorCount + 1];
+    for (unsigned int batch = colorBatchStart[colorCount]; batch != batchCount; ++batch) {
+        dxQuickStepIsland_Stage4LCP_ColoredBatch(coloredContext, batch);
+    }
+
+    const dReal *batchError = coloredContext->m_batchError;
+    const dReal *batchMaxChange = coloredContext->m_batchMaxChange;
+    dReal error = 0;
+    dReal largest = 0;
+    for (unsigned int batch = 0; batch != batchCount; ++batch) {
+        error += batchError[batch];
+        if (batchMaxChange[batch] > largest)
+            largest = batchMaxChange[batch];
+    }
+    maxChange = largest;
+    return error;
+}
+
+// solves the batches of a color, with the helpers if there are any
+static 
+void dxQuickStepIsland_Stage4LCP_ColoredPhase(dxQuickStepperColoredContext *coloredContext, unsigned int color)
+{
+    const unsigned int *colorBatchStart = coloredContext->m_colorBatchStart;
+    unsigned int firstBatch = colorBatchStart[color];
+    unsigned int batchCount = colorBatchStart[color + 1] - firstBatch;
+
+    if (coloredContext->m_helperCount == 0) {
+        for (unsigned int batch = 0; batch != batchCount; ++batch) {
+            dxQuickStepIsland_Stage4LCP_ColoredBatch(coloredContext, firstBatch + batch);
+        }
+        return;
+    }
+
+    // all batches of the previous color are done, nobody touches the counter
+    coloredContext->m_phaseDone = 0;
+    ThrsafeExchange(&coloredContext->m_phaseState, dxCOLORED_PHASE_STATE(color, 0));
+
+    for (;;) {
+        atomicord32 state = coloredContext->m_phaseState;
+        unsigned int next = (unsigned int)state & 0xFFFFU;
+        if (next == batchCount) {
+            break;
+        }
+        if (ThrsafeCompareExchange(&coloredContext->m_phaseState, state, state + 1)) {
+            dxQuickStepIsland_Stage4LCP_ColoredBatch(coloredContext, firstBatch + next);
+            ThrsafeAdd(&coloredContext->m_phaseDone, 1);
+        }
+    }
+
+    // the batches taken by the helpers
+    unsigned int spins = 0;
+    while (coloredContext->m_phaseDone != batchCount) {
+        dxQuickStepColoredSpinWait(spins);
+    }
+}
+
+static 
+void dxQuickStepIsland_Stage4LCP_ColoredBatch(dxQuickStepperColoredContext *coloredContext, unsigned int batch)
+{
+    dxQuickStepperStage4CallContext *stage4CallContext = coloredContext->m_stage4CallContext;
+    const unsigned int *batchStart = coloredContext->m_batchStart;
+    bool dopos = coloredContext->m_dopos;
+
+    dReal error = 0;
+    dReal largest = 0;
+    for (unsigned int i = batchStart[batch], end = batchStart[batch + 1]; i != end; ++i) {
+        dReal change = dxQuickStepIsland_Stage4LCP_IterationStep(stage4CallContext, i, dopos);
+        error += change;
+        if (change > largest)
+            largest = change;
+    }
+    coloredContext->m_batchError[batch] = error;
+    coloredContext->m_batchMaxChange[batch] = largest;
+}
+
 //***************************************************************************
 // SOR-LCP method
 
@@ -2779,6 +3236,8 @@ void dxQuickStepIsland_Stage5(dxQuickStepperStage5CallContext *stage5CallContext
     const dxStepperProcessingCallContext *callContext = stage5CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage5CallContext->m_localContext;
 
+    dxStepStatsLap statsLap(callContext->m_world->stepstats);
+
     dxWorldProcessMemArena *memarena = callContext->m_stepperArena;
     memarena->RestoreState(stage5CallContext->m_stage3MemArenaState);
     stage5CallContext = NULL; // WARNING! stage3CallContext is not valid after this point!
@@ -2791,12 +3250,16 @@ void dxQuickStepIsland_Stage5(dxQuickStepperStage5CallContext *stage5CallContext
     dIASSERT(allowedThreads >= 1);
 
 //    if (allowedThreads == 1) {
+        statsLap.Lap(dxSST_STAGE5);
         IFTIMING (dTimerNow ("compute velocity update"));
         dxQuickStepIsland_Stage6a(stage6CallContext);
         dxQuickStepIsland_Stage6_VelocityCheck(stage6CallContext);
+        statsLap.Lap(dxSST_STAGE6);
         IFTIMING (dTimerNow ("update position and tidy up"));
         dxQuickStepIsland_Stage6b(stage6CallContext);
+        statsLap.Lap(dxSST_INTEGRATION, dxSST_STAGE6);
         dxQuickStepIsland_Stage6c(stage6CallContext);
+        statsLap.Lap(dxSST_STAGE6);
         IFTIMING (dTimerEnd());
         IFTIMING (if (m > 0) dTimerReport (stdout,1));
 /*
@@ -3016,7 +3479,6 @@ size_t dxEstimateQuickStepMemoryRequirements (dxBody * const *body,
                                               dxJoint * const *_joint,
                                               unsigned int _nj)
 {
-    (void)body; // unused
     unsigned int nj, m, mfb;
 
     {
@@ -3077,6 +3539,15 @@ size_t dxEstimateQuickStepMemoryRequirements (dxBody * const *body,
 //                    sub3_res1 += dEFFICIENT_SIZE(sizeof(atomicord32) * 2 * ((size_t)m + 1)); // for mi_links
 //#endif
                     sub3_res1 += dEFFICIENT_SIZE(sizeof(dxQuickStepperStage4CallContext)); // for dxQuickStepperStage4CallContext;
+                    if (nb != 0 && body[0]->world->qs.solver_mode == dQuickStepSolverColored && m >= dxQUICKSTEP_COLORED_MIN_ROWS) {
+                        sub3_res1 += dEFFICIENT_SIZE(sizeof(dxQuickStepperColoredContext)); // for dxQuickStepperColoredContext
+                        sub3_res1 += dEFFICIENT_SIZE(sizeof(duint32) * nb); // for bodyColors
+                        sub3_res1 += dEFFICIENT_SIZE(sizeof(unsigned char) * nj); // for jointColors
+                        sub3_res1 += dEFFICIENT_SIZE(sizeof(unsigned int) * nj); // for jointOrder
+                        sub3_res1 += dEFFICIENT_SIZE(sizeof(unsigned int) * (dxQUICKSTEP_COLORED_MAX_COLORS + 2)); // for colorBatchStart
+                        sub3_res1 += dEFFICIENT_SIZE(sizeof(unsigned int) * ((size_t)nj + 1)); // for batchStart
+                        sub3_res1 += 2 * dEFFICIENT_SIZE(sizeof(dReal) * nj); // for batchError, batchMaxChange
+                    }
 
                     size_t sub3_res2 = dEFFICIENT_SIZE(sizeof(dxQuickStepperStage6CallContext)); // for dxQuickStepperStage6CallContext;
                     
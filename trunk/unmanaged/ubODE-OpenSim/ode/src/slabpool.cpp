@@ -0,0 +1,556 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+size class slab pools. each class keeps the slabs it carved and a shared
+free list behind a spin lock. threads with ODE collision data allocated
+also get a small cache per class in front of the shared list so that
+create/destroy churn on one thread rarely takes the lock
+
+*/
+
+#include <ode/common.h>
+#include <ode/memory.h>
+#include "config.h"
+#include "slabpool.h"
+#include "odeou.h"
+#include "odetls.h"
+#include "util.h"
+
+
+// 16 byte steps up to 256, 64 up to 1024, 256 up to 2048, then 4k, 8k and
+// the 16k obstack arenas
+#define dxSLAB_CLASS_COUNT 35
+
+// blocks carved from one slab, the big classes take at least four
+#define dxSLAB_TARGET_BYTES 16384
+#define dxSLAB_MIN_BLOCKS 4
+
+// blocks a thread cache may hold per class
+#define dxSLAB_CACHE_BYTES 8192
+#define dxSLAB_CACHE_MIN_BLOCKS 2
+#define dxSLAB_CACHE_MAX_BLOCKS 64
+
+
+// free blocks and slab headers are both chained through their first word
+struct dxSlabLink
+{
+    dxSlabLink *next;
+};
+
+#define dxSLAB_HEADER_SIZE dEFFICIENT_SIZE(sizeof(dxSlabLink))
+
+struct dxSlabClass
+{
+    volatile atomicord32 lock;
+    size_t block_size;
+    unsigned blocks_per_slab;
+    unsigned cache_limit;
+
+    dxSlabLink *slabs;
+    dxSlabLink *free_blocks;
+    size_t free_count;
+    size_t slab_count;
+    duint64 slab_allocs;
+    duint64 slab_frees;
+};
+
+struct dxSlabThreadCache
+{
+    unsigned generation;        // g_slabGeneration the blocks belong to
+    dxSlabLink *blocks[dxSLAB_CLASS_COUNT];
+    unsigned counts[dxSLAB_CLASS_COUNT];
+};
+
+
+static dxSlabClass g_slabClasses[dxSLAB_CLASS_COUNT];
+
+static bool g_slabPoolsEnabled = true;  // applied at the next initialization
+static bool g_slabPoolsActive = false;
+
+// bumped on every initialization and finalization so that caches of
+// threads that outlived a dCloseODE() are ignored instead of reused
+static unsigned g_slabGeneration = 0;
+
+
+static inline unsigned SlabClassIndex(size_t size)
+{
+    dIASSERT(size <= dxSLAB_MAX_BLOCK_SIZE);
+
+    if (size <= 256) return size != 0 ? (unsigned)((size + 15) >> 4) - 1 : 0;
+    if (size <= 1024) return 16 + (unsigned)((size - 256 + 63) >> 6) - 1;
+    if (size <= 2048) return 28 + (unsigned)((size - 1024 + 255) >> 8) - 1;
+    if (size <= 4096) return 32;
+    if (size <= 8192) return 33;
+    return 34;
+}
+
+static size_t SlabClassBlockSize(unsigned index)
+{
+    dIASSERT(index < dxSLAB_CLASS_COUNT);
+
+    if (index < 16) return (size_t)(index + 1) << 4;
+    if (index < 28) return 256 + ((size_t)(index - 15) << 6);
+    if (index < 32) return 1024 + ((size_t)(index - 27) << 8);
+    return (size_t)4096 << (index - 32);
+}
+
+static inline size_t SlabBytes(const dxSlabClass *cls)
+{
+    return dxSLAB_HEADER_SIZE + cls->block_size * cls->blocks_per_slab;
+}
+
+
+#if dATOMICS_ENABLED
+
+static inline void LockSlabClass(dxSlabClass *cls)
+{
+    while (!AtomicCompareExchange(&cls->lock, 0, 1)) {
+        while (cls->lock != 0) {
+        }
+    }
+}
+
+static inline void UnlockSlabClass(dxSlabClass *cls)
+{
+    AtomicExchange(&cls->lock, 0);
+}
+
+#else // !dATOMICS_ENABLED
+
+// without atomics ODE is not used from several threads at once
+static inline void LockSlabClass(dxSlabClass *) {}
+static inline void UnlockSlabClass(dxSlabClass *) {}
+
+#endif // dATOMICS_ENABLED
+
+
+static inline dxSlabThreadCache *GetSlabThreadCache()
+{
+#if dTLS_ENABLED
+    dxSlabThreadCache *cache = COdeTls::FindSlabThreadCache();
+    return cache != NULL && cache->generation == g_slabGeneration ? cache : NULL;
+#else
+    return NULL;
+#endif
+}
+
+
+// moves up to count blocks from the shared free list to the front of *out,
+// carving a new slab if the list is empty. returns the number of blocks
+// moved, 0 if a slab could not be allocated
+static unsigned TakeSlabBlocks(dxSlabClass *cls, unsigned count, dxSlabLink **out)
+{
+    dIASSERT(count != 0);
+
+    LockSlabClass(cls);
+
+    if (cls->free_blocks == NULL) {
+        UnlockSlabClass(cls);
+
+        dxSlabLink *slab = (dxSlabLink *)dAlloc(SlabBytes(cls));
+        if (slab == NULL) {
+            return 0;
+        }
+
+        char *blocks = (char *)slab + dxSLAB_HEADER_SIZE;
+        dxSlabLink *last = (dxSlabLink *)(blocks + cls->block_size * (cls->blocks_per_slab - 1));
+        for (char *block = blocks; block != (char *)last; block += cls->block_size) {
+            ((dxSlabLink *)block)->next = (dxSlabLink *)(block + cls->block_size);
+        }
+
+        LockSlabClass(cls);
+
+        slab->next = cls->slabs;
+        cls->slabs = slab;
+        last->next = cls->free_blocks;
+        cls->free_blocks = (dxSlabLink *)blocks;
+        cls->free_count += cls->blocks_per_slab;
+        cls->slab_count++;
+        cls->slab_allocs++;
+    }
+
+    dxSlabLink *first = cls->free_blocks, *last = first;
+    unsigned taken = 1;
+    for (; taken != count && last->next != NULL; taken++) {
+        last = last->next;
+    }
+
+    cls->free_blocks = last->next;
+    cls->free_count -= taken;
+
+    UnlockSlabClass(cls);
+
+    last->next = *out;
+    *out = first;
+    return taken;
+}
+
+static void PutSlabBlocks(dxSlabClass *cls, dxSlabLink *first, dxSlabLink *last, unsigned count)
+{
+    LockSlabClass(cls);
+
+    last->next = cls->free_blocks;
+    cls->free_blocks = first;
+    cls->free_count += count;
+
+    UnlockSlabClass(cls);
+}
+
+// returns the first count blocks of a thread cache list to the shared one
+static void FlushSlabThreadCache(dxSlabThreadCache *cache, unsigned index, unsigned count)
+{
+    dIASSERT(count != 0 && count <= cache->counts[index]);
+
+    dxSlabLink *first = cache->blocks[index], *last = first;
+    for (unsigned i = 1; i != count; i++) {
+        last = last->next;
+    }
+
+    cache->blocks[index] = last->next;
+    cache->counts[index] -= count;
+
+    PutSlabBlocks(g_slabClasses + index, first, last, count);
+}
+
+static void FlushSlabThreadCache(dxSlabThreadCache *cache)
+{
+    for (unsigned index = 0; index != dxSLAB_CLASS_COUNT; index++) {
+        if (cache->counts[index] != 0) {
+            FlushSlabThreadCache(cache, index, cache->counts[index]);
+        }
+    }
+}
+
+
+void *dSlabAlloc(size_t size)
+{
+    if (!g_slabPoolsActive || size > dxSLAB_MAX_BLOCK_SIZE) {
+        return dAlloc(size);
+    }
+
+    unsigned index = SlabClassIndex(size);
+    dxSlabClass *cls = g_slabClasses + index;
+    dxSlabLink *block = NULL;
+
+    dxSlabThreadCache *cache = GetSlabThreadCache();
+    if (cache != NULL) {
+        if (cache->counts[index] == 0) {
+            cache->counts[index] = TakeSlabBlocks(cls, (cls->cache_limit + 1) / 2, &cache->blocks[index]);
+            if (cache->counts[index] == 0) {
+                return NULL;
+            }
+        }
+
+        block = cache->blocks[index];
+        cache->blocks[index] = block->next;
+        cache->counts[index]--;
+    }
+    else if (TakeSlabBlocks(cls, 1, &block) == 0) {
+        return NULL;
+    }
+
+    return block;
+}
+
+void dSlabFree(void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (!g_slabPoolsActive || size > dxSLAB_MAX_BLOCK_SIZE) {
+        dFree(ptr, size);
+        return;
+    }
+
+    unsigned index = SlabClassIndex(size);
+    dxSlabClass *cls = g_slabClasses + index;
+    dxSlabLink *block = (dxSlabLink *)ptr;
+
+    dxSlabThreadCache *cache = GetSlabThreadCache();
+    if (cache != NULL) {
+        if (cache->counts[index] == cls->cache_limit) {
+            FlushSlabThreadCache(cache, index, (cls->cache_limit + 1) / 2);
+        }
+
+        block->next = cache->blocks[index];
+        cache->blocks[index] = block;
+        cache->counts[index]++;
+    }
+    else {
+        PutSlabBlocks(cls, block, block, 1);
+    }
+}
+
+
+bool dInitSlabPools()
+{
+    dIASSERT(!g_slabPoolsActive);
+
+    for (unsigned index = 0; index != dxSLAB_CLASS_COUNT; index++) {
+        dxSlabClass *cls = g_slabClasses + index;
+        memset(cls, 0, sizeof(*cls));
+
+        cls->block_size = SlabClassBlockSize(index);
+
+        size_t blocks = dxSLAB_TARGET_BYTES / cls->block_size;
+        cls->blocks_per_slab = blocks > dxSLAB_MIN_BLOCKS ? (unsigned)blocks : dxSLAB_MIN_BLOCKS;
+
+        size_t cached = dxSLAB_CACHE_BYTES / cls->block_size;
+        cls->cache_limit = cached < dxSLAB_CACHE_MIN_BLOCKS ? dxSLAB_CACHE_MIN_BLOCKS
+            : (cached > dxSLAB_CACHE_MAX_BLOCKS ? dxSLAB_CACHE_MAX_BLOCKS : (unsigned)cached);
+    }
+
+    g_slabGeneration++;
+    g_slabPoolsActive = g_slabPoolsEnabled;
+    return true;
+}
+
+void dFinitSlabPools()
+{
+    g_slabPoolsActive = false;
+    g_slabGeneration++;
+
+    for (unsigned index = 0; index != dxSLAB_CLASS_COUNT; index++) {
+        dxSlabClass *cls = g_slabClasses + index;
+        const size_t slab_bytes = SlabBytes(cls);
+
+        dxSlabLink *slab = cls->slabs;
+        while (slab != NULL) {
+            dxSlabLink *next = slab->next;
+            dFree(slab, slab_bytes);
+            slab = next;
+        }
+
+        cls->slabs = NULL;
+        cls->free_blocks = NULL;
+        cls->free_count = 0;
+        cls->slab_count = 0;
+    }
+}
+
+
+dxSlabThreadCache *dAllocateSlabThreadCache()
+{
+    dxSlabThreadCache *cache = (dxSlabThreadCache *)dAlloc(sizeof(dxSlabThreadCache));
+    if (cache != NULL) {
+        memset(cache, 0, sizeof(*cache));
+        cache->generation = g_slabGeneration;
+    }
+    return cache;
+}
+
+void dFreeSlabThreadCache(dxSlabThreadCache *cache)
+{
+    if (g_slabPoolsActive && cache->generation == g_slabGeneration) {
+        FlushSlabThreadCache(cache);
+    }
+    dFree(cache, sizeof(dxSlabThreadCache));
+}
+
+
+//****************************************************************************
+// trimming
+
+static dxSlabLink *MergeSlabLinks(dxSlabLink *a, dxSlabLink *b)
+{
+    dxSlabLink *head = NULL, **tail = &head;
+
+    while (a != NULL && b != NULL) {
+        if ((size_t)a < (size_t)b) {
+            *tail = a;
+            a = a->next;
+        }
+        else {
+            *tail = b;
+            b = b->next;
+        }
+        tail = &(*tail)->next;
+    }
+
+    *tail = a != NULL ? a : b;
+    return head;
+}
+
+// sorts a chain by address
+static dxSlabLink *SortSlabLinks(dxSlabLink *list)
+{
+    if (list == NULL || list->next == NULL) {
+        return list;
+    }
+
+    dxSlabLink *middle = list, *end = list->next;
+    while (end != NULL && end->next != NULL) {
+        middle = middle->next;
+        end = end->next->next;
+    }
+
+    dxSlabLink *second = middle->next;
+    middle->next = NULL;
+
+    return MergeSlabLinks(SortSlabLinks(list), SortSlabLinks(second));
+}
+
+// releases the slabs all of whose blocks are on the shared free list.
+// with both chains sorted the free blocks of each slab form one run
+static size_t TrimSlabClass(dxSlabClass *cls)
+{
+    dxSlabLink *released = NULL;
+    size_t released_count = 0;
+
+    LockSlabClass(cls);
+
+    if (cls->free_count >= cls->blocks_per_slab) {
+        const size_t span = cls->block_size * cls->blocks_per_slab;
+
+        dxSlabLink *block = SortSlabLinks(cls->free_blocks);
+        dxSlabLink *kept_blocks = NULL, **blocks_tail = &kept_blocks;
+        dxSlabLink *kept_slabs = NULL, **slabs_tail = &kept_slabs;
+
+        dxSlabLink *slab = SortSlabLinks(cls->slabs);
+        while (slab != NULL) {
+            dxSlabLink *next_slab = slab->next;
+            const char *end = (char *)slab + dxSLAB_HEADER_SIZE + span;
+
+            dxSlabLink *run = block, *run_last = NULL;
+            unsigned run_count = 0;
+            for (; block != NULL && (char *)block < end; block = block->next) {
+                dIASSERT((char *)block >= (char *)slab + dxSLAB_HEADER_SIZE);
+                run_last = block;
+                run_count++;
+            }
+
+            if (run_count == cls->blocks_per_slab) {
+                slab->next = released;
+                released = slab;
+                released_count++;
+            }
+            else {
+                if (run_count != 0) {
+                    *blocks_tail = run;
+                    blocks_tail = &run_last->next;
+                }
+                *slabs_tail = slab;
+                slabs_tail = &slab->next;
+            }
+
+            slab = next_slab;
+        }
+        dIASSERT(block == NULL);
+
+        *blocks_tail = NULL;
+        *slabs_tail = NULL;
+
+        cls->free_blocks = kept_blocks;
+        cls->slabs = kept_slabs;
+        cls->free_count -= released_count * cls->blocks_per_slab;
+        cls->slab_count -= released_count;
+        cls->slab_frees += released_count;
+    }
+
+    UnlockSlabClass(cls);
+
+    const size_t slab_bytes = SlabBytes(cls);
+    while (released != NULL) {
+        dxSlabLink *next = released->next;
+        dFree(released, slab_bytes);
+        released = next;
+    }
+
+    return released_count * slab_bytes;
+}
+
+
+//****************************************************************************
+// public API
+
+void dMemoryPoolSetEnabled(int enabled)
+{
+    g_slabPoolsEnabled = enabled != 0;
+}
+
+int dMemoryPoolIsEnabled()
+{
+    return g_slabPoolsActive ? 1 : 0;
+}
+
+int dMemoryPoolGetClassCount()
+{
+    return dxSLAB_CLASS_COUNT;
+}
+
+int dMemoryPoolGetStats(int class_index, dMemoryPoolStats *stats)
+{
+    dAASSERT(stats);
+
+    if (class_index < -1 || class_index >= dxSLAB_CLASS_COUNT) {
+        return 0;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    unsigned begin = class_index >= 0 ? (unsigned)class_index : 0;
+    unsigned end = class_index >= 0 ? (unsigned)class_index + 1 : dxSLAB_CLASS_COUNT;
+    for (unsigned index = begin; index != end; index++) {
+        dxSlabClass *cls = g_slabClasses + index;
+
+        LockSlabClass(cls);
+
+        size_t reserved = cls->slab_count * cls->blocks_per_slab * cls->block_size;
+        size_t free_bytes = cls->free_count * cls->block_size;
+        stats->slab_count += cls->slab_count;
+        stats->reserved_bytes += reserved;
+        stats->used_bytes += reserved - free_bytes;
+        stats->free_bytes += free_bytes;
+        stats->slab_allocs += cls->slab_allocs;
+        stats->slab_frees += cls->slab_frees;
+
+        UnlockSlabClass(cls);
+    }
+
+    if (class_index >= 0) {
+        stats->block_size = SlabClassBlockSize((unsigned)class_index);
+    }
+
+    return 1;
+}
+
+size_t dMemoryPoolTrim()
+{
+    if (!g_slabPoolsActive) {
+        return 0;
+    }
+
+    dxSlabThreadCache *cache = GetSlabThreadCache();
+    if (cache != NULL) {
+        FlushSlabThreadCache(cache);
+    }
+
+    size_t released = 0;
+    for (unsigned index = 0; index != dxSLAB_CLASS_COUNT; index++) {
+        released += TrimSlabClass(g_slabClasses + index);
+    }
+
+    return released;
+}
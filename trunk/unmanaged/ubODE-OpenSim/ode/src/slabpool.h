@@ -0,0 +1,54 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+size class slab pools for bodies, joints, geoms and the joint group arenas
+
+*/
+
+#ifndef _ODE_SLABPOOL_H_
+#define _ODE_SLABPOOL_H_
+
+#include <ode/common.h>
+
+
+// requests up to this many bytes are served from the pools, larger ones
+// and all of them while the pools are disabled go to dAlloc()
+#define dxSLAB_MAX_BLOCK_SIZE 16384
+
+
+struct dxSlabThreadCache;
+
+void *dSlabAlloc(size_t size);
+void dSlabFree(void *ptr, size_t size);
+
+bool dInitSlabPools();
+void dFinitSlabPools();
+
+// a per thread front for the pools, owned by the thread local storage
+// (see odetls.h). freeing it returns its blocks to the shared free lists
+dxSlabThreadCache *dAllocateSlabThreadCache();
+void dFreeSlabThreadCache(dxSlabThreadCache *cache);
+
+
+#endif // _ODE_SLABPOOL_H_
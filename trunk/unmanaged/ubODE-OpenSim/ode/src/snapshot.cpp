@@ -0,0 +1,1494 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+world snapshots
+
+a snapshot is a flat buffer in the native byte order: a header, the world
+parameters, the data objects shared by geoms, the bodies, the geoms in
+space order (a space before its geoms), the geoms attached to each body,
+and the joints. objects refer to each other by their position in the
+snapshot. the world, space and body lists are rebuilt in the saved order,
+so that every world loaded from a snapshot steps the same way.
+
+bodies and joints keep their full internal state. the joint classes hold
+no pointers after the dxJoint members, so that part is saved as bytes.
+
+*/
+
+#include <ode/common.h>
+#include <ode/objects.h>
+#include <ode/collision.h>
+#include <ode/collision_trimesh.h>
+#include <ode/misc.h>
+#include <ode/snapshot.h>
+#include "config.h"
+#include "matrix.h"
+#include "odemath.h"
+#include "objects.h"
+#include "util.h"
+#include "collision_util.h"
+#include "collision_kernel.h"
+#include "collision_std.h"
+#include "collision_space_internal.h"
+#include "collision_trimesh_internal.h"
+#include "heightfield.h"
+#include "osTerrain.h"
+#include "joints/joints.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define dSNAPSHOT_MAGIC     0x504e5364U     // "dSNP"
+#define dSNAPSHOT_VERSION   1
+
+// geom record flags
+enum {
+    dxSnapshotGeomEnabled =   1,
+    dxSnapshotGeomPlaceable = 2,
+    dxSnapshotGeomAttached =  4,    // attached to a saved body
+    dxSnapshotGeomOffset =    8     // with an offset from its body
+};
+
+// convex arrays loaded from a snapshot, in one block
+struct dxSnapshotConvexData
+{
+    size_t size;
+    unsigned int planecount;
+    unsigned int pointcount;
+};
+
+#define dxSNAPSHOT_CONVEX_ARRAYS dEFFICIENT_SIZE(sizeof(dxSnapshotConvexData))
+
+
+//****************************************************************************
+// streams. the same template code saves and loads the plain state
+
+struct dxSnapshotWriter
+{
+    enum { loading = 0 };
+
+    unsigned char *m_buffer;
+    size_t m_capacity;
+    size_t m_size;
+
+    dxSnapshotWriter(void *buffer, size_t capacity):
+        m_buffer((unsigned char *)buffer), m_capacity(capacity), m_size(0) {}
+
+    bool fits(size_t) const { return true; }
+
+    // counts everything, copies while it fits
+    void bytes(const void *data, size_t size)
+    {
+        if (m_size <= m_capacity && size <= m_capacity - m_size) {
+            memcpy(m_buffer + m_size, data, size);
+        }
+        m_size += size;
+    }
+
+    template<class T> void io(const T &value) { bytes(&value, sizeof(T)); }
+};
+
+struct dxSnapshotReader
+{
+    enum { loading = 1 };
+
+    const unsigned char *m_buffer;
+    size_t m_size;
+    size_t m_pos;
+    bool m_ok;
+
+    dxSnapshotReader(const void *buffer, size_t size):
+        m_buffer((const unsigned char *)buffer), m_size(size), m_pos(0), m_ok(true) {}
+
+    // whether size more bytes are left, fails the stream if not
+    bool fits(size_t size)
+    {
+        if (size > m_size - m_pos) {
+            m_ok = false;
+        }
+        return m_ok;
+    }
+
+    void bytes(void *data, size_t size)
+    {
+        if (fits(size)) {
+            memcpy(data, m_buffer + m_pos, size);
+            m_pos += size;
+        }
+        else {
+            memset(data, 0, size);
+        }
+    }
+
+    template<class T> void io(T &value) { bytes(&value, sizeof(T)); }
+};
+
+template<class Stream>
+static void ioWorld(Stream &s, dxWorld *w)
+{
+    s.io(w->gravity);
+    s.io(w->global_erp);
+    s.io(w->global_cfm);
+    s.io(w->adis);
+    s.io(w->body_flags);
+    s.io(w->qs);
+    s.io(w->contactp);
+    s.io(w->dampingp);
+    s.io(w->max_angular_speed);
+    s.io(w->movedp);
+    s.io(w->adis_islands);
+    s.io(w->deterministic);
+}
+
+// returns false if the average buffers do not fit
+template<class Stream>
+static bool ioBody(Stream &s, dxBody *b)
+{
+    s.io(b->flags);
+    s.io(b->mass);
+    s.io(b->invI);
+    s.io(b->invMass);
+    s.io(b->posr);
+    s.io(b->q);
+    s.io(b->lvel);
+    s.io(b->avel);
+    s.io(b->facc);
+    s.io(b->tacc);
+    s.io(b->finite_rot_axis);
+    s.io(b->adis_timeleft);
+    s.io(b->adis_stepsleft);
+    s.io(b->dampingp);
+    s.io(b->max_angular_speed);
+    s.io(b->ccd_radius);
+    s.io(b->ccd_threshold);
+    s.io(b->ccd_pos);
+    s.io(b->reported_pos);
+    s.io(b->reported_q);
+    s.io(b->reported_lvel);
+    s.io(b->reported_avel);
+
+    // the average buffers are sized by the auto-disable parameters
+    s.io(b->adis);
+    const size_t bufferSize = (size_t)b->adis.average_samples * sizeof(dVector3);
+    if (!s.fits(2 * bufferSize)) {
+        return false;
+    }
+    if (Stream::loading) {
+        dBodySetAutoDisableAverageSamplesCount(b, b->adis.average_samples);
+    }
+    s.io(b->average_counter);
+    s.io(b->average_ready);
+    if (bufferSize != 0) {
+        s.bytes(b->average_lvel_buffer, bufferSize);
+        s.bytes(b->average_avel_buffer, bufferSize);
+    }
+    return true;
+}
+
+// the part of a joint after the dxJoint members
+static void getJointState(dxJoint *j, unsigned char **state, size_t *size)
+{
+    *state = (unsigned char *)(j->lambda + 6);
+    *size = (size_t)((unsigned char *)j + j->size() - *state);
+}
+
+
+//****************************************************************************
+// pointer to index tables, sorted by pointer
+
+struct dxSnapshotIndexEntry
+{
+    size_t ptr;
+    int index;
+};
+
+static int compareIndexEntries(const void *a, const void *b)
+{
+    size_t x = ((const dxSnapshotIndexEntry *)a)->ptr;
+    size_t y = ((const dxSnapshotIndexEntry *)b)->ptr;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void sortIndex(dArray<dxSnapshotIndexEntry> &table)
+{
+    qsort(table.data(), table.size(), sizeof(dxSnapshotIndexEntry), &compareIndexEntries);
+}
+
+static int findIndex(const dArray<dxSnapshotIndexEntry> &table, const void *ptr)
+{
+    dxSnapshotIndexEntry key = { (size_t)ptr, -1 };
+    const dxSnapshotIndexEntry *found = (const dxSnapshotIndexEntry *)
+        bsearch(&key, table.data(), table.size(), sizeof(key), &compareIndexEntries);
+    return found != NULL ? found->index : -1;
+}
+
+
+//****************************************************************************
+// geom classes
+
+static bool isSnapshotGeom(const dxGeom *g)
+{
+    return g->type < dFirstUserClass && g->type != dGeomTransformClass;
+}
+
+// the data object a geom shares with others, NULL if none
+static void *getGeomData(dxGeom *g)
+{
+    switch (g->type) {
+        case dConvexClass: return ((dxConvex *)g)->planes;
+        case dTriMeshClass: return ((dxTriMesh *)g)->Data;
+        case dHeightfieldClass: return ((dxHeightfield *)g)->m_p_data;
+        case dOSTerrainClass: return ((dxOSTerrain *)g)->m_p_data;
+    }
+    return NULL;
+}
+
+static int getGeomDataKind(int type)
+{
+    switch (type) {
+        case dConvexClass: return dSnapshotRefConvexData;
+        case dTriMeshClass: return dSnapshotRefTriMeshData;
+        case dHeightfieldClass: return dSnapshotRefHeightfieldData;
+        case dOSTerrainClass: return dSnapshotRefOSTerrainData;
+    }
+    return -1;
+}
+
+// trimesh temporal coherence classes, see dGeomTriMeshEnableTC
+static const int snapshotTCClasses[] = {
+    dSphereClass, dBoxClass, dCapsuleClass, dTriMeshClass, dOSTerrainClass
+};
+
+#define dxSNAPSHOT_TC_CLASSES ((int)(sizeof(snapshotTCClasses) / sizeof(snapshotTCClasses[0])))
+
+static dxJoint *createSnapshotJoint(dxWorld *w, int type)
+{
+    switch (type) {
+        case dJointTypeBall: return dJointCreateBall(w, 0);
+        case dJointTypeHinge: return dJointCreateHinge(w, 0);
+        case dJointTypeSlider: return dJointCreateSlider(w, 0);
+        case dJointTypeUniversal: return dJointCreateUniversal(w, 0);
+        case dJointTypeHinge2: return dJointCreateHinge2(w, 0);
+        case dJointTypeFixed: return dJointCreateFixed(w, 0);
+        case dJointTypeNull: return dJointCreateNull(w, 0);
+        case dJointTypeAMotor: return dJointCreateAMotor(w, 0);
+        case dJointTypeLMotor: return dJointCreateLMotor(w, 0);
+        case dJointTypePlane2D: return dJointCreatePlane2D(w, 0);
+        case dJointTypePR: return dJointCreatePR(w, 0);
+        case dJointTypePU: return dJointCreatePU(w, 0);
+        case dJointTypePiston: return dJointCreatePiston(w, 0);
+        case dJointTypeDBall: return dJointCreateDBall(w, 0);
+        case dJointTypeDHinge: return dJointCreateDHinge(w, 0);
+        case dJointTypeTransmission: return dJointCreateTransmission(w, 0);
+    }
+    return NULL;
+}
+
+
+//****************************************************************************
+// saving
+
+struct dxSnapshotSaveContext
+{
+    dxWorld *world;
+    const dSnapshotCallbacks *callbacks;
+    int flags;
+    dArray<dxGeom *> geoms;
+    dArray<dxSnapshotIndexEntry> geomIndex;
+    dArray<dxGeom *> dataGeoms;     // a geom of each data object
+    dArray<dxSnapshotIndexEntry> dataIndex;
+
+    duint64 ref(int kind, void *object) const
+    {
+        if (object == NULL || callbacks == NULL || callbacks->save_ref == NULL) {
+            return 0;
+        }
+        return callbacks->save_ref(callbacks->context, kind, object);
+    }
+};
+
+static void collectSpaceGeoms(dxSnapshotSaveContext &ctx, dxSpace *space)
+{
+    const int count = space->getNumGeoms();
+    for (int i = 0; i < count; i++) {
+        dxGeom *g = space->getGeom(i);
+        if (isSnapshotGeom(g)) {
+            ctx.geoms.push(g);
+            if (IS_SPACE(g)) {
+                collectSpaceGeoms(ctx, (dxSpace *)g);
+            }
+        }
+    }
+}
+
+static void buildGeomIndex(dxSnapshotSaveContext &ctx)
+{
+    const int count = ctx.geoms.size();
+    ctx.geomIndex.setSize(count);
+    for (int i = 0; i < count; i++) {
+        ctx.geomIndex[i].ptr = (size_t)ctx.geoms[i];
+        ctx.geomIndex[i].index = i;
+    }
+    sortIndex(ctx.geomIndex);
+}
+
+// one entry per distinct data object
+static void buildDataIndex(dxSnapshotSaveContext &ctx)
+{
+    dArray<dxSnapshotIndexEntry> all;
+    for (int i = 0; i < ctx.geoms.size(); i++) {
+        void *data = getGeomData(ctx.geoms[i]);
+        if (data != NULL) {
+            dxSnapshotIndexEntry entry = { (size_t)data, i };
+            all.push(entry);
+        }
+    }
+    sortIndex(all);
+
+    for (int i = 0; i < all.size(); i++) {
+        if (i == 0 || all[i].ptr != all[i - 1].ptr) {
+            dxSnapshotIndexEntry entry = { all[i].ptr, ctx.dataGeoms.size() };
+            ctx.dataIndex.push(entry);
+            ctx.dataGeoms.push(ctx.geoms[all[i].index]);
+        }
+    }
+}
+
+static void saveTriMeshData(dxSnapshotWriter &s, const dxTriMeshData *data)
+{
+    const duint32 vertexCount = data->Mesh.GetNbVertices();
+    const duint32 triangleCount = data->Mesh.GetNbTriangles();
+    s.io(vertexCount);
+    s.io(triangleCount);
+
+    const Point *vertices = data->Mesh.GetVerts();
+    for (duint32 i = 0; i < vertexCount; i++) {
+        dReal vertex[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+        s.io(vertex);
+    }
+    const IndexedTriangle *triangles = data->Mesh.GetTris();
+    for (duint32 i = 0; i < triangleCount; i++) {
+        dTriIndex triangle[3] = {
+            (dTriIndex)triangles[i].mVRef[0], (dTriIndex)triangles[i].mVRef[1], (dTriIndex)triangles[i].mVRef[2]
+        };
+        s.io(triangle);
+    }
+
+    // the built tree, so that the load does not build it again
+    int serializedSize = data->GetSerializedSize();
+    void *serialized = serializedSize != 0 ? dAlloc(serializedSize) : NULL;
+    if (serialized != NULL && data->Serialize(serialized, serializedSize) != serializedSize) {
+        dFree(serialized, serializedSize);
+        serialized = NULL;
+    }
+    if (serialized == NULL) {
+        serializedSize = 0;
+    }
+    s.io(serializedSize);
+    if (serialized != NULL) {
+        s.bytes(serialized, serializedSize);
+        dFree(serialized, serializedSize);
+    }
+}
+
+static void saveOSTerrainData(dxSnapshotWriter &s, const dxOSTerrainData *data)
+{
+    s.io(data->m_nWidthSamples);
+    s.io(data->m_nDepthSamples);
+    s.io(data->m_fThickness);
+    s.io(data->m_fMinHeight);
+    s.io(data->m_fMaxHeight);
+    s.io(data->m_bQuantized);
+    s.io(data->m_bBuildPlanes);
+    for (int y = 0; y < data->m_nDepthSamples; y++) {
+        for (int x = 0; x < data->m_nWidthSamples; x++) {
+            float height = data->GetSample(x, y);
+            s.io(height);
+        }
+    }
+}
+
+static void saveConvexData(dxSnapshotWriter &s, const dxConvex *convex)
+{
+    duint32 polygonSize = 0;
+    for (unsigned int i = 0; i < convex->planecount; i++) {
+        polygonSize += 1 + convex->polygons[polygonSize];
+    }
+
+    const duint32 planeCount = convex->planecount, pointCount = convex->pointcount;
+    s.io(planeCount);
+    s.io(pointCount);
+    s.io(polygonSize);
+    s.bytes(convex->planes, (size_t)planeCount * 4 * sizeof(dReal));
+    s.bytes(convex->points, (size_t)pointCount * 3 * sizeof(dReal));
+    s.bytes(convex->polygons, (size_t)polygonSize * sizeof(unsigned int));
+}
+
+static void saveData(dxSnapshotWriter &s, const dxSnapshotSaveContext &ctx, dxGeom *g)
+{
+    int kind = getGeomDataKind(g->type);
+    int embedded = kind == dSnapshotRefConvexData
+        || ((ctx.flags & dSnapshotEmbedData) != 0
+            && (kind == dSnapshotRefTriMeshData || kind == dSnapshotRefOSTerrainData));
+    s.io(kind);
+    s.io(embedded);
+
+    if (!embedded) {
+        duint64 id = ctx.ref(kind, getGeomData(g));
+        s.io(id);
+    }
+    else if (kind == dSnapshotRefTriMeshData) {
+        saveTriMeshData(s, ((dxTriMesh *)g)->Data);
+    }
+    else if (kind == dSnapshotRefOSTerrainData) {
+        saveOSTerrainData(s, ((dxOSTerrain *)g)->m_p_data);
+    }
+    else {
+        saveConvexData(s, (dxConvex *)g);
+    }
+}
+
+static void saveGeom(dxSnapshotWriter &s, const dxSnapshotSaveContext &ctx, dxGeom *g)
+{
+    int type = g->type;
+    int parent = g->parent_space != NULL ? findIndex(ctx.geomIndex, g->parent_space) : -1;
+    int flags = 0;
+    if (g->gflags & GEOM_ENABLED) flags |= dxSnapshotGeomEnabled;
+    if (g->gflags & GEOM_PLACEABLE) flags |= dxSnapshotGeomPlaceable;
+    if (g->body != NULL && g->body->world == ctx.world) {
+        flags |= dxSnapshotGeomAttached;
+        if (g->offset_posr != NULL) flags |= dxSnapshotGeomOffset;
+    }
+    duint64 category = g->category_bits, collide = g->collide_bits;
+    duint64 data = ctx.ref(dSnapshotRefGeomData, g->data);
+
+    s.io(type);
+    s.io(parent);
+    s.io(flags);
+    s.io(category);
+    s.io(collide);
+    s.io(data);
+
+    if (flags & dxSnapshotGeomOffset) {
+        s.io(g->offset_posr->pos);
+        s.io(g->offset_posr->R);
+    }
+    else if ((flags & (dxSnapshotGeomPlaceable | dxSnapshotGeomAttached)) == dxSnapshotGeomPlaceable) {
+        g->recomputePosr();
+        s.io(g->final_posr->pos);
+        s.io(g->final_posr->R);
+    }
+
+    void *object = getGeomData(g);
+    if (object != NULL) {
+        int dataIndex = findIndex(ctx.dataIndex, object);
+        s.io(dataIndex);
+    }
+
+    switch (type) {
+        case dSphereClass:
+            s.io(((dxSphere *)g)->radius);
+            break;
+
+        case dBoxClass:
+            s.io(((dxBox *)g)->halfside);
+            break;
+
+        case dCapsuleClass:
+            s.io(((dxCapsule *)g)->radius);
+            s.io(((dxCapsule *)g)->halfLenZ);
+            break;
+
+        case dCylinderClass:
+            s.io(((dxCylinder *)g)->radius);
+            s.io(((dxCylinder *)g)->lz);
+            break;
+
+        case dPlaneClass:
+            s.io(((dxPlane *)g)->p);
+            break;
+
+        case dRayClass: {
+            int rayFlags[3] = { dGeomRayGetFirstContact(g), dGeomRayGetBackfaceCull(g), dGeomRayGetClosestHit(g) };
+            s.io(((dxRay *)g)->length);
+            s.io(rayFlags);
+            break;
+        }
+
+        case dTriMeshClass: {
+            int tc[dxSNAPSHOT_TC_CLASSES];
+            for (int i = 0; i < dxSNAPSHOT_TC_CLASSES; i++) {
+                tc[i] = dGeomTriMeshIsTCEnabled(g, snapshotTCClasses[i]);
+            }
+            s.io(tc);
+            break;
+        }
+    }
+
+    if (IS_SPACE(g)) {
+        dxSpace *space = (dxSpace *)g;
+        int manualCleanup = space->getManualCleanup();
+        s.io(space->cleanup);
+        s.io(space->sublevel);
+        s.io(manualCleanup);
+
+        if (type == dHashSpaceClass) {
+            int levels[2];
+            dHashSpaceGetLevels(space, levels, levels + 1);
+            s.io(levels);
+        }
+        else if (type == dQuadTreeSpaceClass) {
+            dVector3 center = { 0, 0, 0, 0 }, extents = { 0, 0, 0, 0 };
+            int depth;
+            dxQuadTreeSpaceGetParams(space, center, extents, &depth);
+            s.io(center);
+            s.io(extents);
+            s.io(depth);
+        }
+        else if (type == dSweepAndPruneSpaceClass) {
+            int sap[2] = { dxSAPSpaceGetAxisOrder(space), dxSAPSpaceGetDirtyCount(space) };
+            s.io(sap);
+        }
+    }
+}
+
+static void saveJoint(dxSnapshotWriter &s, const dxSnapshotSaveContext &ctx, dxJoint *j)
+{
+    int type = j->type();
+    unsigned flags = j->flags & ~dJOINT_INGROUP;
+    int body0 = j->node[0].body != NULL ? j->node[0].body->tag : -1;
+    int body1 = j->node[1].body != NULL ? j->node[1].body->tag : -1;
+    duint64 data = ctx.ref(dSnapshotRefJointData, j->userdata);
+
+    unsigned char *state;
+    size_t stateSize;
+    getJointState(j, &state, &stateSize);
+    duint32 size = (duint32)stateSize;
+
+    s.io(type);
+    s.io(flags);
+    s.io(body0);
+    s.io(body1);
+    s.io(j->lambda);
+    s.io(data);
+    s.io(size);
+    s.bytes(state, stateSize);
+}
+
+size_t dWorldSnapshotSave (dWorldID w, dSpaceID space,
+                           const dSnapshotReplayInfo *replay,
+                           const dSnapshotCallbacks *callbacks, int flags,
+                           void *buffer, size_t capacity)
+{
+    dAASSERT (w);
+    dUASSERT (buffer != NULL || capacity == 0, "bad buffer argument");
+    dUASSERT (space == NULL || IS_SPACE(space), "argument not a space");
+
+    dxSnapshotSaveContext ctx;
+    ctx.world = w;
+    ctx.callbacks = callbacks;
+    ctx.flags = flags;
+
+    // bodies and joints are referred to by their position in the world
+    // lists, kept in the tags. the tags are only used within a step
+    int bodyCount = 0, jointCount = 0;
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        b->tag = bodyCount++;
+    }
+    for (dxJoint *j = w->firstjoint; j; j = (dxJoint *)j->next) {
+        j->tag = j->type() != dJointTypeContact ? jointCount++ : -1;
+    }
+
+    // the space tree first, then the body geoms left out of it
+    if (space != NULL) {
+        ctx.geoms.push(space);
+        collectSpaceGeoms(ctx, space);
+    }
+    buildGeomIndex(ctx);
+    const int spaceGeomCount = ctx.geoms.size();
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        for (dxGeom *g = b->geom; g; g = g->body_next) {
+            if (isSnapshotGeom(g) && findIndex(ctx.geomIndex, g) < 0) {
+                ctx.geoms.push(g);
+            }
+        }
+    }
+    if (ctx.geoms.size() != spaceGeomCount) {
+        buildGeomIndex(ctx);
+    }
+    buildDataIndex(ctx);
+
+    dxSnapshotWriter s(buffer, capacity);
+
+    duint32 header[4] = { dSNAPSHOT_MAGIC, dSNAPSHOT_VERSION, (duint32)sizeof(dReal), (duint32)flags };
+    int hasSpace = space != NULL;
+    s.io(header);
+    s.io(hasSpace);
+
+    dSnapshotReplayInfo info;
+    if (replay != NULL) {
+        info = *replay;
+    }
+    else {
+        memset(&info, 0, sizeof(info));
+    }
+    info.rand_seed = dRandGetSeed();
+    s.io(info);
+
+    ioWorld(s, w);
+
+    int dataCount = ctx.dataGeoms.size();
+    s.io(dataCount);
+    for (int i = 0; i < dataCount; i++) {
+        saveData(s, ctx, ctx.dataGeoms[i]);
+    }
+
+    s.io(bodyCount);
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        ioBody(s, b);
+        duint64 data = ctx.ref(dSnapshotRefBodyData, b->userdata);
+        int islandNext = b->adis_island_next != NULL ? b->adis_island_next->tag : -1;
+        s.io(data);
+        s.io(islandNext);
+    }
+
+    int geomCount = ctx.geoms.size();
+    s.io(geomCount);
+    for (int i = 0; i < geomCount; i++) {
+        saveGeom(s, ctx, ctx.geoms[i]);
+    }
+
+    // the geoms of each body, in the order of the body's list
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        int count = 0;
+        for (dxGeom *g = b->geom; g; g = g->body_next) {
+            if (findIndex(ctx.geomIndex, g) >= 0) count++;
+        }
+        s.io(count);
+        for (dxGeom *g = b->geom; g; g = g->body_next) {
+            int index = findIndex(ctx.geomIndex, g);
+            if (index >= 0) s.io(index);
+        }
+    }
+
+    s.io(jointCount);
+    for (dxJoint *j = w->firstjoint; j; j = (dxJoint *)j->next) {
+        if (j->tag >= 0) {
+            saveJoint(s, ctx, j);
+        }
+    }
+
+    // the joints of each body, in the order of the body's list. it sets the
+    // order of the rows of an island
+    for (dxBody *b = w->firstbody; b; b = (dxBody *)b->next) {
+        int count = 0;
+        for (dxJointNode *n = b->firstjoint; n; n = n->next) {
+            if (n->joint->tag >= 0) count++;
+        }
+        s.io(count);
+        for (dxJointNode *n = b->firstjoint; n; n = n->next) {
+            if (n->joint->tag >= 0) s.io(n->joint->tag);
+        }
+    }
+
+    return s.m_size;
+}
+
+
+//****************************************************************************
+// loading
+
+struct dxSnapshotLoadContext
+{
+    const dSnapshotCallbacks *callbacks;
+    dxWorld *world;
+    dArray<dxBody *> bodies;
+    dArray<dxGeom *> geoms;         // NULL for geoms left out
+    dArray<int> geomFlags;
+    dArray<dxPosR> geomOffsets;
+    dArray<void *> data;            // NULL for objects not found
+    dArray<int> dataKinds;
+    dArray<int> dataOwned;          // created by the load
+
+    void *ref(int kind, duint64 id) const
+    {
+        if (id == 0 || callbacks == NULL || callbacks->load_ref == NULL) {
+            return NULL;
+        }
+        return callbacks->load_ref(callbacks->context, kind, id);
+    }
+};
+
+// an empty mesh loads as no data
+static bool loadTriMeshData(dxSnapshotReader &s, void **object)
+{
+    duint32 vertexCount, triangleCount;
+    s.io(vertexCount);
+    s.io(triangleCount);
+
+    const size_t vertexBytes = (size_t)vertexCount * 3 * sizeof(dReal);
+    const size_t indexBytes = (size_t)triangleCount * 3 * sizeof(dTriIndex);
+    if (!s.fits(vertexBytes) || !s.fits(vertexBytes + indexBytes)) {
+        return false;
+    }
+
+    dReal *vertices = (dReal *)dAlloc(vertexBytes + sizeof(dReal));
+    dTriIndex *indices = (dTriIndex *)dAlloc(indexBytes + sizeof(dTriIndex));
+    s.bytes(vertices, vertexBytes);
+    s.bytes(indices, indexBytes);
+
+    bool valid = true;
+    for (size_t i = 0; i < (size_t)triangleCount * 3; i++) {
+        if (indices[i] >= vertexCount) valid = false;
+    }
+
+    int serializedSize;
+    s.io(serializedSize);
+    valid = valid && serializedSize >= 0 && s.fits(serializedSize);
+
+    if (valid) {
+        void *serialized = serializedSize != 0 ? dAlloc(serializedSize) : NULL;
+        s.bytes(serialized, serializedSize);
+        if (vertexCount != 0 && triangleCount != 0) {
+            *object = dGeomTriMeshDataCreateShared(vertices, (int)vertexCount,
+                indices, (int)triangleCount * 3, serialized, serializedSize);
+        }
+        if (serialized != NULL) {
+            dFree(serialized, serializedSize);
+        }
+    }
+
+    dFree(indices, indexBytes + sizeof(dTriIndex));
+    dFree(vertices, vertexBytes + sizeof(dReal));
+    return valid;
+}
+
+static bool loadOSTerrainData(dxSnapshotReader &s, void **object)
+{
+    int width, depth, quantized, buildPlanes;
+    dReal thickness, minHeight, maxHeight;
+    s.io(width);
+    s.io(depth);
+    s.io(thickness);
+    s.io(minHeight);
+    s.io(maxHeight);
+    s.io(quantized);
+    s.io(buildPlanes);
+
+    if (width < 2 || depth < 2) {
+        return false;
+    }
+    const size_t bytes = (size_t)width * (size_t)depth * sizeof(float);
+    if (!s.fits(bytes)) {
+        return false;
+    }
+
+    float *heights = (float *)dAlloc(bytes);
+    s.bytes(heights, bytes);
+
+    dOSTerrainDataID data = dGeomOSTerrainDataCreate();
+    dGeomOSTerrainDataSetQuantized(data, quantized);
+    dGeomOSTerrainDataSetBuildPlanes(data, buildPlanes);
+    dGeomOSTerrainDataBuild(data, heights, 1, REAL(1.0), width, depth, thickness, 0);
+    dGeomOSTerrainDataSetBounds(data, minHeight, maxHeight);
+
+    dFree(heights, bytes);
+    *object = data;
+    return true;
+}
+
+static bool loadConvexData(dxSnapshotReader &s, void **object)
+{
+    duint32 planeCount, pointCount, polygonSize;
+    s.io(planeCount);
+    s.io(pointCount);
+    s.io(polygonSize);
+
+    const size_t planeBytes = (size_t)planeCount * 4 * sizeof(dReal);
+    const size_t pointBytes = (size_t)pointCount * 3 * sizeof(dReal);
+    const size_t polygonBytes = (size_t)polygonSize * sizeof(unsigned int);
+    if (!s.fits(planeBytes) || !s.fits(planeBytes + pointBytes)
+        || !s.fits(planeBytes + pointBytes + polygonBytes)) {
+        return false;
+    }
+
+    const size_t size = dxSNAPSHOT_CONVEX_ARRAYS + planeBytes + pointBytes + polygonBytes;
+    dxSnapshotConvexData *block = (dxSnapshotConvexData *)dAlloc(size);
+    block->size = size;
+    block->planecount = planeCount;
+    block->pointcount = pointCount;
+    dReal *planes = (dReal *)((unsigned char *)block + dxSNAPSHOT_CONVEX_ARRAYS);
+    dReal *points = planes + (size_t)planeCount * 4;
+    unsigned int *polygons = (unsigned int *)(points + (size_t)pointCount * 3);
+    s.bytes(planes, planeBytes);
+    s.bytes(points, pointBytes);
+    s.bytes(polygons, polygonBytes);
+
+    // every polygon must lie within the array and refer to the points
+    duint32 pos = 0;
+    bool valid = true;
+    for (duint32 i = 0; i < planeCount && valid; i++) {
+        if (pos >= polygonSize || polygons[pos] < 3 || polygons[pos] > polygonSize - pos - 1) {
+            valid = false;
+            break;
+        }
+        for (duint32 k = 1; k <= polygons[pos]; k++) {
+            if (polygons[pos + k] >= pointCount) valid = false;
+        }
+        pos += 1 + polygons[pos];
+    }
+    if (!valid || pos != polygonSize) {
+        dFree(block, size);
+        return false;
+    }
+
+    *object = block;
+    return true;
+}
+
+static bool loadData(dxSnapshotReader &s, dxSnapshotLoadContext &ctx)
+{
+    int kind, embedded;
+    s.io(kind);
+    s.io(embedded);
+    if (!s.m_ok || kind < dSnapshotRefTriMeshData || kind > dSnapshotRefConvexData) {
+        return false;
+    }
+
+    void *object = NULL;
+    bool valid;
+    if (!embedded) {
+        duint64 id;
+        s.io(id);
+        object = kind != dSnapshotRefConvexData ? ctx.ref(kind, id) : NULL;
+        valid = s.m_ok;
+    }
+    else if (kind == dSnapshotRefTriMeshData) {
+        valid = loadTriMeshData(s, &object);
+    }
+    else if (kind == dSnapshotRefOSTerrainData) {
+        valid = loadOSTerrainData(s, &object);
+    }
+    else if (kind == dSnapshotRefConvexData) {
+        valid = loadConvexData(s, &object);
+    }
+    else {
+        valid = false;
+    }
+
+    if (object != NULL && embedded && !valid) {
+        dSnapshotDataDestroy(kind, object);
+        object = NULL;
+    }
+    ctx.data.push(object);
+    ctx.dataKinds.push(kind);
+    ctx.dataOwned.push(object != NULL && embedded);
+    return valid;
+}
+
+// the data object of a geom record, sets found to false if it is missing
+static bool loadGeomData(dxSnapshotReader &s, const dxSnapshotLoadContext &ctx,
+    int type, void **object)
+{
+    int dataIndex;
+    s.io(dataIndex);
+    if (!s.m_ok || dataIndex < 0 || dataIndex >= ctx.data.size()
+        || ctx.dataKinds[dataIndex] != getGeomDataKind(type)) {
+        return false;
+    }
+    *object = ctx.data[dataIndex];
+    return true;
+}
+
+static bool loadGeom(dxSnapshotReader &s, dxSnapshotLoadContext &ctx, int index, int *parent,
+    int *sapDirty)
+{
+    int type, flags;
+    duint64 category, collide, data;
+    s.io(type);
+    s.io(*parent);
+    s.io(flags);
+    s.io(category);
+    s.io(collide);
+    s.io(data);
+    if (!s.m_ok || *parent < -1 || *parent >= index
+        || (*parent >= 0 && (ctx.geoms[*parent] == NULL || !IS_SPACE(ctx.geoms[*parent])))) {
+        return false;
+    }
+
+    dxPosR posr;
+    bool hasPosr = false;
+    if ((flags & dxSnapshotGeomOffset)
+        || (flags & (dxSnapshotGeomPlaceable | dxSnapshotGeomAttached)) == dxSnapshotGeomPlaceable) {
+        s.io(posr.pos);
+        s.io(posr.R);
+        hasPosr = true;
+    }
+
+    void *object = NULL;
+    if (getGeomDataKind(type) >= 0 && !loadGeomData(s, ctx, type, &object)) {
+        return false;
+    }
+
+    dxGeom *g = NULL;
+    switch (type) {
+        case dSphereClass: {
+            dReal radius;
+            s.io(radius);
+            g = dCreateSphere(0, radius);
+            break;
+        }
+
+        case dBoxClass: {
+            dVector3 halfside;
+            s.io(halfside);
+            g = dCreateBox(0, 2 * halfside[0], 2 * halfside[1], 2 * halfside[2]);
+            break;
+        }
+
+        case dCapsuleClass: {
+            dReal radius, halfLength;
+            s.io(radius);
+            s.io(halfLength);
+            g = dCreateCapsule(0, radius, 2 * halfLength);
+            break;
+        }
+
+        case dCylinderClass: {
+            dReal radius, length;
+            s.io(radius);
+            s.io(length);
+            g = dCreateCylinder(0, radius, length);
+            break;
+        }
+
+        case dPlaneClass: {
+            dReal p[4];
+            s.io(p);
+            g = dCreatePlane(0, p[0], p[1], p[2], p[3]);
+            // as saved, not normalized again
+            memcpy(((dxPlane *)g)->p, p, sizeof(p));
+            break;
+        }
+
+        case dRayClass: {
+            dReal length;
+            int rayFlags[3];
+            s.io(length);
+            s.io(rayFlags);
+            g = dCreateRay(0, length);
+            dGeomRaySetFirstContact(g, rayFlags[0]);
+            dGeomRaySetBackfaceCull(g, rayFlags[1]);
+            dGeomRaySetClosestHit(g, rayFlags[2]);
+            break;
+        }
+
+        case dConvexClass:
+            if (object != NULL) {
+                dxSnapshotConvexData *block = (dxSnapshotConvexData *)object;
+                dReal *planes = (dReal *)((unsigned char *)block + dxSNAPSHOT_CONVEX_ARRAYS);
+                dReal *points = planes + (size_t)block->planecount * 4;
+                unsigned int *polygons = (unsigned int *)(points + (size_t)block->pointcount * 3);
+                g = dCreateConvex(0, planes, block->planecount, points, block->pointcount, polygons);
+            }
+            break;
+
+        case dTriMeshClass: {
+            int tc[dxSNAPSHOT_TC_CLASSES];
+            s.io(tc);
+            if (object != NULL) {
+                g = dCreateTriMesh(0, (dTriMeshDataID)object, NULL, NULL, NULL);
+                for (int i = 0; i < dxSNAPSHOT_TC_CLASSES; i++) {
+                    dGeomTriMeshEnableTC(g, snapshotTCClasses[i], tc[i]);
+                }
+            }
+            break;
+        }
+
+        case dHeightfieldClass:
+            if (object != NULL) {
+                g = dCreateHeightfield(0, (dHeightfieldDataID)object, (flags & dxSnapshotGeomPlaceable) != 0);
+            }
+            break;
+
+        case dOSTerrainClass:
+            if (object != NULL) {
+                g = dCreateOSTerrain(0, (dOSTerrainDataID)object, (flags & dxSnapshotGeomPlaceable) != 0);
+            }
+            break;
+
+        case dSimpleSpaceClass:
+        case dHashSpaceClass:
+        case dSweepAndPruneSpaceClass:
+        case dQuadTreeSpaceClass: {
+            int cleanup, sublevel, manualCleanup;
+            s.io(cleanup);
+            s.io(sublevel);
+            s.io(manualCleanup);
+
+            dxSpace *space;
+            if (type == dSimpleSpaceClass) {
+                space = dSimpleSpaceCreate(0);
+            }
+            else if (type == dHashSpaceClass) {
+                int levels[2];
+                s.io(levels);
+                space = dHashSpaceCreate(0);
+                dHashSpaceSetLevels(space, levels[0], levels[1]);
+            }
+            else if (type == dQuadTreeSpaceClass) {
+                dVector3 center, extents;
+                int depth;
+                s.io(center);
+                s.io(extents);
+                s.io(depth);
+                if (depth < 0 || depth > 12) {
+                    return false;
+                }
+                space = dQuadTreeSpaceCreate(0, center, extents, depth);
+            }
+            else {
+                int sap[2];
+                s.io(sap);
+                space = dSweepAndPruneSpaceCreate(0, sap[0]);
+                *sapDirty = sap[1];
+            }
+            space->setCleanup(cleanup);
+            space->setSublevel(sublevel);
+            space->setManulCleanup(manualCleanup);
+            g = space;
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    ctx.geoms.push(g);
+    ctx.geomFlags.push(flags);
+    ctx.geomOffsets.push(posr);
+    if (g == NULL) {
+        return s.m_ok;
+    }
+
+    g->category_bits = (unsigned long)category;
+    g->collide_bits = (unsigned long)collide;
+    g->data = ctx.ref(dSnapshotRefGeomData, data);
+    if ((flags & dxSnapshotGeomEnabled) == 0) {
+        dGeomDisable(g);
+    }
+    if (hasPosr && (flags & dxSnapshotGeomOffset) == 0) {
+        dGeomSetPosition(g, posr.pos[0], posr.pos[1], posr.pos[2]);
+        dGeomSetRotation(g, posr.R);
+    }
+    return s.m_ok;
+}
+
+static bool loadBodyGeoms(dxSnapshotReader &s, dxSnapshotLoadContext &ctx, dxBody *b)
+{
+    int count;
+    s.io(count);
+    if (!s.m_ok || count < 0 || !s.fits((size_t)count * sizeof(int))) {
+        return false;
+    }
+
+    dArray<int> indices;
+    indices.setSize(count);
+    for (int i = 0; i < count; i++) {
+        s.io(indices[i]);
+        if (indices[i] < 0 || indices[i] >= ctx.geoms.size()
+            || (ctx.geomFlags[indices[i]] & dxSnapshotGeomAttached) == 0) {
+            return false;
+        }
+    }
+
+    // the body list grows at the head
+    for (int i = count - 1; i >= 0; i--) {
+        const int index = indices[i];
+        dxGeom *g = ctx.geoms[index];
+        if (g == NULL) {
+            continue;
+        }
+        if (g->body != NULL) {
+            return false;
+        }
+        dGeomSetBody(g, b);
+        if (ctx.geomFlags[index] & dxSnapshotGeomOffset) {
+            const dxPosR &offset = ctx.geomOffsets[index];
+            dGeomSetOffsetPosition(g, offset.pos[0], offset.pos[1], offset.pos[2]);
+            dGeomSetOffsetRotation(g, offset.R);
+        }
+    }
+    return true;
+}
+
+static bool loadJoint(dxSnapshotReader &s, dxSnapshotLoadContext &ctx, dArray<dxJoint *> &joints)
+{
+    int type, body0, body1;
+    unsigned flags;
+    dReal lambda[6];
+    duint64 data;
+    duint32 size;
+    s.io(type);
+    s.io(flags);
+    s.io(body0);
+    s.io(body1);
+    s.io(lambda);
+    s.io(data);
+    s.io(size);
+
+    const int bodyCount = ctx.bodies.size();
+    if (!s.m_ok || body0 < -1 || body0 >= bodyCount || body1 < -1 || body1 >= bodyCount
+        || (body0 < 0 && body1 >= 0)) {
+        return false;
+    }
+
+    dxJoint *j = createSnapshotJoint(ctx.world, type);
+    if (j == NULL) {
+        return false;
+    }
+    joints.push(j);
+
+    unsigned char *state;
+    size_t stateSize;
+    getJointState(j, &state, &stateSize);
+    if (size != stateSize || !s.fits(stateSize)) {
+        return false;
+    }
+
+    dJointAttach(j, body0 >= 0 ? ctx.bodies[body0] : NULL, body1 >= 0 ? ctx.bodies[body1] : NULL);
+    j->flags = flags & ~dJOINT_INGROUP;
+    memcpy(j->lambda, lambda, sizeof(lambda));
+    j->userdata = ctx.ref(dSnapshotRefJointData, data);
+    s.bytes(state, stateSize);
+    return true;
+}
+
+// relinks the joint list of a body in the saved order
+static bool loadBodyJoints(dxSnapshotReader &s, const dArray<dxJoint *> &joints, dxBody *b)
+{
+    int count;
+    s.io(count);
+    if (!s.m_ok || count < 0 || !s.fits((size_t)count * sizeof(int))) {
+        return false;
+    }
+
+    int listed = 0;
+    for (dxJointNode *n = b->firstjoint; n; n = n->next) {
+        listed++;
+    }
+    if (count != listed) {
+        return false;
+    }
+
+    // the node of a body is the one naming the other body. every node of
+    // the list must be named once before the list is touched
+    dArray<dxJointNode *> nodes;
+    nodes.setSize(count);
+    for (int i = 0; i < count; i++) {
+        int index;
+        s.io(index);
+        if (index < 0 || index >= joints.size()) {
+            return false;
+        }
+        dxJoint *j = joints[index];
+        if (j->node[0].body != b && j->node[1].body != b) {
+            return false;
+        }
+        nodes[i] = j->node[0].body == b ? &j->node[1] : &j->node[0];
+        for (int k = 0; k < i; k++) {
+            if (nodes[k] == nodes[i]) return false;
+        }
+    }
+
+    dxJointNode **tail = &b->firstjoint;
+    for (int i = 0; i < count; i++) {
+        *tail = nodes[i];
+        tail = &nodes[i]->next;
+    }
+    *tail = NULL;
+    return true;
+}
+
+// links the sleeping island rings and counts them
+static bool linkIslandRings(dxSnapshotLoadContext &ctx, const dArray<int> &islandNext)
+{
+    dxWorld *w = ctx.world;
+    const int bodyCount = ctx.bodies.size();
+
+    for (int i = 0; i < bodyCount; i++) {
+        dxBody *b = ctx.bodies[i];
+        const int next = islandNext[i];
+        b->tag = 0;
+        if (b->flags & dxBodyIslandAsleep) {
+            if (next < 0 || next >= bodyCount || (ctx.bodies[next]->flags & dxBodyIslandAsleep) == 0) {
+                return false;
+            }
+            b->adis_island_next = ctx.bodies[next];
+        }
+        else if (next != -1) {
+            return false;
+        }
+        if (b->flags & dxBodyCCD) {
+            w->nccd++;
+        }
+    }
+
+    for (int i = 0; i < bodyCount; i++) {
+        dxBody *b = ctx.bodies[i];
+        if ((b->flags & dxBodyIslandAsleep) == 0 || b->tag != 0) {
+            continue;
+        }
+        int count = 0;
+        dxBody *m = b;
+        do {
+            m->tag = 1;
+            count++;
+            m = m->adis_island_next;
+            if (m != b && m->tag != 0) {
+                return false;
+            }
+        } while (m != b);
+        w->asleep_islands++;
+        w->asleep_bodies += count;
+    }
+    return true;
+}
+
+// a SAP space lists the dirty geoms before the sorted ones. the sorted
+// ones are added and cleaned first
+static void addSAPGeoms(dxSnapshotLoadContext &ctx, int index,
+    const dArray<int> &parents, int dirtyCount)
+{
+    dxSpace *space = (dxSpace *)ctx.geoms[index];
+    const int geomCount = ctx.geoms.size();
+
+    int position = 0;
+    for (int i = index + 1; i < geomCount; i++) {
+        if (parents[i] == index) {
+            if (position >= dirtyCount && ctx.geoms[i] != NULL) {
+                dSpaceAdd(space, ctx.geoms[i]);
+            }
+            position++;
+        }
+    }
+    space->cleanGeoms();
+
+    position = 0;
+    for (int i = index + 1; i < geomCount && position < dirtyCount; i++) {
+        if (parents[i] == index) {
+            if (ctx.geoms[i] != NULL) {
+                dSpaceAdd(space, ctx.geoms[i]);
+            }
+            position++;
+        }
+    }
+}
+
+// the lists grow at the head, so they are reversed after the load
+static void reverseObjectList(dObject **first)
+{
+    dObject *reversed = NULL;
+    for (dObject *o = *first, *next; o != NULL; o = next) {
+        next = o->next;
+        o->next = reversed;
+        reversed = o;
+    }
+    *first = reversed;
+
+    dObject **tome = first;
+    for (dObject *o = *first; o != NULL; o = o->next) {
+        o->tome = tome;
+        tome = &o->next;
+    }
+}
+
+static bool loadWorld(dxSnapshotReader &s, dxSnapshotLoadContext &ctx, int hasSpace)
+{
+    dxWorld *w = ctx.world;
+    ioWorld(s, w);
+    if (!s.m_ok || w->qs.solver_mode < dQuickStepSolverSequential || w->qs.solver_mode > dQuickStepSolverColored) {
+        return false;
+    }
+
+    int dataCount;
+    s.io(dataCount);
+    if (!s.m_ok || dataCount < 0 || !s.fits((size_t)dataCount * 2 * sizeof(int))) {
+        return false;
+    }
+    for (int i = 0; i < dataCount; i++) {
+        if (!loadData(s, ctx)) return false;
+    }
+
+    int bodyCount;
+    s.io(bodyCount);
+    if (!s.m_ok || bodyCount < 0 || !s.fits((size_t)bodyCount * sizeof(dxPosR))) {
+        return false;
+    }
+    dArray<int> islandNext;
+    islandNext.setSize(bodyCount);
+    for (int i = 0; i < bodyCount; i++) {
+        dxBody *b = dBodyCreate(w);
+        ctx.bodies.push(b);
+        duint64 data;
+        if (!ioBody(s, b)) return false;
+        s.io(data);
+        s.io(islandNext[i]);
+        b->userdata = ctx.ref(dSnapshotRefBodyData, data);
+    }
+    if (!s.m_ok || !linkIslandRings(ctx, islandNext)) {
+        return false;
+    }
+
+    int geomCount;
+    s.io(geomCount);
+    if (!s.m_ok || geomCount < hasSpace || !s.fits((size_t)geomCount * 3 * sizeof(int))) {
+        return false;
+    }
+    dArray<int> parents, sapDirty;
+    parents.setSize(geomCount);
+    sapDirty.setSize(geomCount);
+    for (int i = 0; i < geomCount; i++) {
+        sapDirty[i] = 0;
+        if (!loadGeom(s, ctx, i, &parents[i], &sapDirty[i])) return false;
+    }
+    if (hasSpace && (ctx.geoms[0] == NULL || !IS_SPACE(ctx.geoms[0]) || parents[0] != -1)) {
+        return false;
+    }
+
+    for (int i = 0; i < bodyCount; i++) {
+        if (!loadBodyGeoms(s, ctx, ctx.bodies[i])) return false;
+    }
+
+    // the space lists grow at the head too, the SAP lists at the tail
+    for (int i = geomCount - 1; i >= 0; i--) {
+        if (ctx.geoms[i] != NULL && parents[i] >= 0
+            && ctx.geoms[parents[i]]->type != dSweepAndPruneSpaceClass) {
+            dSpaceAdd((dxSpace *)ctx.geoms[parents[i]], ctx.geoms[i]);
+        }
+    }
+    for (int i = 0; i < geomCount; i++) {
+        if (ctx.geoms[i] != NULL && ctx.geoms[i]->type == dSweepAndPruneSpaceClass) {
+            addSAPGeoms(ctx, i, parents, sapDirty[i]);
+        }
+    }
+
+    int jointCount;
+    s.io(jointCount);
+    if (!s.m_ok || jointCount < 0 || !s.fits((size_t)jointCount * 4 * sizeof(int))) {
+        return false;
+    }
+    dArray<dxJoint *> joints;
+    for (int i = 0; i < jointCount; i++) {
+        if (!loadJoint(s, ctx, joints)) return false;
+    }
+    for (int i = 0; i < bodyCount; i++) {
+        if (!loadBodyJoints(s, joints, ctx.bodies[i])) return false;
+    }
+
+    reverseObjectList((dObject **)&w->firstbody);
+    reverseObjectList((dObject **)&w->firstjoint);
+    return s.m_ok;
+}
+
+// undoes a load that failed
+static void destroyLoaded(dxSnapshotLoadContext &ctx)
+{
+    // a geom comes after its space
+    for (int i = ctx.geoms.size() - 1; i >= 0; i--) {
+        if (ctx.geoms[i] != NULL) dGeomDestroy(ctx.geoms[i]);
+    }
+    for (int i = 0; i < ctx.bodies.size(); i++) {
+        ctx.bodies[i]->flags &= ~dxBodyIslandAsleep;
+    }
+    dWorldDestroy(ctx.world);
+    for (int i = 0; i < ctx.data.size(); i++) {
+        if (ctx.dataOwned[i]) dSnapshotDataDestroy(ctx.dataKinds[i], ctx.data[i]);
+    }
+}
+
+int dWorldSnapshotLoad (const void *buffer, size_t size,
+                        const dSnapshotCallbacks *callbacks,
+                        dWorldID *world, dSpaceID *space,
+                        dSnapshotReplayInfo *replay)
+{
+    dUASSERT (buffer != NULL || size == 0, "bad buffer argument");
+    dUASSERT (world != NULL && space != NULL, "bad world or space argument");
+
+    dxSnapshotReader s(buffer, size);
+    duint32 header[4];
+    int hasSpace;
+    dSnapshotReplayInfo info;
+    s.io(header);
+    s.io(hasSpace);
+    s.io(info);
+    if (!s.m_ok || header[0] != dSNAPSHOT_MAGIC || header[1] != dSNAPSHOT_VERSION
+        || header[2] != sizeof(dReal) || (hasSpace != 0 && hasSpace != 1)) {
+        return 0;
+    }
+
+    dxSnapshotLoadContext ctx;
+    ctx.callbacks = callbacks;
+    ctx.world = dWorldCreate();
+    if (!loadWorld(s, ctx, hasSpace)) {
+        destroyLoaded(ctx);
+        return 0;
+    }
+
+    for (int i = 0; i < ctx.data.size(); i++) {
+        if (ctx.dataOwned[i]) {
+            dUASSERT (callbacks != NULL && callbacks->data_loaded != NULL, "the snapshot data needs a data_loaded callback");
+            callbacks->data_loaded(callbacks->context, ctx.dataKinds[i], ctx.data[i]);
+        }
+    }
+
+    *world = ctx.world;
+    *space = hasSpace ? (dxSpace *)ctx.geoms[0] : NULL;
+    if (replay != NULL) {
+        *replay = info;
+    }
+    return 1;
+}
+
+void dSnapshotDataDestroy (int kind, void *data)
+{
+    dAASSERT (data);
+    switch (kind) {
+        case dSnapshotRefTriMeshData:
+            dGeomTriMeshDataDestroy((dTriMeshDataID)data);
+            break;
+
+        case dSnapshotRefOSTerrainData:
+            dGeomOSTerrainDataDestroy((dOSTerrainDataID)data);
+            break;
+
+        case dSnapshotRefConvexData:
+            dFree(data, ((dxSnapshotConvexData *)data)->size);
+            break;
+
+        default:
+            dUASSERT (0, "not a data object loaded from a snapshot");
+    }
+}
@@ -225,12 +225,26 @@ int dCollideSphereBox (dxGeom *o1, dxGeom *o2, int flags,
     }
     dMultiply0_331 (q, boxR, t);
     dSubtractVectors3r4(r, p, q);
-    depth = sphere->radius - dCalcVectorLength3(r);
+    dReal dist = dCalcVectorLength3(r);
+    depth = sphere->radius - dist;
     if (depth < 0)
         return 0;
     dAddVectors3r4(contact->pos, q, boxpos);
-    dCopyVector3r4(contact->normal, r);
-    dNormalize3(contact->normal);
+    if (dist > dEpsilon)
+        dCopyScaledVector3r4(contact->normal, r, dRecip(dist));
+    else
+    {
+        // center on the surface, use the normal of a face it was clipped to
+        int i = 0;
+        while (i < 2 && dFabs(t[i]) < l[i])
+            i++;
+        dVector3 tmp;
+        tmp[0] = 0;
+        tmp[1] = 0;
+        tmp[2] = 0;
+        tmp[i] = (t[i] > 0) ? REAL(1.0) : REAL(-1.0);
+        dMultiply0_331 (contact->normal, boxR, tmp);
+    }
     contact->depth = depth;
     return 1;
 }
@@ -0,0 +1,226 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+#include <ode/common.h>
+#include <ode/objects.h>
+#include <ode/memory.h>
+#include "config.h"
+#include "error.h"
+#include "stepstats.h"
+#include "threadingutils.h"
+
+#include <string.h>
+
+#ifdef WIN32
+#include "windows.h"
+#else
+#include <time.h>
+#endif
+
+
+// the time stamp counter rate is measured against the reference clock
+// over at least this many seconds
+#define STEPSTATS_MIN_CALIBRATION_TIME 0.01
+
+
+dxStepStats::dxStepStats():
+    m_enabled(false),
+    m_stepped(false),
+    m_calibrationTicks(0),
+    m_calibrationReference(0),
+    m_arenaHighWater(0),
+    m_islands(NULL),
+    m_islandsCapacity(0),
+    m_islandsCount(0)
+{
+    for (unsigned i = 0; i != dxSST__MAX; ++i) m_ticks[i] = 0;
+    for (unsigned j = 0; j != dxSSC__MAX; ++j) m_counts[j] = 0;
+}
+
+dxStepStats::~dxStepStats()
+{
+    if (m_islands != NULL) {
+        dFree(m_islands, m_islandsCapacity * sizeof(dWorldIslandStepStats));
+    }
+}
+
+void dxStepStats::SetEnabled(bool enabled)
+{
+    if (enabled && !m_enabled) {
+        m_calibrationReference = ReadReferenceTicks();
+        m_calibrationTicks = ReadTicks();
+        m_stepped = false;
+    }
+    m_enabled = enabled;
+}
+
+void dxStepStats::BeginStep()
+{
+    dIASSERT(m_enabled);
+
+    for (unsigned i = 0; i != dxSST__MAX; ++i) m_ticks[i] = 0;
+    for (unsigned j = 0; j != dxSSC__MAX; ++j) m_counts[j] = 0;
+    m_arenaHighWater = 0;
+    m_islandsCount = 0;
+    m_stepped = true;
+}
+
+void dxStepStats::AddTicks(dxStepStatsTimer timer, duint64 ticks)
+{
+    dIASSERT((unsigned)timer < dxSST__MAX);
+    ThrsafeAddSize(&m_ticks[timer], (size_t)ticks);
+}
+
+void dxStepStats::AddCount(dxStepStatsCounter counter, size_t count)
+{
+    dIASSERT((unsigned)counter < dxSSC__MAX);
+    ThrsafeAddSize(&m_counts[counter], count);
+}
+
+void dxStepStats::UpdateArenaHighWater(size_t size)
+{
+    ThrsafeMaximizeSize(&m_arenaHighWater, size);
+}
+
+bool dxStepStats::ReserveIslands(size_t count)
+{
+    if (count > m_islandsCapacity) {
+        size_t capacity = m_islandsCapacity != 0 ? m_islandsCapacity : 16;
+        while (capacity < count) capacity *= 2;
+
+        dWorldIslandStepStats *islands = (dWorldIslandStepStats *)dRealloc(m_islands,
+            m_islandsCapacity * sizeof(dWorldIslandStepStats), capacity * sizeof(dWorldIslandStepStats));
+        if (islands == NULL) {
+            return false;
+        }
+        m_islands = islands;
+        m_islandsCapacity = capacity;
+    }
+    return true;
+}
+
+void dxStepStats::RecordIsland(unsigned bodies, unsigned joints, unsigned rows, unsigned lcpIterations, unsigned colors)
+{
+    // islands that found no room are left out
+    size_t index = ThrsafeIncrementSizeUpToLimit(&m_islandsCount, m_islandsCapacity);
+    if (index != m_islandsCapacity) {
+        dWorldIslandStepStats &island = m_islands[index];
+        island.bodies = (int)bodies;
+        island.joints = (int)joints;
+        island.rows = (int)rows;
+        island.lcp_iterations = (int)lcpIterations;
+        island.colors = (int)colors;
+    }
+}
+
+int dxStepStats::GetStats(dWorldStepStats *stats) const
+{
+    memset(stats, 0, sizeof(dWorldStepStats));
+
+    if (!m_enabled || !m_stepped) {
+        return 0;
+    }
+
+    double secondsPerTick = 1.0 / GetTicksPerSecond();
+
+    stats->total_time = m_ticks[dxSST_TOTAL] * secondsPerTick;
+    stats->islands_time = m_ticks[dxSST_ISLANDS] * secondsPerTick;
+    for (unsigned stage = 0; stage != 7; ++stage) {
+        stats->stage_time[stage] = m_ticks[dxSST_STAGE0 + stage] * secondsPerTick;
+    }
+    stats->lcp_time = m_ticks[dxSST_LCP] * secondsPerTick;
+    stats->integration_time = m_ticks[dxSST_INTEGRATION] * secondsPerTick;
+
+    stats->islands = (int)m_counts[dxSSC_ISLANDS];
+    stats->bodies = (int)m_counts[dxSSC_BODIES];
+    stats->joints = (int)m_counts[dxSSC_JOINTS];
+    stats->rows = (int)m_counts[dxSSC_ROWS];
+    stats->lcp_iterations = (int)m_counts[dxSSC_LCP_ITERATIONS];
+    stats->arena_high_water = m_arenaHighWater;
+
+    return 1;
+}
+
+int dxStepStats::GetIslandStats(dWorldIslandStepStats *buffer, int capacity) const
+{
+    if (!m_enabled || !m_stepped) {
+        return 0;
+    }
+
+    size_t count = m_islandsCount;
+    if (count > (size_t)capacity) {
+        count = (size_t)capacity;
+    }
+    memcpy(buffer, m_islands, count * sizeof(dWorldIslandStepStats));
+    return (int)count;
+}
+
+double dxStepStats::GetTicksPerSecond() const
+{
+#if dSTEPSTATS_USE_RDTSC
+    const double referenceRate = GetReferenceTicksPerSecond();
+    duint64 reference, ticks;
+    while (true) {
+        reference = ReadReferenceTicks();
+        ticks = ReadTicks();
+        if ((double)(reference - m_calibrationReference) >= STEPSTATS_MIN_CALIBRATION_TIME * referenceRate) {
+            break;
+        }
+    }
+    return (double)(ticks - m_calibrationTicks) * referenceRate / (double)(reference - m_calibrationReference);
+#else
+    return GetReferenceTicksPerSecond();
+#endif
+}
+
+
+#ifdef WIN32
+
+duint64 dxStepStats::ReadReferenceTicks()
+{
+    LARGE_INTEGER a;
+    QueryPerformanceCounter(&a);
+    return (duint64)a.QuadPart;
+}
+
+double dxStepStats::GetReferenceTicksPerSecond()
+{
+    LARGE_INTEGER a;
+    QueryPerformanceFrequency(&a);
+    return (double)a.QuadPart;
+}
+
+#else
+
+duint64 dxStepStats::ReadReferenceTicks()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (duint64)ts.tv_sec * 1000000000u + (duint64)ts.tv_nsec;
+}
+
+double dxStepStats::GetReferenceTicksPerSecond()
+{
+    return 1e9;
+}
+
+#endif
@@ -0,0 +1,183 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001-2003 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+
+per step profiling counters reported by dWorldGetStepStats. everything is
+compiled in and costs a flag test while disabled; when enabled the timers
+read the cpu time stamp counter where one is available.
+
+*/
+
+#ifndef _ODE_STEPSTATS_H_
+#define _ODE_STEPSTATS_H_
+
+#include <ode/common.h>
+#include <ode/objects.h>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define dSTEPSTATS_USE_RDTSC 1
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define dSTEPSTATS_USE_RDTSC 1
+#else
+#define dSTEPSTATS_USE_RDTSC 0
+#endif
+
+
+enum dxStepStatsTimer
+{
+    dxSST_TOTAL,
+    dxSST_ISLANDS,
+    dxSST_STAGE0,
+    dxSST_STAGE1,
+    dxSST_STAGE2,
+    dxSST_STAGE3,
+    dxSST_STAGE4,
+    dxSST_STAGE5,
+    dxSST_STAGE6,
+    dxSST_LCP,              // part of dxSST_STAGE4
+    dxSST_INTEGRATION,      // part of dxSST_STAGE6
+
+    dxSST__MAX
+};
+
+enum dxStepStatsCounter
+{
+    dxSSC_ISLANDS,
+    dxSSC_BODIES,
+    dxSSC_JOINTS,
+    dxSSC_ROWS,
+    dxSSC_LCP_ITERATIONS,
+
+    dxSSC__MAX
+};
+
+
+class dxStepStats
+{
+public:
+    dxStepStats();
+    ~dxStepStats();
+
+    bool IsEnabled() const { return m_enabled; }
+    void SetEnabled(bool enabled);
+
+    // clears the counters at the start of a step
+    void BeginStep();
+
+    // may be called from several threads at once
+    void AddTicks(dxStepStatsTimer timer, duint64 ticks);
+    void AddCount(dxStepStatsCounter counter, size_t count);
+    void UpdateArenaHighWater(size_t size);
+
+    // makes room for the islands of the step, called before they are stepped
+    bool ReserveIslands(size_t count);
+    // may be called from several threads at once
+    void RecordIsland(unsigned bodies, unsigned joints, unsigned rows, unsigned lcpIterations, unsigned colors);
+
+    int GetStats(dWorldStepStats *stats) const;
+    int GetIslandStats(dWorldIslandStepStats *buffer, int capacity) const;
+
+    static duint64 ReadTicks()
+    {
+#if dSTEPSTATS_USE_RDTSC
+        return (duint64)__rdtsc();
+#else
+        return ReadReferenceTicks();
+#endif
+    }
+
+private:
+    static duint64 ReadReferenceTicks();
+    static double GetReferenceTicksPerSecond();
+    double GetTicksPerSecond() const;
+
+private:
+    bool                m_enabled;
+    bool                m_stepped;          // a step has run since enabling
+    duint64             m_calibrationTicks; // tick and reference clock values
+    duint64             m_calibrationReference; // at the time of enabling
+    size_t              volatile m_ticks[dxSST__MAX];
+    size_t              volatile m_counts[dxSSC__MAX];
+    size_t              volatile m_arenaHighWater;
+    dWorldIslandStepStats *m_islands;       // one per island stepped by QuickStep
+    size_t              m_islandsCapacity;
+    size_t              volatile m_islandsCount;
+};
+
+
+// Accumulates the ticks elapsed between successive Lap() calls into
+// the world step stats. Does nothing if the stats are disabled.
+class dxStepStatsLap
+{
+public:
+    explicit dxStepStatsLap(dxStepStats &stats):
+        m_stats(stats.IsEnabled() ? &stats : NULL),
+        m_last(m_stats != NULL ? dxStepStats::ReadTicks() : 0)
+    {
+    }
+
+    bool IsActive() const { return m_stats != NULL; }
+
+    void Lap(dxStepStatsTimer timer)
+    {
+        if (m_stats != NULL) {
+            duint64 now = dxStepStats::ReadTicks();
+            m_stats->AddTicks(timer, now - m_last);
+            m_last = now;
+        }
+    }
+
+    // for timers that are a part of another one
+    void Lap(dxStepStatsTimer timer, dxStepStatsTimer parentTimer)
+    {
+        if (m_stats != NULL) {
+            duint64 now = dxStepStats::ReadTicks();
+            m_stats->AddTicks(timer, now - m_last);
+            m_stats->AddTicks(parentTimer, now - m_last);
+            m_last = now;
+        }
+    }
+
+    void Count(dxStepStatsCounter counter, size_t count)
+    {
+        if (m_stats != NULL) {
+            m_stats->AddCount(counter, count);
+        }
+    }
+
+    void RecordIsland(unsigned bodies, unsigned joints, unsigned rows, unsigned lcpIterations, unsigned colors)
+    {
+        if (m_stats != NULL) {
+            m_stats->RecordIsland(bodies, joints, rows, lcpIterations, colors);
+        }
+    }
+
+private:
+    dxStepStats         *m_stats;
+    duint64             m_last;
+};
+
+
+#endif // _ODE_STEPSTATS_H_
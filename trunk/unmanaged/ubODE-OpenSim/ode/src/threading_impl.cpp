@@ -34,9 +34,18 @@
 #include "config.h"
 #include "threading_impl_posix.h"
 #include "threading_impl_win.h"
+#include "threading_scheduler_posix.h"
 #include "threading_impl.h"
 
 
+// The work-stealing scheduler only has a POSIX implementation
+#if dBUILTIN_THREADING_IMPL_ENABLED && !defined(_WIN32)
+#define dSCHEDULER_IMPL_ENABLED 1
+#else
+#define dSCHEDULER_IMPL_ENABLED 0
+#endif
+
+
 static dMutexGroupID AllocMutexGroup(dThreadingImplementationID impl, dmutexindex_t Mutex_count, const char *const *Mutex_names_ptr/*=NULL*/);
 static void FreeMutexGroup(dThreadingImplementationID impl, dMutexGroupID mutex_group);
 static void LockMutexGroupMutex(dThreadingImplementationID impl, dMutexGroupID mutex_group, dmutexindex_t mutex_index);
@@ -192,6 +201,78 @@ static const dxThreadingFunctionsInfo g_builtin_threading_functions =
 }
 
 
+/*extern */dThreadingSchedulerID dThreadingAllocateScheduler(unsigned thread_count, 
+                                                             size_t stack_size, unsigned int ode_data_allocate_flags, 
+                                                             const unsigned *cpu_list/*=NULL*/, unsigned cpu_count/*=0*/)
+{
+    dAASSERT(thread_count != 0);
+    dAASSERT(cpu_list == NULL || cpu_count != 0);
+
+#if dSCHEDULER_IMPL_ENABLED
+    dxThreadingScheduler *scheduler = new dxThreadingScheduler();
+
+    if (scheduler != NULL && !scheduler->InitializeObject(thread_count, stack_size, ode_data_allocate_flags, cpu_list, cpu_count))
+    {
+        delete scheduler;
+        scheduler = NULL;
+    }
+#else
+    dThreadingSchedulerID scheduler = NULL;
+    (void)stack_size; // unused
+    (void)ode_data_allocate_flags; // unused
+    (void)cpu_list; // unused
+    (void)cpu_count; // unused
+#endif // #if dSCHEDULER_IMPL_ENABLED
+
+    return (dThreadingSchedulerID)scheduler;
+}
+
+/*extern */dThreadingImplementationID dThreadingSchedulerAllocateImplementation(dThreadingSchedulerID scheduler)
+{
+#if dSCHEDULER_IMPL_ENABLED
+    dAASSERT(scheduler != NULL);
+
+    dxThreadingSchedulerView *view = ((dxThreadingScheduler *)scheduler)->AllocateView();
+    dxIThreadingImplementation *impl = view;
+#else
+    (void)scheduler; // unused
+    dxIThreadingImplementation *impl = NULL;
+#endif // #if dSCHEDULER_IMPL_ENABLED
+
+    return (dThreadingImplementationID)impl;
+}
+
+/*extern */void dThreadingSchedulerGetUsage(dThreadingSchedulerID scheduler, dThreadingImplementationID impl, 
+                                            dThreadingSchedulerUsage *out_usage, int reset_usage)
+{
+    dAASSERT(out_usage != NULL);
+
+#if dSCHEDULER_IMPL_ENABLED
+    dAASSERT(scheduler != NULL && impl != NULL);
+
+    dxThreadingSchedulerView *view = (dxThreadingSchedulerView *)(dxIThreadingImplementation *)impl;
+    dUASSERT(((dxThreadingScheduler *)scheduler)->IsOwnView(view), "implementation is not the scheduler's");
+
+    view->RetrieveUsage(out_usage, reset_usage != 0);
+#else
+    (void)scheduler; // unused
+    (void)impl; // unused
+    (void)reset_usage; // unused
+    out_usage->cpu_nsec = 0;
+    out_usage->call_count = 0;
+#endif // #if dSCHEDULER_IMPL_ENABLED
+}
+
+/*extern */void dThreadingFreeScheduler(dThreadingSchedulerID scheduler)
+{
+#if dSCHEDULER_IMPL_ENABLED
+    delete (dxThreadingScheduler *)scheduler;
+#else
+    (void)scheduler; // unused
+#endif // #if dSCHEDULER_IMPL_ENABLED
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 
 static dMutexGroupID AllocMutexGroup(dThreadingImplementationID impl, dmutexindex_t Mutex_count, const char *const *Mutex_names_ptr/*=NULL*/)
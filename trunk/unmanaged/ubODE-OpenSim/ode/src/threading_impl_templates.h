@@ -660,18 +660,20 @@ void dxtemplateJobListContainer<tThreadLull, tThreadMutex, tAtomicsProvider>::Re
             break;
         }
 
-        void *job_call_wait = current_job->m_call_wait;
+        int call_fault = current_job->m_call_fault;
 
-        if (job_call_wait != NULL)
+        // The fault must be stored before the wait is signalled: the waiter
+        // may return at once and its accumulator is often on its stack
+        if (current_job->m_fault_accumulator_ptr)
         {
-            wait_signal_proc_ptr(job_call_wait);
+            *current_job->m_fault_accumulator_ptr = call_fault;
         }
 
-        int call_fault = current_job->m_call_fault;
+        void *job_call_wait = current_job->m_call_wait;
 
-        if (current_job->m_fault_accumulator_ptr)
+        if (job_call_wait != NULL)
         {
-            *current_job->m_fault_accumulator_ptr = call_fault;
+            wait_signal_proc_ptr(job_call_wait);
         }
 
         dxThreadedJobInfo *dependent_job = current_job->m_dependent_job;
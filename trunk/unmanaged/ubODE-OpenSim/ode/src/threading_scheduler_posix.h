@@ -0,0 +1,1163 @@
+/*************************************************************************
+ *                                                                       *
+ * Open Dynamics Engine, Copyright (C) 2001,2002 Russell L. Smith.       *
+ * All rights reserved.  Email: russ@q12.org   Web: www.q12.org          *
+ *                                                                       *
+ * This library is free software; you can redistribute it and/or         *
+ * modify it under the terms of EITHER:                                  *
+ *   (1) The GNU Lesser General Public License as published by the Free  *
+ *       Software Foundation; either version 2.1 of the License, or (at  *
+ *       your option) any later version. The text of the GNU Lesser      *
+ *       General Public License is included with this library in the     *
+ *       file LICENSE.TXT.                                               *
+ *   (2) The BSD-style license that is included with this library in     *
+ *       the file LICENSE-BSD.TXT.                                       *
+ *                                                                       *
+ * This library is distributed in the hope that it will be useful,       *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the files    *
+ * LICENSE.TXT and LICENSE-BSD.TXT for more details.                     *
+ *                                                                       *
+ *************************************************************************/
+
+/*
+ *  Work-stealing scheduler for built-in threading support provider.
+ *
+ *  One set of threads serves any number of implementation views, one view
+ *  per world. Every thread owns a job deque: it takes its own jobs from the
+ *  bottom and steals from the top of the others'. Calls posted by threads
+ *  that are not the scheduler's go to a shared injection deque. Idle threads
+ *  spin for a while and then park on a wakeup.
+ */
+
+
+#ifndef _ODE_THREADING_SCHEDULER_POSIX_H_
+#define _ODE_THREADING_SCHEDULER_POSIX_H_
+
+
+#include <ode/common.h>
+
+
+#if !defined(_WIN32)
+
+
+#include "threading_impl_posix.h"
+
+#if dBUILTIN_THREADING_IMPL_ENABLED
+
+#include <ode/odeinit.h>
+#include <ode/threading_impl.h>
+#include <sched.h>
+#include <signal.h>
+
+
+// Rounds an idle thread checks the deques before parking
+#define dxSCHEDULER_SPIN_ROUNDS     64
+
+
+class dxThreadingSchedulerView;
+struct dxThreadingScheduler;
+
+typedef dxtemplateCallWait<dxCondvarWakeup> dxSchedulerCallWait;
+typedef dxtemplateMutexGroup<dxMutexMutex> dxSchedulerMutexGroup;
+typedef dxtemplateThreadingLockHelper<dxMutexMutex> dxSchedulerLockHelper;
+
+
+struct dxSchedulerJobInfo:
+    public dxThreadedJobInfo
+{
+    dxSchedulerJobInfo() {}
+
+    dxSchedulerJobInfo          *m_prev_job; // towards the deque top
+    dxThreadingSchedulerView    *m_view;
+    bool                        m_job_started;
+};
+
+
+/************************************************************************/
+/* dxSchedulerJobDeque class implementation                             */
+/************************************************************************/
+
+class dxSchedulerJobDeque
+{
+public:
+    dxSchedulerJobDeque(): m_top(NULL), m_bottom(NULL), m_deque_lock() {}
+    ~dxSchedulerJobDeque() { dIASSERT(m_top == NULL); }
+
+    bool InitializeObject() { return m_deque_lock.InitializeObject(); }
+
+public:
+    void PushBottom(dxSchedulerJobInfo *job_instance);
+    dxSchedulerJobInfo *PopBottom();
+    dxSchedulerJobInfo *StealTop();
+
+    // Unlocked peek, only good enough to decide whether to lock
+    bool LooksEmpty() const { return m_top == NULL; }
+
+private:
+    dxSchedulerJobInfo *volatile m_top;
+    dxSchedulerJobInfo          *m_bottom;
+    dxMutexMutex                m_deque_lock;
+};
+
+
+void dxSchedulerJobDeque::PushBottom(dxSchedulerJobInfo *job_instance)
+{
+    dxSchedulerLockHelper deque_access(m_deque_lock);
+
+    dxSchedulerJobInfo *bottom_job = m_bottom;
+    job_instance->m_next_job = NULL;
+    job_instance->m_prev_job = bottom_job;
+
+    if (bottom_job != NULL)
+    {
+        bottom_job->m_next_job = job_instance;
+    }
+    else
+    {
+        m_top = job_instance;
+    }
+
+    m_bottom = job_instance;
+}
+
+dxSchedulerJobInfo *dxSchedulerJobDeque::PopBottom()
+{
+    dxSchedulerLockHelper deque_access(m_deque_lock);
+
+    dxSchedulerJobInfo *job_instance = m_bottom;
+
+    if (job_instance != NULL)
+    {
+        dxSchedulerJobInfo *prev_job = job_instance->m_prev_job;
+        m_bottom = prev_job;
+
+        if (prev_job != NULL)
+        {
+            prev_job->m_next_job = NULL;
+        }
+        else
+        {
+            m_top = NULL;
+        }
+    }
+
+    return job_instance;
+}
+
+dxSchedulerJobInfo *dxSchedulerJobDeque::StealTop()
+{
+    dxSchedulerLockHelper deque_access(m_deque_lock);
+
+    dxSchedulerJobInfo *job_instance = m_top;
+
+    if (job_instance != NULL)
+    {
+        dxSchedulerJobInfo *next_job = (dxSchedulerJobInfo *)job_instance->m_next_job;
+        m_top = next_job;
+
+        if (next_job != NULL)
+        {
+            next_job->m_prev_job = NULL;
+        }
+        else
+        {
+            m_bottom = NULL;
+        }
+    }
+
+    return job_instance;
+}
+
+
+/************************************************************************/
+/* dxThreadingScheduler class definition                                */
+/************************************************************************/
+
+struct dxSchedulerWorker
+{
+    dxSchedulerWorker(): m_scheduler(NULL), m_worker_index(0), m_thread_handle(), m_init_error(EOK), m_job_deque() {}
+
+    dxThreadingScheduler    *m_scheduler;
+    unsigned                m_worker_index;
+    pthread_t               m_thread_handle;
+    int                     m_init_error;
+    dxSchedulerJobDeque     m_job_deque;
+};
+
+struct dxThreadingScheduler:
+    public dBase
+{
+public:
+    dxThreadingScheduler();
+    ~dxThreadingScheduler();
+
+    bool InitializeObject(unsigned thread_count, size_t stack_size, unsigned int ode_data_allocate_flags, 
+        const unsigned *cpu_list, unsigned cpu_count);
+
+private:
+    void FinalizeObject();
+
+    bool StartWorker(dxSchedulerWorker *worker, size_t stack_size, const unsigned *cpu_list, unsigned cpu_count);
+    bool InitializeWorkerAttributes(pthread_attr_t *thread_attr, size_t stack_size, const unsigned *cpu_list, unsigned cpu_count, unsigned worker_index);
+    void FinalizeWorkers();
+
+    static void *WorkerProcedure_Callback(void *thread_param);
+    void WorkerProcedure(dxSchedulerWorker *worker);
+    static bool DisableSignalHandlers();
+
+    void ServeJobsUntilShutdown(dxSchedulerWorker *worker);
+    bool SpinForReadyJobs();
+    void ParkIdleWorker();
+    bool AnyJobsLookReady() const;
+
+public:
+    dxThreadingSchedulerView *AllocateView();
+    void FreeView(dxThreadingSchedulerView *view);
+    bool IsOwnView(const dxThreadingSchedulerView *view);
+
+    unsigned RetrieveWorkerCount() const { return m_worker_count; }
+
+public:
+    dxSchedulerJobInfo *AllocateJobInfo();
+    void FreeJobInfo(dxSchedulerJobInfo *job_instance);
+    bool PreallocateJobInfos(ddependencycount_t extra_info_count);
+
+    void MakeJobReady(dxSchedulerJobInfo *job_instance);
+    void ReleaseJob(dxSchedulerJobInfo *job_instance, bool job_result);
+    dxSchedulerJobInfo *FindReadyJob(dxSchedulerWorker *worker);
+    void RunJob(dxSchedulerJobInfo *job_instance);
+
+    // NULL for the threads that are not this scheduler's
+    dxSchedulerWorker *GetCurrentWorker() const { return (dxSchedulerWorker *)pthread_getspecific(m_worker_key); }
+
+private:
+    typedef dxOUAtomicsProvider::atomicord_t atomicord_t;
+
+    dxSchedulerWorker       *m_workers;
+    unsigned                m_worker_capacity;
+    unsigned                m_worker_count;
+    unsigned                m_started_count;
+    unsigned int            m_ode_data_allocate_flags;
+    pthread_key_t           m_worker_key;
+    bool                    m_worker_key_allocated;
+
+    dxSchedulerJobDeque     m_injected_jobs;
+
+    volatile atomicord_t    m_idle_count;
+    dxCondvarWakeup         m_idle_wakeup;
+    dxCondvarWakeup         m_ready_wakeup;
+    volatile int            m_shutdown_requested;
+
+    dxSchedulerJobInfo      *m_info_pool;
+    dxMutexMutex            m_pool_lock;
+
+    dxThreadingSchedulerView *m_views;
+    dxMutexMutex            m_views_lock;
+};
+
+
+/************************************************************************/
+/* dxThreadingSchedulerView class definition                            */
+/************************************************************************/
+
+class dxThreadingSchedulerView:
+    public dBase,
+    public dxIThreadingImplementation
+{
+public:
+    explicit dxThreadingSchedulerView(dxThreadingScheduler *scheduler):
+        dBase(),
+        m_scheduler(scheduler),
+        m_next_view(NULL),
+        m_info_count_preallocated(0),
+        m_usage_cpu_nsec(0),
+        m_usage_call_count(0),
+        m_usage_lock()
+    {
+    }
+
+    virtual ~dxThreadingSchedulerView() {}
+
+    bool InitializeObject() { return m_usage_lock.InitializeObject(); }
+
+public:
+    void AccountJob(duint64 cpu_nsec);
+    void RetrieveUsage(dThreadingSchedulerUsage *out_usage, bool reset_usage);
+
+protected:
+    virtual void FreeInstance();
+
+protected:
+    virtual dIMutexGroup *AllocMutexGroup(dmutexindex_t Mutex_count);
+    virtual void FreeMutexGroup(dIMutexGroup *mutex_group);
+    virtual void LockMutexGroupMutex(dIMutexGroup *mutex_group, dmutexindex_t mutex_index);
+    virtual void UnlockMutexGroupMutex(dIMutexGroup *mutex_group, dmutexindex_t mutex_index);
+
+protected:
+    virtual dxICallWait *AllocACallWait();
+    virtual void ResetACallWait(dxICallWait *call_wait);
+    virtual void FreeACallWait(dxICallWait *call_wait);
+
+protected:
+    virtual bool PreallocateJobInfos(ddependencycount_t max_simultaneous_calls_estimate);
+    virtual void ScheduleNewJob(int *fault_accumulator_ptr/*=NULL*/, 
+        dCallReleaseeID *out_post_releasee_ptr/*=NULL*/, ddependencycount_t dependencies_count, dCallReleaseeID dependent_releasee/*=NULL*/, 
+        dxICallWait *call_wait/*=NULL*/, 
+        dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index);
+    virtual void AlterJobDependenciesCount(dCallReleaseeID target_releasee, ddependencychange_t dependencies_count_change);
+    virtual void WaitJobCompletion(int *out_wait_status_ptr/*=NULL*/, 
+        dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/);
+
+protected:
+    virtual unsigned RetrieveActiveThreadsCount();
+    virtual void StickToJobsProcessing(dxThreadReadyToServeCallback *readiness_callback/*=NULL*/, void *callback_context/*=NULL*/);
+    virtual void ShutdownProcessing();
+    virtual void CleanupForRestart();
+
+private:
+    friend struct dxThreadingScheduler;
+
+    dxThreadingScheduler        *m_scheduler;
+    dxThreadingSchedulerView    *m_next_view;
+    ddependencycount_t          m_info_count_preallocated;
+
+    duint64                     m_usage_cpu_nsec;
+    duint64                     m_usage_call_count;
+    dxMutexMutex                m_usage_lock;
+};
+
+
+/************************************************************************/
+/* dxThreadingScheduler class implementation                            */
+/************************************************************************/
+
+dxThreadingScheduler::dxThreadingScheduler():
+    dBase(),
+    m_workers(NULL),
+    m_worker_capacity(0),
+    m_worker_count(0),
+    m_started_count(0),
+    m_ode_data_allocate_flags(0),
+    m_worker_key(),
+    m_worker_key_allocated(false),
+    m_injected_jobs(),
+    m_idle_count(0),
+    m_idle_wakeup(),
+    m_ready_wakeup(),
+    m_shutdown_requested(0),
+    m_info_pool(NULL),
+    m_pool_lock(),
+    m_views(NULL),
+    m_views_lock()
+{
+}
+
+dxThreadingScheduler::~dxThreadingScheduler()
+{
+    FinalizeObject();
+}
+
+
+bool dxThreadingScheduler::InitializeObject(unsigned thread_count, size_t stack_size, unsigned int ode_data_allocate_flags, 
+    const unsigned *cpu_list, unsigned cpu_count)
+{
+    dIASSERT(m_workers == NULL);
+
+    bool result = false;
+
+    do
+    {
+        if (!m_injected_jobs.InitializeObject() || !m_idle_wakeup.InitializeObject() || !m_ready_wakeup.InitializeObject()
+            || !m_pool_lock.InitializeObject() || !m_views_lock.InitializeObject())
+        {
+            break;
+        }
+
+        int key_result = pthread_key_create(&m_worker_key, NULL);
+        if (key_result != EOK)
+        {
+            errno = key_result;
+            break;
+        }
+
+        m_worker_key_allocated = true;
+
+        dxSchedulerWorker *workers = (dxSchedulerWorker *)dAlloc(thread_count * sizeof(dxSchedulerWorker));
+        if (workers == NULL)
+        {
+            break;
+        }
+
+        m_workers = workers;
+        m_worker_capacity = thread_count;
+        m_ode_data_allocate_flags = ode_data_allocate_flags;
+
+        bool any_fault = false;
+
+        // All the workers must exist before any thread starts looking for jobs to steal
+        for (unsigned worker_index = 0; worker_index != thread_count; ++worker_index)
+        {
+            dxSchedulerWorker *worker = workers + worker_index;
+            new(worker) dxSchedulerWorker();
+
+            worker->m_scheduler = this;
+            worker->m_worker_index = worker_index;
+            m_worker_count = worker_index + 1;
+
+            if (!worker->m_job_deque.InitializeObject())
+            {
+                any_fault = true;
+                break;
+            }
+        }
+
+        for (unsigned worker_index = 0; !any_fault && worker_index != thread_count; ++worker_index)
+        {
+            if (!StartWorker(workers + worker_index, stack_size, cpu_list, cpu_count))
+            {
+                any_fault = true;
+                break;
+            }
+
+            m_started_count = worker_index + 1;
+        }
+
+        if (any_fault)
+        {
+            break;
+        }
+
+        result = true;
+    }
+    while (false);
+
+    return result;
+}
+
+void dxThreadingScheduler::FinalizeObject()
+{
+    dIASSERT(m_views == NULL); // The views must be freed before the scheduler
+
+    if (m_workers != NULL)
+    {
+        FinalizeWorkers();
+
+        dFree(m_workers, m_worker_capacity * sizeof(dxSchedulerWorker));
+        m_workers = NULL;
+        m_worker_capacity = 0;
+        m_worker_count = 0;
+    }
+
+    if (m_worker_key_allocated)
+    {
+        int key_result = pthread_key_delete(m_worker_key);
+        dICHECK(key_result == EOK || ((errno = key_result), false));
+
+        m_worker_key_allocated = false;
+    }
+
+    dxSchedulerJobInfo *current_info = m_info_pool;
+
+    while (current_info != NULL)
+    {
+        dxSchedulerJobInfo *info_save = current_info;
+        current_info = (dxSchedulerJobInfo *)current_info->m_next_job;
+
+        delete info_save;
+    }
+
+    m_info_pool = NULL;
+}
+
+
+bool dxThreadingScheduler::StartWorker(dxSchedulerWorker *worker, size_t stack_size, const unsigned *cpu_list, unsigned cpu_count)
+{
+    bool result = false;
+
+    do
+    {
+        pthread_attr_t thread_attr;
+        if (!InitializeWorkerAttributes(&thread_attr, stack_size, cpu_list, cpu_count, worker->m_worker_index))
+        {
+            break;
+        }
+
+        int thread_create_result = pthread_create(&worker->m_thread_handle, &thread_attr, &WorkerProcedure_Callback, (void *)worker);
+
+        int destroy_result = pthread_attr_destroy(&thread_attr);
+        dIVERIFY(destroy_result == EOK);
+
+        if (thread_create_result != EOK)
+        {
+            errno = thread_create_result;
+            break;
+        }
+
+        m_ready_wakeup.WaitWakeup(NULL);
+
+        if (worker->m_init_error != EOK)
+        {
+            int join_result = pthread_join(worker->m_thread_handle, NULL);
+            dICHECK(join_result == EOK);
+
+            errno = worker->m_init_error;
+            break;
+        }
+
+        result = true;
+    }
+    while (false);
+
+    return result;
+}
+
+bool dxThreadingScheduler::InitializeWorkerAttributes(pthread_attr_t *thread_attr, size_t stack_size, 
+    const unsigned *cpu_list, unsigned cpu_count, unsigned worker_index)
+{
+    bool result = false;
+
+    bool attr_inited = false;
+
+    do
+    {
+        int init_result = pthread_attr_init(thread_attr);
+        if (init_result != EOK)
+        {
+            errno = init_result;
+            break;
+        }
+
+        attr_inited = true;
+
+        int set_result;
+        if ((set_result = pthread_attr_setdetachstate(thread_attr, PTHREAD_CREATE_JOINABLE)) != EOK
+            || (set_result = pthread_attr_setinheritsched(thread_attr, PTHREAD_INHERIT_SCHED)) != EOK
+#if (HAVE_PTHREAD_ATTR_SETSTACKLAZY)
+            || (set_result = pthread_attr_setstacklazy(thread_attr, PTHREAD_STACK_NOTLAZY)) != EOK
+#endif
+            || (stack_size != 0 && (set_result = pthread_attr_setstacksize(thread_attr, stack_size)) != EOK))
+        {
+            errno = set_result;
+            break;
+        }
+
+#if defined(__linux__) && defined(CPU_SET)
+        if (cpu_list != NULL && cpu_count != 0)
+        {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu_list[worker_index % cpu_count], &cpu_set);
+
+            if ((set_result = pthread_attr_setaffinity_np(thread_attr, sizeof(cpu_set), &cpu_set)) != EOK)
+            {
+                errno = set_result;
+                break;
+            }
+        }
+#else
+        // Affinity is left to the system where it can not be set
+        (void)cpu_list; // unused
+        (void)cpu_count; // unused
+        (void)worker_index; // unused
+#endif
+
+        result = true;
+    }
+    while (false);
+
+    if (!result)
+    {
+        if (attr_inited)
+        {
+            int destroy_result = pthread_attr_destroy(thread_attr);
+            dIVERIFY(destroy_result == EOK);
+        }
+    }
+
+    return result;
+}
+
+void dxThreadingScheduler::FinalizeWorkers()
+{
+    // It is expected that no calls are posted any longer
+    m_shutdown_requested = true;
+    m_idle_wakeup.WakeupAllThreads();
+
+    dxSchedulerWorker *const started_end = m_workers + m_started_count;
+    for (dxSchedulerWorker *current_worker = m_workers; current_worker != started_end; ++current_worker)
+    {
+        int join_result = pthread_join(current_worker->m_thread_handle, NULL);
+        dICHECK(join_result == EOK);
+    }
+
+    m_started_count = 0;
+
+    dxSchedulerWorker *const workers_end = m_workers + m_worker_count;
+    for (dxSchedulerWorker *current_worker = m_workers; current_worker != workers_end; ++current_worker)
+    {
+        current_worker->dxSchedulerWorker::~dxSchedulerWorker();
+    }
+}
+
+
+void *dxThreadingScheduler::WorkerProcedure_Callback(void *thread_param)
+{
+    dxSchedulerWorker *worker = (dxSchedulerWorker *)thread_param;
+    worker->m_scheduler->WorkerProcedure(worker);
+
+    return 0;
+}
+
+void dxThreadingScheduler::WorkerProcedure(dxSchedulerWorker *worker)
+{
+    int key_result = EOK;
+    bool init_result = dAllocateODEDataForThread(m_ode_data_allocate_flags) != 0
+        && DisableSignalHandlers()
+        && ((key_result = pthread_setspecific(m_worker_key, worker)) == EOK || ((errno = key_result), false));
+
+    worker->m_init_error = init_result ? EOK : ((errno != EOK) ? errno : EFAULT);
+    m_ready_wakeup.WakeupAThread();
+
+    if (init_result)
+    {
+        ServeJobsUntilShutdown(worker);
+    }
+}
+
+/*static */bool dxThreadingScheduler::DisableSignalHandlers()
+{
+    sigset_t set;
+    sigfillset(&set);
+
+    return sigprocmask(SIG_BLOCK, &set, NULL) != -1;
+}
+
+
+void dxThreadingScheduler::ServeJobsUntilShutdown(dxSchedulerWorker *worker)
+{
+    while (true)
+    {
+        dxSchedulerJobInfo *job_instance = FindReadyJob(worker);
+
+        if (job_instance != NULL)
+        {
+            RunJob(job_instance);
+            continue;
+        }
+
+        if (SpinForReadyJobs())
+        {
+            continue;
+        }
+
+        // It is expected that new jobs will not be queued any longer after shutdown had been requested
+        if (m_shutdown_requested)
+        {
+            break;
+        }
+
+        ParkIdleWorker();
+    }
+}
+
+bool dxThreadingScheduler::SpinForReadyJobs()
+{
+    bool jobs_found = false;
+
+    for (unsigned spin_round = 0; spin_round != dxSCHEDULER_SPIN_ROUNDS; ++spin_round)
+    {
+        if (AnyJobsLookReady())
+        {
+            jobs_found = true;
+            break;
+        }
+
+        sched_yield();
+    }
+
+    return jobs_found;
+}
+
+void dxThreadingScheduler::ParkIdleWorker()
+{
+    dxOUAtomicsProvider::IncrementTargetNoRet(&m_idle_count);
+
+    // Re-check after registering: a job pushed before that would not have woken anybody
+    if (!AnyJobsLookReady() && !m_shutdown_requested)
+    {
+        m_idle_wakeup.WaitWakeup(NULL);
+    }
+
+    dxOUAtomicsProvider::DecrementTargetNoRet(&m_idle_count);
+}
+
+bool dxThreadingScheduler::AnyJobsLookReady() const
+{
+    bool result = !m_injected_jobs.LooksEmpty();
+
+    const dxSchedulerWorker *const workers_end = m_workers + m_worker_count;
+    for (const dxSchedulerWorker *current_worker = m_workers; !result && current_worker != workers_end; ++current_worker)
+    {
+        result = !current_worker->m_job_deque.LooksEmpty();
+    }
+
+    return result;
+}
+
+
+dxThreadingSchedulerView *dxThreadingScheduler::AllocateView()
+{
+    dxThreadingSchedulerView *view = new dxThreadingSchedulerView(this);
+
+    if (view != NULL)
+    {
+        if (view->InitializeObject())
+        {
+            dxSchedulerLockHelper views_access(m_views_lock);
+
+            view->m_next_view = m_views;
+            m_views = view;
+        }
+        else
+        {
+            delete view;
+            view = NULL;
+        }
+    }
+
+    return view;
+}
+
+void dxThreadingScheduler::FreeView(dxThreadingSchedulerView *view)
+{
+    {
+        dxSchedulerLockHelper views_access(m_views_lock);
+
+        for (dxThreadingSchedulerView **current_view_ptr = &m_views; ; current_view_ptr = &(*current_view_ptr)->m_next_view)
+        {
+            dIASSERT(*current_view_ptr != NULL);
+
+            if (*current_view_ptr == view)
+            {
+                *current_view_ptr = view->m_next_view;
+                break;
+            }
+        }
+    }
+
+    delete view;
+}
+
+bool dxThreadingScheduler::IsOwnView(const dxThreadingSchedulerView *view)
+{
+    dxSchedulerLockHelper views_access(m_views_lock);
+
+    const dxThreadingSchedulerView *current_view = m_views;
+    while (current_view != NULL && current_view != view)
+    {
+        current_view = current_view->m_next_view;
+    }
+
+    return current_view != NULL;
+}
+
+
+dxSchedulerJobInfo *dxThreadingScheduler::AllocateJobInfo()
+{
+    dxSchedulerJobInfo *job_instance;
+
+    {
+        dxSchedulerLockHelper pool_access(m_pool_lock);
+
+        job_instance = m_info_pool;
+
+        if (job_instance != NULL)
+        {
+            m_info_pool = (dxSchedulerJobInfo *)job_instance->m_next_job;
+        }
+    }
+
+    if (job_instance == NULL)
+    {
+        job_instance = new dxSchedulerJobInfo();
+    }
+
+    return job_instance;
+}
+
+void dxThreadingScheduler::FreeJobInfo(dxSchedulerJobInfo *job_instance)
+{
+    dxSchedulerLockHelper pool_access(m_pool_lock);
+
+    job_instance->m_next_job = m_info_pool;
+    m_info_pool = job_instance;
+}
+
+bool dxThreadingScheduler::PreallocateJobInfos(ddependencycount_t extra_info_count)
+{
+    bool allocation_failure = false;
+
+    for (; extra_info_count != 0; --extra_info_count)
+    {
+        dxSchedulerJobInfo *job_instance = new dxSchedulerJobInfo();
+
+        if (job_instance == NULL)
+        {
+            allocation_failure = true;
+            break;
+        }
+
+        FreeJobInfo(job_instance);
+    }
+
+    bool result = !allocation_failure;
+    return result;
+}
+
+
+void dxThreadingScheduler::MakeJobReady(dxSchedulerJobInfo *job_instance)
+{
+    dIASSERT(!job_instance->m_job_started);
+
+    dxSchedulerWorker *worker = GetCurrentWorker();
+    dxSchedulerJobDeque *job_deque = worker != NULL ? &worker->m_job_deque : &m_injected_jobs;
+    job_deque->PushBottom(job_instance);
+
+    // Query with a barrier: pairs with the re-check in ParkIdleWorker()
+    if (dxOUAtomicsProvider::QueryTargetValue(&m_idle_count) != 0)
+    {
+        m_idle_wakeup.WakeupAThread();
+    }
+}
+
+void dxThreadingScheduler::ReleaseJob(dxSchedulerJobInfo *job_instance, bool job_result)
+{
+    dxSchedulerJobInfo *current_job = job_instance;
+
+    if (!job_result)
+    {
+        // Accumulate call fault (be careful to not reset it!!!)
+        current_job->m_call_fault = 1;
+    }
+
+    while (true)
+    {
+        dIASSERT(current_job->m_dependencies_count != 0);
+
+        ddependencycount_t new_dependencies_count = dxOUAtomicsProvider::AddValueToTarget<sizeof(ddependencycount_t)>((volatile void *)&current_job->m_dependencies_count, -1) - 1;
+
+        if (new_dependencies_count != 0)
+        {
+            break;
+        }
+
+        if (!current_job->m_job_started)
+        {
+            // The last dependency of a job that has not run yet
+            MakeJobReady(current_job);
+            break;
+        }
+
+        int call_fault = current_job->m_call_fault;
+
+        // The fault must be stored before the wait is signalled: the waiter
+        // may return at once and its accumulator is often on its stack
+        if (current_job->m_fault_accumulator_ptr)
+        {
+            *current_job->m_fault_accumulator_ptr = call_fault;
+        }
+
+        void *job_call_wait = current_job->m_call_wait;
+
+        if (job_call_wait != NULL)
+        {
+            dxSchedulerCallWait::AbstractSignalTheWait(job_call_wait);
+        }
+
+        dxSchedulerJobInfo *dependent_job = (dxSchedulerJobInfo *)current_job->m_dependent_job;
+        FreeJobInfo(current_job);
+
+        if (dependent_job == NULL)
+        {
+            break;
+        }
+
+        if (call_fault)
+        {
+            // Accumulate call fault (be careful to not reset it!!!)
+            dependent_job->m_call_fault = 1;
+        }
+
+        current_job = dependent_job;
+    }
+}
+
+dxSchedulerJobInfo *dxThreadingScheduler::FindReadyJob(dxSchedulerWorker *worker)
+{
+    dxSchedulerJobInfo *job_instance = NULL;
+
+    do
+    {
+        // Own jobs first, newest first, as their data is likely still in cache
+        if (worker != NULL && (job_instance = worker->m_job_deque.PopBottom()) != NULL)
+        {
+            break;
+        }
+
+        if (!m_injected_jobs.LooksEmpty() && (job_instance = m_injected_jobs.StealTop()) != NULL)
+        {
+            break;
+        }
+
+        // Steal the oldest job of somebody else
+        const unsigned worker_count = m_worker_count;
+        const unsigned first_victim = worker != NULL ? worker->m_worker_index + 1 : 0;
+
+        for (unsigned victim_round = 0; victim_round != worker_count; ++victim_round)
+        {
+            dxSchedulerWorker *victim = m_workers + (first_victim + victim_round) % worker_count;
+
+            if (victim != worker && !victim->m_job_deque.LooksEmpty() && (job_instance = victim->m_job_deque.StealTop()) != NULL)
+            {
+                break;
+            }
+        }
+    }
+    while (false);
+
+    return job_instance;
+}
+
+void dxThreadingScheduler::RunJob(dxSchedulerJobInfo *job_instance)
+{
+    // The running job holds one dependency on itself until it returns
+    job_instance->m_dependencies_count = 1;
+    job_instance->m_job_started = true;
+
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    const clockid_t usage_clock = CLOCK_THREAD_CPUTIME_ID;
+#else
+    const clockid_t usage_clock = CLOCK_MONOTONIC;
+#endif
+
+    timespec start_time, end_time;
+    clock_gettime(usage_clock, &start_time);
+
+    bool job_result = job_instance->InvokeCallFunction();
+
+    clock_gettime(usage_clock, &end_time);
+
+    duint64 cpu_nsec = (duint64)(end_time.tv_sec - start_time.tv_sec) * 1000000000 + (end_time.tv_nsec - start_time.tv_nsec);
+    job_instance->m_view->AccountJob(cpu_nsec);
+
+    ReleaseJob(job_instance, job_result);
+}
+
+
+/************************************************************************/
+/* dxThreadingSchedulerView class implementation                        */
+/************************************************************************/
+
+void dxThreadingSchedulerView::AccountJob(duint64 cpu_nsec)
+{
+    dxSchedulerLockHelper usage_access(m_usage_lock);
+
+    m_usage_cpu_nsec += cpu_nsec;
+    m_usage_call_count += 1;
+}
+
+void dxThreadingSchedulerView::RetrieveUsage(dThreadingSchedulerUsage *out_usage, bool reset_usage)
+{
+    dxSchedulerLockHelper usage_access(m_usage_lock);
+
+    out_usage->cpu_nsec = m_usage_cpu_nsec;
+    out_usage->call_count = m_usage_call_count;
+
+    if (reset_usage)
+    {
+        m_usage_cpu_nsec = 0;
+        m_usage_call_count = 0;
+    }
+}
+
+
+void dxThreadingSchedulerView::FreeInstance()
+{
+    m_scheduler->FreeView(this);
+}
+
+
+dIMutexGroup *dxThreadingSchedulerView::AllocMutexGroup(dmutexindex_t Mutex_count)
+{
+    dxSchedulerMutexGroup *mutex_group = dxSchedulerMutexGroup::AllocateInstance(Mutex_count);
+    return (dIMutexGroup *)mutex_group;
+}
+
+void dxThreadingSchedulerView::FreeMutexGroup(dIMutexGroup *mutex_group)
+{
+    dxSchedulerMutexGroup::FreeInstance((dxSchedulerMutexGroup *)mutex_group);
+}
+
+void dxThreadingSchedulerView::LockMutexGroupMutex(dIMutexGroup *mutex_group, dmutexindex_t mutex_index)
+{
+    ((dxSchedulerMutexGroup *)mutex_group)->LockMutex(mutex_index);
+}
+
+void dxThreadingSchedulerView::UnlockMutexGroupMutex(dIMutexGroup *mutex_group, dmutexindex_t mutex_index)
+{
+    ((dxSchedulerMutexGroup *)mutex_group)->UnlockMutex(mutex_index);
+}
+
+
+dxICallWait *dxThreadingSchedulerView::AllocACallWait()
+{
+    dxSchedulerCallWait *call_wait = new dxSchedulerCallWait();
+
+    if (call_wait != NULL && !call_wait->InitializeObject())
+    {
+        delete call_wait;
+        call_wait = NULL;
+    }
+
+    return (dxICallWait *)call_wait;
+}
+
+void dxThreadingSchedulerView::ResetACallWait(dxICallWait *call_wait)
+{
+    ((dxSchedulerCallWait *)call_wait)->ResetTheWait();
+}
+
+void dxThreadingSchedulerView::FreeACallWait(dxICallWait *call_wait)
+{
+    delete ((dxSchedulerCallWait *)call_wait);
+}
+
+
+bool dxThreadingSchedulerView::PreallocateJobInfos(ddependencycount_t max_simultaneous_calls_estimate)
+{
+    // The infos are shared by all the views, so each view adds its own share
+    bool result = true;
+
+    if (max_simultaneous_calls_estimate > m_info_count_preallocated)
+    {
+        result = m_scheduler->PreallocateJobInfos(max_simultaneous_calls_estimate - m_info_count_preallocated);
+
+        if (result)
+        {
+            m_info_count_preallocated = max_simultaneous_calls_estimate;
+        }
+    }
+
+    return result;
+}
+
+void dxThreadingSchedulerView::ScheduleNewJob(
+    int *fault_accumulator_ptr/*=NULL*/, 
+    dCallReleaseeID *out_post_releasee_ptr/*=NULL*/, ddependencycount_t dependencies_count, dCallReleaseeID dependent_releasee/*=NULL*/, 
+    dxICallWait *call_wait/*=NULL*/, 
+    dThreadedCallFunction *call_func, void *call_context, dcallindex_t instance_index)
+{
+    dxSchedulerJobInfo *new_job = m_scheduler->AllocateJobInfo();
+    dIASSERT(new_job != NULL);
+
+    new_job->AssignJobData(dependencies_count, dMAKE_RELEASEE_JOBINSTANCE(dependent_releasee), (dxSchedulerCallWait *)call_wait, fault_accumulator_ptr, call_func, call_context, instance_index);
+    new_job->m_view = this;
+    new_job->m_job_started = false;
+
+    if (out_post_releasee_ptr != NULL)
+    {
+        *out_post_releasee_ptr = dMAKE_JOBINSTANCE_RELEASEE(new_job);
+    }
+
+    if (dependencies_count == 0)
+    {
+        m_scheduler->MakeJobReady(new_job);
+    }
+}
+
+void dxThreadingSchedulerView::AlterJobDependenciesCount(dCallReleaseeID target_releasee, ddependencychange_t dependencies_count_change)
+{
+    dIASSERT(dependencies_count_change != 0);
+
+    dxSchedulerJobInfo *job_instance = (dxSchedulerJobInfo *)dMAKE_RELEASEE_JOBINSTANCE(target_releasee);
+
+    // Dependencies should not be changed when job has already become ready for execution
+    dIASSERT(job_instance->m_dependencies_count != 0);
+
+    ddependencycount_t new_dependencies_count = dxOUAtomicsProvider::AddValueToTarget<sizeof(ddependencycount_t)>((volatile void *)&job_instance->m_dependencies_count, dependencies_count_change) + dependencies_count_change;
+
+    if (new_dependencies_count == 0)
+    {
+        m_scheduler->MakeJobReady(job_instance);
+    }
+}
+
+void dxThreadingSchedulerView::WaitJobCompletion(
+    int *out_wait_status_ptr/*=NULL*/, 
+    dxICallWait *call_wait, const dThreadedWaitTime *timeout_time_ptr/*=NULL*/)
+{
+    dIASSERT(call_wait != NULL);
+
+    dxSchedulerCallWait *scheduler_wait = (dxSchedulerCallWait *)call_wait;
+
+    // Help with whatever is ready while the call is not done, then block.
+    // A wait with a timeout does not help as a job might run past it.
+    if (timeout_time_ptr == NULL)
+    {
+        const dThreadedWaitTime no_wait_time = { 0, 0 };
+        dxSchedulerWorker *worker = m_scheduler->GetCurrentWorker();
+
+        while (!scheduler_wait->PerformWaiting(&no_wait_time))
+        {
+            dxSchedulerJobInfo *job_instance = m_scheduler->FindReadyJob(worker);
+
+            if (job_instance == NULL)
+            {
+                break;
+            }
+
+            m_scheduler->RunJob(job_instance);
+        }
+    }
+
+    bool wait_status = scheduler_wait->PerformWaiting(timeout_time_ptr);
+    dIASSERT(timeout_time_ptr != NULL || wait_status);
+
+    if (out_wait_status_ptr)
+    {
+        *out_wait_status_ptr = wait_status;
+    }
+}
+
+
+unsigned dxThreadingSchedulerView::RetrieveActiveThreadsCount()
+{
+    return m_scheduler->RetrieveWorkerCount();
+}
+
+void dxThreadingSchedulerView::StickToJobsProcessing(dxThreadReadyToServeCallback *readiness_callback/*=NULL*/, void *callback_context/*=NULL*/)
+{
+    (void)readiness_callback; // unused
+    (void)callback_context; // unused
+    dIASSERT(false); // The view is served by the scheduler's own threads
+}
+
+void dxThreadingSchedulerView::ShutdownProcessing()
+{
+    // Do nothing
+}
+
+void dxThreadingSchedulerView::CleanupForRestart()
+{
+    // Do nothing
+}
+
+
+#endif // #if dBUILTIN_THREADING_IMPL_ENABLED
+
+
+#endif // #if !defined(_WIN32)
+
+
+#endif // #ifndef _ODE_THREADING_SCHEDULER_POSIX_H_
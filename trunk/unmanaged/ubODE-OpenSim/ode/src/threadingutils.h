@@ -146,6 +146,31 @@ size_t ThrsafeIncrementSizeUpToLimit(volatile size_t *storagePointer, size_t lim
     return resultValue;
 }
 
+static inline
+void ThrsafeAddSize(volatile size_t *storagePointer, size_t addendValue)
+{
+    while (true) {
+        size_t currentValue = *storagePointer;
+        if (ThrsafeCompareExchangePointer((volatile atomicptr *)storagePointer, (atomicptr)currentValue, (atomicptr)(currentValue + addendValue))) {
+            break;
+        }
+    }
+}
+
+static inline
+void ThrsafeMaximizeSize(volatile size_t *storagePointer, size_t candidateValue)
+{
+    while (true) {
+        size_t currentValue = *storagePointer;
+        if (currentValue >= candidateValue) {
+            break;
+        }
+        if (ThrsafeCompareExchangePointer((volatile atomicptr *)storagePointer, (atomicptr)currentValue, (atomicptr)candidateValue)) {
+            break;
+        }
+    }
+}
+
 
 
 #endif // _ODE_THREADINGUTILS_H_
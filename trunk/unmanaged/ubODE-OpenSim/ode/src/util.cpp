@@ -518,11 +518,13 @@ void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize)
             }
         }
 
-        // if it's idle, accumulate steps and time.
-        // these counters won't overflow because this code doesn't run for disabled bodies.
+        // if it's idle, accumulate steps and time. they stop at zero as a
+        // body can stay idle for long in an island that is still moving.
         if (idle) {
-            bb->adis_stepsleft--;
-            bb->adis_timeleft -= stepsize;
+            if (bb->adis_stepsleft > 0)
+                bb->adis_stepsleft--;
+            if (bb->adis_timeleft > 0)
+                bb->adis_timeleft -= stepsize;
         }
         else {
             // Reset countdowns
@@ -530,8 +532,9 @@ void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize)
             bb->adis_timeleft = bb->adis.idle_time;
         }
 
-        // disable the body if it's idle for a long enough time
-        if ( bb->adis_stepsleft <= 0 && bb->adis_timeleft <= 0 )
+        // disable the body if it's idle for a long enough time. with island
+        // auto-disabling that is left to the island building
+        if ( bb->adis_stepsleft <= 0 && bb->adis_timeleft <= 0 && !world->adis_islands )
         {
             bb->flags |= dxBodyDisabled; // set the disable flag
 
@@ -544,6 +547,59 @@ void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize)
 }
 
 
+// an island falls asleep once all its bodies have been idle long enough.
+// a lone body without joints is not resting on anything, so is never idle
+static bool islandIsIdle (dxBody *const *body, unsigned int nb, unsigned int nj)
+{
+    if (nj == 0)
+        return false;
+
+    for (unsigned int i = 0; i < nb; i++) {
+        const dxBody *b = body[i];
+        if ((b->flags & dxBodyAutoDisable) == 0 || b->adis.average_samples == 0
+            || b->adis_stepsleft > 0 || b->adis_timeleft > 0)
+            return false;
+    }
+    return true;
+}
+
+// disable the bodies of an island and link them in a ring, so that waking
+// any of them wakes all
+static void sleepIsland (dxWorld *world, dxBody *const *body, unsigned int nb)
+{
+    for (unsigned int i = 0; i < nb; i++) {
+        dxBody *b = body[i];
+        b->flags |= dxBodyDisabled | dxBodyIslandAsleep;
+        dZeroVector3r4(b->lvel);
+        dZeroVector3r4(b->avel);
+        b->adis_island_next = body[i + 1 < nb ? i + 1 : 0];
+    }
+    world->asleep_islands++;
+    world->asleep_bodies += nb;
+}
+
+void dxWakeIsland (dxBody *b)
+{
+    dIASSERT(b->flags & dxBodyIslandAsleep);
+
+    dxWorld *world = b->world;
+    int count = 0;
+    dxBody *m = b;
+    do {
+        dxBody *next = m->adis_island_next;
+        m->flags &= ~(dxBodyDisabled | dxBodyIslandAsleep);
+        m->adis_stepsleft = m->adis.idle_steps;
+        m->adis_timeleft = m->adis.idle_time;
+        m->adis_island_next = NULL;
+        count++;
+        m = next;
+    } while (m != b);
+
+    world->asleep_islands--;
+    world->asleep_bodies -= count;
+}
+
+
 //****************************************************************************
 // body rotation
 
@@ -704,7 +760,8 @@ static size_t EstimateIslandProcessingMemoryRequirements(dxWorld *world)
     size_t jointssize = dEFFICIENT_SIZE((size_t)(unsigned)world->nj * sizeof(dxJoint*));
     res += bodiessize + jointssize;
 
-    size_t sesize = (bodiessize < jointssize) ? bodiessize : jointssize;
+    // waking a sleeping island pushes its bodies without going through joints
+    size_t sesize = (bodiessize < jointssize || world->adis_islands) ? bodiessize : jointssize;
     res += sesize;
 
     return res;
@@ -732,8 +789,9 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
         // allocate a stack of unvisited bodies in the island. the maximum size of
         // the stack can be the lesser of the number of bodies or joints, because
         // new bodies are only ever added to the stack by going through untagged
-        // joints. all the bodies in the stack must be tagged!
-        unsigned int stackalloc = (nj < nb) ? nj : nb;
+        // joints. all the bodies in the stack must be tagged! waking a sleeping
+        // island pushes its bodies without joints, so it needs room for all.
+        unsigned int stackalloc = (nj < nb && !world->adis_islands) ? nj : nb;
         dxBody **stack = memarena->AllocateArray<dxBody *>(stackalloc);
 
         {
@@ -777,6 +835,17 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
                                         // Make sure all bodies are in the enabled state.
                                         nbody->flags &= ~dxBodyDisabled;
                                         stack[stacksize++] = nbody;
+
+                                        // the island it fell asleep with wakes with it
+                                        if (nbody->flags & dxBodyIslandAsleep) {
+                                            for (dxBody *m = nbody->adis_island_next; m != nbody; m = m->adis_island_next) {
+                                                if (m->tag <= 0) {
+                                                    m->tag = 1;
+                                                    stack[stacksize++] = m;
+                                                }
+                                            }
+                                            dxWakeIsland(nbody);
+                                        }
                                     }
                                 } else {
                                     njoint->tag = -1; // Used in Step to prevent search over disabled joints (not needed for QuickStep so far)
@@ -784,7 +853,7 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
                             }
                         }
                         dIASSERT(stacksize <= (unsigned int)world->nb);
-                        dIASSERT(stacksize <= (unsigned int)world->nj);
+                        dIASSERT(stacksize <= (unsigned int)world->nj || world->adis_islands);
 
                         if (stacksize == 0) {
                             break;
@@ -799,6 +868,14 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
                     dIASSERT((size_t)(bodycurr - bodystart) <= (size_t)UINT_MAX);
                     dIASSERT((size_t)(jointcurr - jointstart) <= (size_t)UINT_MAX);
 
+                    if (world->adis_islands && islandIsIdle(bodystart, bcount, jcount)) {
+                        // drop the island from this step, untagged as a disabled one
+                        sleepIsland(world, bodystart, bcount);
+                        for (unsigned int i = 0; i < bcount; i++) bodystart[i]->tag = -1;
+                        for (unsigned int i = 0; i < jcount; i++) jointstart[i]->tag = 0;
+                        continue;
+                    }
+
                     sizescurr[dxISE_BODIES_COUNT] = bcount;
                     sizescurr[dxISE_JOINTS_COUNT] = jcount;
                     sizescurr += dxISE__MAX;
@@ -845,6 +922,11 @@ static size_t BuildIslandsAndEstimateStepperMemoryRequirements(
     size_t islandcount = ((size_t)(sizescurr - islandsizes) / dxISE__MAX);
     islandsinfo.AssignInfo(islandcount, islandsizes, body, joint);
 
+    world->awake_islands = (int)islandcount;
+    world->awake_bodies = 0;
+    for (size_t i = 0; i < islandcount; i++)
+        world->awake_bodies += (int)islandsizes[i * dxISE__MAX + dxISE_BODIES_COUNT];
+
     return maxreq;
 }
 
@@ -1033,6 +1115,9 @@ void dxIslandsProcessingCallContext::ThreadedProcessIslandSearch(dxSingleIslandC
 
     if (finalizeJob) {
         dxWorldProcessMemArena *stepperArena = stepperCallContext->m_stepperArena;
+        if (m_world->stepstats.IsEnabled()) {
+            m_world->stepstats.UpdateArenaHighWater(stepperArena->GetHighWaterSize());
+        }
         stepperCallContext->dxSingleIslandCallContext::~dxSingleIslandCallContext();
 
         dxWorldProcessContext *context = m_world->UnsafeGetWorldProcessingContext(); 
@@ -1111,6 +1196,7 @@ dxWorldProcessMemArena *dxWorldProcessMemArena::ReallocateMemArena (
             arena->m_pAllocEnd = blockend;
             arena->m_pArenaBegin = pNewArenaBuffer;
             arena->m_pAllocCurrentOrNextArena = NULL;
+            arena->m_pAllocHighWater = blockbegin;
             arena->m_pArenaMemMgr = memmgr;
         }
 
@@ -1185,9 +1271,27 @@ bool dxReallocateWorldProcessContext (dxWorld *world, dxWorldProcessIslandsInfo
         }
         dIASSERT(islandsArena->IsStructureValid());
 
+        dxStepStatsLap statsLap(world->stepstats);
+
         size_t stepperReq = BuildIslandsAndEstimateStepperMemoryRequirements(islandsInfo, islandsArena, world, stepSize, stepperEstimate);
         dIASSERT(stepperReq == dEFFICIENT_SIZE(stepperReq));
 
+        if (statsLap.IsActive()) {
+            statsLap.Lap(dxSST_ISLANDS);
+
+            size_t islandsCount = islandsInfo.GetIslandsCount();
+            unsigned int const *islandSizes = islandsInfo.GetIslandSizes();
+            size_t bodiesCount = 0, jointsCount = 0;
+            for (size_t islandIndex = 0; islandIndex != islandsCount; ++islandIndex) {
+                bodiesCount += islandSizes[islandIndex * dxISE__MAX + dxISE_BODIES_COUNT];
+                jointsCount += islandSizes[islandIndex * dxISE__MAX + dxISE_JOINTS_COUNT];
+            }
+            statsLap.Count(dxSSC_ISLANDS, islandsCount);
+            statsLap.Count(dxSSC_BODIES, bodiesCount);
+            statsLap.Count(dxSSC_JOINTS, jointsCount);
+            world->stepstats.ReserveIslands(islandsCount);
+        }
+
         size_t stepperReqWithCallContext = stepperReq + dEFFICIENT_SIZE(sizeof(dxSingleIslandCallContext));
 
         unsigned islandThreadsCount = world->GetThreadingIslandsMaxThreadsCount();
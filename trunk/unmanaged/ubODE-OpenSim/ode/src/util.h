@@ -61,6 +61,7 @@
 #endif
 
 void dInternalHandleAutoDisabling (dxWorld *world, dReal stepsize);
+void dxWakeIsland (dxBody *b);
 void dxStepBody (dxBody *b, dReal h);
 
 
@@ -157,6 +158,12 @@ public:
     void ResetState()
     {
         m_pAllocCurrentOrNextArena = m_pAllocBegin;
+        m_pAllocHighWater = m_pAllocBegin;
+    }
+
+    size_t GetHighWaterSize() const
+    {
+        return (size_t)m_pAllocHighWater - (size_t)m_pAllocBegin;
     }
 
     void *PeekBufferRemainder() const
@@ -169,6 +176,9 @@ public:
         void *block = m_pAllocCurrentOrNextArena;
         m_pAllocCurrentOrNextArena = dOFFSET_EFFICIENTLY(block, size);
         dIASSERT(m_pAllocCurrentOrNextArena <= m_pAllocEnd);
+        if (m_pAllocCurrentOrNextArena > m_pAllocHighWater) {
+            m_pAllocHighWater = m_pAllocCurrentOrNextArena;
+        }
         return block;
     }
 
@@ -200,6 +210,7 @@ private:
 
 private:
     void *m_pAllocCurrentOrNextArena;
+    void *m_pAllocHighWater;
     void *m_pAllocBegin;
     void *m_pAllocEnd;
     void *m_pArenaBegin;